@@ -1,2 +1,2 @@
-from .ragfile import RagFile
+from .ragfile import RagFile, LshIndex, create_many, match_many, minhash_windows, open
 from .metadata import RagFileMetaV1
@@ -74,7 +74,7 @@ class RagFileBuilderHF:
             token_ids=token_list["input_ids"],
             embedding_id=self.model.name_or_path,
             tokenizer_id=self.tokenizer.name_or_path,
-            embeddings=embeddings.tolist(),
+            embeddings=embeddings.float().cpu().contiguous().numpy(),
             extended_metadata=metadata,
             metadata_version=self.metadata_ver,
         )
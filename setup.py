@@ -12,15 +12,18 @@ include_dirs = [
     "src/algorithms",
     "src/search",
     "src/utils",
+    "src/index",
 ]
 
 # Common sources
 common_sources = [
     "src/python/pyragfile.c",
     "src/python/pyragfileheader.c",
+    "src/python/pyarrayview.c",
     "src/python/similarity.c",
     "src/python/utility.c",
     "src/core/ragfile.c",
+    "src/core/ragfile_batch.c",
     "src/core/minhash.c",
     "src/utils/strdup.c",
     "src/algorithms/quantize.c",
@@ -29,12 +32,19 @@ common_sources = [
     "src/algorithms/cosine.c",
     "src/search/heap.c",
     "src/search/scan.c",
+    "src/search/uring_scan.c",
+    "src/search/cascade.c",
     "src/utils/file_io.c",
+    "src/utils/thread_pool.c",
+    "src/utils/dir_walk.c",
+    "src/index/ragidx.c",
+    "src/index/lsh.c",
 ]
 
 # Specific sources for the ragfile module
 ragfile_module_sources = common_sources + [
     "src/python/ragfilemodule.c",
+    "src/python/pylshindex.c",
 ]
 
 # Specific sources for the io module
@@ -47,7 +57,8 @@ ragfile_module = Extension(
     "ragfile.ragfile",
     sources=ragfile_module_sources,
     include_dirs=include_dirs,
-    extra_compile_args=["-std=c11"] if sys.platform != "win32" else [],
+    extra_compile_args=["-std=c11", "-pthread"] if sys.platform != "win32" else [],
+    extra_link_args=["-pthread"] if sys.platform != "win32" else [],
 )
 
 # Extension for io module
@@ -55,7 +66,8 @@ ragfile_io = Extension(
     "ragfile.io",
     sources=ragfile_io_sources,
     include_dirs=include_dirs,
-    extra_compile_args=["-std=c11"] if sys.platform != "win32" else [],
+    extra_compile_args=["-std=c11", "-pthread"] if sys.platform != "win32" else [],
+    extra_link_args=["-pthread"] if sys.platform != "win32" else [],
 )
 
 setup(
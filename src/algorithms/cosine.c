@@ -1,27 +1,479 @@
 #include "cosine.h"
 #include <math.h>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COSINE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define COSINE_TILE 4               // Rows and columns of the register tile
+#define COSINE_BLOCK_ROWS 64        // Vectors of set1 kept in cache while set2 streams past
+#define COSINE_BLOCK_COLS 64        // Vectors of set2 per block of scores
+#define COSINE_BLOCK_DEPTH 1024     // Floats of each vector per pass over a block
+
+typedef float (*DotProductFn)(const float* vec1, const float* vec2, size_t size);
+
+// Dot products of COSINE_TILE rows with COSINE_TILE columns over depth floats, written to out[row * COSINE_TILE + col]
+typedef void (*DotTileFn)(const float* const* rows, const float* const* cols, size_t depth, float* out);
+
+// Four accumulators break the dependency chain of a sequential sum
+static float dot_product_scalar(const float* vec1, const float* vec2, size_t size) {
+    float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        sum0 += vec1[i] * vec2[i];
+        sum1 += vec1[i + 1] * vec2[i + 1];
+        sum2 += vec1[i + 2] * vec2[i + 2];
+        sum3 += vec1[i + 3] * vec2[i + 3];
+    }
+    for (; i < size; i++) {
+        sum0 += vec1[i] * vec2[i];
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+// Each loaded value feeds four products, so the tile does four times the work of a dot product per load
+static void dot_tile_scalar(const float* const* rows, const float* const* cols, size_t depth, float* out) {
+    float acc[COSINE_TILE * COSINE_TILE] = {0};
+    for (size_t k = 0; k < depth; k++) {
+        for (size_t r = 0; r < COSINE_TILE; r++) {
+            const float a = rows[r][k];
+            for (size_t c = 0; c < COSINE_TILE; c++) {
+                acc[r * COSINE_TILE + c] += a * cols[c][k];
+            }
+        }
+    }
+    for (size_t i = 0; i < COSINE_TILE * COSINE_TILE; i++) {
+        out[i] = acc[i];
+    }
+}
+
+#ifdef COSINE_X86_KERNELS
+// Four vectors of accumulators hide the latency of the fused multiply-adds
+__attribute__((target("avx2,fma")))
+static float dot_product_avx2(const float* vec1, const float* vec2, size_t size) {
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(vec1 + i), _mm256_loadu_ps(vec2 + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(vec1 + i + 8), _mm256_loadu_ps(vec2 + i + 8), acc1);
+        acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(vec1 + i + 16), _mm256_loadu_ps(vec2 + i + 16), acc2);
+        acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(vec1 + i + 24), _mm256_loadu_ps(vec2 + i + 24), acc3);
+    }
+    for (; i + 8 <= size; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(vec1 + i), _mm256_loadu_ps(vec2 + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+    float result = _mm_cvtss_f32(sum);
+    for (; i < size; i++) {
+        result += vec1[i] * vec2[i];
+    }
+    return result;
+}
+
+// As dot_product_avx2 with 16 floats per vector; the tail is a masked load
+__attribute__((target("avx512f")))
+static float dot_product_avx512(const float* vec1, const float* vec2, size_t size) {
+    __m512 acc0 = _mm512_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    size_t i = 0;
+    for (; i + 64 <= size; i += 64) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(vec1 + i), _mm512_loadu_ps(vec2 + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(vec1 + i + 16), _mm512_loadu_ps(vec2 + i + 16), acc1);
+        acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(vec1 + i + 32), _mm512_loadu_ps(vec2 + i + 32), acc2);
+        acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(vec1 + i + 48), _mm512_loadu_ps(vec2 + i + 48), acc3);
+    }
+    for (; i + 16 <= size; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(vec1 + i), _mm512_loadu_ps(vec2 + i), acc0);
+    }
+    if (i < size) {
+        __mmask16 mask = (__mmask16)((1u << (size - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, vec1 + i), _mm512_maskz_loadu_ps(mask, vec2 + i), acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3)));
+}
+
+// Horizontal sums of four vectors, as the four lanes of one
+__attribute__((target("avx2")))
+static inline __m128 hsum4_avx2(__m256 a, __m256 b, __m256 c, __m256 d) {
+    __m128 a4 = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    __m128 b4 = _mm_add_ps(_mm256_castps256_ps128(b), _mm256_extractf128_ps(b, 1));
+    __m128 c4 = _mm_add_ps(_mm256_castps256_ps128(c), _mm256_extractf128_ps(c, 1));
+    __m128 d4 = _mm_add_ps(_mm256_castps256_ps128(d), _mm256_extractf128_ps(d, 1));
+    return _mm_hadd_ps(_mm_hadd_ps(a4, b4), _mm_hadd_ps(c4, d4));
+}
+
+// A 4x4 tile needs 16 accumulators, all the registers AVX2 has, so it is computed as two 2x4 halves
+__attribute__((target("avx2,fma")))
+static void dot_tile_avx2(const float* const* rows, const float* const* cols, size_t depth, float* out) {
+    for (size_t r = 0; r < COSINE_TILE; r += 2) {
+        const float* row0 = rows[r];
+        const float* row1 = rows[r + 1];
+        __m256 acc00 = _mm256_setzero_ps(), acc01 = acc00, acc02 = acc00, acc03 = acc00;
+        __m256 acc10 = acc00, acc11 = acc00, acc12 = acc00, acc13 = acc00;
+        size_t k = 0;
+        for (; k + 8 <= depth; k += 8) {
+            __m256 a0 = _mm256_loadu_ps(row0 + k);
+            __m256 a1 = _mm256_loadu_ps(row1 + k);
+            __m256 b0 = _mm256_loadu_ps(cols[0] + k);
+            __m256 b1 = _mm256_loadu_ps(cols[1] + k);
+            __m256 b2 = _mm256_loadu_ps(cols[2] + k);
+            __m256 b3 = _mm256_loadu_ps(cols[3] + k);
+            acc00 = _mm256_fmadd_ps(a0, b0, acc00);
+            acc01 = _mm256_fmadd_ps(a0, b1, acc01);
+            acc02 = _mm256_fmadd_ps(a0, b2, acc02);
+            acc03 = _mm256_fmadd_ps(a0, b3, acc03);
+            acc10 = _mm256_fmadd_ps(a1, b0, acc10);
+            acc11 = _mm256_fmadd_ps(a1, b1, acc11);
+            acc12 = _mm256_fmadd_ps(a1, b2, acc12);
+            acc13 = _mm256_fmadd_ps(a1, b3, acc13);
+        }
+        _mm_storeu_ps(out + r * COSINE_TILE, hsum4_avx2(acc00, acc01, acc02, acc03));
+        _mm_storeu_ps(out + (r + 1) * COSINE_TILE, hsum4_avx2(acc10, acc11, acc12, acc13));
+        for (; k < depth; k++) {
+            for (size_t c = 0; c < COSINE_TILE; c++) {
+                out[r * COSINE_TILE + c] += row0[k] * cols[c][k];
+                out[(r + 1) * COSINE_TILE + c] += row1[k] * cols[c][k];
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static inline __m128 hsum4_avx512(__m512 a, __m512 b, __m512 c, __m512 d) {
+    __m256 a8 = _mm256_add_ps(_mm512_castps512_ps256(a), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)));
+    __m256 b8 = _mm256_add_ps(_mm512_castps512_ps256(b), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(b), 1)));
+    __m256 c8 = _mm256_add_ps(_mm512_castps512_ps256(c), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(c), 1)));
+    __m256 d8 = _mm256_add_ps(_mm512_castps512_ps256(d), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(d), 1)));
+    return hsum4_avx2(a8, b8, c8, d8);
+}
+
+// The full 4x4 tile fits in the 32 AVX-512 registers; the tail is a masked step
+__attribute__((target("avx512f")))
+static void dot_tile_avx512(const float* const* rows, const float* const* cols, size_t depth, float* out) {
+    __m512 acc00 = _mm512_setzero_ps(), acc01 = acc00, acc02 = acc00, acc03 = acc00;
+    __m512 acc10 = acc00, acc11 = acc00, acc12 = acc00, acc13 = acc00;
+    __m512 acc20 = acc00, acc21 = acc00, acc22 = acc00, acc23 = acc00;
+    __m512 acc30 = acc00, acc31 = acc00, acc32 = acc00, acc33 = acc00;
+    for (size_t k = 0; k < depth; k += 16) {
+        __mmask16 mask = depth - k >= 16 ? (__mmask16)0xFFFF : (__mmask16)((1u << (depth - k)) - 1);
+        __m512 b0 = _mm512_maskz_loadu_ps(mask, cols[0] + k);
+        __m512 b1 = _mm512_maskz_loadu_ps(mask, cols[1] + k);
+        __m512 b2 = _mm512_maskz_loadu_ps(mask, cols[2] + k);
+        __m512 b3 = _mm512_maskz_loadu_ps(mask, cols[3] + k);
+        __m512 a = _mm512_maskz_loadu_ps(mask, rows[0] + k);
+        acc00 = _mm512_fmadd_ps(a, b0, acc00);
+        acc01 = _mm512_fmadd_ps(a, b1, acc01);
+        acc02 = _mm512_fmadd_ps(a, b2, acc02);
+        acc03 = _mm512_fmadd_ps(a, b3, acc03);
+        a = _mm512_maskz_loadu_ps(mask, rows[1] + k);
+        acc10 = _mm512_fmadd_ps(a, b0, acc10);
+        acc11 = _mm512_fmadd_ps(a, b1, acc11);
+        acc12 = _mm512_fmadd_ps(a, b2, acc12);
+        acc13 = _mm512_fmadd_ps(a, b3, acc13);
+        a = _mm512_maskz_loadu_ps(mask, rows[2] + k);
+        acc20 = _mm512_fmadd_ps(a, b0, acc20);
+        acc21 = _mm512_fmadd_ps(a, b1, acc21);
+        acc22 = _mm512_fmadd_ps(a, b2, acc22);
+        acc23 = _mm512_fmadd_ps(a, b3, acc23);
+        a = _mm512_maskz_loadu_ps(mask, rows[3] + k);
+        acc30 = _mm512_fmadd_ps(a, b0, acc30);
+        acc31 = _mm512_fmadd_ps(a, b1, acc31);
+        acc32 = _mm512_fmadd_ps(a, b2, acc32);
+        acc33 = _mm512_fmadd_ps(a, b3, acc33);
+    }
+    _mm_storeu_ps(out, hsum4_avx512(acc00, acc01, acc02, acc03));
+    _mm_storeu_ps(out + COSINE_TILE, hsum4_avx512(acc10, acc11, acc12, acc13));
+    _mm_storeu_ps(out + 2 * COSINE_TILE, hsum4_avx512(acc20, acc21, acc22, acc23));
+    _mm_storeu_ps(out + 3 * COSINE_TILE, hsum4_avx512(acc30, acc31, acc32, acc33));
+}
+#endif
+
+int cosine_kernel_supported(CosineKernel kernel) {
+    switch (kernel) {
+        case COSINE_KERNEL_AUTO:
+        case COSINE_KERNEL_SCALAR:
+            return 1;
+#ifdef COSINE_X86_KERNELS
+        case COSINE_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? 1 : 0;
+        case COSINE_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") ? 1 : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static CosineKernel cosine_resolve_kernel(CosineKernel kernel) {
+    if (kernel == COSINE_KERNEL_AUTO) {
+        kernel = cosine_kernel_supported(COSINE_KERNEL_AVX512) ? COSINE_KERNEL_AVX512
+               : cosine_kernel_supported(COSINE_KERNEL_AVX2) ? COSINE_KERNEL_AVX2
+               : COSINE_KERNEL_SCALAR;
+    }
+    return kernel;
+}
+
+static DotProductFn dot_product_fn(CosineKernel kernel) {
+    kernel = cosine_resolve_kernel(kernel);
+#ifdef COSINE_X86_KERNELS
+    if (kernel == COSINE_KERNEL_AVX512) {
+        return dot_product_avx512;
+    }
+    if (kernel == COSINE_KERNEL_AVX2) {
+        return dot_product_avx2;
+    }
+#endif
+    return dot_product_scalar;
+}
+
+static DotTileFn dot_tile_fn(CosineKernel kernel) {
+    kernel = cosine_resolve_kernel(kernel);
+#ifdef COSINE_X86_KERNELS
+    if (kernel == COSINE_KERNEL_AVX512) {
+        return dot_tile_avx512;
+    }
+    if (kernel == COSINE_KERNEL_AVX2) {
+        return dot_tile_avx2;
+    }
+#endif
+    return dot_tile_scalar;
+}
+
+float dot_product(const float* vec1, const float* vec2, size_t size) {
+    return dot_product_with_kernel(vec1, vec2, size, COSINE_KERNEL_AUTO);
+}
+
+float dot_product_with_kernel(const float* vec1, const float* vec2, size_t size, CosineKernel kernel) {
+    if (!vec1 || !vec2 || !cosine_kernel_supported(kernel)) {
+        return 0.0f;
+    }
+    return dot_product_fn(kernel)(vec1, vec2, size);
+}
+
 float cosine_similarity(const float* vec1, const float* vec2, size_t size) {
     if (!vec1 || !vec2 || size == 0) {
         return 0.0f;
     }
 
-    float dot_product = 0.0f;
-    float magnitude1 = 0.0f;
-    float magnitude2 = 0.0f;
+    const DotProductFn dot = dot_product_fn(COSINE_KERNEL_AUTO);
+    float magnitude1 = sqrtf(dot(vec1, vec1, size));
+    float magnitude2 = sqrtf(dot(vec2, vec2, size));
 
-    for (size_t i = 0; i < size; i++) {
-        dot_product += vec1[i] * vec2[i];
-        magnitude1 += vec1[i] * vec1[i];
-        magnitude2 += vec2[i] * vec2[i];
+    if (magnitude1 == 0.0f || magnitude2 == 0.0f) {
+        return 0.0f;
     }
 
-    magnitude1 = sqrtf(magnitude1);
-    magnitude2 = sqrtf(magnitude2);
+    return dot(vec1, vec2, size) / (magnitude1 * magnitude2);
+}
 
-    if (magnitude1 == 0.0f || magnitude2 == 0.0f) {
-        return 0.0f;
+void l2_norms(const float* vectors, size_t count, size_t size, float* norms) {
+    const DotProductFn dot = dot_product_fn(COSINE_KERNEL_AUTO);
+    for (size_t i = 0; i < count; i++) {
+        const float* vector = vectors + i * size;
+        norms[i] = sqrtf(dot(vector, vector, size));
+    }
+}
+
+void l2_normalize(float* vectors, size_t count, size_t size) {
+    const DotProductFn dot = dot_product_fn(COSINE_KERNEL_AUTO);
+    for (size_t i = 0; i < count; i++) {
+        float* vector = vectors + i * size;
+        float norm = sqrtf(dot(vector, vector, size));
+        if (norm == 0.0f) {
+            continue;
+        }
+        float scale = 1.0f / norm;
+        for (size_t j = 0; j < size; j++) {
+            vector[j] *= scale;
+        }
     }
+}
+
+// Dot products of num_rows vectors of set1 with num_cols vectors of set2, written to out[row * stride + col].
+// Full tiles go through the register-tiled kernel; the ragged edges are single dot products.
+static void dot_block(DotTileFn tile, DotProductFn dot, const float* set1, size_t num_rows,
+                      const float* set2, size_t num_cols, size_t size, float* out, size_t stride) {
+    for (size_t r = 0; r < num_rows; r++) {
+        for (size_t c = 0; c < num_cols; c++) {
+            out[r * stride + c] = 0.0f;
+        }
+    }
+
+    // Vectors longer than the block depth are split so a tile's rows and columns stay in L1
+    for (size_t k = 0; k < size; k += COSINE_BLOCK_DEPTH) {
+        size_t depth = size - k < COSINE_BLOCK_DEPTH ? size - k : COSINE_BLOCK_DEPTH;
+        for (size_t r = 0; r < num_rows; r += COSINE_TILE) {
+            size_t tile_rows = num_rows - r < COSINE_TILE ? num_rows - r : COSINE_TILE;
+            const float* rows[COSINE_TILE];
+            for (size_t t = 0; t < tile_rows; t++) {
+                rows[t] = set1 + (r + t) * size + k;
+            }
+            for (size_t c = 0; c < num_cols; c += COSINE_TILE) {
+                size_t tile_cols = num_cols - c < COSINE_TILE ? num_cols - c : COSINE_TILE;
+                const float* cols[COSINE_TILE];
+                for (size_t t = 0; t < tile_cols; t++) {
+                    cols[t] = set2 + (c + t) * size + k;
+                }
+
+                if (tile_rows < COSINE_TILE || tile_cols < COSINE_TILE) {
+                    for (size_t tr = 0; tr < tile_rows; tr++) {
+                        for (size_t tc = 0; tc < tile_cols; tc++) {
+                            out[(r + tr) * stride + c + tc] += dot(rows[tr], cols[tc], depth);
+                        }
+                    }
+                    continue;
+                }
+                float products[COSINE_TILE * COSINE_TILE];
+                tile(rows, cols, depth, products);
+                for (size_t tr = 0; tr < COSINE_TILE; tr++) {
+                    for (size_t tc = 0; tc < COSINE_TILE; tc++) {
+                        out[(r + tr) * stride + c + tc] += products[tr * COSINE_TILE + tc];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Turn a block of dot products into cosine similarities; zero vectors have no direction and score 0
+static void dot_block_normalize(const float* norms1, size_t num_rows, const float* norms2, size_t num_cols,
+                                float* out, size_t stride) {
+    if (!norms1 && !norms2) {
+        return;
+    }
+    for (size_t r = 0; r < num_rows; r++) {
+        float norm1 = norms1 ? norms1[r] : 1.0f;
+        for (size_t c = 0; c < num_cols; c++) {
+            float norm = norm1 * (norms2 ? norms2[c] : 1.0f);
+            out[r * stride + c] = norm == 0.0f ? 0.0f : out[r * stride + c] / norm;
+        }
+    }
+}
 
-    return dot_product / (magnitude1 * magnitude2);
+int cosine_similarity_matrix(const float* set1, const float* norms1, size_t count1,
+                             const float* set2, const float* norms2, size_t count2, size_t size, float* scores) {
+    return cosine_similarity_matrix_with_kernel(set1, norms1, count1, set2, norms2, count2, size, scores,
+                                                COSINE_KERNEL_AUTO);
+}
+
+int cosine_similarity_matrix_with_kernel(const float* set1, const float* norms1, size_t count1,
+                                         const float* set2, const float* norms2, size_t count2, size_t size,
+                                         float* scores, CosineKernel kernel) {
+    if ((count1 > 0 && !set1) || (count2 > 0 && !set2) || (count1 > 0 && count2 > 0 && !scores) ||
+        !cosine_kernel_supported(kernel)) {
+        return 0;
+    }
+    const DotTileFn tile = dot_tile_fn(kernel);
+    const DotProductFn dot = dot_product_fn(kernel);
+
+    for (size_t r = 0; r < count1; r += COSINE_BLOCK_ROWS) {
+        size_t num_rows = count1 - r < COSINE_BLOCK_ROWS ? count1 - r : COSINE_BLOCK_ROWS;
+        for (size_t c = 0; c < count2; c += COSINE_BLOCK_COLS) {
+            size_t num_cols = count2 - c < COSINE_BLOCK_COLS ? count2 - c : COSINE_BLOCK_COLS;
+            float* out = scores + r * count2 + c;
+            dot_block(tile, dot, set1 + r * size, num_rows, set2 + c * size, num_cols, size, out, count2);
+            dot_block_normalize(norms1 ? norms1 + r : NULL, num_rows, norms2 ? norms2 + c : NULL, num_cols,
+                                out, count2);
+        }
+    }
+    return 1;
+}
+
+typedef struct {
+    double max;      // Best pair
+    double total;    // Sum over all pairs
+    double maxsim;   // Sum over set1 of each vector's best pair
+} CosineTotals;
+
+// Reduce the similarity matrix a block at a time, so it never needs to be stored
+static void cosine_totals(const float* set1, const float* norms1, size_t count1,
+                          const float* set2, const float* norms2, size_t count2, size_t size, CosineTotals* totals) {
+    const DotTileFn tile = dot_tile_fn(COSINE_KERNEL_AUTO);
+    const DotProductFn dot = dot_product_fn(COSINE_KERNEL_AUTO);
+    float block[COSINE_BLOCK_ROWS * COSINE_BLOCK_COLS];
+    float row_max[COSINE_BLOCK_ROWS];
+    totals->max = -1.0;
+    totals->total = 0.0;
+    totals->maxsim = 0.0;
+    if (count2 == 0) {
+        return;
+    }
+
+    for (size_t r = 0; r < count1; r += COSINE_BLOCK_ROWS) {
+        size_t num_rows = count1 - r < COSINE_BLOCK_ROWS ? count1 - r : COSINE_BLOCK_ROWS;
+        for (size_t c = 0; c < count2; c += COSINE_BLOCK_COLS) {
+            size_t num_cols = count2 - c < COSINE_BLOCK_COLS ? count2 - c : COSINE_BLOCK_COLS;
+            dot_block(tile, dot, set1 + r * size, num_rows, set2 + c * size, num_cols, size, block, num_cols);
+            dot_block_normalize(norms1 ? norms1 + r : NULL, num_rows, norms2 ? norms2 + c : NULL, num_cols,
+                                block, num_cols);
+            for (size_t i = 0; i < num_rows; i++) {
+                float best = c == 0 ? block[i * num_cols] : row_max[i];
+                double row_total = 0.0;
+                for (size_t j = 0; j < num_cols; j++) {
+                    float similarity = block[i * num_cols + j];
+                    best = similarity > best ? similarity : best;
+                    row_total += similarity;
+                }
+                row_max[i] = best;
+                totals->total += row_total;
+            }
+        }
+        for (size_t i = 0; i < num_rows; i++) {
+            totals->max = row_max[i] > totals->max ? row_max[i] : totals->max;
+            totals->maxsim += row_max[i];
+        }
+    }
+}
+
+void cosine_similarity_pairs(const float* set1, const float* norms1, size_t count1,
+                             const float* set2, const float* norms2, size_t count2, size_t size,
+                             double* max_similarity, double* mean_similarity) {
+    CosineTotals totals;
+    cosine_totals(set1, norms1, count1, set2, norms2, count2, size, &totals);
+    if (max_similarity) {
+        *max_similarity = totals.max;
+    }
+    if (mean_similarity) {
+        *mean_similarity = count1 > 0 && count2 > 0 ? totals.total / ((double)count1 * (double)count2) : 0.0;
+    }
+}
+
+double cosine_similarity_reduce(const float* set1, const float* norms1, size_t count1,
+                                const float* set2, const float* norms2, size_t count2, size_t size,
+                                CosineReduction reduction) {
+    CosineTotals totals;
+    cosine_totals(set1, norms1, count1, set2, norms2, count2, size, &totals);
+    switch (reduction) {
+        case COSINE_REDUCE_MEAN:
+            return count1 > 0 && count2 > 0 ? totals.total / ((double)count1 * (double)count2) : 0.0;
+        case COSINE_REDUCE_MAXSIM:
+            return totals.maxsim;
+        default:
+            return totals.max;
+    }
+}
+
+int cosine_similarity_batch(const float* query, const float* query_norms, size_t query_count,
+                            const float* const* candidates, const float* const* candidate_norms,
+                            const size_t* candidate_counts, size_t num_candidates, size_t size,
+                            CosineReduction reduction, double* scores) {
+    if ((query_count > 0 && !query) || (num_candidates > 0 && (!candidates || !candidate_counts || !scores))) {
+        return 0;
+    }
+    for (size_t i = 0; i < num_candidates; i++) {
+        if (candidate_counts[i] > 0 && !candidates[i]) {
+            return 0;
+        }
+    }
+
+    // The query is the row side of every block, so it stays in cache from one candidate to the next
+    for (size_t i = 0; i < num_candidates; i++) {
+        scores[i] = cosine_similarity_reduce(query, query_norms, query_count, candidates[i],
+                                             candidate_norms ? candidate_norms[i] : NULL, candidate_counts[i],
+                                             size, reduction);
+    }
+    return 1;
 }
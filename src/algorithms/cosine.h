@@ -3,6 +3,27 @@
 
 #include <stddef.h>
 
+/**
+ * Implementations of the dot product loop. Each keeps several independent
+ * accumulators, so results differ from a sequential sum by rounding only.
+ */
+typedef enum {
+    COSINE_KERNEL_AUTO = 0,   // Widest kernel the CPU supports
+    COSINE_KERNEL_SCALAR,     // Portable C
+    COSINE_KERNEL_AVX2,       // 8 floats per fused multiply-add (x86 with AVX2 and FMA)
+    COSINE_KERNEL_AVX512      // 16 floats per fused multiply-add (x86 with AVX-512F)
+} CosineKernel;
+
+/**
+ * Ways of reducing the similarities of every pair of vectors from two sets to
+ * a single score.
+ */
+typedef enum {
+    COSINE_REDUCE_MAX = 0,   // Best pair
+    COSINE_REDUCE_MEAN,      // Mean over all pairs
+    COSINE_REDUCE_MAXSIM     // Late interaction: sum over set1 of each vector's best match in set2
+} CosineReduction;
+
 /**
  * Compute cosine similarity between two vectors.
  *
@@ -13,4 +34,141 @@
  */
 float cosine_similarity(const float* vec1, const float* vec2, size_t size);
 
+/**
+ * Compute the dot product of two vectors with the kernel picked for the CPU
+ * at run time.
+ *
+ * @param vec1 Pointer to the first vector.
+ * @param vec2 Pointer to the second vector.
+ * @param size Size of the vectors.
+ * @return The dot product.
+ */
+float dot_product(const float* vec1, const float* vec2, size_t size);
+
+/**
+ * Compute the dot product of two vectors with a given kernel.
+ *
+ * @param vec1 Pointer to the first vector.
+ * @param vec2 Pointer to the second vector.
+ * @param size Size of the vectors.
+ * @param kernel Kernel to use.
+ * @return The dot product, or 0 if the CPU does not support the kernel.
+ */
+float dot_product_with_kernel(const float* vec1, const float* vec2, size_t size, CosineKernel kernel);
+
+/**
+ * Compute the L2 norm of each of count vectors stored back to back.
+ *
+ * @param vectors Pointer to count vectors of size floats.
+ * @param count Number of vectors.
+ * @param size Size of each vector.
+ * @param norms Array of count norms to fill.
+ */
+void l2_norms(const float* vectors, size_t count, size_t size, float* norms);
+
+/**
+ * Scale each of count vectors stored back to back to unit L2 norm in place.
+ * Zero vectors are left as they are.
+ *
+ * @param vectors Pointer to count vectors of size floats.
+ * @param count Number of vectors.
+ * @param size Size of each vector.
+ */
+void l2_normalize(float* vectors, size_t count, size_t size);
+
+/**
+ * Compare every vector of one set with every vector of another by cosine
+ * similarity, reducing to both COSINE_REDUCE_MAX and COSINE_REDUCE_MEAN in one
+ * pass. Norms are passed in rather than recomputed for each pair; a NULL norm
+ * array means the set holds unit vectors, and the similarity is then the dot
+ * product itself.
+ *
+ * @param set1 Pointer to count1 vectors of size floats.
+ * @param norms1 Norms of set1, or NULL if its vectors are L2-normalized.
+ * @param count1 Number of vectors in set1.
+ * @param set2 Pointer to count2 vectors of size floats.
+ * @param norms2 Norms of set2, or NULL if its vectors are L2-normalized.
+ * @param count2 Number of vectors in set2.
+ * @param size Size of each vector.
+ * @param max_similarity Optional; receives the best pair similarity (-1 if a set is empty).
+ * @param mean_similarity Optional; receives the mean pair similarity (0 if a set is empty).
+ */
+void cosine_similarity_pairs(const float* set1, const float* norms1, size_t count1,
+                             const float* set2, const float* norms2, size_t count2, size_t size,
+                             double* max_similarity, double* mean_similarity);
+
+/**
+ * Compute the cosine similarity of every vector of one set with every vector
+ * of another. The matrix is computed in cache-sized blocks, each from 4x4 tiles
+ * of dot products held in registers, so every loaded value is used four times.
+ *
+ * @param set1 Pointer to count1 vectors of size floats.
+ * @param norms1 Norms of set1, or NULL if its vectors are L2-normalized.
+ * @param count1 Number of vectors in set1.
+ * @param set2 Pointer to count2 vectors of size floats.
+ * @param norms2 Norms of set2, or NULL if its vectors are L2-normalized.
+ * @param count2 Number of vectors in set2.
+ * @param size Size of each vector.
+ * @param scores Array of count1 * count2 similarities to fill, scores[i * count2 + j] for set1[i] and set2[j].
+ * @return 1 on success, 0 if an argument is invalid.
+ */
+int cosine_similarity_matrix(const float* set1, const float* norms1, size_t count1,
+                             const float* set2, const float* norms2, size_t count2, size_t size, float* scores);
+
+/**
+ * cosine_similarity_matrix with a given kernel.
+ *
+ * @return 1 on success, 0 if an argument is invalid or the CPU does not support the kernel.
+ */
+int cosine_similarity_matrix_with_kernel(const float* set1, const float* norms1, size_t count1,
+                                         const float* set2, const float* norms2, size_t count2, size_t size,
+                                         float* scores, CosineKernel kernel);
+
+/**
+ * Compare two sets of vectors and reduce the similarity matrix to one score.
+ * The matrix is reduced a block at a time as it is computed, and never stored.
+ *
+ * @param set1 Pointer to count1 vectors of size floats (the query side for COSINE_REDUCE_MAXSIM).
+ * @param norms1 Norms of set1, or NULL if its vectors are L2-normalized.
+ * @param count1 Number of vectors in set1.
+ * @param set2 Pointer to count2 vectors of size floats.
+ * @param norms2 Norms of set2, or NULL if its vectors are L2-normalized.
+ * @param count2 Number of vectors in set2.
+ * @param size Size of each vector.
+ * @param reduction Reduction to apply.
+ * @return The score. If a set is empty, -1 for COSINE_REDUCE_MAX and 0 otherwise.
+ */
+double cosine_similarity_reduce(const float* set1, const float* norms1, size_t count1,
+                                const float* set2, const float* norms2, size_t count2, size_t size,
+                                CosineReduction reduction);
+
+/**
+ * Score a query set of vectors against a batch of candidate sets with
+ * cosine_similarity_reduce. The query stays in cache across the candidates.
+ *
+ * @param query Pointer to query_count vectors of size floats.
+ * @param query_norms Norms of the query, or NULL if its vectors are L2-normalized.
+ * @param query_count Number of query vectors.
+ * @param candidates Array of num_candidates pointers to candidate vectors.
+ * @param candidate_norms Array of num_candidates pointers to candidate norms (each NULL if normalized), or NULL if all are.
+ * @param candidate_counts Array of num_candidates vector counts.
+ * @param num_candidates Number of candidates.
+ * @param size Size of each vector.
+ * @param reduction Reduction to apply.
+ * @param scores Array of num_candidates scores to fill.
+ * @return 1 on success, 0 if an argument is invalid.
+ */
+int cosine_similarity_batch(const float* query, const float* query_norms, size_t query_count,
+                            const float* const* candidates, const float* const* candidate_norms,
+                            const size_t* candidate_counts, size_t num_candidates, size_t size,
+                            CosineReduction reduction, double* scores);
+
+/**
+ * Check whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return 1 if the kernel is supported, 0 otherwise. COSINE_KERNEL_AUTO and COSINE_KERNEL_SCALAR always are.
+ */
+int cosine_kernel_supported(CosineKernel kernel);
+
 #endif // COSINE_H
@@ -1,34 +1,318 @@
 #include "hamming.h"
-#include "../include/config.h"
-#include <stdio.h> // for NULL definition
+#include <string.h>
 
-// Compute Hamming distance for arrays of uint8_t
-int hamming_distance(uint8_t *vec1, uint8_t *vec2, size_t size) {
-    if (vec1 == NULL || vec2 == NULL) {
-        fprintf(stderr, "Null pointer passed to hamming_distance\n");
-        return -1; // Error code for null pointers
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HAMMING_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define HAMMING_BLOCK_SIZE 1024  // Distances computed per batch call by hamming_top_k
+
+// Count differing bits 64 at a time; inlined into each kernel so that it uses that kernel's popcount
+static inline __attribute__((always_inline)) uint32_t hamming_words(const uint8_t* vec1, const uint8_t* vec2, size_t size) {
+    uint32_t distance = 0;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, vec1 + i, sizeof(uint64_t));
+        memcpy(&b, vec2 + i, sizeof(uint64_t));
+        distance += (uint32_t)__builtin_popcountll(a ^ b);
     }
-    
-    int distance = 0;
-    for (size_t i = 0; i < size; i++) {
-        distance += __builtin_popcount(vec1[i] ^ vec2[i]);
+    for (; i < size; i++) {
+        distance += (uint32_t)__builtin_popcount(vec1[i] ^ vec2[i]);
     }
     return distance;
 }
 
-// Compute Hamming similarity for arrays of uint8_t
-double hamming_similarity(uint8_t *vec1, uint8_t *vec2, size_t size) {
+static inline __attribute__((always_inline)) void hamming_words_many(const uint8_t* query, const uint8_t* codes, size_t start,
+                                                                     size_t count, size_t size, uint16_t* distances) {
+    for (size_t n = start; n < count; n++) {
+        distances[n] = (uint16_t)hamming_words(query, codes + n * size, size);
+    }
+}
+
+static void hamming_kernel_scalar(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances) {
+    hamming_words_many(query, codes, 0, count, size, distances);
+}
+
+#ifdef HAMMING_X86_KERNELS
+__attribute__((target("popcnt")))
+static void hamming_kernel_popcnt(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances) {
+    hamming_words_many(query, codes, 0, count, size, distances);
+}
+
+// Sum the per-word popcounts of the codes packed into one vector
+static inline void hamming_sum_words(const uint64_t* words, size_t codes_per_vector, size_t words_per_code, uint16_t* distances) {
+    for (size_t c = 0; c < codes_per_vector; c++) {
+        uint64_t distance = 0;
+        for (size_t w = 0; w < words_per_code; w++) {
+            distance += words[c * words_per_code + w];
+        }
+        distances[c] = (uint16_t)distance;
+    }
+}
+
+// Popcount of each 64-bit word: nibbles are counted with a byte shuffle, then summed per word
+__attribute__((target("avx2")))
+static inline __m256i hamming_avx2_word_counts(__m256i x, __m256i lookup, __m256i low_mask) {
+    __m256i bytes = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_mask)),
+                                    _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask)));
+    return _mm256_sad_epu8(bytes, _mm256_setzero_si256());
+}
+
+// Codes that divide 32 bytes are packed several to a vector against a repeated query; others use popcnt
+__attribute__((target("avx2,popcnt")))
+static void hamming_kernel_avx2(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances) {
+    size_t n = 0;
+    if (size % sizeof(uint64_t) == 0 && 32 % size == 0) {
+        const size_t codes_per_vector = 32 / size;
+        uint8_t repeated[32] = {0};
+        for (size_t c = 0; c < codes_per_vector; c++) {
+            memcpy(repeated + c * size, query, size);
+        }
+        const __m256i q = _mm256_loadu_si256((const __m256i*)repeated);
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        uint64_t words[4];
+
+        // 16-byte binary embeddings are summed across two vectors, four codes per iteration
+        if (size == 16) {
+            for (; n + 4 <= count; n += 4) {
+                __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(codes + n * size)), q);
+                __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(codes + n * size + 32)), q);
+                a = hamming_avx2_word_counts(a, lookup, low_mask);
+                b = hamming_avx2_word_counts(b, lookup, low_mask);
+                // Lanes hold codes 0, 2, 1, 3
+                __m256i sums = _mm256_add_epi64(_mm256_unpacklo_epi64(a, b), _mm256_unpackhi_epi64(a, b));
+                _mm256_storeu_si256((__m256i*)words, sums);
+                distances[n] = (uint16_t)words[0];
+                distances[n + 1] = (uint16_t)words[2];
+                distances[n + 2] = (uint16_t)words[1];
+                distances[n + 3] = (uint16_t)words[3];
+            }
+        }
+
+        for (; n + codes_per_vector <= count; n += codes_per_vector) {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(codes + n * size)), q);
+            _mm256_storeu_si256((__m256i*)words, hamming_avx2_word_counts(x, lookup, low_mask));
+            hamming_sum_words(words, codes_per_vector, size / sizeof(uint64_t), distances + n);
+        }
+    }
+    hamming_words_many(query, codes, n, count, size, distances);
+}
+
+// As hamming_kernel_avx2 with 64-byte vectors, counting each 64-bit word in one instruction
+__attribute__((target("avx512f,avx512vpopcntdq,popcnt")))
+static void hamming_kernel_avx512(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances) {
+    size_t n = 0;
+    if (size % sizeof(uint64_t) == 0 && 64 % size == 0) {
+        const size_t codes_per_vector = 64 / size;
+        uint8_t repeated[64] = {0};
+        for (size_t c = 0; c < codes_per_vector; c++) {
+            memcpy(repeated + c * size, query, size);
+        }
+        const __m512i q = _mm512_loadu_si512((const void*)repeated);
+
+        // Binary embeddings of 8 or 16 bytes are reduced in registers, eight codes per iteration
+        if (size == 8) {
+            for (; n + 8 <= count; n += 8) {
+                __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(codes + n * size)), q);
+                _mm_storeu_si128((__m128i*)(distances + n), _mm512_cvtepi64_epi16(_mm512_popcnt_epi64(x)));
+            }
+        } else if (size == 16) {
+            const __m512i even = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+            const __m512i odd = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+            for (; n + 8 <= count; n += 8) {
+                __m512i a = _mm512_popcnt_epi64(_mm512_xor_si512(_mm512_loadu_si512((const void*)(codes + n * size)), q));
+                __m512i b = _mm512_popcnt_epi64(_mm512_xor_si512(_mm512_loadu_si512((const void*)(codes + n * size + 64)), q));
+                __m512i sums = _mm512_add_epi64(_mm512_permutex2var_epi64(a, even, b), _mm512_permutex2var_epi64(a, odd, b));
+                _mm_storeu_si128((__m128i*)(distances + n), _mm512_cvtepi64_epi16(sums));
+            }
+        }
+
+        uint64_t words[8];
+        for (; n + codes_per_vector <= count; n += codes_per_vector) {
+            __m512i x = _mm512_xor_si512(_mm512_loadu_si512((const void*)(codes + n * size)), q);
+            _mm512_storeu_si512((void*)words, _mm512_popcnt_epi64(x));
+            hamming_sum_words(words, codes_per_vector, size / sizeof(uint64_t), distances + n);
+        }
+    }
+    hamming_words_many(query, codes, n, count, size, distances);
+}
+#endif
+
+int hamming_kernel_supported(HammingKernel kernel) {
+    switch (kernel) {
+        case HAMMING_KERNEL_AUTO:
+        case HAMMING_KERNEL_SCALAR:
+            return 1;
+#ifdef HAMMING_X86_KERNELS
+        case HAMMING_KERNEL_POPCNT:
+            return __builtin_cpu_supports("popcnt") ? 1 : 0;
+        case HAMMING_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") ? 1 : 0;
+        case HAMMING_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq") &&
+                   __builtin_cpu_supports("popcnt") ? 1 : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static HammingKernel hamming_resolve_kernel(HammingKernel kernel) {
+    if (kernel != HAMMING_KERNEL_AUTO) {
+        return kernel;
+    }
+    return hamming_kernel_supported(HAMMING_KERNEL_AVX512) ? HAMMING_KERNEL_AVX512
+         : hamming_kernel_supported(HAMMING_KERNEL_AVX2) ? HAMMING_KERNEL_AVX2
+         : hamming_kernel_supported(HAMMING_KERNEL_POPCNT) ? HAMMING_KERNEL_POPCNT
+         : HAMMING_KERNEL_SCALAR;
+}
+
+typedef void (*HammingManyFn)(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances);
+
+static HammingManyFn hamming_many_fn(HammingKernel kernel) {
+#ifdef HAMMING_X86_KERNELS
+    switch (kernel) {
+        case HAMMING_KERNEL_AVX512:
+            return hamming_kernel_avx512;
+        case HAMMING_KERNEL_AVX2:
+            return hamming_kernel_avx2;
+        case HAMMING_KERNEL_POPCNT:
+            return hamming_kernel_popcnt;
+        default:
+            break;
+    }
+#endif
+    (void)kernel;
+    return hamming_kernel_scalar;
+}
+
+#ifdef HAMMING_X86_KERNELS
+__attribute__((target("popcnt")))
+static uint32_t hamming_words_popcnt(const uint8_t* vec1, const uint8_t* vec2, size_t size) {
+    return hamming_words(vec1, vec2, size);
+}
+#endif
+
+static uint32_t hamming_words_scalar(const uint8_t* vec1, const uint8_t* vec2, size_t size) {
+    return hamming_words(vec1, vec2, size);
+}
+
+int hamming_distance(const uint8_t* vec1, const uint8_t* vec2, size_t size) {
     if (vec1 == NULL || vec2 == NULL) {
-        fprintf(stderr, "Null pointer passed to hamming_similarity\n");
-        return -1.0; // Error code for null pointers
+        return -1;
+    }
+#ifdef HAMMING_X86_KERNELS
+    if (__builtin_cpu_supports("popcnt")) {
+        return (int)hamming_words_popcnt(vec1, vec2, size);
     }
-    
+#endif
+    return (int)hamming_words_scalar(vec1, vec2, size);
+}
+
+double hamming_similarity(const uint8_t* vec1, const uint8_t* vec2, size_t size) {
     int distance = hamming_distance(vec1, vec2, size);
-    if (distance == -1) { // Check if hamming_distance returned an error
-        return -1.0; // Propagate the error code
+    if (distance < 0 || size == 0) {
+        return -1.0;
+    }
+    double bits = (double)size * 8.0;
+    return (bits - distance) / bits;
+}
+
+int hamming_distance_many(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances) {
+    return hamming_distance_many_with_kernel(query, codes, count, size, distances, HAMMING_KERNEL_AUTO);
+}
+
+int hamming_distance_many_with_kernel(const uint8_t* query, const uint8_t* codes, size_t count, size_t size,
+                                      uint16_t* distances, HammingKernel kernel) {
+    if (!query || (count > 0 && (!codes || !distances)) || size > HAMMING_MAX_CODE_BYTES ||
+        !hamming_kernel_supported(kernel)) {
+        return -1;
     }
+    hamming_many_fn(hamming_resolve_kernel(kernel))(query, codes, count, size, distances);
+    return 0;
+}
 
-    int vector_dim = BINARY_EMBEDDING_DIM;
-    return (double)(vector_dim - distance) / (double)vector_dim;
+// Order matches by distance, then index, so that the heap root is the worst match kept
+static int hamming_match_worse(const HammingMatch* a, const HammingMatch* b) {
+    return a->distance > b->distance || (a->distance == b->distance && a->index > b->index);
 }
 
+static void hamming_sift_down(HammingMatch* heap, size_t size, size_t i) {
+    for (;;) {
+        size_t worst = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < size && hamming_match_worse(&heap[left], &heap[worst])) {
+            worst = left;
+        }
+        if (right < size && hamming_match_worse(&heap[right], &heap[worst])) {
+            worst = right;
+        }
+        if (worst == i) {
+            return;
+        }
+        HammingMatch tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
+    }
+}
+
+static void hamming_sift_up(HammingMatch* heap, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!hamming_match_worse(&heap[i], &heap[parent])) {
+            return;
+        }
+        HammingMatch tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+size_t hamming_top_k(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, size_t k,
+                     HammingMatch* matches) {
+    if (!query || (count > 0 && !codes) || (k > 0 && !matches) || size > HAMMING_MAX_CODE_BYTES) {
+        return 0;
+    }
+    if (k > count) {
+        k = count;
+    }
+    if (k == 0) {
+        return 0;
+    }
+
+    uint16_t distances[HAMMING_BLOCK_SIZE];
+    const HammingManyFn many = hamming_many_fn(hamming_resolve_kernel(HAMMING_KERNEL_AUTO));
+
+    // matches[] is a max-heap of the best k so far; codes in later blocks only enter when strictly closer
+    size_t kept = 0;
+    for (size_t block = 0; block < count; block += HAMMING_BLOCK_SIZE) {
+        size_t block_size = count - block < HAMMING_BLOCK_SIZE ? count - block : HAMMING_BLOCK_SIZE;
+        many(query, codes + block * size, block_size, size, distances);
+        for (size_t j = 0; j < block_size; j++) {
+            HammingMatch match = {.index = block + j, .distance = distances[j]};
+            if (kept < k) {
+                matches[kept] = match;
+                hamming_sift_up(matches, kept++);
+            } else if (match.distance < matches[0].distance) {
+                matches[0] = match;
+                hamming_sift_down(matches, k, 0);
+            }
+        }
+    }
+
+    // Pop the worst match to the back until the array is sorted best first
+    for (size_t end = k; end > 1; end--) {
+        HammingMatch tmp = matches[0];
+        matches[0] = matches[end - 1];
+        matches[end - 1] = tmp;
+        hamming_sift_down(matches, end - 1, 0);
+    }
+    return k;
+}
@@ -4,8 +4,92 @@
 #include <stdint.h>
 #include <stddef.h>
 
-int hamming_distance(uint8_t *vec1, uint8_t *vec2, size_t size);
-double hamming_similarity(uint8_t *vec1, uint8_t *vec2, size_t size);
+#define HAMMING_MAX_CODE_BYTES (UINT16_MAX / 8)  // Longest code whose distances fit in a uint16_t
 
-#endif // HAMMING_H
+/**
+ * Implementations of the batch Hamming loops. All of them produce the same
+ * distances.
+ */
+typedef enum {
+    HAMMING_KERNEL_AUTO = 0,   // Widest kernel the CPU supports
+    HAMMING_KERNEL_SCALAR,     // Portable C, 64-bit words
+    HAMMING_KERNEL_POPCNT,     // 64-bit words counted by the popcnt instruction (x86)
+    HAMMING_KERNEL_AVX2,       // 32 bytes per vector, counted with a nibble lookup table (x86 with AVX2)
+    HAMMING_KERNEL_AVX512      // 64 bytes per vector, counted with VPOPCNTDQ (x86 with AVX-512F and VPOPCNTDQ)
+} HammingKernel;
+
+// A code found by hamming_top_k
+typedef struct {
+    uint64_t index;     // Position of the code in the searched array
+    uint16_t distance;  // Number of differing bits from the query
+} HammingMatch;
+
+/**
+ * Compute the Hamming distance between two bit vectors, 64 bits at a time.
+ *
+ * @param vec1 Pointer to the first vector.
+ * @param vec2 Pointer to the second vector.
+ * @param size Size of the vectors in bytes.
+ * @return The number of differing bits, or -1 if a vector is NULL.
+ */
+int hamming_distance(const uint8_t* vec1, const uint8_t* vec2, size_t size);
+
+/**
+ * Compute the Hamming similarity between two bit vectors, the fraction of
+ * their size * 8 bits that are equal.
+ *
+ * @param vec1 Pointer to the first vector.
+ * @param vec2 Pointer to the second vector.
+ * @param size Size of the vectors in bytes.
+ * @return The similarity (between 0 and 1), or -1 if a vector is NULL.
+ */
+double hamming_similarity(const uint8_t* vec1, const uint8_t* vec2, size_t size);
+
+/**
+ * Compute the Hamming distance of a query code to each of count codes stored
+ * back to back. Codes of 8, 16 or 32 bytes (64 for AVX-512) are packed several
+ * to a vector, so short binary embeddings are compared a full vector at a time.
+ *
+ * @param query Pointer to the query code.
+ * @param codes Pointer to count codes of size bytes each.
+ * @param count Number of codes.
+ * @param size Size of each code in bytes (at most HAMMING_MAX_CODE_BYTES).
+ * @param distances Array of count distances to fill.
+ * @return 0 on success, -1 on invalid arguments.
+ */
+int hamming_distance_many(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, uint16_t* distances);
 
+/**
+ * hamming_distance_many with a given kernel.
+ *
+ * @return 0 on success, -1 on invalid arguments or if the CPU does not support the kernel.
+ */
+int hamming_distance_many_with_kernel(const uint8_t* query, const uint8_t* codes, size_t count, size_t size,
+                                      uint16_t* distances, HammingKernel kernel);
+
+/**
+ * Find the k codes closest to a query in a single pass. Distances are computed
+ * a block at a time by the batch kernel into a small buffer that stays in
+ * cache, and only codes closer than the current k-th best reach the heap, so
+ * the scan is bound by reading the codes.
+ *
+ * @param query Pointer to the query code.
+ * @param codes Pointer to count codes of size bytes each.
+ * @param count Number of codes.
+ * @param size Size of each code in bytes (at most HAMMING_MAX_CODE_BYTES).
+ * @param k Number of codes to keep.
+ * @param matches Array of k matches, filled by increasing distance, ties by increasing index.
+ * @return The number of matches written (min(k, count)), or 0 on invalid arguments.
+ */
+size_t hamming_top_k(const uint8_t* query, const uint8_t* codes, size_t count, size_t size, size_t k,
+                     HammingMatch* matches);
+
+/**
+ * Check whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return 1 if the kernel is supported, 0 otherwise. HAMMING_KERNEL_AUTO and HAMMING_KERNEL_SCALAR always are.
+ */
+int hamming_kernel_supported(HammingKernel kernel);
+
+#endif // HAMMING_H
@@ -1,17 +1,264 @@
 #include "../include/config.h"
 #include "jaccard.h"
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define JACCARD_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Queries compared per pass over a signature by the batch kernels
+#define JACCARD_QUERY_BLOCK 4
+
+// Count the slots two signatures agree on
+typedef uint32_t (*JaccardCountFn)(const uint32_t* mh1, const uint32_t* mh2);
+// Count the slots a signature agrees on with each of JACCARD_QUERY_BLOCK queries
+typedef void (*JaccardCountBlockFn)(const uint32_t* mh, const uint32_t* const* queries, uint32_t* counts);
+
+static uint32_t jaccard_count_scalar(const uint32_t* mh1, const uint32_t* mh2) {
+    uint32_t matches = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        matches += mh1[i] == mh2[i];
+    }
+    return matches;
+}
+
+static void jaccard_count_block_scalar(const uint32_t* mh, const uint32_t* const* queries, uint32_t* counts) {
+    const uint32_t* q0 = queries[0];
+    const uint32_t* q1 = queries[1];
+    const uint32_t* q2 = queries[2];
+    const uint32_t* q3 = queries[3];
+    uint32_t m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        uint32_t value = mh[i];
+        m0 += q0[i] == value;
+        m1 += q1[i] == value;
+        m2 += q2[i] == value;
+        m3 += q3[i] == value;
+    }
+    counts[0] = m0;
+    counts[1] = m1;
+    counts[2] = m2;
+    counts[3] = m3;
+}
+
+#ifdef JACCARD_X86_KERNELS
+// Equal lanes compare to -1, so subtracting the comparisons counts matches per lane
+__attribute__((target("avx2")))
+static uint32_t jaccard_sum_avx2(__m256i counts) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+static uint32_t jaccard_count_avx2(const uint32_t* mh1, const uint32_t* mh2) {
+    __m256i counts = _mm256_setzero_si256();
+    for (size_t i = 0; i < MINHASH_SIZE; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(mh1 + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(mh2 + i));
+        counts = _mm256_sub_epi32(counts, _mm256_cmpeq_epi32(a, b));
+    }
+    return jaccard_sum_avx2(counts);
+}
+
+__attribute__((target("avx2")))
+static void jaccard_count_block_avx2(const uint32_t* mh, const uint32_t* const* queries, uint32_t* counts) {
+    __m256i c0 = _mm256_setzero_si256(), c1 = c0, c2 = c0, c3 = c0;
+    for (size_t i = 0; i < MINHASH_SIZE; i += 8) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)(mh + i));
+        c0 = _mm256_sub_epi32(c0, _mm256_cmpeq_epi32(value, _mm256_loadu_si256((const __m256i*)(queries[0] + i))));
+        c1 = _mm256_sub_epi32(c1, _mm256_cmpeq_epi32(value, _mm256_loadu_si256((const __m256i*)(queries[1] + i))));
+        c2 = _mm256_sub_epi32(c2, _mm256_cmpeq_epi32(value, _mm256_loadu_si256((const __m256i*)(queries[2] + i))));
+        c3 = _mm256_sub_epi32(c3, _mm256_cmpeq_epi32(value, _mm256_loadu_si256((const __m256i*)(queries[3] + i))));
+    }
+    counts[0] = jaccard_sum_avx2(c0);
+    counts[1] = jaccard_sum_avx2(c1);
+    counts[2] = jaccard_sum_avx2(c2);
+    counts[3] = jaccard_sum_avx2(c3);
+}
+
+// Comparisons yield a 16-bit mask, counted with popcount
+__attribute__((target("avx512f,popcnt")))
+static uint32_t jaccard_count_avx512(const uint32_t* mh1, const uint32_t* mh2) {
+    uint32_t matches = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; i += 16) {
+        __m512i a = _mm512_loadu_si512((const void*)(mh1 + i));
+        __m512i b = _mm512_loadu_si512((const void*)(mh2 + i));
+        matches += (uint32_t)__builtin_popcount(_mm512_cmpeq_epi32_mask(a, b));
+    }
+    return matches;
+}
+
+__attribute__((target("avx512f,popcnt")))
+static void jaccard_count_block_avx512(const uint32_t* mh, const uint32_t* const* queries, uint32_t* counts) {
+    uint32_t m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+    for (size_t i = 0; i < MINHASH_SIZE; i += 16) {
+        __m512i value = _mm512_loadu_si512((const void*)(mh + i));
+        m0 += (uint32_t)__builtin_popcount(_mm512_cmpeq_epi32_mask(value, _mm512_loadu_si512((const void*)(queries[0] + i))));
+        m1 += (uint32_t)__builtin_popcount(_mm512_cmpeq_epi32_mask(value, _mm512_loadu_si512((const void*)(queries[1] + i))));
+        m2 += (uint32_t)__builtin_popcount(_mm512_cmpeq_epi32_mask(value, _mm512_loadu_si512((const void*)(queries[2] + i))));
+        m3 += (uint32_t)__builtin_popcount(_mm512_cmpeq_epi32_mask(value, _mm512_loadu_si512((const void*)(queries[3] + i))));
+    }
+    counts[0] = m0;
+    counts[1] = m1;
+    counts[2] = m2;
+    counts[3] = m3;
+}
+#endif
+
+int jaccard_kernel_supported(JaccardKernel kernel) {
+    switch (kernel) {
+        case JACCARD_KERNEL_AUTO:
+        case JACCARD_KERNEL_SCALAR:
+            return 1;
+#ifdef JACCARD_X86_KERNELS
+        case JACCARD_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") ? 1 : 0;
+        case JACCARD_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt") ? 1 : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static JaccardKernel jaccard_resolve_kernel(JaccardKernel kernel) {
+    if (kernel != JACCARD_KERNEL_AUTO) {
+        return kernel;
+    }
+    return jaccard_kernel_supported(JACCARD_KERNEL_AVX512) ? JACCARD_KERNEL_AVX512
+         : jaccard_kernel_supported(JACCARD_KERNEL_AVX2) ? JACCARD_KERNEL_AVX2
+         : JACCARD_KERNEL_SCALAR;
+}
+
+static JaccardCountFn jaccard_count_fn(JaccardKernel kernel) {
+#ifdef JACCARD_X86_KERNELS
+    if (kernel == JACCARD_KERNEL_AVX512) {
+        return jaccard_count_avx512;
+    }
+    if (kernel == JACCARD_KERNEL_AVX2) {
+        return jaccard_count_avx2;
+    }
+#endif
+    (void)kernel;
+    return jaccard_count_scalar;
+}
+
+static JaccardCountBlockFn jaccard_count_block_fn(JaccardKernel kernel) {
+#ifdef JACCARD_X86_KERNELS
+    if (kernel == JACCARD_KERNEL_AVX512) {
+        return jaccard_count_block_avx512;
+    }
+    if (kernel == JACCARD_KERNEL_AVX2) {
+        return jaccard_count_block_avx2;
+    }
+#endif
+    (void)kernel;
+    return jaccard_count_block_scalar;
+}
+
 float jaccard_similarity(const uint32_t* mh1, const uint32_t* mh2) {
-    if (!mh1 || !mh2) {
+    return jaccard_similarity_with_kernel(mh1, mh2, JACCARD_KERNEL_AUTO);
+}
+
+float jaccard_similarity_with_kernel(const uint32_t* mh1, const uint32_t* mh2, JaccardKernel kernel) {
+    if (!mh1 || !mh2 || !jaccard_kernel_supported(kernel)) {
         return 0.0f;
     }
+    return (float)jaccard_count_fn(jaccard_resolve_kernel(kernel))(mh1, mh2) / MINHASH_SIZE;
+}
 
-    size_t matches = 0;
-    for (size_t i = 0; i < MINHASH_SIZE; i++) {
-        if (mh1[i] == mh2[i]) {
-            matches++;
+void jaccard_similarity_many(const uint32_t* mh, const uint32_t* queries, size_t num_queries, float* scores) {
+    jaccard_similarity_matrix_with_kernel(mh, 1, queries, num_queries, scores, JACCARD_KERNEL_AUTO);
+}
+
+void jaccard_similarity_matrix(const uint32_t* queries, size_t num_queries,
+                               const uint32_t* signatures, size_t count, float* scores) {
+    jaccard_similarity_matrix_with_kernel(queries, num_queries, signatures, count, scores, JACCARD_KERNEL_AUTO);
+}
+
+int jaccard_similarity_matrix_with_kernel(const uint32_t* queries, size_t num_queries,
+                                          const uint32_t* signatures, size_t count, float* scores,
+                                          JaccardKernel kernel) {
+    if ((num_queries > 0 && !queries) || (count > 0 && !signatures) || (num_queries > 0 && count > 0 && !scores) ||
+        !jaccard_kernel_supported(kernel)) {
+        return 0;
+    }
+    kernel = jaccard_resolve_kernel(kernel);
+    const JaccardCountFn count_fn = jaccard_count_fn(kernel);
+    const JaccardCountBlockFn count_block_fn = jaccard_count_block_fn(kernel);
+
+    // With a single query the signatures are the blocked side, otherwise each signature is
+    // loaded once per block of queries while the queries stay in cache
+    const uint32_t* outer = num_queries == 1 ? queries : signatures;
+    const uint32_t* inner = num_queries == 1 ? signatures : queries;
+    size_t num_outer = num_queries == 1 ? 1 : count;
+    size_t num_inner = num_queries == 1 ? count : num_queries;
+
+    for (size_t o = 0; o < num_outer; o++) {
+        const uint32_t* mh = outer + o * MINHASH_SIZE;
+        size_t i = 0;
+        for (; i + JACCARD_QUERY_BLOCK <= num_inner; i += JACCARD_QUERY_BLOCK) {
+            const uint32_t* block[JACCARD_QUERY_BLOCK];
+            uint32_t counts[JACCARD_QUERY_BLOCK];
+            for (size_t b = 0; b < JACCARD_QUERY_BLOCK; b++) {
+                block[b] = inner + (i + b) * MINHASH_SIZE;
+            }
+            count_block_fn(mh, block, counts);
+            for (size_t b = 0; b < JACCARD_QUERY_BLOCK; b++) {
+                size_t q = num_queries == 1 ? 0 : i + b;
+                size_t n = num_queries == 1 ? i + b : o;
+                scores[q * count + n] = (float)counts[b] / MINHASH_SIZE;
+            }
+        }
+        for (; i < num_inner; i++) {
+            size_t q = num_queries == 1 ? 0 : i;
+            size_t n = num_queries == 1 ? i : o;
+            scores[q * count + n] = (float)count_fn(mh, inner + i * MINHASH_SIZE) / MINHASH_SIZE;
+        }
+    }
+    return 1;
+}
+
+int bbit_bits_supported(unsigned bits) {
+    return bits == 1 || bits == 2 || bits == 4 || bits == 8 || bits == 16;
+}
+
+void bbit_pack_signature(const uint32_t* signature, unsigned bits, uint64_t* packed) {
+    const uint64_t mask = (UINT64_C(1) << bits) - 1;
+    const size_t per_word = 64 / bits;
+    for (size_t w = 0; w < BBIT_SIGNATURE_WORDS(bits); w++) {
+        uint64_t word = 0;
+        for (size_t k = 0; k < per_word; k++) {
+            word |= ((uint64_t)signature[w * per_word + k] & mask) << (k * bits);
+        }
+        packed[w] = word;
+    }
+}
+
+float bbit_jaccard_similarity(const uint64_t* packed1, const uint64_t* packed2, unsigned bits) {
+    if (!packed1 || !packed2 || !bbit_bits_supported(bits)) {
+        return 0.0f;
+    }
+
+    // After folding, the lowest bit of each slot is set if any of its bits differ
+    uint64_t low_bits = 0;
+    for (unsigned k = 0; k < 64; k += bits) {
+        low_bits |= UINT64_C(1) << k;
+    }
+
+    size_t mismatches = 0;
+    for (size_t w = 0; w < BBIT_SIGNATURE_WORDS(bits); w++) {
+        uint64_t diff = packed1[w] ^ packed2[w];
+        for (unsigned width = 1; width < bits; width *= 2) {
+            diff |= diff >> width;
         }
+        mismatches += (size_t)__builtin_popcountll(diff & low_bits);
     }
 
-    return (float)matches / MINHASH_SIZE;
+    float match_rate = 1.0f - (float)mismatches / MINHASH_SIZE;
+    float chance = 1.0f / (float)(UINT32_C(1) << bits);
+    float similarity = (match_rate - chance) / (1.0f - chance);
+    return similarity < 0.0f ? 0.0f : similarity;
 }
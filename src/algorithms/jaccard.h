@@ -5,14 +5,115 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * Implementations of the Jaccard similarity loops. All of them produce the
+ * same scores.
+ */
+typedef enum {
+    JACCARD_KERNEL_AUTO = 0,   // Widest kernel the CPU supports
+    JACCARD_KERNEL_SCALAR,     // Portable C
+    JACCARD_KERNEL_AVX2,       // 8 slots per compare, matches counted per lane (x86 with AVX2)
+    JACCARD_KERNEL_AVX512      // 16 slots per compare, matches counted from the mask with popcount (x86 with AVX-512F)
+} JaccardKernel;
+
 /**
  * Compute Jaccard similarity between two MinHash signatures.
  *
  * @param mh1 Pointer to the first MinHash signature.
  * @param mh2 Pointer to the second MinHash signature.
- * @param size Size of the MinHash signatures.
  * @return The computed Jaccard similarity (between 0 and 1).
  */
 float jaccard_similarity(const uint32_t* mh1, const uint32_t* mh2);
 
+/**
+ * Compute Jaccard similarity between two MinHash signatures with a given kernel.
+ *
+ * @param mh1 Pointer to the first MinHash signature.
+ * @param mh2 Pointer to the second MinHash signature.
+ * @param kernel Kernel to use.
+ * @return The computed Jaccard similarity, or 0 if the CPU does not support the kernel.
+ */
+float jaccard_similarity_with_kernel(const uint32_t* mh1, const uint32_t* mh2, JaccardKernel kernel);
+
+/**
+ * Compute the Jaccard similarity of one MinHash signature against a batch of
+ * signatures stored back to back. Several signatures are compared per pass
+ * over the first one, so each of its values is loaded once per block.
+ *
+ * @param mh Pointer to the MinHash signature.
+ * @param queries Pointer to num_queries signatures stored back to back.
+ * @param num_queries Number of query signatures.
+ * @param scores Array of num_queries similarities to fill.
+ */
+void jaccard_similarity_many(const uint32_t* mh, const uint32_t* queries, size_t num_queries, float* scores);
+
+/**
+ * Compute the Jaccard similarity of every query against every signature of a
+ * matrix. Each signature is read once and compared against blocks of queries,
+ * which stay in cache for small query counts.
+ *
+ * @param queries Pointer to num_queries signatures stored back to back.
+ * @param num_queries Number of query signatures.
+ * @param signatures Pointer to count signatures stored back to back.
+ * @param count Number of signatures.
+ * @param scores Row-major num_queries x count array to fill; scores[q * count + n]
+ *               compares query q with signature n.
+ */
+void jaccard_similarity_matrix(const uint32_t* queries, size_t num_queries,
+                               const uint32_t* signatures, size_t count, float* scores);
+
+/**
+ * jaccard_similarity_matrix with a given kernel.
+ *
+ * @return 1 on success, 0 if an argument is invalid or the CPU does not support the kernel.
+ */
+int jaccard_similarity_matrix_with_kernel(const uint32_t* queries, size_t num_queries,
+                                          const uint32_t* signatures, size_t count, float* scores,
+                                          JaccardKernel kernel);
+
+/**
+ * Check whether a kernel can run on this CPU.
+ *
+ * @param kernel Kernel to check.
+ * @return 1 if the kernel is supported, 0 otherwise. JACCARD_KERNEL_AUTO and JACCARD_KERNEL_SCALAR always are.
+ */
+int jaccard_kernel_supported(JaccardKernel kernel);
+
+// Number of uint64_t words in a b-bit packed signature
+#define BBIT_SIGNATURE_WORDS(bits) (MINHASH_SIZE * (bits) / 64)
+#define BBIT_MAX_BITS 16
+
+/**
+ * Check whether a b-bit signature width is supported (1, 2, 4, 8 or 16).
+ *
+ * @param bits Bits kept per signature slot.
+ * @return 1 if supported, 0 otherwise.
+ */
+int bbit_bits_supported(unsigned bits);
+
+/**
+ * Pack a MinHash signature into a b-bit signature (Li and König, 2010) by
+ * keeping the lowest bits of every slot. Slot i occupies bits
+ * [i * bits, (i + 1) * bits) of the packed words.
+ *
+ * @param signature Pointer to the MinHash signature.
+ * @param bits Bits kept per slot (see bbit_bits_supported).
+ * @param packed Receives BBIT_SIGNATURE_WORDS(bits) words.
+ */
+void bbit_pack_signature(const uint32_t* signature, unsigned bits, uint64_t* packed);
+
+/**
+ * Estimate the Jaccard similarity from two b-bit signatures. Slots that differ
+ * are counted a word at a time with XOR and popcount; since unrelated slots
+ * still agree on their lowest bits with probability 2^-bits, the match rate P
+ * is corrected to (P - 2^-bits) / (1 - 2^-bits), the estimator of Li and König
+ * for sets that are small relative to the hash range, and clamped to [0, 1].
+ *
+ * @param packed1 Pointer to the first packed signature.
+ * @param packed2 Pointer to the second packed signature.
+ * @param bits Bits per slot of both signatures.
+ * @return The estimated Jaccard similarity (between 0 and 1).
+ */
+float bbit_jaccard_similarity(const uint64_t* packed1, const uint64_t* packed2, unsigned bits);
+
 #endif // JACCARD_H
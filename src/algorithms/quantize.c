@@ -2,19 +2,14 @@
 #include "../include/config.h"
 #include <assert.h>
 #include <string.h>
-#include <stdio.h>
 
 void compute_average_embedding(const float* flattened, size_t num_embeddings, size_t embedding_dim, float* average_embedding) {
     assert(embedding_dim % 8 == 0); // Ensure dimension is divisible by 8
-    assert(BINARY_EMBEDDING_DIM <= embedding_dim); // Ensure binary dimension does not exceed total dimension
 
-    size_t effective_dim = BINARY_EMBEDDING_DIM; // Use binary dimension from config
-    if (effective_dim > embedding_dim) {
-        fprintf(stderr, "Error: Effective dimension exceeds embedding dimension.\n");
-        return;
-    }
+    // Embeddings narrower than the binary dimension leave the remaining bits clear
+    size_t effective_dim = BINARY_EMBEDDING_DIM < embedding_dim ? BINARY_EMBEDDING_DIM : embedding_dim;
 
-    memset(average_embedding, 0, effective_dim * sizeof(float));
+    memset(average_embedding, 0, BINARY_EMBEDDING_DIM * sizeof(float));
     for (size_t i = 0; i < num_embeddings; i++) {
         for (size_t j = 0; j < effective_dim; j++) { // Only iterate up to the truncated dimension
             average_embedding[j] += flattened[i * embedding_dim + j];
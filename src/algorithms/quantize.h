@@ -4,6 +4,11 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/**
+ * Average the first BINARY_EMBEDDING_DIM dimensions of a set of embeddings.
+ *
+ * @param average_embedding Receives BINARY_EMBEDDING_DIM floats; dimensions past embedding_dim are 0.
+ */
 void compute_average_embedding(const float* flattened, size_t num_embeddings, size_t embedding_dim, float* average_embedding);
 void quantize_and_pack(float* average_embedding, uint8_t* packed_bits);
 
@@ -4,6 +4,11 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MINHASH_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
 // MurmurHash3 32-bit implementation
 uint32_t murmurhash3_32(const void* key, int len, uint32_t seed) {
     const uint32_t c1 = 0xcc9e2d51;
@@ -96,21 +101,408 @@ uint32_t minhash_hash(const void* data, size_t len, size_t index, uint32_t seed)
     return murmurhash3_32(data, len, seed + index);
 }
 
+// Token dependent half of a MurmurHash3 block round, shared by every seed
+static inline uint32_t murmur_mix_block(uint32_t k) {
+    k *= 0xcc9e2d51;
+    k = (k << 15) | (k >> 17);
+    return k * 0x1b873593;
+}
+
+static inline uint32_t murmur_fmix(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6b;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// Signature slots [start, end): slot j is the minimum over n-grams of murmurhash3_32(ngram, seed + j)
+static void minhash_kernel_scalar(uint32_t* signature, size_t start, size_t end, uint32_t seed,
+                                  const uint32_t* blocks, size_t num_ngrams, size_t ngram_size) {
+    const uint32_t len = (uint32_t)(ngram_size * sizeof(uint32_t));
+    for (size_t j = start; j < end; j++) {
+        uint32_t min = signature[j];
+        const uint32_t lane_seed = seed + (uint32_t)j;
+        for (size_t i = 0; i < num_ngrams; i++) {
+            uint32_t hash = lane_seed;
+            for (size_t b = 0; b < ngram_size; b++) {
+                hash ^= blocks[i + b];
+                hash = ((hash << 13) | (hash >> 19)) * 5 + 0xe6546b64;
+            }
+            hash = murmur_fmix(hash ^ len);
+            min = hash < min ? hash : min;
+        }
+        signature[j] = min;
+    }
+}
+
+#ifdef MINHASH_X86_KERNELS
+// Eight slots per vector; returns the number of slots done, the rest is left to the scalar kernel
+__attribute__((target("avx2")))
+static size_t minhash_kernel_avx2(uint32_t* signature, size_t num_hashes, uint32_t seed,
+                                  const uint32_t* blocks, size_t num_ngrams, size_t ngram_size) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i n = _mm256_set1_epi32((int)0xe6546b64);
+    const __m256i len = _mm256_set1_epi32((int)(ngram_size * sizeof(uint32_t)));
+    const __m256i fmix1 = _mm256_set1_epi32((int)0x85ebca6b);
+    const __m256i fmix2 = _mm256_set1_epi32((int)0xc2b2ae35);
+
+    size_t j = 0;
+    for (; j + 8 <= num_hashes; j += 8) {
+        const __m256i seeds = _mm256_add_epi32(_mm256_set1_epi32((int)(seed + (uint32_t)j)), lanes);
+        __m256i min = _mm256_loadu_si256((const __m256i*)(signature + j));
+        for (size_t i = 0; i < num_ngrams; i++) {
+            __m256i hash = seeds;
+            for (size_t b = 0; b < ngram_size; b++) {
+                hash = _mm256_xor_si256(hash, _mm256_set1_epi32((int)blocks[i + b]));
+                hash = _mm256_or_si256(_mm256_slli_epi32(hash, 13), _mm256_srli_epi32(hash, 19));
+                hash = _mm256_add_epi32(_mm256_add_epi32(hash, _mm256_slli_epi32(hash, 2)), n);
+            }
+            hash = _mm256_xor_si256(hash, len);
+            hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 16));
+            hash = _mm256_mullo_epi32(hash, fmix1);
+            hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 13));
+            hash = _mm256_mullo_epi32(hash, fmix2);
+            hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 16));
+            min = _mm256_min_epu32(min, hash);
+        }
+        _mm256_storeu_si256((__m256i*)(signature + j), min);
+    }
+    return j;
+}
+
+// Sixteen slots per vector, as minhash_kernel_avx2
+__attribute__((target("avx512f")))
+static size_t minhash_kernel_avx512(uint32_t* signature, size_t num_hashes, uint32_t seed,
+                                    const uint32_t* blocks, size_t num_ngrams, size_t ngram_size) {
+    const __m512i lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i n = _mm512_set1_epi32((int)0xe6546b64);
+    const __m512i len = _mm512_set1_epi32((int)(ngram_size * sizeof(uint32_t)));
+    const __m512i fmix1 = _mm512_set1_epi32((int)0x85ebca6b);
+    const __m512i fmix2 = _mm512_set1_epi32((int)0xc2b2ae35);
+
+    size_t j = 0;
+    for (; j + 16 <= num_hashes; j += 16) {
+        const __m512i seeds = _mm512_add_epi32(_mm512_set1_epi32((int)(seed + (uint32_t)j)), lanes);
+        __m512i min = _mm512_loadu_si512((const void*)(signature + j));
+        for (size_t i = 0; i < num_ngrams; i++) {
+            __m512i hash = seeds;
+            for (size_t b = 0; b < ngram_size; b++) {
+                hash = _mm512_xor_si512(hash, _mm512_set1_epi32((int)blocks[i + b]));
+                hash = _mm512_rol_epi32(hash, 13);
+                hash = _mm512_add_epi32(_mm512_add_epi32(hash, _mm512_slli_epi32(hash, 2)), n);
+            }
+            hash = _mm512_xor_si512(hash, len);
+            hash = _mm512_xor_si512(hash, _mm512_srli_epi32(hash, 16));
+            hash = _mm512_mullo_epi32(hash, fmix1);
+            hash = _mm512_xor_si512(hash, _mm512_srli_epi32(hash, 13));
+            hash = _mm512_mullo_epi32(hash, fmix2);
+            hash = _mm512_xor_si512(hash, _mm512_srli_epi32(hash, 16));
+            min = _mm512_min_epu32(min, hash);
+        }
+        _mm512_storeu_si512((void*)(signature + j), min);
+    }
+    return j;
+}
+#endif
+
+int minhash_kernel_supported(MinHashKernel kernel) {
+    switch (kernel) {
+        case MINHASH_KERNEL_AUTO:
+        case MINHASH_KERNEL_SCALAR:
+            return 1;
+#ifdef MINHASH_X86_KERNELS
+        case MINHASH_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") ? 1 : 0;
+        case MINHASH_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") ? 1 : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static MinHashKernel minhash_resolve_kernel(MinHashKernel kernel) {
+    if (kernel != MINHASH_KERNEL_AUTO) {
+        return kernel;
+    }
+    return minhash_kernel_supported(MINHASH_KERNEL_AVX512) ? MINHASH_KERNEL_AVX512
+         : minhash_kernel_supported(MINHASH_KERNEL_AVX2) ? MINHASH_KERNEL_AVX2
+         : MINHASH_KERNEL_SCALAR;
+}
+
+// Mix every token once instead of once per n-gram and hash function
+static void minhash_mix_tokens(uint32_t* blocks, const uint32_t* token_ids, size_t token_count) {
+    for (size_t i = 0; i < token_count; i++) {
+        blocks[i] = murmur_mix_block(token_ids[i]);
+    }
+}
+
+// Fold the n-grams starting at the first num_ngrams mixed tokens into the running minimums
+static void minhash_accumulate(uint32_t* signature, size_t num_hashes, uint32_t seed, const uint32_t* blocks,
+                               size_t num_ngrams, size_t ngram_size, MinHashKernel kernel) {
+    size_t done = 0;
+#ifdef MINHASH_X86_KERNELS
+    if (kernel == MINHASH_KERNEL_AVX512) {
+        done = minhash_kernel_avx512(signature, num_hashes, seed, blocks, num_ngrams, ngram_size);
+    } else if (kernel == MINHASH_KERNEL_AVX2) {
+        done = minhash_kernel_avx2(signature, num_hashes, seed, blocks, num_ngrams, ngram_size);
+    }
+#else
+    (void)kernel;
+#endif
+    minhash_kernel_scalar(signature, done, num_hashes, seed, blocks, num_ngrams, ngram_size);
+}
+
+static void minhash_fill_empty(uint32_t* signature, size_t num_hashes) {
+    for (size_t j = 0; j < num_hashes; j++) {
+        signature[j] = UINT32_MAX;
+    }
+}
+
+MinHashError minhash_compute_with_kernel(MinHash* mh, const uint32_t* token_ids, size_t token_count,
+                                         size_t ngram_size, MinHashKernel kernel) {
+    if (!mh || !token_ids || token_count < ngram_size || !minhash_kernel_supported(kernel)) {
+        return MINHASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint32_t* blocks = (uint32_t*)malloc((token_count ? token_count : 1) * sizeof(uint32_t));
+    if (blocks == NULL) {
+        return MINHASH_ERROR_MEMORY;
+    }
+    minhash_mix_tokens(blocks, token_ids, token_count);
+    minhash_accumulate(mh->signature, mh->num_hashes, mh->seed, blocks, token_count - ngram_size + 1, ngram_size,
+                       minhash_resolve_kernel(kernel));
+
+    free(blocks);
+    return MINHASH_SUCCESS;
+}
+
 // Compute MinHash signature from token IDs
 MinHashError minhash_compute_from_tokens(MinHash* mh, const uint32_t* token_ids, size_t token_count, size_t ngram_size) {
-    if (!mh || !token_ids || token_count < ngram_size) {
+    return minhash_compute_with_kernel(mh, token_ids, token_count, ngram_size, MINHASH_KERNEL_AUTO);
+}
+
+// Compute a one-permutation MinHash signature from token IDs, with one hash per n-gram
+MinHashError minhash_compute_oph(MinHash* mh, const uint32_t* token_ids, size_t token_count, size_t ngram_size) {
+    if (!mh || !token_ids || token_count < ngram_size || ngram_size == 0) {
         return MINHASH_ERROR_INVALID_ARGUMENT;
     }
 
+    uint8_t* filled = (uint8_t*)calloc(mh->num_hashes, sizeof(uint8_t));
+    if (filled == NULL) {
+        return MINHASH_ERROR_MEMORY;
+    }
+    for (size_t j = 0; j < mh->num_hashes; j++) {
+        mh->signature[j] = UINT32_MAX;
+    }
+
+    size_t num_filled = 0;
     for (size_t i = 0; i <= token_count - ngram_size; i++) {
+        uint32_t hash = murmurhash3_32(&token_ids[i], ngram_size * sizeof(uint32_t), mh->seed);
+        size_t bin = (size_t)(((uint64_t)hash * mh->num_hashes) >> 32);
+        if (!filled[bin]) {
+            filled[bin] = 1;
+            num_filled++;
+        }
+        if (hash < mh->signature[bin]) {
+            mh->signature[bin] = hash;
+        }
+    }
+
+    // Optimal densification: probe (bin, attempt) pairs until a bin that received an n-gram is found
+    if (num_filled > 0 && num_filled < mh->num_hashes) {
         for (size_t j = 0; j < mh->num_hashes; j++) {
-            uint32_t hash = minhash_hash(&token_ids[i], ngram_size * sizeof(uint32_t), j, mh->seed);
-            if (hash < mh->signature[j]) {
-                mh->signature[j] = hash;
+            if (filled[j]) {
+                continue;
+            }
+            uint32_t probe[2] = {(uint32_t)j, 0};
+            size_t source;
+            do {
+                source = (size_t)(((uint64_t)murmurhash3_32(probe, sizeof(probe), mh->seed) * mh->num_hashes) >> 32);
+                probe[1]++;
+            } while (!filled[source]);
+            mh->signature[j] = mh->signature[source];
+        }
+    }
+
+    free(filled);
+    return MINHASH_SUCCESS;
+}
+
+// Create a streaming MinHash context
+MinHashError minhash_stream_create(MinHashStream** stream, size_t num_hashes, uint32_t seed, size_t ngram_size) {
+    if (!stream || num_hashes == 0 || ngram_size == 0) {
+        return MINHASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    *stream = (MinHashStream*)calloc(1, sizeof(MinHashStream));
+    if (*stream == NULL) {
+        return MINHASH_ERROR_MEMORY;
+    }
+    (*stream)->signature = (uint32_t*)malloc(num_hashes * sizeof(uint32_t));
+    (*stream)->carry = (uint32_t*)malloc(ngram_size * sizeof(uint32_t));
+    if ((*stream)->signature == NULL || (*stream)->carry == NULL) {
+        minhash_stream_free(*stream);
+        *stream = NULL;
+        return MINHASH_ERROR_MEMORY;
+    }
+    (*stream)->num_hashes = num_hashes;
+    (*stream)->seed = seed;
+    (*stream)->ngram_size = ngram_size;
+    minhash_stream_reset(*stream);
+
+    return MINHASH_SUCCESS;
+}
+
+void minhash_stream_reset(MinHashStream* stream) {
+    if (stream) {
+        minhash_fill_empty(stream->signature, stream->num_hashes);
+        stream->carry_count = 0;
+        stream->token_count = 0;
+    }
+}
+
+void minhash_stream_free(MinHashStream* stream) {
+    if (stream) {
+        free(stream->signature);
+        free(stream->carry);
+        free(stream->buffer);
+        free(stream);
+    }
+}
+
+// Feed tokens to a streaming MinHash context
+MinHashError minhash_update(MinHashStream* stream, const uint32_t* token_ids, size_t token_count) {
+    if (!stream || (!token_ids && token_count > 0)) {
+        return MINHASH_ERROR_INVALID_ARGUMENT;
+    }
+    if (token_count == 0) {
+        return MINHASH_SUCCESS;
+    }
+
+    // The carried tokens start the n-grams that the new tokens complete
+    size_t total = stream->carry_count + token_count;
+    if (total > stream->buffer_capacity) {
+        uint32_t* buffer = (uint32_t*)realloc(stream->buffer, total * sizeof(uint32_t));
+        if (buffer == NULL) {
+            return MINHASH_ERROR_MEMORY;
+        }
+        stream->buffer = buffer;
+        stream->buffer_capacity = total;
+    }
+    memcpy(stream->buffer, stream->carry, stream->carry_count * sizeof(uint32_t));
+    minhash_mix_tokens(stream->buffer + stream->carry_count, token_ids, token_count);
+
+    if (total >= stream->ngram_size) {
+        minhash_accumulate(stream->signature, stream->num_hashes, stream->seed, stream->buffer,
+                           total - stream->ngram_size + 1, stream->ngram_size,
+                           minhash_resolve_kernel(MINHASH_KERNEL_AUTO));
+    }
+
+    size_t keep = stream->ngram_size - 1 < total ? stream->ngram_size - 1 : total;
+    memcpy(stream->carry, stream->buffer + total - keep, keep * sizeof(uint32_t));
+    stream->carry_count = keep;
+    stream->token_count += token_count;
+    return MINHASH_SUCCESS;
+}
+
+// Read the signature of the tokens fed so far
+MinHashError minhash_finalize(const MinHashStream* stream, uint32_t* signature) {
+    if (!stream || !signature || stream->token_count < stream->ngram_size) {
+        return MINHASH_ERROR_INVALID_ARGUMENT;
+    }
+    memcpy(signature, stream->signature, stream->num_hashes * sizeof(uint32_t));
+    return MINHASH_SUCCESS;
+}
+
+size_t minhash_window_count(size_t token_count, size_t window_size, size_t step) {
+    if (token_count == 0 || window_size == 0 || step == 0) {
+        return 0;
+    }
+    if (token_count <= window_size) {
+        return 1;
+    }
+    // Stop at the first window that reaches the end, or that would start past it when windows leave gaps
+    size_t to_end = 1 + (token_count - window_size + step - 1) / step;
+    size_t starts = (token_count + step - 1) / step;
+    return to_end < starts ? to_end : starts;
+}
+
+// Compute the signature of every sliding window in one pass
+MinHashError minhash_compute_windows(const uint32_t* token_ids, size_t token_count, size_t window_size, size_t step,
+                                     size_t num_hashes, uint32_t seed, size_t ngram_size,
+                                     uint32_t* signatures, size_t stride) {
+    size_t count = minhash_window_count(token_count, window_size, step);
+    if ((!token_ids && token_count > 0) || (!signatures && count > 0) || ngram_size == 0 ||
+        window_size < ngram_size || step == 0 || num_hashes == 0 || stride < num_hashes) {
+        return MINHASH_ERROR_INVALID_ARGUMENT;
+    }
+    if (count == 0) {
+        return MINHASH_SUCCESS;
+    }
+
+    // A window holds `full` whole steps of n-gram positions followed by the first `rest` positions of
+    // the next step. Each step is hashed once into the minimums over those first positions and over the
+    // whole step, which every window that contains it then reuses.
+    const size_t span = window_size - ngram_size + 1;
+    const size_t num_ngrams = token_count >= ngram_size ? token_count - ngram_size + 1 : 0;
+    const size_t full = span / step;
+    const size_t rest = span % step;
+    const size_t ring_size = full + 1;
+    const MinHashKernel kernel = minhash_resolve_kernel(MINHASH_KERNEL_AUTO);
+
+    uint32_t* blocks = (uint32_t*)malloc(token_count * sizeof(uint32_t));
+    uint32_t* ring = (uint32_t*)malloc(ring_size * 2 * num_hashes * sizeof(uint32_t));
+    if (blocks == NULL || ring == NULL) {
+        free(blocks);
+        free(ring);
+        return MINHASH_ERROR_MEMORY;
+    }
+    minhash_mix_tokens(blocks, token_ids, token_count);
+
+    size_t next_step = 0;
+    for (size_t k = 0; k < count; k++) {
+        size_t steps_end = k + full + (rest > 0 ? 1 : 0);
+        for (size_t c = next_step > k ? next_step : k; c < steps_end; c++) {
+            uint32_t* partial = ring + (c % ring_size) * 2 * num_hashes;
+            uint32_t* whole = partial + num_hashes;
+            size_t start = c * step;
+            size_t split = start + rest < num_ngrams ? start + rest : num_ngrams;
+            size_t end = start + step < num_ngrams ? start + step : num_ngrams;
+
+            minhash_fill_empty(partial, num_hashes);
+            if (start < split) {
+                minhash_accumulate(partial, num_hashes, seed, blocks + start, split - start, ngram_size, kernel);
+            }
+            if (full > 0) {
+                memcpy(whole, partial, num_hashes * sizeof(uint32_t));
+                if (split < end) {
+                    minhash_accumulate(whole, num_hashes, seed, blocks + split, end - split, ngram_size, kernel);
+                }
+            }
+        }
+        next_step = steps_end;
+
+        uint32_t* signature = signatures + k * stride;
+        minhash_fill_empty(signature, num_hashes);
+        for (size_t c = k; c < k + full; c++) {
+            const uint32_t* whole = ring + (c % ring_size) * 2 * num_hashes + num_hashes;
+            for (size_t j = 0; j < num_hashes; j++) {
+                signature[j] = whole[j] < signature[j] ? whole[j] : signature[j];
+            }
+        }
+        if (rest > 0) {
+            const uint32_t* partial = ring + ((k + full) % ring_size) * 2 * num_hashes;
+            for (size_t j = 0; j < num_hashes; j++) {
+                signature[j] = partial[j] < signature[j] ? partial[j] : signature[j];
             }
         }
     }
 
+    free(blocks);
+    free(ring);
     return MINHASH_SUCCESS;
 }
 
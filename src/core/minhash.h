@@ -14,6 +14,17 @@ typedef enum {
     MINHASH_ERROR_INVALID_ARGUMENT // Invalid argument passed to function
 } MinHashError;
 
+/**
+ * Implementations of the minhash_compute_from_tokens hash loop. All of them
+ * produce the same signatures as minhash_hash.
+ */
+typedef enum {
+    MINHASH_KERNEL_AUTO = 0,   // Widest kernel the CPU supports
+    MINHASH_KERNEL_SCALAR,     // Portable C
+    MINHASH_KERNEL_AVX2,       // 8 hash functions per instruction (x86 with AVX2)
+    MINHASH_KERNEL_AVX512      // 16 hash functions per instruction (x86 with AVX-512F)
+} MinHashKernel;
+
 /**
  * Structure representing a MinHash object.
  */
@@ -23,6 +34,21 @@ typedef struct {
     uint32_t seed;              // Seed value for hash functions
 } MinHash;
 
+/**
+ * Streaming MinHash context, fed tokens in pieces with minhash_update.
+ */
+typedef struct {
+    uint32_t* signature;        // Minimums over the n-grams seen so far
+    size_t num_hashes;
+    uint32_t seed;
+    size_t ngram_size;
+    uint32_t* carry;            // Last ngram_size - 1 tokens (mixed), which start n-grams the next update completes
+    size_t carry_count;
+    uint32_t* buffer;           // Scratch space for the carried and new tokens
+    size_t buffer_capacity;
+    size_t token_count;         // Number of tokens fed since the last reset
+} MinHashStream;
+
 /**
  * Create a new MinHash object.
  * @param mh Pointer to a MinHash pointer where the new object will be stored.
@@ -48,6 +74,123 @@ void minhash_free(MinHash* mh);
  */
 MinHashError minhash_compute_from_tokens(MinHash* mh, const uint32_t* token_ids, size_t token_count, size_t ngram_size);
 
+/**
+ * Compute MinHash signature from token IDs with a given kernel, as
+ * minhash_compute_from_tokens does with the kernel picked for the CPU at run
+ * time. The part of MurmurHash3 that only depends on the tokens is computed
+ * once per token, and the kernel evaluates the seeded remainder for several
+ * hash functions at once, keeping their minimums in registers.
+ * @param mh Pointer to the MinHash object.
+ * @param token_ids Array of token IDs.
+ * @param token_count Number of tokens in the array.
+ * @param ngram_size Size of n-grams to use for hashing.
+ * @param kernel Kernel to use; MINHASH_ERROR_INVALID_ARGUMENT if the CPU does not support it.
+ * @return MINHASH_SUCCESS on success, or an error code on failure.
+ */
+MinHashError minhash_compute_with_kernel(MinHash* mh, const uint32_t* token_ids, size_t token_count,
+                                         size_t ngram_size, MinHashKernel kernel);
+
+/**
+ * Check whether a kernel can run on this CPU.
+ * @param kernel Kernel to check.
+ * @return 1 if the kernel is supported, 0 otherwise. MINHASH_KERNEL_AUTO and MINHASH_KERNEL_SCALAR always are.
+ */
+int minhash_kernel_supported(MinHashKernel kernel);
+
+/**
+ * Compute a one-permutation MinHash (OPH) signature from token IDs, replacing
+ * the current signature. Each n-gram is hashed once: the high bits of the hash
+ * pick one of num_hashes bins and each bin keeps its smallest hash. Bins that
+ * no n-gram fell into are filled by optimal densification (Shrivastava, 2017):
+ * an empty bin borrows the value of the first non-empty bin on a probe
+ * sequence that depends only on the bin and the seed, so two signatures agree
+ * in a slot with the same probability as classic MinHash. The signatures are
+ * not comparable with those of minhash_compute_from_tokens.
+ * @param mh Pointer to the MinHash object.
+ * @param token_ids Array of token IDs.
+ * @param token_count Number of tokens in the array.
+ * @param ngram_size Size of n-grams to use for hashing.
+ * @return MINHASH_SUCCESS on success, or an error code on failure.
+ */
+MinHashError minhash_compute_oph(MinHash* mh, const uint32_t* token_ids, size_t token_count, size_t ngram_size);
+
+/**
+ * Create a streaming MinHash context. Feeding a token sequence in any number
+ * of pieces gives the same signature as minhash_compute_from_tokens on the
+ * whole sequence (into a fresh MinHash), including n-grams that straddle two
+ * pieces.
+ * @param stream Pointer to a MinHashStream pointer where the new context will be stored.
+ * @param num_hashes Number of hash functions to use in the MinHash signature.
+ * @param seed Seed value for the hash functions.
+ * @param ngram_size Size of n-grams to use for hashing.
+ * @return MINHASH_SUCCESS on success, or an error code on failure.
+ */
+MinHashError minhash_stream_create(MinHashStream** stream, size_t num_hashes, uint32_t seed, size_t ngram_size);
+
+/**
+ * Feed the next tokens of the sequence to a streaming MinHash context.
+ * @param stream Pointer to the MinHashStream.
+ * @param token_ids Array of token IDs.
+ * @param token_count Number of tokens in the array.
+ * @return MINHASH_SUCCESS on success, or an error code on failure.
+ */
+MinHashError minhash_update(MinHashStream* stream, const uint32_t* token_ids, size_t token_count);
+
+/**
+ * Copy out the signature of the tokens fed so far. The context is left as is,
+ * so more tokens can be fed afterwards.
+ * @param stream Pointer to the MinHashStream.
+ * @param signature Array of num_hashes slots that receives the signature.
+ * @return MINHASH_SUCCESS on success, or MINHASH_ERROR_INVALID_ARGUMENT if fewer than ngram_size tokens were fed.
+ */
+MinHashError minhash_finalize(const MinHashStream* stream, uint32_t* signature);
+
+/**
+ * Start a new sequence in a streaming MinHash context.
+ * @param stream Pointer to the MinHashStream.
+ */
+void minhash_stream_reset(MinHashStream* stream);
+
+/**
+ * Free memory associated with a streaming MinHash context.
+ * @param stream Pointer to the MinHashStream to be freed.
+ */
+void minhash_stream_free(MinHashStream* stream);
+
+/**
+ * Number of sliding windows minhash_compute_windows produces: windows start
+ * every step tokens until one reaches the end of the sequence (or the next
+ * would start past it), and the last one may be shorter than window_size.
+ * @param token_count Number of tokens in the sequence.
+ * @param window_size Number of tokens per window.
+ * @param step Number of tokens between the starts of two windows.
+ * @return Number of windows (0 for an empty sequence or a zero size or step).
+ */
+size_t minhash_window_count(size_t token_count, size_t window_size, size_t step);
+
+/**
+ * Compute the MinHash signature of every sliding window of a token sequence in
+ * one pass. Window k covers tokens [k * step, k * step + window_size), clipped
+ * to the sequence, and its signature equals minhash_compute_from_tokens on
+ * those tokens; a window too short to hold an n-gram gets UINT32_MAX slots.
+ * Every n-gram is hashed once: the minimums of each step are shared by all the
+ * windows that overlap it, so the cost is linear in the sequence length rather
+ * than in the number of windows times the window size.
+ * @param token_ids Array of token IDs.
+ * @param token_count Number of tokens in the array.
+ * @param window_size Number of tokens per window (at least ngram_size).
+ * @param step Number of tokens between the starts of two windows.
+ * @param num_hashes Number of hash functions per signature.
+ * @param seed Seed value for the hash functions.
+ * @param ngram_size Size of n-grams to use for hashing.
+ * @param signatures Receives minhash_window_count signatures of num_hashes slots.
+ * @param stride Number of slots between the starts of two signatures (at least num_hashes).
+ * @return MINHASH_SUCCESS on success, or an error code on failure.
+ */
+MinHashError minhash_compute_windows(const uint32_t* token_ids, size_t token_count, size_t window_size, size_t step,
+                                     size_t num_hashes, uint32_t seed, size_t ngram_size,
+                                     uint32_t* signatures, size_t stride);
+
 /**
  * Merge two MinHash signatures.
  * @param dest Destination MinHash object.
@@ -1,59 +1,73 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // O_CLOEXEC
+#endif
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "ragfile.h"
 #include "minhash.h"
 #include "../algorithms/quantize.h"
+#include "../algorithms/cosine.h"
 #include "../include/config.h"
 #include "../utils/file_io.h"
 #include "../utils/strdup.h"
 
 
-RagfileError ragfile_compute_minhash(const uint32_t* token_ids, size_t token_count, uint32_t* minhash_signature) {
+typedef MinHashError (*MinHashComputeFn)(MinHash* mh, const uint32_t* token_ids, size_t token_count, size_t ngram_size);
+
+// Compute a signature of MINHASH_SIZE / 2 bigram hashes followed by MINHASH_SIZE / 2 trigram hashes
+static RagfileError ragfile_compute_signature(const uint32_t* token_ids, size_t token_count, uint32_t* minhash_signature,
+                                              MinHashComputeFn compute) {
     if (!token_ids || !minhash_signature || token_count == 0) {
         return RAGFILE_ERROR_INVALID_ARGUMENT;
     }
-    assert(minhash_signature != NULL && "minhash_signature must be pre-allocated with enough space");
 
-    // Half of MINHASH_SIZE for each of bi-grams and tri-grams
+    // Half of MINHASH_SIZE for each of bi-grams and tri-grams, computed in place
     const size_t half_minhash_size = MINHASH_SIZE / 2;
-
-    MinHash* mh_bigrams;
-    MinHash* mh_trigrams;
-
-    // Create MinHash for bigrams
-    if (minhash_create(&mh_bigrams, half_minhash_size, 0) != MINHASH_SUCCESS) {
-        return RAGFILE_ERROR_MEMORY;
-    }
-
-    // Create MinHash for trigrams
-    if (minhash_create(&mh_trigrams, half_minhash_size, 0) != MINHASH_SUCCESS) {
-        minhash_free(mh_bigrams);
-        return RAGFILE_ERROR_MEMORY;
+    MinHash mh_bigrams = {.signature = minhash_signature, .num_hashes = half_minhash_size, .seed = 0};
+    MinHash mh_trigrams = {.signature = minhash_signature + half_minhash_size, .num_hashes = half_minhash_size, .seed = 0};
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        minhash_signature[i] = UINT32_MAX;
     }
 
-    // Compute MinHash for bigrams
-    if (minhash_compute_from_tokens(mh_bigrams, token_ids, token_count, 2) != MINHASH_SUCCESS) {
-        minhash_free(mh_bigrams);
-        minhash_free(mh_trigrams);
+    if (compute(&mh_bigrams, token_ids, token_count, 2) != MINHASH_SUCCESS ||
+        compute(&mh_trigrams, token_ids, token_count, 3) != MINHASH_SUCCESS) {
         return RAGFILE_ERROR_INVALID_ARGUMENT;
     }
 
-    // Compute MinHash for trigrams
-    if (minhash_compute_from_tokens(mh_trigrams, token_ids, token_count, 3) != MINHASH_SUCCESS) {
-        minhash_free(mh_bigrams);
-        minhash_free(mh_trigrams);
-        return RAGFILE_ERROR_INVALID_ARGUMENT;
-    }
+    return RAGFILE_SUCCESS;
+}
 
-    // Combine results
-    memcpy(minhash_signature, mh_bigrams->signature, half_minhash_size * sizeof(uint32_t));
-    memcpy(minhash_signature + half_minhash_size, mh_trigrams->signature, half_minhash_size * sizeof(uint32_t));
+RagfileError ragfile_compute_minhash(const uint32_t* token_ids, size_t token_count, uint32_t* minhash_signature) {
+    return ragfile_compute_signature(token_ids, token_count, minhash_signature, minhash_compute_from_tokens);
+}
 
-    // Free resources
-    minhash_free(mh_bigrams);
-    minhash_free(mh_trigrams);
+RagfileError ragfile_compute_minhash_oph(const uint32_t* token_ids, size_t token_count, uint32_t* minhash_signature) {
+    return ragfile_compute_signature(token_ids, token_count, minhash_signature, minhash_compute_oph);
+}
 
+RagfileError ragfile_compute_minhash_windows(const uint32_t* token_ids, size_t token_count, size_t window_size,
+                                             size_t step, uint32_t* signatures) {
+    // Both halves are checked before either is written, since the bigram half accepts windows the trigram half rejects
+    if (window_size < 3) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+    const size_t half_minhash_size = MINHASH_SIZE / 2;
+    MinHashError error = minhash_compute_windows(token_ids, token_count, window_size, step, half_minhash_size, 0, 2,
+                                                 signatures, MINHASH_SIZE);
+    if (error == MINHASH_SUCCESS) {
+        error = minhash_compute_windows(token_ids, token_count, window_size, step, half_minhash_size, 0, 3,
+                                        signatures ? signatures + half_minhash_size : NULL, MINHASH_SIZE);
+    }
+    if (error != MINHASH_SUCCESS) {
+        return error == MINHASH_ERROR_MEMORY ? RAGFILE_ERROR_MEMORY : RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
     return RAGFILE_SUCCESS;
 }
 
@@ -61,7 +75,7 @@ RagfileError ragfile_compute_minhash(const uint32_t* token_ids, size_t token_cou
 RagfileError compute_binary_embedding(RagFile* rf, const float* embeddings, uint32_t num_embeddings, uint16_t embedding_dim) {
     if (!embeddings) return RAGFILE_ERROR_INVALID_ARGUMENT;
 
-    float average_embedding[embedding_dim];
+    float average_embedding[BINARY_EMBEDDING_DIM];
     compute_average_embedding(embeddings, num_embeddings, embedding_dim, average_embedding);
 
     uint8_t binary_embedding[BINARY_EMBEDDING_BYTE_DIM];
@@ -73,11 +87,42 @@ RagfileError compute_binary_embedding(RagFile* rf, const float* embeddings, uint
 }
 
 
+RagfileError ragfile_embedding_norms(const RagFile* rf, float** norms) {
+    if (!rf || !norms) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+    *norms = NULL;
+    if (rf->header.flags & RAGFILE_FLAG_NORMALIZED_EMBEDDINGS) {
+        return RAGFILE_SUCCESS;
+    }
+    if (!rf->embeddings) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t count = rf->file_metadata.num_embeddings;
+    *norms = (float*)malloc((count ? count : 1) * sizeof(float));
+    if (*norms == NULL) {
+        return RAGFILE_ERROR_MEMORY;
+    }
+    l2_norms(rf->embeddings, count, rf->file_metadata.embedding_dim, *norms);
+    return RAGFILE_SUCCESS;
+}
+
 RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* token_ids, size_t token_count,
                             const float* embeddings, uint32_t embedding_size, const char* extended_metadata,
                             const char* tokenizer_id, const char* embedding_id, 
                             uint16_t extended_metadata_version, uint16_t num_embeddings, uint16_t embedding_dim) {
-    if (!rf || !text || !token_ids || !embeddings || !tokenizer_id || !embedding_id) {
+    return ragfile_create_with_flags(rf, text, token_ids, token_count, embeddings, embedding_size, extended_metadata,
+                                     tokenizer_id, embedding_id, extended_metadata_version, num_embeddings,
+                                     embedding_dim, 0);
+}
+
+RagfileError ragfile_create_with_flags(RagFile** rf, const char* text, const uint32_t* token_ids, size_t token_count,
+                                       const float* embeddings, uint32_t embedding_size, const char* extended_metadata,
+                                       const char* tokenizer_id, const char* embedding_id,
+                                       uint16_t extended_metadata_version, uint16_t num_embeddings, uint16_t embedding_dim,
+                                       uint16_t flags) {
+    if (!rf || !text || !token_ids || !embeddings || !tokenizer_id || !embedding_id || (flags & ~RAGFILE_FLAGS_KNOWN)) {
         return RAGFILE_ERROR_INVALID_ARGUMENT;
     }
 
@@ -89,7 +134,7 @@ RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* toke
     // Initialize header
     (*rf)->header.magic = RAGFILE_MAGIC;
     (*rf)->header.version = RAGFILE_VERSION;
-    (*rf)->header.flags = 0;  // No flags set for now
+    (*rf)->header.flags = flags;
     (*rf)->header.tokenizer_id_hash = crc16(tokenizer_id);
     (*rf)->header.embedding_id_hash = crc16(embedding_id);
 
@@ -113,15 +158,10 @@ RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* toke
     // Zero out the minhash_signature array before computation.
     memset((*rf)->header.minhash_signature, 0, MINHASH_SIZE * sizeof(uint32_t));
 
-    RagfileError binary_embedding_error = compute_binary_embedding(*rf, embeddings, num_embeddings, embedding_dim);
-    if (binary_embedding_error != RAGFILE_SUCCESS) {
-        ragfile_free(*rf);
-        *rf = NULL;
-        return binary_embedding_error;
-    }
-
     // Compute minhash signature
-    RagfileError mh_error = ragfile_compute_minhash(token_ids, token_count, (*rf)->header.minhash_signature);
+    RagfileError mh_error = (flags & RAGFILE_FLAG_MINHASH_OPH)
+        ? ragfile_compute_minhash_oph(token_ids, token_count, (*rf)->header.minhash_signature)
+        : ragfile_compute_minhash(token_ids, token_count, (*rf)->header.minhash_signature);
     if (mh_error != RAGFILE_SUCCESS) {
         ragfile_free(*rf);
         *rf = NULL;
@@ -144,6 +184,17 @@ RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* toke
         return RAGFILE_ERROR_MEMORY;
     }
     memcpy((*rf)->embeddings, embeddings, embedding_size * sizeof(float));
+    if (flags & RAGFILE_FLAG_NORMALIZED_EMBEDDINGS) {
+        l2_normalize((*rf)->embeddings, num_embeddings, embedding_dim);
+    }
+
+    // The binary embedding is quantized from the embeddings as stored
+    RagfileError binary_embedding_error = compute_binary_embedding(*rf, (*rf)->embeddings, num_embeddings, embedding_dim);
+    if (binary_embedding_error != RAGFILE_SUCCESS) {
+        ragfile_free(*rf);
+        *rf = NULL;
+        return binary_embedding_error;
+    }
 
     // Copy extended metadata
     if (extended_metadata) {
@@ -160,7 +211,43 @@ RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* toke
     return RAGFILE_SUCCESS;
 }
 
+struct RagFileStorage {
+    void* mapping;
+    size_t size;
+    float* embeddings_copy;  // Aligned copy when the embeddings are misaligned in the mapping, or the loaded lazy section
+    atomic_int refcount;
+
+    // Lazy RagFiles only
+    char* path;              // NULL for memory mapped views
+    char* text;
+    char* extended_metadata;
+    pthread_mutex_t lock;    // Serializes the loading of sections
+};
+
+static void ragfile_storage_free(RagFileStorage* storage) {
+    if (storage->mapping) {
+        munmap(storage->mapping, storage->size);
+    }
+    if (storage->path) {
+        pthread_mutex_destroy(&storage->lock);
+        free(storage->path);
+        free(storage->text);
+        free(storage->extended_metadata);
+    }
+    free(storage->embeddings_copy);
+    free(storage);
+}
+
 void ragfile_free(RagFile* rf) {
+    if (rf && rf->storage) {
+        // Views share their buffers with the mapping; only the last reference releases it
+        if (atomic_fetch_sub(&rf->storage->refcount, 1) > 1) {
+            return;
+        }
+        ragfile_storage_free(rf->storage);
+        free(rf);
+        return;
+    }
     if (rf) {
         free(rf->text);
         rf->text = NULL;  // Prevent dangling pointer
@@ -238,8 +325,336 @@ RagfileError ragfile_load(RagFile** rf, FILE* file) {
     return RAGFILE_SUCCESS;
 }
 
+RagfileError ragfile_retain(RagFile* rf) {
+    if (!rf || !rf->storage) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+    atomic_fetch_add(&rf->storage->refcount, 1);
+    return RAGFILE_SUCCESS;
+}
+
+// Point a RagFile at the sections of a serialized file held in memory
+static RagfileError ragfile_parse_view(RagFile* rf, const char* data, size_t size, float** embeddings_copy) {
+    size_t offset = sizeof(RagfileHeader) + sizeof(FileMetadata);
+    if (size < offset) {
+        return RAGFILE_ERROR_IO;
+    }
+    memcpy(&rf->header, data, sizeof(RagfileHeader));
+    if (rf->header.magic != RAGFILE_MAGIC || rf->header.version != RAGFILE_VERSION) {
+        return RAGFILE_ERROR_FORMAT;
+    }
+    memcpy(&rf->file_metadata, data + sizeof(RagfileHeader), sizeof(FileMetadata));
+    if (rf->file_metadata.tokenizer_id[MODEL_ID_SIZE - 1] != '\0' ||
+        rf->file_metadata.embedding_id[MODEL_ID_SIZE - 1] != '\0') {
+        return RAGFILE_ERROR_FORMAT;
+    }
+
+    uint64_t text_size = rf->file_metadata.text_size;
+    uint64_t embedding_bytes = (uint64_t)rf->file_metadata.embedding_size * sizeof(float);
+    uint64_t metadata_size = rf->file_metadata.metadata_size;
+    if (text_size + embedding_bytes + metadata_size > size - offset) {
+        return RAGFILE_ERROR_IO;  // Truncated file
+    }
+
+    rf->text = text_size > 0 ? (char*)data + offset : NULL;
+    offset += text_size;
+
+    const char* embeddings = data + offset;
+    if ((uintptr_t)embeddings % _Alignof(float) == 0) {
+        rf->embeddings = (float*)embeddings;
+    } else {
+        *embeddings_copy = (float*)malloc(embedding_bytes > 0 ? embedding_bytes : 1);
+        if (*embeddings_copy == NULL) {
+            return RAGFILE_ERROR_MEMORY;
+        }
+        memcpy(*embeddings_copy, embeddings, embedding_bytes);
+        rf->embeddings = *embeddings_copy;
+    }
+    offset += embedding_bytes;
+
+    rf->extended_metadata = metadata_size > 0 ? (char*)data + offset : NULL;
+    return RAGFILE_SUCCESS;
+}
+
+RagfileError ragfile_open_mmap(RagFile** rf, const char* path) {
+    if (!rf || !path) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return RAGFILE_ERROR_IO;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return RAGFILE_ERROR_IO;
+    }
+    if (st.st_size < (off_t)(sizeof(RagfileHeader) + sizeof(FileMetadata))) {
+        close(fd);
+        return RAGFILE_ERROR_FORMAT;  // Too short to be a RagFile (and empty files cannot be mapped)
+    }
+
+    RagFileStorage* storage = (RagFileStorage*)calloc(1, sizeof(RagFileStorage));
+    *rf = (RagFile*)calloc(1, sizeof(RagFile));
+    if (storage == NULL || *rf == NULL) {
+        close(fd);
+        free(storage);
+        free(*rf);
+        *rf = NULL;
+        return RAGFILE_ERROR_MEMORY;
+    }
+
+    // The mapping outlives the descriptor
+    storage->size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, storage->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        free(storage);
+        free(*rf);
+        *rf = NULL;
+        return RAGFILE_ERROR_IO;
+    }
+    storage->mapping = mapping;
+    atomic_init(&storage->refcount, 1);
+
+    RagfileError error = ragfile_parse_view(*rf, (const char*)mapping, storage->size, &storage->embeddings_copy);
+    if (error != RAGFILE_SUCCESS) {
+        ragfile_storage_free(storage);
+        free(*rf);
+        *rf = NULL;
+        return error;
+    }
+    (*rf)->storage = storage;
+    return RAGFILE_SUCCESS;
+}
+
+// Copy a section of a serialized file into a new NUL terminated buffer (NULL when empty, as read_text does)
+static RagfileError ragfile_copy_string(char** dest, const char* src, size_t size) {
+    *dest = NULL;
+    if (size == 0) {
+        return RAGFILE_SUCCESS;
+    }
+    *dest = (char*)malloc(size + 1);
+    if (*dest == NULL) {
+        return RAGFILE_ERROR_MEMORY;
+    }
+    memcpy(*dest, src, size);
+    (*dest)[size] = '\0';
+    return RAGFILE_SUCCESS;
+}
+
+RagfileError ragfile_load_from_buffer(RagFile** rf, const uint8_t* data, size_t size, bool borrow) {
+    if (!rf || !data) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+
+    *rf = (RagFile*)calloc(1, sizeof(RagFile));
+    if (*rf == NULL) {
+        return RAGFILE_ERROR_MEMORY;
+    }
+    float* embeddings_copy = NULL;
+    RagfileError error = ragfile_parse_view(*rf, (const char*)data, size, &embeddings_copy);
+    if (error != RAGFILE_SUCCESS) {
+        free(embeddings_copy);
+        free(*rf);
+        *rf = NULL;
+        return error;
+    }
+
+    if (borrow) {
+        RagFileStorage* storage = (RagFileStorage*)calloc(1, sizeof(RagFileStorage));
+        if (storage == NULL) {
+            free(embeddings_copy);
+            free(*rf);
+            *rf = NULL;
+            return RAGFILE_ERROR_MEMORY;
+        }
+        storage->embeddings_copy = embeddings_copy;
+        atomic_init(&storage->refcount, 1);
+        (*rf)->storage = storage;
+        return RAGFILE_SUCCESS;
+    }
+
+    // Replace the pointers into the buffer with owned copies, one section at a time
+    const char* text = (*rf)->text;
+    const float* embeddings = (*rf)->embeddings;
+    const char* extended_metadata = (*rf)->extended_metadata;
+    (*rf)->text = NULL;
+    (*rf)->extended_metadata = NULL;
+    (*rf)->embeddings = embeddings_copy;
+    if ((*rf)->embeddings == NULL) {
+        size_t embedding_bytes = (size_t)(*rf)->file_metadata.embedding_size * sizeof(float);
+        (*rf)->embeddings = (float*)malloc(embedding_bytes > 0 ? embedding_bytes : 1);
+        if ((*rf)->embeddings != NULL) {
+            memcpy((*rf)->embeddings, embeddings, embedding_bytes);
+        }
+    }
+    if ((*rf)->embeddings == NULL ||
+        ragfile_copy_string(&(*rf)->text, text, (*rf)->file_metadata.text_size) != RAGFILE_SUCCESS ||
+        ragfile_copy_string(&(*rf)->extended_metadata, extended_metadata, (*rf)->file_metadata.metadata_size) != RAGFILE_SUCCESS) {
+        ragfile_free(*rf);
+        *rf = NULL;
+        return RAGFILE_ERROR_MEMORY;
+    }
+    return RAGFILE_SUCCESS;
+}
+
+RagfileError ragfile_open_lazy(RagFile** rf, const char* path) {
+    if (!rf || !path) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return RAGFILE_ERROR_IO;
+    }
+    struct stat st;
+    char prefix[sizeof(RagfileHeader) + sizeof(FileMetadata)];
+    bool complete = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(prefix) &&
+                    pread(fd, prefix, sizeof(prefix), 0) == (ssize_t)sizeof(prefix);
+    close(fd);
+    if (!complete) {
+        return RAGFILE_ERROR_IO;
+    }
+
+    RagFileStorage* storage = (RagFileStorage*)calloc(1, sizeof(RagFileStorage));
+    *rf = (RagFile*)calloc(1, sizeof(RagFile));
+    char* path_copy = strdup(path);
+    if (storage == NULL || *rf == NULL || path_copy == NULL || pthread_mutex_init(&storage->lock, NULL) != 0) {
+        free(storage);
+        free(*rf);
+        free(path_copy);
+        *rf = NULL;
+        return RAGFILE_ERROR_MEMORY;
+    }
+    storage->path = path_copy;
+    storage->size = (size_t)st.st_size;
+    atomic_init(&storage->refcount, 1);
+    (*rf)->storage = storage;
+
+    // Validate the header and section sizes now, so loading a section later only fails if the file changed
+    RagfileError error = RAGFILE_SUCCESS;
+    memcpy(&(*rf)->header, prefix, sizeof(RagfileHeader));
+    memcpy(&(*rf)->file_metadata, prefix + sizeof(RagfileHeader), sizeof(FileMetadata));
+    const FileMetadata* metadata = &(*rf)->file_metadata;
+    if ((*rf)->header.magic != RAGFILE_MAGIC || (*rf)->header.version != RAGFILE_VERSION ||
+        metadata->tokenizer_id[MODEL_ID_SIZE - 1] != '\0' || metadata->embedding_id[MODEL_ID_SIZE - 1] != '\0') {
+        error = RAGFILE_ERROR_FORMAT;
+    } else if ((uint64_t)metadata->text_size + (uint64_t)metadata->embedding_size * sizeof(float) +
+               metadata->metadata_size > storage->size - sizeof(prefix)) {
+        error = RAGFILE_ERROR_IO;  // Truncated file
+    }
+    if (error != RAGFILE_SUCCESS) {
+        ragfile_free(*rf);
+        *rf = NULL;
+    }
+    return error;
+}
+
+// Read one section of a lazy RagFile into a new buffer, NUL terminated for the string sections
+static RagfileError ragfile_read_section(const RagFile* rf, uint64_t offset, size_t size, bool terminate, void** buffer) {
+    char* data = (char*)malloc(size + (terminate || size == 0 ? 1 : 0));
+    if (data == NULL) {
+        return RAGFILE_ERROR_MEMORY;
+    }
+    if (read_at(rf->storage->path, offset, data, size) != FILE_IO_SUCCESS) {
+        free(data);
+        return RAGFILE_ERROR_IO;
+    }
+    if (terminate) {
+        data[size] = '\0';
+    }
+    *buffer = data;
+    return RAGFILE_SUCCESS;
+}
+
+RagfileError ragfile_load_section(RagFile* rf, unsigned sections) {
+    if (!rf) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+    RagFileStorage* storage = rf->storage;
+    if (!storage || !storage->path) {
+        return RAGFILE_SUCCESS;  // Every section is already in memory
+    }
+
+    const FileMetadata* metadata = &rf->file_metadata;
+    uint64_t text_offset = sizeof(RagfileHeader) + sizeof(FileMetadata);
+    uint64_t embeddings_offset = text_offset + metadata->text_size;
+    size_t embedding_bytes = (size_t)metadata->embedding_size * sizeof(float);
+    uint64_t metadata_offset = embeddings_offset + embedding_bytes;
+
+    RagfileError error = RAGFILE_SUCCESS;
+    void* buffer;
+    pthread_mutex_lock(&storage->lock);
+    if ((sections & RAGFILE_SECTION_TEXT) && rf->text == NULL) {
+        error = ragfile_read_section(rf, text_offset, metadata->text_size, true, &buffer);
+        if (error == RAGFILE_SUCCESS) {
+            storage->text = rf->text = (char*)buffer;
+        }
+    }
+    if (error == RAGFILE_SUCCESS && (sections & RAGFILE_SECTION_EMBEDDINGS) && rf->embeddings == NULL) {
+        error = ragfile_read_section(rf, embeddings_offset, embedding_bytes, false, &buffer);
+        if (error == RAGFILE_SUCCESS) {
+            storage->embeddings_copy = rf->embeddings = (float*)buffer;
+        }
+    }
+    // Like ragfile_load, an empty extended metadata section stays NULL
+    if (error == RAGFILE_SUCCESS && (sections & RAGFILE_SECTION_METADATA) &&
+        rf->extended_metadata == NULL && metadata->metadata_size > 0) {
+        error = ragfile_read_section(rf, metadata_offset, metadata->metadata_size, true, &buffer);
+        if (error == RAGFILE_SUCCESS) {
+            storage->extended_metadata = rf->extended_metadata = (char*)buffer;
+        }
+    }
+    pthread_mutex_unlock(&storage->lock);
+    return error;
+}
+
+// Whether a RagFile has every section it declares in memory, as saving requires
+static bool ragfile_is_complete(const RagFile* rf) {
+    return rf->text && rf->embeddings && (rf->extended_metadata != NULL) == (rf->file_metadata.metadata_size > 0);
+}
+
+size_t ragfile_serialized_size(const RagFile* rf) {
+    if (!rf) {
+        return 0;
+    }
+    // Computed from the declared section sizes, so sections of a lazy RagFile need not be loaded
+    return sizeof(RagfileHeader) + sizeof(FileMetadata) + rf->file_metadata.text_size +
+           (size_t)rf->file_metadata.embedding_size * sizeof(float) + rf->file_metadata.metadata_size;
+}
+
+RagfileError ragfile_save_to_buffer(const RagFile* rf, uint8_t* buffer, size_t capacity, size_t* written) {
+    if (!rf || !buffer || !ragfile_is_complete(rf)) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+    size_t size = ragfile_serialized_size(rf);
+    if (written) {
+        *written = size;
+    }
+    if (capacity < size) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+
+    // Same layout as ragfile_save, with one memcpy per section
+    uint8_t* cursor = buffer;
+    memcpy(cursor, &rf->header, sizeof(RagfileHeader));
+    cursor += sizeof(RagfileHeader);
+    memcpy(cursor, &rf->file_metadata, sizeof(FileMetadata));
+    cursor += sizeof(FileMetadata);
+    memcpy(cursor, rf->text, rf->file_metadata.text_size);
+    cursor += rf->file_metadata.text_size;
+    memcpy(cursor, rf->embeddings, (size_t)rf->file_metadata.embedding_size * sizeof(float));
+    cursor += (size_t)rf->file_metadata.embedding_size * sizeof(float);
+    if (rf->file_metadata.metadata_size > 0) {
+        memcpy(cursor, rf->extended_metadata, rf->file_metadata.metadata_size);
+    }
+    return RAGFILE_SUCCESS;
+}
+
 RagfileError ragfile_save(const RagFile* rf, FILE* file) {
-    if (!rf || !file || !rf->text || !rf->embeddings || (rf->extended_metadata && rf->file_metadata.metadata_size == 0)) {
+    if (!rf || !file || !ragfile_is_complete(rf)) {
         return RAGFILE_ERROR_INVALID_ARGUMENT;
     }
 
@@ -41,12 +41,25 @@ typedef struct {
 } FileMetadata;
 #pragma pack(pop)
 
+// Sections of a RagFile that follow the header and file metadata
+typedef enum {
+    RAGFILE_SECTION_TEXT = 1,
+    RAGFILE_SECTION_EMBEDDINGS = 2,
+    RAGFILE_SECTION_METADATA = 4,
+    RAGFILE_SECTION_ALL = 7
+} RagfileSection;
+
+// Backing storage shared by the references to a read-only view (see ragfile_open_mmap, ragfile_open_lazy
+// and ragfile_load_from_buffer)
+typedef struct RagFileStorage RagFileStorage;
+
 typedef struct {
     RagfileHeader header;
     FileMetadata file_metadata;
     char* text;
     float* embeddings;
     char* extended_metadata;
+    RagFileStorage* storage;  // NULL when the RagFile owns its buffers
 } RagFile;
 
 /**
@@ -69,6 +82,34 @@ RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* toke
                             const char* tokenizer_id, const char* embedding_id, 
                             uint16_t extended_metadata_version, uint16_t num_embeddings, uint16_t embedding_dim);
 
+/**
+ * Create a new RagFile object with header flags, as ragfile_create. With
+ * RAGFILE_FLAG_MINHASH_OPH the signature is computed with
+ * ragfile_compute_minhash_oph instead of ragfile_compute_minhash. With
+ * RAGFILE_FLAG_NORMALIZED_EMBEDDINGS every embedding is scaled to unit L2 norm
+ * before it is stored and quantized.
+ *
+ * @param flags Bitwise or of RAGFILE_FLAG_* values.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure (RAGFILE_ERROR_INVALID_ARGUMENT for unknown flags).
+ */
+RagfileError ragfile_create_with_flags(RagFile** rf, const char* text, const uint32_t* token_ids, size_t token_count,
+                                       const float* embeddings, uint32_t embedding_size, const char* extended_metadata,
+                                       const char* tokenizer_id, const char* embedding_id,
+                                       uint16_t extended_metadata_version, uint16_t num_embeddings, uint16_t embedding_dim,
+                                       uint16_t flags);
+
+/**
+ * Whether the MinHash signatures of two headers were computed with the same
+ * scheme, and so can be compared with jaccard_similarity.
+ *
+ * @param flags Flags of the first header.
+ * @param other_flags Flags of the second header.
+ * @return true if the signatures are compatible.
+ */
+static inline bool ragfile_minhash_compatible(uint16_t flags, uint16_t other_flags) {
+    return ((flags ^ other_flags) & RAGFILE_FLAGS_MINHASH) == 0;
+}
+
 /**
  * Load a RagFile from disk.
  *
@@ -77,6 +118,77 @@ RagfileError ragfile_create(RagFile** rf, const char* text, const uint32_t* toke
  * @return RAGFILE_SUCCESS on success, or an error code on failure.
  */
 RagfileError ragfile_load(RagFile** rf, FILE* file);
+
+/**
+ * Parse a serialized RagFile (as written by ragfile_save) held in memory.
+ * Every section size is checked against the buffer before it is used.
+ *
+ * By default the sections are copied and the RagFile owns them, exactly as
+ * with ragfile_load. With borrow set, the RagFile is instead a read-only view
+ * like those of ragfile_open_mmap: text and extended_metadata point into the
+ * buffer and are not NUL terminated, embeddings do too unless they are
+ * misaligned, and the buffer must outlive every reference to the view.
+ *
+ * @param rf Pointer to a RagFile pointer where the loaded object will be stored.
+ * @param data Serialized RagFile.
+ * @param size Size of the serialized RagFile in bytes.
+ * @param borrow Reference the buffer instead of copying the sections.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_load_from_buffer(RagFile** rf, const uint8_t* data, size_t size, bool borrow);
+
+/**
+ * Open a RagFile as a read-only view of a memory mapping of the file. The
+ * header and file metadata are copied, but text, embeddings and
+ * extended_metadata point into the mapping, so nothing else is read until it
+ * is touched. Unlike ragfile_load, text and extended_metadata are not NUL
+ * terminated: use text_size and metadata_size. Embeddings that are not
+ * 4-byte aligned in the file (the text size is not a multiple of 4) are
+ * copied into an aligned buffer.
+ *
+ * The view starts with one reference; ragfile_retain adds one and
+ * ragfile_free drops one, and the file is unmapped with the last.
+ *
+ * @param rf Pointer to a RagFile pointer where the view will be stored.
+ * @param path Path to the file to map.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_open_mmap(RagFile** rf, const char* path);
+
+/**
+ * Open a RagFile lazily: only the header and file metadata are read, and
+ * text, embeddings and extended_metadata stay NULL until they are loaded with
+ * ragfile_load_section. Each section is then read with a single pread at the
+ * offset given by the sizes before it, reopening the file by path so that a
+ * lazy RagFile holds no descriptor. Loaded text and extended_metadata are NUL
+ * terminated, as with ragfile_load. The file must not change while it is open.
+ *
+ * References are managed as for ragfile_open_mmap.
+ *
+ * @param rf Pointer to a RagFile pointer where the lazy RagFile will be stored.
+ * @param path Path to the file.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_open_lazy(RagFile** rf, const char* path);
+
+/**
+ * Make sure sections of a RagFile are in memory, reading those of a lazy
+ * RagFile that have not been read yet. Safe to call from several threads.
+ * A no-op for RagFiles that were loaded, created or memory mapped.
+ *
+ * @param rf Pointer to the RagFile.
+ * @param sections Bitwise or of RagfileSection values.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_load_section(RagFile* rf, unsigned sections);
+
+/**
+ * Take another reference to a read-only view.
+ *
+ * @param rf Pointer to a view from ragfile_open_mmap, ragfile_open_lazy or a borrowing ragfile_load_from_buffer.
+ * @return RAGFILE_SUCCESS, or RAGFILE_ERROR_INVALID_ARGUMENT if rf owns its buffers.
+ */
+RagfileError ragfile_retain(RagFile* rf);
 /**
  * Save a RagFile to disk.
  *
@@ -87,7 +199,29 @@ RagfileError ragfile_load(RagFile** rf, FILE* file);
 RagfileError ragfile_save(const RagFile* rf, FILE* file);
 
 /**
- * Free memory associated with a RagFile object.
+ * Number of bytes ragfile_save and ragfile_save_to_buffer write for a RagFile,
+ * from its declared section sizes (the sections need not be loaded).
+ *
+ * @param rf Pointer to the RagFile.
+ * @return Serialized size in bytes (0 if rf is NULL).
+ */
+size_t ragfile_serialized_size(const RagFile* rf);
+
+/**
+ * Serialize a RagFile into a caller supplied buffer, in the same layout as
+ * ragfile_save but without stdio.
+ *
+ * @param rf Pointer to the RagFile to be saved.
+ * @param buffer Destination buffer.
+ * @param capacity Size of the buffer in bytes.
+ * @param written Set to ragfile_serialized_size(rf), also when the buffer is too small (can be NULL).
+ * @return RAGFILE_SUCCESS on success, or RAGFILE_ERROR_INVALID_ARGUMENT if the
+ *         RagFile is incomplete or the buffer is smaller than its serialized size.
+ */
+RagfileError ragfile_save_to_buffer(const RagFile* rf, uint8_t* buffer, size_t capacity, size_t* written);
+
+/**
+ * Free memory associated with a RagFile object, or drop a reference to a view.
  *
  * @param rf Pointer to the RagFile to be freed.
  */
@@ -110,6 +244,47 @@ uint16_t crc16(const char* input_string);
  * @return RAGFILE_SUCCESS on success, or an error code on failure.
  */
 RagfileError ragfile_compute_minhash(const uint32_t* token_ids, size_t token_count, uint32_t* minhash_signature);
+
+/**
+ * Compute a one-permutation MinHash signature for a set of token IDs, laid out
+ * like ragfile_compute_minhash (bigrams then trigrams) but with each n-gram
+ * hashed once (see minhash_compute_oph). Stored with RAGFILE_FLAG_MINHASH_OPH.
+ *
+ * @param token_ids Array of token IDs.
+ * @param token_count Number of tokens in the array.
+ * @param minhash_signature Pointer to an array where the MinHash signature will be stored.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_compute_minhash_oph(const uint32_t* token_ids, size_t token_count, uint32_t* minhash_signature);
+
+/**
+ * Compute the MinHash signature of every sliding window of a token sequence in
+ * one pass, sharing the n-gram hashes of overlapping windows (see
+ * minhash_compute_windows). Signature k equals ragfile_compute_minhash on
+ * tokens [k * step, k * step + window_size), clipped to the sequence; slots of
+ * a window too short for bigrams or trigrams are UINT32_MAX.
+ *
+ * @param token_ids Array of token IDs.
+ * @param token_count Number of tokens in the array.
+ * @param window_size Number of tokens per window (at least 3).
+ * @param step Number of tokens between the starts of two windows.
+ * @param signatures Receives minhash_window_count(token_count, window_size, step) signatures of MINHASH_SIZE slots.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_compute_minhash_windows(const uint32_t* token_ids, size_t token_count, size_t window_size,
+                                             size_t step, uint32_t* signatures);
+
+/**
+ * Get the L2 norm of each embedding of a loaded RagFile, for
+ * cosine_similarity_pairs. Files created with RAGFILE_FLAG_NORMALIZED_EMBEDDINGS
+ * need none, and *norms is set to NULL.
+ *
+ * @param rf Pointer to the RagFile, with its embeddings loaded.
+ * @param norms Receives an array of num_embeddings norms to free, or NULL for normalized embeddings.
+ * @return RAGFILE_SUCCESS on success, or an error code on failure.
+ */
+RagfileError ragfile_embedding_norms(const RagFile* rf, float** norms);
+
 RagfileError compute_binary_embedding(RagFile* rf, const float* embeddings, uint32_t num_embeddings, uint16_t embedding_dim);
  
 #endif // RAGFILE_H
@@ -0,0 +1,90 @@
+#include "ragfile_batch.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const RagFileSpec* specs;
+    size_t count;
+    const char* tokenizer_id;
+    const char* embedding_id;
+    uint16_t extended_metadata_version;
+    uint16_t flags;
+    RagFile** rfs;
+    atomic_size_t next;
+    atomic_size_t failed;   // Lowest failing index, or count
+    RagfileError* errors;   // Error of each document, read for the failed one
+} CreateManyJob;
+
+static void ragfile_create_worker(void* ctx, size_t worker) {
+    (void)worker;
+    CreateManyJob* job = (CreateManyJob*)ctx;
+
+    for (;;) {
+        size_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+        if (i >= job->count || i > atomic_load_explicit(&job->failed, memory_order_relaxed)) {
+            break;  // Done, or past a failure whose results will be thrown away
+        }
+
+        const RagFileSpec* spec = &job->specs[i];
+        job->errors[i] = ragfile_create_with_flags(&job->rfs[i], spec->text, spec->token_ids, spec->token_count,
+                                                   spec->embeddings, spec->embedding_size, spec->extended_metadata,
+                                                   job->tokenizer_id, job->embedding_id, job->extended_metadata_version,
+                                                   spec->num_embeddings, spec->embedding_dim, job->flags);
+        if (job->errors[i] != RAGFILE_SUCCESS) {
+            job->rfs[i] = NULL;
+            size_t failed = atomic_load_explicit(&job->failed, memory_order_relaxed);
+            while (i < failed && !atomic_compare_exchange_weak(&job->failed, &failed, i)) {
+            }
+        }
+    }
+}
+
+RagfileError ragfile_create_many(ThreadPool* pool, size_t num_workers, const RagFileSpec* specs, size_t count,
+                                 const char* tokenizer_id, const char* embedding_id,
+                                 uint16_t extended_metadata_version, uint16_t flags, RagFile** rfs,
+                                 size_t* failed_index) {
+    if ((!specs || !rfs) && count > 0) {
+        return RAGFILE_ERROR_INVALID_ARGUMENT;
+    }
+    if (count == 0) {
+        return RAGFILE_SUCCESS;
+    }
+
+    CreateManyJob job = {
+        .specs = specs,
+        .count = count,
+        .tokenizer_id = tokenizer_id,
+        .embedding_id = embedding_id,
+        .extended_metadata_version = extended_metadata_version,
+        .flags = flags,
+        .rfs = rfs,
+        .errors = (RagfileError*)malloc(count * sizeof(RagfileError)),
+    };
+    if (!job.errors) {
+        return RAGFILE_ERROR_MEMORY;
+    }
+    memset(rfs, 0, count * sizeof(RagFile*));
+    atomic_init(&job.next, 0);
+    atomic_init(&job.failed, count);
+
+    if (pool && num_workers > 1) {
+        thread_pool_run(pool, ragfile_create_worker, &job, num_workers < count ? num_workers : count);
+    } else {
+        ragfile_create_worker(&job, 0);
+    }
+
+    size_t failed = atomic_load(&job.failed);
+    RagfileError error = failed < count ? job.errors[failed] : RAGFILE_SUCCESS;
+    free(job.errors);
+    if (error != RAGFILE_SUCCESS) {
+        for (size_t i = 0; i < count; i++) {
+            ragfile_free(rfs[i]);
+            rfs[i] = NULL;
+        }
+        if (failed_index) {
+            *failed_index = failed;
+        }
+    }
+    return error;
+}
@@ -0,0 +1,42 @@
+#ifndef RAGFILE_BATCH_H
+#define RAGFILE_BATCH_H
+
+#include "ragfile.h"
+#include "../utils/thread_pool.h"
+
+// Per document arguments of ragfile_create
+typedef struct {
+    const char* text;
+    const uint32_t* token_ids;
+    size_t token_count;
+    const float* embeddings;
+    uint32_t embedding_size;
+    const char* extended_metadata;   // Can be NULL
+    uint16_t num_embeddings;
+    uint16_t embedding_dim;
+} RagFileSpec;
+
+/**
+ * Create a batch of RagFiles in parallel. Each document is built exactly as
+ * by ragfile_create_with_flags (MinHash, binary embedding and copies); workers claim
+ * documents one at a time, so uneven document sizes balance out.
+ *
+ * @param pool Thread pool to run on, or NULL to create on the calling thread.
+ * @param num_workers Number of workers to use.
+ * @param specs Array of documents.
+ * @param count Number of documents.
+ * @param tokenizer_id Tokenizer identifier shared by the batch.
+ * @param embedding_id Embedding model identifier shared by the batch.
+ * @param extended_metadata_version Version of the metadata format shared by the batch.
+ * @param flags Header flags shared by the batch (see ragfile_create_with_flags).
+ * @param rfs Array of count pointers that receives the new RagFiles.
+ * @param failed_index Set to the index of the first document that failed (can be NULL).
+ * @return RAGFILE_SUCCESS, or the error of the first failing document, in
+ *         which case no RagFile is returned.
+ */
+RagfileError ragfile_create_many(ThreadPool* pool, size_t num_workers, const RagFileSpec* specs, size_t count,
+                                 const char* tokenizer_id, const char* embedding_id,
+                                 uint16_t extended_metadata_version, uint16_t flags, RagFile** rfs,
+                                 size_t* failed_index);
+
+#endif // RAGFILE_BATCH_H
@@ -8,6 +8,12 @@
 #define METADATA_MAX_SIZE 1024
 #define MINHASH_SIZE 256
 
+// RagfileHeader.flags
+#define RAGFILE_FLAG_MINHASH_OPH 0x0001             // Signature computed with one-permutation hashing (minhash_compute_oph)
+#define RAGFILE_FLAG_NORMALIZED_EMBEDDINGS 0x0002   // Embeddings stored with unit L2 norm, so cosine similarity is a dot product
+#define RAGFILE_FLAGS_MINHASH RAGFILE_FLAG_MINHASH_OPH  // Flags that must match for two signatures to be compared
+#define RAGFILE_FLAGS_KNOWN (RAGFILE_FLAG_MINHASH_OPH | RAGFILE_FLAG_NORMALIZED_EMBEDDINGS)
+
 #ifndef BINARY_EMBEDDING_DIM
 #define BINARY_EMBEDDING_DIM 128 // Default dimension
 #endif
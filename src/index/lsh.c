@@ -0,0 +1,604 @@
+#include "lsh.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../utils/strdup.h"
+#include "../algorithms/jaccard.h"
+
+#define LSH_INITIAL_CAPACITY 64
+#define LSH_MAX_PATH_LENGTH 65536
+#define LSH_TOMBSTONE UINT32_MAX     // Path slot of a deleted entry
+#define LSH_MAX_ENTRIES (UINT32_MAX - 1)
+
+// One hash table per band: band key -> chain of entries sharing that band
+typedef struct {
+    uint64_t* keys;
+    uint32_t* heads;    // Entry id + 1 of the newest entry in the bucket, 0 if the slot is empty
+    uint32_t* next;     // Per entry: id + 1 of the next entry in the same bucket, 0 at the end
+    size_t capacity;    // Power of two
+    size_t used;
+} LshBand;
+
+struct LshIndex {
+    uint16_t bands;
+    uint16_t rows;
+    size_t num_bands;       // Bands over both signature halves
+    // Taken from the first insert and shared by every entry
+    uint16_t flags;         // RAGFILE_FLAGS_MINHASH bits
+    uint16_t tokenizer_id_hash;
+    uint16_t embedding_id_hash;
+
+    LshBand* band_tables;
+
+    // Entries are append-only; deleted entries stay in the band chains until the index is compacted
+    char** paths;
+    uint32_t* signatures;
+    bool* live;
+    size_t count;
+    size_t capacity;
+    size_t live_count;
+
+    // Path -> entry id + 1 for live entries
+    uint32_t* path_slots;
+    size_t path_capacity;
+    size_t path_used;       // Slots holding an entry or a tombstone
+};
+
+// Scores are meaningless across tokenizers, embedding models and MinHash schemes
+static bool lsh_compatible(const LshIndex* index, const RagfileHeader* header) {
+    return header->tokenizer_id_hash == index->tokenizer_id_hash &&
+           header->embedding_id_hash == index->embedding_id_hash &&
+           ragfile_minhash_compatible(header->flags, index->flags);
+}
+
+static uint64_t lsh_band_key(const uint32_t* signature, size_t start, uint16_t rows) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (uint16_t i = 0; i < rows; i++) {
+        h ^= signature[start + i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static size_t lsh_band_start(const LshIndex* index, size_t band) {
+    size_t half = band / index->bands;
+    return half * LSH_HALF_SIZE + (band % index->bands) * index->rows;
+}
+
+static uint64_t lsh_path_hash(const char* path) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Find the slot holding key, or the empty slot where it belongs
+static size_t lsh_band_find(const LshBand* table, uint64_t key) {
+    size_t mask = table->capacity - 1;
+    size_t slot = key & mask;
+    while (table->heads[slot] != 0 && table->keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static LshError lsh_band_grow(LshBand* table) {
+    size_t capacity = table->capacity ? table->capacity * 2 : LSH_INITIAL_CAPACITY;
+    uint64_t* keys = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    uint32_t* heads = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    if (!keys || !heads) {
+        free(keys);
+        free(heads);
+        return LSH_ERROR_MEMORY;
+    }
+
+    LshBand grown = {keys, heads, table->next, capacity, table->used};
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->heads[i] != 0) {
+            size_t slot = lsh_band_find(&grown, table->keys[i]);
+            grown.keys[slot] = table->keys[i];
+            grown.heads[slot] = table->heads[i];
+        }
+    }
+
+    free(table->keys);
+    free(table->heads);
+    *table = grown;
+    return LSH_SUCCESS;
+}
+
+// Find the path slot of a live entry, or the first free slot if the path is not indexed
+static size_t lsh_path_find(const LshIndex* index, const char* path, bool* found) {
+    size_t mask = index->path_capacity - 1;
+    size_t slot = lsh_path_hash(path) & mask;
+    size_t free_slot = SIZE_MAX;
+    *found = false;
+
+    while (index->path_slots[slot] != 0) {
+        uint32_t value = index->path_slots[slot];
+        if (value == LSH_TOMBSTONE) {
+            if (free_slot == SIZE_MAX) {
+                free_slot = slot;
+            }
+        } else if (strcmp(index->paths[value - 1], path) == 0) {
+            *found = true;
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    return free_slot != SIZE_MAX ? free_slot : slot;
+}
+
+// Rehash the live entries into a table of the given capacity, dropping tombstones
+static LshError lsh_path_rehash(LshIndex* index, size_t capacity) {
+    uint32_t* slots = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    if (!slots) {
+        return LSH_ERROR_MEMORY;
+    }
+
+    free(index->path_slots);
+    index->path_slots = slots;
+    index->path_capacity = capacity;
+    index->path_used = 0;
+    for (size_t id = 0; id < index->count; id++) {
+        if (index->live[id]) {
+            bool found;
+            size_t slot = lsh_path_find(index, index->paths[id], &found);
+            index->path_slots[slot] = (uint32_t)(id + 1);
+            index->path_used++;
+        }
+    }
+    return LSH_SUCCESS;
+}
+
+static LshError lsh_reserve_entry(LshIndex* index) {
+    if (index->count >= LSH_MAX_ENTRIES) {
+        return LSH_ERROR_MEMORY;
+    }
+    if (index->count < index->capacity) {
+        return LSH_SUCCESS;
+    }
+
+    size_t capacity = index->capacity ? index->capacity * 2 : LSH_INITIAL_CAPACITY;
+    char** paths = (char**)realloc(index->paths, capacity * sizeof(char*));
+    if (!paths) {
+        return LSH_ERROR_MEMORY;
+    }
+    index->paths = paths;
+
+    uint32_t* signatures = (uint32_t*)realloc(index->signatures, capacity * MINHASH_SIZE * sizeof(uint32_t));
+    if (!signatures) {
+        return LSH_ERROR_MEMORY;
+    }
+    index->signatures = signatures;
+
+    bool* live = (bool*)realloc(index->live, capacity * sizeof(bool));
+    if (!live) {
+        return LSH_ERROR_MEMORY;
+    }
+    index->live = live;
+
+    for (size_t band = 0; band < index->num_bands; band++) {
+        uint32_t* next = (uint32_t*)realloc(index->band_tables[band].next, capacity * sizeof(uint32_t));
+        if (!next) {
+            return LSH_ERROR_MEMORY;
+        }
+        index->band_tables[band].next = next;
+    }
+
+    index->capacity = capacity;
+    return LSH_SUCCESS;
+}
+
+LshError lsh_create(LshIndex** index, uint16_t bands, uint16_t rows) {
+    if (!index || bands == 0 || rows == 0 || (size_t)bands * rows > LSH_HALF_SIZE) {
+        return LSH_ERROR_INVALID_ARGUMENT;
+    }
+
+    *index = (LshIndex*)calloc(1, sizeof(LshIndex));
+    if (*index == NULL) {
+        return LSH_ERROR_MEMORY;
+    }
+
+    (*index)->bands = bands;
+    (*index)->rows = rows;
+    (*index)->num_bands = 2 * (size_t)bands;
+    (*index)->band_tables = (LshBand*)calloc((*index)->num_bands, sizeof(LshBand));
+    (*index)->path_slots = (uint32_t*)calloc(LSH_INITIAL_CAPACITY, sizeof(uint32_t));
+    (*index)->path_capacity = LSH_INITIAL_CAPACITY;
+    if (!(*index)->band_tables || !(*index)->path_slots) {
+        lsh_free(*index);
+        *index = NULL;
+        return LSH_ERROR_MEMORY;
+    }
+
+    return LSH_SUCCESS;
+}
+
+void lsh_free(LshIndex* index) {
+    if (!index) {
+        return;
+    }
+
+    for (size_t id = 0; id < index->count; id++) {
+        free(index->paths[id]);
+    }
+    if (index->band_tables) {
+        for (size_t band = 0; band < index->num_bands; band++) {
+            free(index->band_tables[band].keys);
+            free(index->band_tables[band].heads);
+            free(index->band_tables[band].next);
+        }
+    }
+    free(index->band_tables);
+    free(index->paths);
+    free(index->signatures);
+    free(index->live);
+    free(index->path_slots);
+    free(index);
+}
+
+static LshError lsh_insert_signature(LshIndex* index, const char* path, const uint32_t* signature) {
+    // Keep the path table at most 70% full, tombstones included
+    if ((index->path_used + 1) * 10 > index->path_capacity * 7) {
+        size_t capacity = index->path_capacity;
+        if ((index->live_count + 1) * 10 > capacity * 3) {
+            capacity *= 2;
+        }
+        LshError error = lsh_path_rehash(index, capacity);
+        if (error != LSH_SUCCESS) {
+            return error;
+        }
+    }
+
+    LshError error = lsh_reserve_entry(index);
+    if (error != LSH_SUCCESS) {
+        return error;
+    }
+    for (size_t band = 0; band < index->num_bands; band++) {
+        LshBand* table = &index->band_tables[band];
+        if ((table->used + 1) * 10 > table->capacity * 7 && (error = lsh_band_grow(table)) != LSH_SUCCESS) {
+            return error;
+        }
+    }
+
+    char* copy = strdup(path);
+    if (!copy) {
+        return LSH_ERROR_MEMORY;
+    }
+
+    // A path is indexed at most once; re-inserting it replaces the old entry
+    bool found;
+    size_t path_slot = lsh_path_find(index, path, &found);
+    if (found) {
+        uint32_t old_id = index->path_slots[path_slot] - 1;
+        index->live[old_id] = false;
+        free(index->paths[old_id]);
+        index->paths[old_id] = NULL;
+        index->live_count--;
+    } else if (index->path_slots[path_slot] == 0) {
+        index->path_used++;
+    }
+
+    size_t id = index->count++;
+    index->paths[id] = copy;
+    memcpy(index->signatures + id * MINHASH_SIZE, signature, MINHASH_SIZE * sizeof(uint32_t));
+    index->live[id] = true;
+    index->live_count++;
+    index->path_slots[path_slot] = (uint32_t)(id + 1);
+
+    for (size_t band = 0; band < index->num_bands; band++) {
+        LshBand* table = &index->band_tables[band];
+        uint64_t key = lsh_band_key(signature, lsh_band_start(index, band), index->rows);
+        size_t slot = lsh_band_find(table, key);
+        if (table->heads[slot] == 0) {
+            table->keys[slot] = key;
+            table->used++;
+        }
+        table->next[id] = table->heads[slot];
+        table->heads[slot] = (uint32_t)(id + 1);
+    }
+
+    return LSH_SUCCESS;
+}
+
+// Rebuild the band tables from the live entries only
+static LshError lsh_compact(LshIndex* index) {
+    LshIndex* compacted;
+    LshError error = lsh_create(&compacted, index->bands, index->rows);
+    if (error != LSH_SUCCESS) {
+        return error;
+    }
+    compacted->flags = index->flags;
+    compacted->tokenizer_id_hash = index->tokenizer_id_hash;
+    compacted->embedding_id_hash = index->embedding_id_hash;
+
+    for (size_t id = 0; id < index->count && error == LSH_SUCCESS; id++) {
+        if (index->live[id]) {
+            error = lsh_insert_signature(compacted, index->paths[id], index->signatures + id * MINHASH_SIZE);
+        }
+    }
+    if (error != LSH_SUCCESS) {
+        lsh_free(compacted);
+        return error;
+    }
+
+    LshIndex old = *index;
+    *index = *compacted;
+    *compacted = old;
+    lsh_free(compacted);
+    return LSH_SUCCESS;
+}
+
+LshError lsh_insert(LshIndex* index, const char* path, const RagfileHeader* header) {
+    if (!index || !path || !header) {
+        return LSH_ERROR_INVALID_ARGUMENT;
+    }
+
+    // The first entry fixes what every other entry and query must match
+    if (index->live_count == 0) {
+        index->flags = header->flags & RAGFILE_FLAGS_MINHASH;
+        index->tokenizer_id_hash = header->tokenizer_id_hash;
+        index->embedding_id_hash = header->embedding_id_hash;
+    } else if (!lsh_compatible(index, header)) {
+        return LSH_ERROR_INCOMPATIBLE;
+    }
+
+    return lsh_insert_signature(index, path, header->minhash_signature);
+}
+
+LshError lsh_delete(LshIndex* index, const char* path) {
+    if (!index || !path) {
+        return LSH_ERROR_INVALID_ARGUMENT;
+    }
+
+    bool found;
+    size_t path_slot = lsh_path_find(index, path, &found);
+    if (!found) {
+        return LSH_ERROR_NOT_FOUND;
+    }
+
+    uint32_t id = index->path_slots[path_slot] - 1;
+    index->path_slots[path_slot] = LSH_TOMBSTONE;
+    index->live[id] = false;
+    free(index->paths[id]);
+    index->paths[id] = NULL;
+    index->live_count--;
+
+    // Once most entries are dead, walking their chains costs more than rebuilding
+    if (index->count >= LSH_INITIAL_CAPACITY && index->live_count < index->count / 2) {
+        lsh_compact(index);  // On failure the index stays valid, just not compacted
+    }
+
+    return LSH_SUCCESS;
+}
+
+size_t lsh_size(const LshIndex* index) {
+    return index ? index->live_count : 0;
+}
+
+void lsh_config(const LshIndex* index, uint16_t* bands, uint16_t* rows) {
+    *bands = index ? index->bands : 0;
+    *rows = index ? index->rows : 0;
+}
+
+// Set of entry ids already scored by a query
+typedef struct {
+    uint32_t* slots;    // Entry id + 1, 0 if empty
+    size_t capacity;
+    size_t used;
+} LshSeen;
+
+// Returns 1 if id was added, 0 if it was already present, -1 on allocation failure
+static int lsh_seen_add(LshSeen* seen, uint32_t id) {
+    if ((seen->used + 1) * 2 > seen->capacity) {
+        size_t capacity = seen->capacity * 2;
+        uint32_t* slots = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+        if (!slots) {
+            return -1;
+        }
+        for (size_t i = 0; i < seen->capacity; i++) {
+            if (seen->slots[i] != 0) {
+                size_t slot = (seen->slots[i] * 0x9E3779B1u) & (capacity - 1);
+                while (slots[slot] != 0) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                slots[slot] = seen->slots[i];
+            }
+        }
+        free(seen->slots);
+        seen->slots = slots;
+        seen->capacity = capacity;
+    }
+
+    uint32_t value = id + 1;
+    size_t slot = (value * 0x9E3779B1u) & (seen->capacity - 1);
+    while (seen->slots[slot] != 0) {
+        if (seen->slots[slot] == value) {
+            return 0;
+        }
+        slot = (slot + 1) & (seen->capacity - 1);
+    }
+    seen->slots[slot] = value;
+    seen->used++;
+    return 1;
+}
+
+LshError lsh_query(const LshIndex* index, const RagfileHeader* query, float threshold,
+                   MinHeap* heap, size_t* num_candidates) {
+    if (!index || !query || !heap) {
+        return LSH_ERROR_INVALID_ARGUMENT;
+    }
+    if (num_candidates) {
+        *num_candidates = 0;
+    }
+    if (!lsh_compatible(index, query)) {
+        return LSH_SUCCESS;
+    }
+
+    const uint32_t* signature = query->minhash_signature;
+
+    LshSeen seen = {(uint32_t*)calloc(LSH_INITIAL_CAPACITY, sizeof(uint32_t)), LSH_INITIAL_CAPACITY, 0};
+    if (!seen.slots) {
+        return LSH_ERROR_MEMORY;
+    }
+
+    LshError result = LSH_SUCCESS;
+    size_t candidates = 0;
+    for (size_t band = 0; band < index->num_bands && result == LSH_SUCCESS; band++) {
+        const LshBand* table = &index->band_tables[band];
+        if (table->capacity == 0) {
+            continue;
+        }
+
+        uint64_t key = lsh_band_key(signature, lsh_band_start(index, band), index->rows);
+        size_t slot = lsh_band_find(table, key);
+        for (uint32_t next = table->heads[slot]; next != 0; next = table->next[next - 1]) {
+            uint32_t id = next - 1;
+            if (!index->live[id]) {
+                continue;
+            }
+
+            int added = lsh_seen_add(&seen, id);
+            if (added < 0) {
+                result = LSH_ERROR_MEMORY;
+                break;
+            }
+            if (added == 0) {
+                continue;
+            }
+
+            candidates++;
+            double score = jaccard_similarity(signature, index->signatures + (size_t)id * MINHASH_SIZE);
+            if (score < threshold) {
+                continue;
+            }
+            if (heap_offer(heap, index->paths[id], score) < 0) {
+                result = LSH_ERROR_MEMORY;
+                break;
+            }
+        }
+    }
+
+    free(seen.slots);
+    if (num_candidates) {
+        *num_candidates = candidates;
+    }
+    return result;
+}
+
+LshError lsh_save(const LshIndex* index, const char* path) {
+    if (!index || !path) {
+        return LSH_ERROR_INVALID_ARGUMENT;
+    }
+
+    size_t tmp_length = strlen(path) + sizeof(".tmp");
+    char* tmp_path = (char*)malloc(tmp_length);
+    if (!tmp_path) {
+        return LSH_ERROR_MEMORY;
+    }
+    snprintf(tmp_path, tmp_length, "%s.tmp", path);
+
+    FILE* file = fopen(tmp_path, "wb");
+    if (!file) {
+        free(tmp_path);
+        return LSH_ERROR_IO;
+    }
+
+    LshFileHeader header = {0};
+    header.magic = LSH_MAGIC;
+    header.version = LSH_VERSION;
+    header.bands = index->bands;
+    header.rows = index->rows;
+    header.minhash_size = MINHASH_SIZE;
+    header.flags = index->flags;
+    header.tokenizer_id_hash = index->tokenizer_id_hash;
+    header.embedding_id_hash = index->embedding_id_hash;
+    header.count = index->live_count;
+
+    bool ok = fwrite(&header, sizeof(LshFileHeader), 1, file) == 1;
+    for (size_t id = 0; ok && id < index->count; id++) {
+        if (!index->live[id]) {
+            continue;
+        }
+        uint32_t length = (uint32_t)strlen(index->paths[id]);
+        ok = fwrite(&length, sizeof(uint32_t), 1, file) == 1 &&
+             fwrite(index->paths[id], 1, length, file) == length &&
+             fwrite(index->signatures + id * MINHASH_SIZE, sizeof(uint32_t), MINHASH_SIZE, file) == MINHASH_SIZE;
+    }
+
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (ok && rename(tmp_path, path) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        remove(tmp_path);
+    }
+    free(tmp_path);
+    return ok ? LSH_SUCCESS : LSH_ERROR_IO;
+}
+
+LshError lsh_load(LshIndex** index, const char* path) {
+    if (!index || !path) {
+        return LSH_ERROR_INVALID_ARGUMENT;
+    }
+    *index = NULL;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return LSH_ERROR_IO;
+    }
+
+    LshFileHeader header;
+    if (fread(&header, sizeof(LshFileHeader), 1, file) != 1 ||
+        header.magic != LSH_MAGIC || header.version != LSH_VERSION || header.minhash_size != MINHASH_SIZE ||
+        (header.flags & ~RAGFILE_FLAGS_MINHASH) != 0) {
+        fclose(file);
+        return LSH_ERROR_FORMAT;
+    }
+
+    LshError error = lsh_create(index, header.bands, header.rows);
+    if (error != LSH_SUCCESS) {
+        fclose(file);
+        return error == LSH_ERROR_INVALID_ARGUMENT ? LSH_ERROR_FORMAT : error;
+    }
+    (*index)->flags = header.flags;
+    (*index)->tokenizer_id_hash = header.tokenizer_id_hash;
+    (*index)->embedding_id_hash = header.embedding_id_hash;
+
+    char* entry_path = (char*)malloc(LSH_MAX_PATH_LENGTH + 1);
+    uint32_t* signature = (uint32_t*)malloc(MINHASH_SIZE * sizeof(uint32_t));
+    if (!entry_path || !signature) {
+        error = LSH_ERROR_MEMORY;
+    }
+
+    for (uint64_t i = 0; i < header.count && error == LSH_SUCCESS; i++) {
+        uint32_t length;
+        if (fread(&length, sizeof(uint32_t), 1, file) != 1 || length > LSH_MAX_PATH_LENGTH ||
+            fread(entry_path, 1, length, file) != length ||
+            fread(signature, sizeof(uint32_t), MINHASH_SIZE, file) != MINHASH_SIZE) {
+            error = LSH_ERROR_FORMAT;
+            break;
+        }
+        entry_path[length] = '\0';
+        error = lsh_insert_signature(*index, entry_path, signature);
+    }
+
+    free(entry_path);
+    free(signature);
+    fclose(file);
+    if (error != LSH_SUCCESS) {
+        lsh_free(*index);
+        *index = NULL;
+    }
+    return error;
+}
@@ -0,0 +1,152 @@
+#ifndef LSH_H
+#define LSH_H
+
+#include "../include/config.h"
+#include "../core/ragfile.h"
+#include "../search/heap.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define LSH_MAGIC 0x48534C52    // "RLSH" in ASCII
+#define LSH_VERSION 3
+#define LSH_HALF_SIZE (MINHASH_SIZE / 2)  // Slots per signature half (bigrams, then trigrams)
+
+#define LSH_DEFAULT_BANDS 20
+#define LSH_DEFAULT_ROWS 6
+
+typedef enum {
+    LSH_SUCCESS = 0,
+    LSH_ERROR_IO,
+    LSH_ERROR_FORMAT,
+    LSH_ERROR_MEMORY,
+    LSH_ERROR_INVALID_ARGUMENT,
+    LSH_ERROR_NOT_FOUND,
+    LSH_ERROR_INCOMPATIBLE
+} LshError;
+
+/**
+ * On-disk header of an LSH index, followed by count entries of
+ * {uint32_t path_length, char path[path_length], uint32_t signature[MINHASH_SIZE]}.
+ * Band tables are rebuilt from the stored signatures when the index is loaded.
+ */
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bands;         // Bands per signature half
+    uint16_t rows;          // Signature slots per band
+    uint16_t minhash_size;  // MINHASH_SIZE of the indexed signatures
+    uint16_t flags;         // RAGFILE_FLAGS_MINHASH bits shared by the indexed signatures
+    uint16_t tokenizer_id_hash;  // Tokenizer and embedding model shared by the indexed files
+    uint16_t embedding_id_hash;
+    uint16_t reserved;
+    uint64_t count;         // Number of entries that follow
+} LshFileHeader;
+#pragma pack(pop)
+
+/**
+ * Banded LSH index over MinHash signatures. Each half of the signature is cut
+ * into `bands` bands of `rows` slots, and two signatures become candidates
+ * when any band matches exactly. Candidates are then scored on their stored
+ * signature, so results carry the same Jaccard estimate as a full scan.
+ * All entries share the tokenizer, embedding model and MinHash scheme of the
+ * first one inserted.
+ *
+ * Queries do not modify the index and may run concurrently; insert and
+ * delete require exclusive access.
+ */
+typedef struct LshIndex LshIndex;
+
+/**
+ * Create an empty LSH index.
+ *
+ * @param index Pointer to an LshIndex pointer where the new object will be stored.
+ * @param bands Number of bands per signature half.
+ * @param rows Number of signature slots per band (bands * rows <= LSH_HALF_SIZE).
+ * @return LSH_SUCCESS on success, or an error code on failure.
+ */
+LshError lsh_create(LshIndex** index, uint16_t bands, uint16_t rows);
+
+/**
+ * Load an LSH index saved with lsh_save.
+ *
+ * @param index Pointer to an LshIndex pointer where the new object will be stored.
+ * @param path Path of the index file.
+ * @return LSH_SUCCESS on success, or an error code on failure.
+ */
+LshError lsh_load(LshIndex** index, const char* path);
+
+/**
+ * Save the live entries of an LSH index. The file is written next to its
+ * destination and renamed into place, so readers never see a partial index.
+ *
+ * @param index Pointer to the LshIndex.
+ * @param path Path of the index file.
+ * @return LSH_SUCCESS on success, or an error code on failure.
+ */
+LshError lsh_save(const LshIndex* index, const char* path);
+
+/**
+ * Free an LSH index.
+ *
+ * @param index Pointer to the LshIndex (can be NULL).
+ */
+void lsh_free(LshIndex* index);
+
+/**
+ * Insert the signature of a header under a path, replacing any entry already
+ * stored for that path. An empty index takes the tokenizer, embedding model and
+ * MinHash scheme of the header.
+ *
+ * @param index Pointer to the LshIndex.
+ * @param path Path identifying the entry (copied).
+ * @param header Header whose MINHASH_SIZE signature slots are indexed (copied).
+ * @return LSH_SUCCESS on success, LSH_ERROR_INCOMPATIBLE if the header uses another
+ *         tokenizer, embedding model or MinHash scheme than the indexed entries, or
+ *         an error code on failure.
+ */
+LshError lsh_insert(LshIndex* index, const char* path, const RagfileHeader* header);
+
+/**
+ * Delete the entry stored for a path.
+ *
+ * @param index Pointer to the LshIndex.
+ * @param path Path identifying the entry.
+ * @return LSH_SUCCESS on success, LSH_ERROR_NOT_FOUND if the path is not indexed.
+ */
+LshError lsh_delete(LshIndex* index, const char* path);
+
+/**
+ * Number of live entries in the index.
+ *
+ * @param index Pointer to the LshIndex.
+ * @return Number of entries.
+ */
+size_t lsh_size(const LshIndex* index);
+
+/**
+ * Band configuration of the index.
+ *
+ * @param index Pointer to the LshIndex (both values are 0 if NULL).
+ * @param bands Set to the number of bands per signature half.
+ * @param rows Set to the number of slots per band.
+ */
+void lsh_config(const LshIndex* index, uint16_t* bands, uint16_t* rows);
+
+/**
+ * Find the entries sharing at least one band with a signature, score each
+ * candidate once on its stored signature and add those scoring at least
+ * threshold to the min heap. A query of another tokenizer, embedding model or
+ * MinHash scheme than the indexed entries has no candidates.
+ *
+ * @param index Pointer to the LshIndex.
+ * @param query Header holding the MINHASH_SIZE signature slots of the query.
+ * @param threshold Minimum Jaccard estimate of a result.
+ * @param heap MinHeap structure to store top k results.
+ * @param num_candidates Optional; set to the number of candidates that were scored.
+ * @return LSH_SUCCESS on success, or an error code on failure.
+ */
+LshError lsh_query(const LshIndex* index, const RagfileHeader* query, float threshold,
+                   MinHeap* heap, size_t* num_candidates);
+
+#endif // LSH_H
@@ -0,0 +1,331 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // madvise
+#endif
+#include "ragidx.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../utils/file_io.h"
+#include "../algorithms/jaccard.h"
+
+#define RAGIDX_SCORE_CHUNK 256  // Signatures scored per call to the batch Jaccard kernel
+
+static uint64_t ragidx_align(uint64_t offset) {
+    return (offset + RAGIDX_ALIGNMENT - 1) & ~(uint64_t)(RAGIDX_ALIGNMENT - 1);
+}
+
+// Bytes of the signature column per file
+static uint64_t ragidx_signature_size(unsigned signature_bits) {
+    return signature_bits ? BBIT_SIGNATURE_WORDS(signature_bits) * sizeof(uint64_t) : MINHASH_SIZE * sizeof(uint32_t);
+}
+
+// Compute the column layout for count files whose paths take paths_size bytes
+static void ragidx_layout(RagIndexHeader* header, uint64_t count, uint64_t paths_size, unsigned signature_bits) {
+    memset(header, 0, sizeof(RagIndexHeader));
+    header->magic = RAGIDX_MAGIC;
+    header->flags = signature_bits ? RAGIDX_FLAG_BBIT_SIGNATURES : 0;
+    header->signature_bits = (uint16_t)signature_bits;
+    header->version = RAGIDX_VERSION;
+    header->minhash_size = MINHASH_SIZE;
+    header->binary_embedding_bytes = BINARY_EMBEDDING_BYTE_DIM;
+    header->count = count;
+
+    uint64_t offset = ragidx_align(sizeof(RagIndexHeader));
+    header->path_offsets_offset = offset;
+    offset = ragidx_align(offset + (count + 1) * sizeof(uint64_t));
+    header->paths_offset = offset;
+    offset = ragidx_align(offset + paths_size);
+    header->header_flags_offset = offset;
+    offset = ragidx_align(offset + count * sizeof(uint16_t));
+    header->tokenizer_hash_offset = offset;
+    offset = ragidx_align(offset + count * sizeof(uint16_t));
+    header->embedding_hash_offset = offset;
+    offset = ragidx_align(offset + count * sizeof(uint16_t));
+    header->binary_embedding_offset = offset;
+    offset = ragidx_align(offset + count * BINARY_EMBEDDING_BYTE_DIM);
+    header->signature_offset = offset;
+    offset = ragidx_align(offset + count * ragidx_signature_size(signature_bits));
+    header->file_size = offset;
+}
+
+RagIndexError ragidx_build(const char* index_path, const char* const* file_paths, size_t count, size_t* failed_index) {
+    return ragidx_build_packed(index_path, file_paths, count, 0, failed_index);
+}
+
+RagIndexError ragidx_build_packed(const char* index_path, const char* const* file_paths, size_t count,
+                                  unsigned signature_bits, size_t* failed_index) {
+    if (!index_path || (!file_paths && count > 0) || (signature_bits && !bbit_bits_supported(signature_bits))) {
+        return RAGIDX_ERROR_INVALID_ARGUMENT;
+    }
+
+    uint64_t paths_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        paths_size += strlen(file_paths[i]) + 1;
+    }
+
+    RagIndexHeader layout;
+    ragidx_layout(&layout, count, paths_size, signature_bits);
+
+    int fd = open(index_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return RAGIDX_ERROR_IO;
+    }
+    if (ftruncate(fd, (off_t)layout.file_size) != 0) {
+        close(fd);
+        return RAGIDX_ERROR_IO;
+    }
+
+    uint8_t* map = (uint8_t*)mmap(NULL, layout.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return RAGIDX_ERROR_IO;
+    }
+
+    uint64_t* path_offsets = (uint64_t*)(map + layout.path_offsets_offset);
+    char* paths = (char*)(map + layout.paths_offset);
+    uint16_t* header_flags = (uint16_t*)(map + layout.header_flags_offset);
+    uint16_t* tokenizer_hashes = (uint16_t*)(map + layout.tokenizer_hash_offset);
+    uint16_t* embedding_hashes = (uint16_t*)(map + layout.embedding_hash_offset);
+    uint8_t* binary_embeddings = map + layout.binary_embedding_offset;
+    uint8_t* signatures = map + layout.signature_offset;
+    uint64_t signature_size = ragidx_signature_size(signature_bits);
+
+    RagIndexError result = RAGIDX_SUCCESS;
+    uint64_t path_offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        RagfileHeader header;
+        if (read_ragfile_header_at(file_paths[i], &header, true) != FILE_IO_SUCCESS) {
+            if (failed_index) {
+                *failed_index = i;
+            }
+            result = RAGIDX_ERROR_IO;
+            break;
+        }
+        if (header.magic != RAGFILE_MAGIC || header.version != RAGFILE_VERSION) {
+            if (failed_index) {
+                *failed_index = i;
+            }
+            result = RAGIDX_ERROR_FORMAT;
+            break;
+        }
+
+        size_t length = strlen(file_paths[i]) + 1;
+        path_offsets[i] = path_offset;
+        memcpy(paths + path_offset, file_paths[i], length);
+        path_offset += length;
+
+        header_flags[i] = header.flags;
+        tokenizer_hashes[i] = header.tokenizer_id_hash;
+        embedding_hashes[i] = header.embedding_id_hash;
+        memcpy(binary_embeddings + i * BINARY_EMBEDDING_BYTE_DIM, header.binary_embedding, BINARY_EMBEDDING_BYTE_DIM);
+        if (signature_bits) {
+            bbit_pack_signature(header.minhash_signature, signature_bits, (uint64_t*)(signatures + i * signature_size));
+        } else {
+            memcpy(signatures + i * signature_size, header.minhash_signature, signature_size);
+        }
+    }
+    path_offsets[count] = path_offset;
+
+    // Write the header last so that an interrupted build is never mistaken for a valid index
+    if (result == RAGIDX_SUCCESS) {
+        memcpy(map, &layout, sizeof(RagIndexHeader));
+        if (msync(map, layout.file_size, MS_SYNC) != 0) {
+            result = RAGIDX_ERROR_IO;
+        }
+    }
+
+    munmap(map, layout.file_size);
+    if (result != RAGIDX_SUCCESS) {
+        unlink(index_path);
+    }
+    return result;
+}
+
+RagIndexError ragidx_open(RagIndex** index, const char* index_path) {
+    if (!index || !index_path) {
+        return RAGIDX_ERROR_INVALID_ARGUMENT;
+    }
+    *index = NULL;
+
+    int fd = open(index_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return RAGIDX_ERROR_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return RAGIDX_ERROR_IO;
+    }
+    if ((size_t)st.st_size < sizeof(RagIndexHeader)) {
+        close(fd);
+        return RAGIDX_ERROR_FORMAT;
+    }
+
+    size_t map_size = (size_t)st.st_size;
+    uint8_t* map = (uint8_t*)mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return RAGIDX_ERROR_IO;
+    }
+
+    // Every offset must match the layout the builder would have produced for this count
+    const RagIndexHeader* header = (const RagIndexHeader*)map;
+    RagIndexHeader expected;
+    bool valid = header->magic == RAGIDX_MAGIC && header->version == RAGIDX_VERSION &&
+                 header->count <= map_size / sizeof(uint64_t) &&
+                 header->paths_offset <= header->header_flags_offset &&
+                 (header->signature_bits == 0 || bbit_bits_supported(header->signature_bits));
+    if (valid) {
+        ragidx_layout(&expected, header->count, header->header_flags_offset - header->paths_offset, header->signature_bits);
+        valid = memcmp(header, &expected, offsetof(RagIndexHeader, file_size)) == 0 &&
+                header->file_size == expected.file_size && header->file_size == map_size;
+    }
+    // Paths are read straight from the mapping, so each one must lie inside the path table and end in a NUL
+    if (valid) {
+        const uint64_t* path_offsets = (const uint64_t*)(map + header->path_offsets_offset);
+        const char* paths = (const char*)(map + header->paths_offset);
+        uint64_t paths_size = header->header_flags_offset - header->paths_offset;
+        valid = path_offsets[0] == 0;
+        for (uint64_t i = 0; valid && i < header->count; i++) {
+            valid = path_offsets[i] < path_offsets[i + 1] && path_offsets[i + 1] <= paths_size &&
+                    paths[path_offsets[i + 1] - 1] == '\0';
+        }
+    }
+    if (!valid) {
+        munmap(map, map_size);
+        return RAGIDX_ERROR_FORMAT;
+    }
+
+    *index = (RagIndex*)calloc(1, sizeof(RagIndex));
+    if (*index == NULL) {
+        munmap(map, map_size);
+        return RAGIDX_ERROR_MEMORY;
+    }
+
+    madvise(map, map_size, MADV_SEQUENTIAL);
+
+    (*index)->map = map;
+    (*index)->map_size = map_size;
+    (*index)->header = header;
+    (*index)->count = header->count;
+    (*index)->path_offsets = (const uint64_t*)(map + header->path_offsets_offset);
+    (*index)->paths = (const char*)(map + header->paths_offset);
+    (*index)->header_flags = (const uint16_t*)(map + header->header_flags_offset);
+    (*index)->tokenizer_hashes = (const uint16_t*)(map + header->tokenizer_hash_offset);
+    (*index)->embedding_hashes = (const uint16_t*)(map + header->embedding_hash_offset);
+    (*index)->binary_embeddings = map + header->binary_embedding_offset;
+    (*index)->signature_bits = header->signature_bits;
+    if (header->signature_bits) {
+        (*index)->packed_signatures = (const uint64_t*)(map + header->signature_offset);
+    } else {
+        (*index)->signatures = (const uint32_t*)(map + header->signature_offset);
+    }
+
+    return RAGIDX_SUCCESS;
+}
+
+void ragidx_close(RagIndex* index) {
+    if (index) {
+        munmap(index->map, index->map_size);
+        free(index);
+    }
+}
+
+const char* ragidx_path(const RagIndex* index, uint64_t i) {
+    return index->paths + index->path_offsets[i];
+}
+
+const uint32_t* ragidx_signature(const RagIndex* index, uint64_t i) {
+    return index->signatures ? index->signatures + i * MINHASH_SIZE : NULL;
+}
+
+const uint64_t* ragidx_packed_signature(const RagIndex* index, uint64_t i) {
+    return index->packed_signatures ? index->packed_signatures + i * BBIT_SIGNATURE_WORDS(index->signature_bits) : NULL;
+}
+
+RagIndexError ragidx_match_range(const RagIndex* index, const RagFile* referenceRagFile,
+                                 uint64_t start, uint64_t end, MinHeap* heap) {
+    if (!index || !referenceRagFile || !heap) {
+        return RAGIDX_ERROR_INVALID_ARGUMENT;
+    }
+    if (end > index->count) {
+        end = index->count;
+    }
+
+    const uint32_t* reference = referenceRagFile->header.minhash_signature;
+    uint16_t reference_flags = referenceRagFile->header.flags;
+    uint16_t reference_tokenizer = referenceRagFile->header.tokenizer_id_hash;
+    uint16_t reference_embedding = referenceRagFile->header.embedding_id_hash;
+    uint64_t packed_reference[BBIT_SIGNATURE_WORDS(BBIT_MAX_BITS)];
+    if (index->signature_bits) {
+        bbit_pack_signature(reference, index->signature_bits, packed_reference);
+    }
+    // Full signatures are contiguous, so they are scored a chunk at a time by the batch kernel
+    float scores[RAGIDX_SCORE_CHUNK];
+    for (uint64_t chunk = start; chunk < end; chunk += RAGIDX_SCORE_CHUNK) {
+        size_t chunk_size = end - chunk < RAGIDX_SCORE_CHUNK ? (size_t)(end - chunk) : RAGIDX_SCORE_CHUNK;
+        if (!index->signature_bits) {
+            jaccard_similarity_many(reference, ragidx_signature(index, chunk), chunk_size, scores);
+        }
+        for (size_t j = 0; j < chunk_size; j++) {
+            uint64_t i = chunk + j;
+            if (index->tokenizer_hashes[i] != reference_tokenizer || index->embedding_hashes[i] != reference_embedding ||
+                !ragfile_minhash_compatible(index->header_flags[i], reference_flags)) {
+                continue;
+            }
+            double score = index->signature_bits
+                ? bbit_jaccard_similarity(packed_reference, ragidx_packed_signature(index, i), index->signature_bits)
+                : scores[j];
+            if (heap_offer(heap, ragidx_path(index, i), score) < 0) {
+                return RAGIDX_ERROR_MEMORY;
+            }
+        }
+    }
+
+    return RAGIDX_SUCCESS;
+}
+
+typedef struct {
+    const RagIndex* index;
+    const RagFile* referenceRagFile;
+    MinHeap** heaps;
+    size_t num_workers;
+    atomic_int status;  // First error reported by a worker
+} RagIndexMatchJob;
+
+static void ragidx_match_worker(void* ctx, size_t worker) {
+    RagIndexMatchJob* job = (RagIndexMatchJob*)ctx;
+    uint64_t count = job->index->count;
+    uint64_t start = count * worker / job->num_workers;
+    uint64_t end = count * (worker + 1) / job->num_workers;
+    RagIndexError error = ragidx_match_range(job->index, job->referenceRagFile, start, end, job->heaps[worker]);
+    if (error != RAGIDX_SUCCESS) {
+        int expected = RAGIDX_SUCCESS;
+        atomic_compare_exchange_strong(&job->status, &expected, (int)error);
+    }
+}
+
+RagIndexError ragidx_match(ThreadPool* pool, size_t num_workers, const RagIndex* index,
+                           const RagFile* referenceRagFile, MinHeap** heaps) {
+    if (!index || !referenceRagFile || !heaps || num_workers == 0) {
+        return RAGIDX_ERROR_INVALID_ARGUMENT;
+    }
+
+    if (pool == NULL || num_workers == 1) {
+        return ragidx_match_range(index, referenceRagFile, 0, index->count, heaps[0]);
+    }
+
+    if (num_workers > thread_pool_size(pool)) {
+        num_workers = thread_pool_size(pool);
+    }
+    RagIndexMatchJob job = {.index = index, .referenceRagFile = referenceRagFile, .heaps = heaps, .num_workers = num_workers};
+    atomic_init(&job.status, RAGIDX_SUCCESS);
+    thread_pool_run(pool, ragidx_match_worker, &job, num_workers);
+    return (RagIndexError)atomic_load(&job.status);
+}
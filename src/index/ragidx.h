@@ -0,0 +1,172 @@
+#ifndef RAGIDX_H
+#define RAGIDX_H
+
+#include "../include/config.h"
+#include "../core/ragfile.h"
+#include "../search/heap.h"
+#include "../utils/thread_pool.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#define RAGIDX_MAGIC 0x58444952 // "RIDX" in ASCII
+#define RAGIDX_VERSION 1
+#define RAGIDX_ALIGNMENT 64     // Every column starts on a cache line
+
+#define RAGIDX_FLAG_BBIT_SIGNATURES 0x0001  // The signature column holds b-bit packed signatures
+
+typedef enum {
+    RAGIDX_SUCCESS = 0,
+    RAGIDX_ERROR_IO,
+    RAGIDX_ERROR_FORMAT,
+    RAGIDX_ERROR_MEMORY,
+    RAGIDX_ERROR_INVALID_ARGUMENT
+} RagIndexError;
+
+/**
+ * On-disk header of a .ragidx sidecar. All offsets are in bytes from the start
+ * of the file and are multiples of RAGIDX_ALIGNMENT. The columns hold one
+ * entry per indexed file, in the order the files were given to the builder.
+ */
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint16_t minhash_size;              // MINHASH_SIZE of the indexed files
+    uint16_t binary_embedding_bytes;    // BINARY_EMBEDDING_BYTE_DIM of the indexed files
+    uint16_t signature_bits;            // Bits kept per signature slot, 0 for full 32-bit signatures
+    uint16_t reserved;
+    uint64_t count;                     // Number of indexed files
+    uint64_t path_offsets_offset;       // uint64_t[count + 1], offsets into the path table
+    uint64_t paths_offset;              // NUL terminated paths, back to back
+    uint64_t header_flags_offset;       // uint16_t[count], RagfileHeader.flags
+    uint64_t tokenizer_hash_offset;     // uint16_t[count]
+    uint64_t embedding_hash_offset;     // uint16_t[count]
+    uint64_t binary_embedding_offset;   // uint8_t[count][binary_embedding_bytes]
+    uint64_t signature_offset;          // uint32_t[count][minhash_size], or uint64_t[count][BBIT_SIGNATURE_WORDS(signature_bits)]
+    uint64_t file_size;
+} RagIndexHeader;
+#pragma pack(pop)
+
+/**
+ * Read-only view of a memory mapped .ragidx sidecar.
+ */
+typedef struct {
+    void* map;
+    size_t map_size;
+    const RagIndexHeader* header;
+    uint64_t count;
+    const uint64_t* path_offsets;
+    const char* paths;
+    const uint16_t* header_flags;
+    const uint16_t* tokenizer_hashes;
+    const uint16_t* embedding_hashes;
+    const uint8_t* binary_embeddings;
+    const uint32_t* signatures;         // NULL when the signatures are packed
+    unsigned signature_bits;
+    const uint64_t* packed_signatures;  // NULL unless signature_bits is non-zero
+} RagIndex;
+
+/**
+ * Build a .ragidx sidecar from the headers of a set of .rag files.
+ *
+ * @param index_path Path of the sidecar to write (overwritten if it exists).
+ * @param file_paths Array of paths to .rag files.
+ * @param count Number of paths in the array.
+ * @param failed_index Optional; set to the index of the file that could not be read or parsed.
+ * @return RAGIDX_SUCCESS on success, or an error code on failure.
+ */
+RagIndexError ragidx_build(const char* index_path, const char* const* file_paths, size_t count, size_t* failed_index);
+
+/**
+ * Build a .ragidx sidecar whose signature column keeps only the lowest
+ * signature_bits of every slot. A 1-bit column is 32 bytes per file instead of
+ * 1 KiB, so far more of the index stays cache resident while scanning, at the
+ * cost of a noisier similarity estimate (see bbit_jaccard_similarity).
+ *
+ * @param index_path Path of the sidecar to write (overwritten if it exists).
+ * @param file_paths Array of paths to .rag files.
+ * @param count Number of paths in the array.
+ * @param signature_bits Bits kept per slot (1, 2, 4, 8 or 16), or 0 for full signatures.
+ * @param failed_index Optional; set to the index of the file that could not be read or parsed.
+ * @return RAGIDX_SUCCESS on success, or an error code on failure.
+ */
+RagIndexError ragidx_build_packed(const char* index_path, const char* const* file_paths, size_t count,
+                                  unsigned signature_bits, size_t* failed_index);
+
+/**
+ * Memory map a .ragidx sidecar for scanning.
+ *
+ * @param index Pointer to a RagIndex pointer where the new object will be stored.
+ * @param index_path Path to the sidecar.
+ * @return RAGIDX_SUCCESS on success, or an error code on failure.
+ */
+RagIndexError ragidx_open(RagIndex** index, const char* index_path);
+
+/**
+ * Unmap a sidecar and free the RagIndex.
+ *
+ * @param index Pointer to the RagIndex (can be NULL).
+ */
+void ragidx_close(RagIndex* index);
+
+/**
+ * Get the path of an indexed file.
+ *
+ * @param index Pointer to the RagIndex.
+ * @param i Index of the file.
+ * @return The NUL terminated path, owned by the mapping.
+ */
+const char* ragidx_path(const RagIndex* index, uint64_t i);
+
+/**
+ * Get the MinHash signature of an indexed file.
+ *
+ * @param index Pointer to the RagIndex.
+ * @param i Index of the file.
+ * @return Pointer to MINHASH_SIZE signature slots, owned by the mapping, or NULL if the index is packed.
+ */
+const uint32_t* ragidx_signature(const RagIndex* index, uint64_t i);
+
+/**
+ * Get the b-bit packed signature of an indexed file.
+ *
+ * @param index Pointer to the RagIndex.
+ * @param i Index of the file.
+ * @return Pointer to BBIT_SIGNATURE_WORDS(index->signature_bits) words, owned by the mapping, or NULL if the index is not packed.
+ */
+const uint64_t* ragidx_packed_signature(const RagIndex* index, uint64_t i);
+
+/**
+ * Score the indexed files in [start, end) against a reference RagFile and add
+ * them to the min heap, without opening any of the .rag files. Files whose
+ * tokenizer or embedding id hash differs from the reference, or whose signature
+ * uses another MinHash scheme, are skipped. On a
+ * packed index the reference is packed once and scored with
+ * bbit_jaccard_similarity.
+ *
+ * @param index Pointer to the RagIndex.
+ * @param referenceRagFile Pointer to a RagFile containing the reference minhash signature.
+ * @param start First file to score.
+ * @param end One past the last file to score (clamped to the index size).
+ * @param heap MinHeap structure to store top k results.
+ * @return RAGIDX_SUCCESS on success, or an error code on failure.
+ */
+RagIndexError ragidx_match_range(const RagIndex* index, const RagFile* referenceRagFile,
+                                 uint64_t start, uint64_t end, MinHeap* heap);
+
+/**
+ * Score every indexed file against a reference RagFile. The index is split
+ * into contiguous ranges, one per worker, and each worker fills its own heap.
+ *
+ * @param pool Worker pool, or NULL to scan on the calling thread.
+ * @param num_workers Number of workers (and heaps) to use.
+ * @param index Pointer to the RagIndex.
+ * @param referenceRagFile Pointer to a RagFile containing the reference minhash signature.
+ * @param heaps Array of num_workers MinHeaps, merged by the caller.
+ * @return RAGIDX_SUCCESS on success, or an error code on failure.
+ */
+RagIndexError ragidx_match(ThreadPool* pool, size_t num_workers, const RagIndex* index,
+                           const RagFile* referenceRagFile, MinHeap** heaps);
+
+#endif // RAGIDX_H
@@ -2,6 +2,8 @@
 #include <Python.h>
 #include "../include/config.h"
 #include "../core/ragfile.h"
+#include "../index/ragidx.h"
+#include "../algorithms/jaccard.h"
 #include "pyragfile.h"
 #include "pyragfileheader.h"
 
@@ -11,14 +13,20 @@ static PyTypeObject *imported_PyRagFileHeaderType = NULL;
 // Forward declaration of methods
 static PyObject* py_ragfile_load(PyObject* self, PyObject* args);
 static PyObject* py_ragfile_dump(PyObject* self, PyObject* args);
-static PyObject* py_ragfile_loads(PyObject* self, PyObject* args);
+static PyObject* py_ragfile_loads(PyObject* self, PyObject* args, PyObject* kwds);
 static PyObject* py_ragfile_dumps(PyObject* self, PyObject* args);
+static PyObject* py_ragfile_dumps_into(PyObject* self, PyObject* args, PyObject* kwds);
+static PyObject* py_ragfile_serialized_size(PyObject* self, PyObject* args);
+static PyObject* py_ragfile_build_index(PyObject* self, PyObject* args, PyObject* kwds);
 
 static PyMethodDef ragfile_methods[] = {
     {"load", py_ragfile_load, METH_VARARGS, "Load a RagFile from a file"},
     {"dump", py_ragfile_dump, METH_VARARGS, "Save a RagFile to a file"},
-    {"loads", py_ragfile_loads, METH_VARARGS, "Load a RagFile from a string"},
+    {"loads", (PyCFunction)py_ragfile_loads, METH_VARARGS | METH_KEYWORDS, "Load a RagFile from a string, optionally borrowing its buffer"},
     {"dumps", py_ragfile_dumps, METH_VARARGS, "Save a RagFile to a string"},
+    {"dumps_into", (PyCFunction)py_ragfile_dumps_into, METH_VARARGS | METH_KEYWORDS, "Save a RagFile into a writable buffer"},
+    {"serialized_size", py_ragfile_serialized_size, METH_VARARGS, "Number of bytes a RagFile is saved as"},
+    {"build_index", (PyCFunction)py_ragfile_build_index, METH_VARARGS | METH_KEYWORDS, "Build a .ragidx sidecar from the headers of RagFiles, optionally with b-bit packed signatures"},
     {NULL, NULL, 0, NULL}
 };
 
@@ -162,10 +170,15 @@ static PyObject* py_ragfile_dump(PyObject* self, PyObject* args) {
     }
 
     if (!py_rf->rf) {
+        fclose(file);
         PyErr_SetString(PyExc_RuntimeError, "Invalid RagFile");
         return NULL;
     }
-    RagfileError error = ragfile_save(py_rf->rf, file);
+    // A lazy RagFile is read in full before it is written
+    RagfileError error = ragfile_load_section(py_rf->rf, RAGFILE_SECTION_ALL);
+    if (error == RAGFILE_SUCCESS) {
+        error = ragfile_save(py_rf->rf, file);
+    }
     fclose(file);
 
     if (error != RAGFILE_SUCCESS) {
@@ -176,100 +189,215 @@ static PyObject* py_ragfile_dump(PyObject* self, PyObject* args) {
     Py_RETURN_NONE;
 }
 
-// Load RagFile from string
-static PyObject* py_ragfile_loads(PyObject* self, PyObject* args) {
-    const char* data;
-    Py_ssize_t length;
-    printf("aaa\n");
+// Load RagFile from string, parsing the sections straight out of the buffer
+static PyObject* py_ragfile_loads(PyObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* data_obj;
+    int borrow = 0;
+    static char* kwlist[] = {"data", "borrow", NULL};
 
-    if (!PyArg_ParseTuple(args, "s#", &data, &length)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|p", kwlist, &data_obj, &borrow)) {
         return NULL;
     }
 
-    printf("baa\n");
-    if (length == 0) {
-        PyErr_SetString(PyExc_ValueError, "Empty data cannot be loaded as a RagFile");
-        return NULL;
-    }
-
-    printf("caa\n");
-    FILE* file = fmemopen((void*)data, length, "rb");
-    if (!file) {
-        PyErr_SetString(PyExc_IOError, "Failed to open memory buffer as file");
+    // A borrowing RagFile keeps a memoryview, which also stops a bytearray from being resized under it
+    PyObject* base = NULL;
+    Py_buffer buffer;
+    if (borrow) {
+        if (PyUnicode_Check(data_obj)) {
+            PyErr_SetString(PyExc_TypeError, "borrow requires a bytes-like object");
+            return NULL;
+        }
+        base = PyMemoryView_FromObject(data_obj);
+        if (!base) {
+            return NULL;
+        }
+        if (!PyBuffer_IsContiguous(PyMemoryView_GET_BUFFER(base), 'C')) {
+            Py_DECREF(base);
+            PyErr_SetString(PyExc_TypeError, "borrow requires a contiguous buffer");
+            return NULL;
+        }
+        buffer = *PyMemoryView_GET_BUFFER(base);
+    } else if (!PyArg_Parse(data_obj, "s*", &buffer)) {
         return NULL;
     }
 
-    printf("daa\n");
     RagFile* rf = NULL;
-    RagfileError error = ragfile_load(&rf, file);
-    fclose(file);
+    RagfileError error = RAGFILE_ERROR_FORMAT;
+    if (buffer.len > 0) {
+        error = ragfile_load_from_buffer(&rf, (const uint8_t*)buffer.buf, (size_t)buffer.len, borrow);
+    }
+    if (!borrow) {
+        PyBuffer_Release(&buffer);
+    }
 
-    printf("eaa\n");
-    if (error != RAGFILE_SUCCESS || !rf) {
-        if (rf) {
-            ragfile_free(rf);
+    if (error != RAGFILE_SUCCESS) {
+        Py_XDECREF(base);
+        if (buffer.len == 0) {
+            PyErr_SetString(PyExc_ValueError, "Empty data cannot be loaded as a RagFile");
+        } else if (error == RAGFILE_ERROR_MEMORY) {
+            PyErr_NoMemory();
+        } else {
+            PyErr_Format(PyExc_IOError, "Failed to load RagFile from string, error code: %d", error);
         }
-        PyErr_Format(PyExc_IOError, "Failed to load RagFile from string, error code: %d", error);
         return NULL;
     }
 
-    printf("Before PyRagFile_New\n");
-    printf("imported_PyRagFileType: %p\n", (void*)imported_PyRagFileType);
-    printf("imported_PyRagFileHeaderType: %p\n", (void*)imported_PyRagFileHeaderType);
-    printf("rf: %p\n", (void*)rf);
-
+    // PyRagFile_New takes ownership of rf, even when it fails
     PyObject* result = PyRagFile_New(imported_PyRagFileType, rf, imported_PyRagFileHeaderType);
-    printf("After PyRagFile_New\n");
-
     if (!result) {
-        ragfile_free(rf); // Clean up if Python object creation fails
+        Py_XDECREF(base);
+        return NULL;
     }
-
-    printf("gaa\n");
+    ((PyRagFile*)result)->base = base;
     return result;
 }
 
 
-// Dump RagFile to string
+// Check a dumps argument and make sure a lazy RagFile is read in full
+static RagFile* dumpable_ragfile(PyRagFile* py_rf) {
+    if (!py_rf->rf) {
+        PyErr_SetString(PyExc_RuntimeError, "Invalid RagFile object");
+        return NULL;
+    }
+    if (ragfile_load_section(py_rf->rf, RAGFILE_SECTION_ALL) != RAGFILE_SUCCESS) {
+        PyErr_SetString(PyExc_IOError, "Failed to read RagFile");
+        return NULL;
+    }
+    return py_rf->rf;
+}
+
+// Dump RagFile to string, serializing straight into a bytes object of the exact size
 static PyObject* py_ragfile_dumps(PyObject* self, PyObject* args) {
     PyRagFile* py_rf;
-    printf("000\n");
     if (!PyArg_ParseTuple(args, "O!", imported_PyRagFileType, &py_rf)) {
         return NULL;
     }
-    printf("111\n");
+    RagFile* rf = dumpable_ragfile(py_rf);
+    if (!rf) {
+        return NULL;
+    }
 
-    if (!py_rf->rf) {
-        PyErr_SetString(PyExc_RuntimeError, "Invalid RagFile object");
+    PyObject* result = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)ragfile_serialized_size(rf));
+    if (!result) {
         return NULL;
     }
-    printf("211\n");
+    RagfileError error = ragfile_save_to_buffer(rf, (uint8_t*)PyBytes_AS_STRING(result), (size_t)PyBytes_GET_SIZE(result), NULL);
+    if (error != RAGFILE_SUCCESS) {
+        Py_DECREF(result);
+        PyErr_Format(PyExc_IOError, "Failed to save RagFile to string, error code: %d", error);
+        return NULL;
+    }
+    return result;
+}
 
-    char* buffer = NULL;
-    size_t size = 0;
-    FILE* file = open_memstream(&buffer, &size);
-    if (!file) {
-        PyErr_SetString(PyExc_IOError, "Failed to create memory buffer");
+// Dump RagFile into a caller owned writable buffer, returning the number of bytes written
+static PyObject* py_ragfile_dumps_into(PyObject* self, PyObject* args, PyObject* kwds) {
+    PyRagFile* py_rf;
+    PyObject* buffer_obj;
+    Py_ssize_t offset = 0;
+    static char* kwlist[] = {"rf", "buffer", "offset", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O!O|n", kwlist, imported_PyRagFileType, &py_rf, &buffer_obj, &offset)) {
+        return NULL;
+    }
+    RagFile* rf = dumpable_ragfile(py_rf);
+    if (!rf) {
         return NULL;
     }
-    printf("311\n");
 
-    RagfileError error = ragfile_save(py_rf->rf, file);
-    fclose(file);
-    printf("411\n");
+    Py_buffer buffer;
+    if (PyObject_GetBuffer(buffer_obj, &buffer, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    if (offset < 0 || offset > buffer.len) {
+        PyBuffer_Release(&buffer);
+        PyErr_SetString(PyExc_ValueError, "offset is outside the buffer");
+        return NULL;
+    }
 
+    size_t written = 0;
+    RagfileError error = ragfile_save_to_buffer(rf, (uint8_t*)buffer.buf + offset, (size_t)(buffer.len - offset), &written);
+    PyBuffer_Release(&buffer);
     if (error != RAGFILE_SUCCESS) {
-        if (buffer) free(buffer);
-        PyErr_Format(PyExc_IOError, "Failed to save RagFile to string, error code: %d", error);
+        if (written > (size_t)(buffer.len - offset)) {
+            PyErr_Format(PyExc_ValueError, "Buffer too small: %zu bytes needed, %zd available", written, buffer.len - offset);
+        } else {
+            PyErr_Format(PyExc_IOError, "Failed to save RagFile to buffer, error code: %d", error);
+        }
         return NULL;
     }
-    printf("511\n");
+    return PyLong_FromSize_t(written);
+}
 
-    PyObject* result = PyBytes_FromStringAndSize(buffer, size);
-    free(buffer);
-    if (!result) {
-        return PyErr_NoMemory();
+// Number of bytes dumps and dumps_into produce for a RagFile
+static PyObject* py_ragfile_serialized_size(PyObject* self, PyObject* args) {
+    PyRagFile* py_rf;
+    if (!PyArg_ParseTuple(args, "O!", imported_PyRagFileType, &py_rf)) {
+        return NULL;
     }
-    return result;
+    if (!py_rf->rf) {
+        PyErr_SetString(PyExc_RuntimeError, "Invalid RagFile object");
+        return NULL;
+    }
+    return PyLong_FromSize_t(ragfile_serialized_size(py_rf->rf));
 }
 
+// Build a .ragidx sidecar from an iterable of RagFile paths
+static PyObject* py_ragfile_build_index(PyObject* self, PyObject* args, PyObject* kwds) {
+    PyObject* file_iterable;
+    const char* index_path;
+    unsigned int signature_bits = 0;
+    static char* kwlist[] = {"files", "index_path", "signature_bits", NULL};
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Os|I", kwlist, &file_iterable, &index_path, &signature_bits)) {
+        return NULL;
+    }
+    if (signature_bits != 0 && !bbit_bits_supported(signature_bits)) {
+        PyErr_SetString(PyExc_ValueError, "signature_bits must be 0, 1, 2, 4, 8 or 16");
+        return NULL;
+    }
+
+    PyObject* file_list = PySequence_List(file_iterable);
+    if (!file_list) {
+        return NULL;
+    }
+
+    Py_ssize_t count = PyList_GET_SIZE(file_list);
+    const char** paths = (const char**)malloc((count > 0 ? count : 1) * sizeof(const char*));
+    if (!paths) {
+        Py_DECREF(file_list);
+        return PyErr_NoMemory();
+    }
+
+    for (Py_ssize_t i = 0; i < count; i++) {
+        paths[i] = PyUnicode_AsUTF8(PyList_GET_ITEM(file_list, i));
+        if (paths[i] == NULL) {
+            free(paths);
+            Py_DECREF(file_list);
+            PyErr_Format(PyExc_ValueError, "Invalid file path encountered");
+            return NULL;
+        }
+    }
+
+    size_t failed_index = (size_t)count;  // Left untouched unless a RagFile fails
+    RagIndexError error;
+    Py_BEGIN_ALLOW_THREADS
+    error = ragidx_build_packed(index_path, paths, (size_t)count, signature_bits, &failed_index);
+    Py_END_ALLOW_THREADS
+
+    if (error == RAGIDX_ERROR_IO || error == RAGIDX_ERROR_FORMAT) {
+        if (failed_index < (size_t)count) {
+            PyErr_Format(PyExc_IOError, "Failed to index '%s', error code: %d", paths[failed_index], error);
+        } else {
+            PyErr_Format(PyExc_IOError, "Failed to write index '%s', error code: %d", index_path, error);
+        }
+    } else if (error != RAGIDX_SUCCESS) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to build index, error code: %d", error);
+    }
+
+    free(paths);
+    Py_DECREF(file_list);
+    if (error != RAGIDX_SUCCESS) {
+        return NULL;
+    }
+    return PyLong_FromSsize_t(count);
+}
@@ -0,0 +1,86 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "pyarrayview.h"
+
+static void PyArrayView_dealloc(PyArrayView* self) {
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int PyArrayView_getbuffer(PyArrayView* self, Py_buffer* view, int flags) {
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "RagFile arrays are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+
+    Py_ssize_t len = self->itemsize;
+    for (int i = 0; i < self->ndim; i++) {
+        len *= self->shape[i];
+    }
+
+    // The array is C-contiguous, so every request short of writable access can be served
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->buf = self->data;
+    view->len = len;
+    view->readonly = 1;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs PyArrayView_as_buffer = {
+    .bf_getbuffer = (getbufferproc)PyArrayView_getbuffer,
+};
+
+PyTypeObject PyArrayViewType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "ragfile.ArrayView",
+    .tp_doc = "Read-only buffer over an array of a RagFile",
+    .tp_basicsize = sizeof(PyArrayView),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc = (destructor)PyArrayView_dealloc,
+    .tp_as_buffer = &PyArrayView_as_buffer,
+};
+
+PyObject* PyArrayView_New(PyObject* owner, void* data, const char* format, Py_ssize_t itemsize,
+                          int ndim, const Py_ssize_t* shape) {
+    if (ndim < 1 || ndim > ARRAY_VIEW_MAX_NDIM) {
+        PyErr_SetString(PyExc_ValueError, "Unsupported number of dimensions");
+        return NULL;
+    }
+    // Both extension modules build this file, but only the ragfile module readies its types at import
+    if (!(PyArrayViewType.tp_flags & Py_TPFLAGS_READY) && PyType_Ready(&PyArrayViewType) < 0) {
+        return NULL;
+    }
+
+    PyArrayView* self = PyObject_New(PyArrayView, &PyArrayViewType);
+    if (!self) {
+        return NULL;
+    }
+    static char empty;  // Empty arrays may have no storage, but a buffer needs an address
+    self->owner = owner;
+    Py_INCREF(owner);
+    self->data = data ? data : &empty;
+    self->format = format;
+    self->itemsize = itemsize;
+    self->ndim = ndim;
+    Py_ssize_t stride = itemsize;
+    for (int i = ndim - 1; i >= 0; i--) {
+        self->shape[i] = shape[i];
+        self->strides[i] = stride;
+        stride *= shape[i];
+    }
+
+    // The memoryview holds the only reference to the exporter
+    PyObject* memoryview = PyMemoryView_FromObject((PyObject*)self);
+    Py_DECREF(self);
+    return memoryview;
+}
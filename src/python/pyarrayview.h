@@ -0,0 +1,38 @@
+#ifndef PYARRAYVIEW_H
+#define PYARRAYVIEW_H
+
+#include <Python.h>
+
+#define ARRAY_VIEW_MAX_NDIM 2
+
+// Read-only buffer exporter over an array owned by another Python object
+typedef struct {
+    PyObject_HEAD
+    PyObject* owner;     // Kept alive while the view (or any memoryview of it) exists
+    void* data;
+    const char* format;  // struct module format of one item
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[ARRAY_VIEW_MAX_NDIM];
+    Py_ssize_t strides[ARRAY_VIEW_MAX_NDIM];
+} PyArrayView;
+
+extern PyTypeObject PyArrayViewType;
+
+/**
+ * Expose a C-contiguous array as a read-only memoryview without copying it.
+ * The memoryview (and np.asarray of it) holds a reference to owner, so data
+ * must stay valid for as long as owner is alive.
+ *
+ * @param owner Object that owns data.
+ * @param data First item of the array.
+ * @param format struct module format of one item (e.g. "f" or "I").
+ * @param itemsize Size of one item in bytes.
+ * @param ndim Number of dimensions (at most ARRAY_VIEW_MAX_NDIM).
+ * @param shape Size of each dimension.
+ * @return New memoryview, or NULL with an exception set.
+ */
+PyObject* PyArrayView_New(PyObject* owner, void* data, const char* format, Py_ssize_t itemsize,
+                          int ndim, const Py_ssize_t* shape);
+
+#endif // PYARRAYVIEW_H
@@ -0,0 +1,227 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include "pylshindex.h"
+#include "pyragfile.h"
+#include "similarity.h"
+#include "../utils/file_io.h"
+
+// An LshIndex created through __new__ without __init__ has no index yet
+static int PyLshIndex_check(PyLshIndex* self) {
+    if (self->index == NULL) {
+        PyErr_SetString(PyExc_ValueError, "LshIndex is not initialized");
+        return -1;
+    }
+    return 0;
+}
+
+static void PyLshIndex_dealloc(PyLshIndex* self) {
+    lsh_free(self->index);
+    self->index = NULL;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int PyLshIndex_init(PyLshIndex* self, PyObject* args, PyObject* kwds) {
+    unsigned short bands = LSH_DEFAULT_BANDS;
+    unsigned short rows = LSH_DEFAULT_ROWS;
+
+    static char* kwlist[] = {"bands", "rows", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|HH", kwlist, &bands, &rows)) {
+        return -1;
+    }
+
+    LshIndex* index;
+    LshError error = lsh_create(&index, bands, rows);
+    if (error == LSH_ERROR_INVALID_ARGUMENT) {
+        PyErr_Format(PyExc_ValueError, "bands * rows must be between 1 and %d", LSH_HALF_SIZE);
+        return -1;
+    } else if (error != LSH_SUCCESS) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    lsh_free(self->index);
+    self->index = index;
+    return 0;
+}
+
+static PyObject* PyLshIndex_load(PyTypeObject* type, PyObject* args) {
+    const char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+
+    LshIndex* index;
+    LshError error;
+    Py_BEGIN_ALLOW_THREADS
+    error = lsh_load(&index, path);
+    Py_END_ALLOW_THREADS
+    if (error != LSH_SUCCESS) {
+        PyErr_Format(PyExc_IOError, "Failed to load LSH index '%s', error code: %d", path, error);
+        return NULL;
+    }
+
+    PyLshIndex* self = (PyLshIndex*)type->tp_alloc(type, 0);
+    if (!self) {
+        lsh_free(index);
+        return PyErr_NoMemory();
+    }
+    self->index = index;
+    return (PyObject*)self;
+}
+
+static PyObject* PyLshIndex_save(PyLshIndex* self, PyObject* args) {
+    const char* path;
+    if (PyLshIndex_check(self) < 0 || !PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+
+    if (lsh_save(self->index, path) != LSH_SUCCESS) {
+        PyErr_Format(PyExc_IOError, "Failed to save LSH index '%s'", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+// Insert a file, reading its signature from disk unless a RagFile is given
+static PyObject* PyLshIndex_insert(PyLshIndex* self, PyObject* args, PyObject* kwds) {
+    const char* path;
+    PyObject* rf_obj = Py_None;
+
+    static char* kwlist[] = {"path", "rf", NULL};
+
+    if (PyLshIndex_check(self) < 0 || !PyArg_ParseTupleAndKeywords(args, kwds, "s|O", kwlist, &path, &rf_obj)) {
+        return NULL;
+    }
+
+    const RagfileHeader* header;
+    RagfileHeader file_header;
+    if (rf_obj != Py_None) {
+        if (!PyObject_TypeCheck(rf_obj, &PyRagFileType)) {
+            PyErr_SetString(PyExc_TypeError, "rf must be a RagFile object");
+            return NULL;
+        }
+        header = &((PyRagFile*)rf_obj)->rf->header;
+    } else {
+        if (read_ragfile_header_at(path, &file_header, false) != FILE_IO_SUCCESS ||
+            file_header.magic != RAGFILE_MAGIC) {
+            PyErr_Format(PyExc_IOError, "Failed to read RagFile header from '%s'", path);
+            return NULL;
+        }
+        header = &file_header;
+    }
+
+    LshError error = lsh_insert(self->index, path, header);
+    if (error == LSH_ERROR_INCOMPATIBLE) {
+        PyErr_Format(PyExc_ValueError, "'%s' uses another tokenizer, embedding model or MinHash scheme than the indexed files", path);
+        return NULL;
+    } else if (error != LSH_SUCCESS) {
+        return PyErr_NoMemory();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* PyLshIndex_delete(PyLshIndex* self, PyObject* args) {
+    const char* path;
+    if (PyLshIndex_check(self) < 0 || !PyArg_ParseTuple(args, "s", &path)) {
+        return NULL;
+    }
+
+    if (lsh_delete(self->index, path) != LSH_SUCCESS) {
+        PyErr_Format(PyExc_KeyError, "'%s' is not in the index", path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* PyLshIndex_query(PyLshIndex* self, PyObject* args, PyObject* kwds) {
+    PyRagFile* rf;
+    float threshold = 0.5f;
+    unsigned int top_k = 100;
+
+    static char* kwlist[] = {"rf", "threshold", "top_k", NULL};
+
+    if (PyLshIndex_check(self) < 0 ||
+        !PyArg_ParseTupleAndKeywords(args, kwds, "O!|fI", kwlist, &PyRagFileType, &rf, &threshold, &top_k)) {
+        return NULL;
+    }
+
+    if (top_k == 0) {
+        PyErr_SetString(PyExc_ValueError, "top_k must be greater than 0");
+        return NULL;
+    }
+
+    MinHeap* heap = create_min_heap(top_k);
+    if (heap == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
+        return NULL;
+    }
+
+    if (lsh_query(self->index, &rf->rf->header, threshold, heap, NULL) != LSH_SUCCESS) {
+        free_min_heap(heap);
+        return PyErr_NoMemory();
+    }
+
+    PyObject* result_list = match_heap_to_list(heap);
+    free_min_heap(heap);
+    return result_list;
+}
+
+static Py_ssize_t PyLshIndex_length(PyLshIndex* self) {
+    if (PyLshIndex_check(self) < 0) {
+        return -1;
+    }
+    return (Py_ssize_t)lsh_size(self->index);
+}
+
+static PyObject* PyLshIndex_get_bands(PyLshIndex* self, void* closure) {
+    if (PyLshIndex_check(self) < 0) {
+        return NULL;
+    }
+    uint16_t bands, rows;
+    lsh_config(self->index, &bands, &rows);
+    return PyLong_FromUnsignedLong(bands);
+}
+
+static PyObject* PyLshIndex_get_rows(PyLshIndex* self, void* closure) {
+    if (PyLshIndex_check(self) < 0) {
+        return NULL;
+    }
+    uint16_t bands, rows;
+    lsh_config(self->index, &bands, &rows);
+    return PyLong_FromUnsignedLong(rows);
+}
+
+static PyMethodDef PyLshIndex_methods[] = {
+    {"load", (PyCFunction)PyLshIndex_load, METH_VARARGS | METH_CLASS, "Load an LSH index from a file"},
+    {"save", (PyCFunction)PyLshIndex_save, METH_VARARGS, "Save the LSH index to a file"},
+    {"insert", (PyCFunction)PyLshIndex_insert, METH_VARARGS | METH_KEYWORDS, "Insert or replace the signature of a RagFile"},
+    {"delete", (PyCFunction)PyLshIndex_delete, METH_VARARGS, "Remove a RagFile from the index"},
+    {"query", (PyCFunction)PyLshIndex_query, METH_VARARGS | METH_KEYWORDS, "Find indexed files whose Jaccard similarity is above a threshold"},
+    {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef PyLshIndex_getsetters[] = {
+    {"bands", (getter)PyLshIndex_get_bands, NULL, "Get the number of bands per signature half", NULL},
+    {"rows", (getter)PyLshIndex_get_rows, NULL, "Get the number of signature slots per band", NULL},
+    {NULL}  /* Sentinel */
+};
+
+static PySequenceMethods PyLshIndex_as_sequence = {
+    .sq_length = (lenfunc)PyLshIndex_length,
+};
+
+PyTypeObject PyLshIndexType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "ragfile.LshIndex",
+    .tp_doc = "LSH banding index over RagFile MinHash signatures",
+    .tp_basicsize = sizeof(PyLshIndex),
+    .tp_itemsize = 0,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)PyLshIndex_init,
+    .tp_dealloc = (destructor)PyLshIndex_dealloc,
+    .tp_methods = PyLshIndex_methods,
+    .tp_getset = PyLshIndex_getsetters,
+    .tp_as_sequence = &PyLshIndex_as_sequence,
+};
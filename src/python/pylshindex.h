@@ -0,0 +1,14 @@
+#ifndef PYLSHINDEX_H
+#define PYLSHINDEX_H
+
+#include <Python.h>
+#include "../index/lsh.h"
+
+typedef struct {
+    PyObject_HEAD
+    LshIndex* index;
+} PyLshIndex;
+
+extern PyTypeObject PyLshIndexType;
+
+#endif // PYLSHINDEX_H
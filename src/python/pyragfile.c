@@ -2,8 +2,11 @@
 #include <Python.h>
 #include "pyragfile.h"
 #include "pyragfileheader.h"
+#include "pyarrayview.h"
 #include "similarity.h"
 #include "utility.h"
+#include "../core/ragfile_batch.h"
+#include "../core/minhash.h"
 
 // Deallocate PyRagFile
 static void PyRagFile_dealloc(PyRagFile* self) {
@@ -12,8 +15,14 @@ static void PyRagFile_dealloc(PyRagFile* self) {
         ragfile_free(self->rf);
         self->rf = NULL;
     }
+    if (self->header) {
+        // The header object may outlive the RagFile, so it must not keep pointing into it
+        self->header->header = NULL;
+        self->header->owner = NULL;
+    }
     Py_XDECREF(self->header);
     Py_XDECREF(self->file_metadata);
+    Py_XDECREF(self->base);  // Only after the RagFile that points into it is gone
     Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -22,6 +31,7 @@ PyObject* PyRagFile_New(PyTypeObject* type, RagFile* rf, PyTypeObject* header_ty
     printf("in PyRagFile_New\n");
     PyRagFile* obj = (PyRagFile*)type->tp_alloc(type, 0);
     if (!obj) {
+        ragfile_free(rf);  // Ownership of rf passes to the new object, even on failure
         return PyErr_NoMemory();
     }
     printf("setting objects\n");
@@ -56,6 +66,7 @@ int PyRagFile_shared_init(PyRagFile* self, RagFile* rf, int is_loaded, PyTypeObj
         return -1;
     }
     self->header = (PyRagFileHeader*)header_obj;
+    self->header->owner = (PyObject*)self;
 
     // Debug statements
     printf("PyRagFile_shared_init: self->header: %p\n", (void*)self->header);
@@ -93,16 +104,25 @@ static int PyRagFile_init(PyRagFile* self, PyObject* args, PyObject* kwds) {
     uint32_t num_embeddings = 0;
     uint32_t embedding_dim = 0;
     int is_loaded = 0;
+    const char* minhash = NULL;
+    int normalize = 0;
+    uint16_t flags = 0;
 
-    static char* kwlist[] = {"text", "token_ids", "embeddings", "extended_metadata", "tokenizer_id", "embedding_id", "metadata_version", "is_loaded", NULL};
+    static char* kwlist[] = {"text", "token_ids", "embeddings", "extended_metadata", "tokenizer_id", "embedding_id", "metadata_version", "is_loaded", "minhash", "normalize", NULL};
 
     printf("PyRagFile_init: Parsing arguments\n");
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sOOsssHi", kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|sOOsssHizp", kwlist,
                                      &text, &token_ids_obj, &embeddings_obj, &extended_metadata,
-                                     &tokenizer_id, &embedding_id, &metadata_version, &is_loaded)) {
+                                     &tokenizer_id, &embedding_id, &metadata_version, &is_loaded, &minhash, &normalize)) {
         return -1; // Error handling if arguments are not correctly parsed
     }
+    if (!parse_minhash_scheme(minhash, &flags)) {
+        return -1;
+    }
+    if (normalize) {
+        flags |= RAGFILE_FLAG_NORMALIZED_EMBEDDINGS;
+    }
 
     printf("PyRagFile_init: Arguments parsed\n");
 
@@ -111,44 +131,36 @@ static int PyRagFile_init(PyRagFile* self, PyObject* args, PyObject* kwds) {
         return -1;
     }
 
-    uint32_t* token_ids = NULL;
-    float* flattened_embeddings = NULL;
-    size_t total_floats = 0;
-
     if (!is_loaded) {
-        // Token IDs conversion
-        Py_ssize_t num_tokens = PyList_Size(token_ids_obj);
-        token_ids = (uint32_t*)malloc(num_tokens * sizeof(uint32_t));
-        if (!token_ids) {
-            PyErr_NoMemory();
+        // Token IDs conversion; aligned uint32 and float32 buffers are used in place
+        PreparedArray token_ids;
+        size_t num_tokens = 0;
+        if (!prepare_token_ids(token_ids_obj, &token_ids, &num_tokens)) {
             return -1;
         }
-        for (Py_ssize_t i = 0; i < num_tokens; i++) {
-            PyObject* item = PyList_GetItem(token_ids_obj, i);
-            if (!PyLong_Check(item)) {
-                free(token_ids);
-                PyErr_SetString(PyExc_TypeError, "Token IDs must be integers");
-                return -1;
-            }
-            token_ids[i] = (uint32_t)PyLong_AsUnsignedLong(item);
-        }
 
         printf("PyRagFile_init: Converted token IDs\n");
 
         // Embeddings preparation
+        PreparedArray flattened_embeddings;
+        size_t total_floats = 0;
         if (!prepare_embeddings(embeddings_obj, &flattened_embeddings, &total_floats, &num_embeddings, &embedding_dim)) {
-            free(token_ids);
+            release_prepared(&token_ids);
             return -1; // Validate and prepare the embeddings array
         }
 
         printf("PyRagFile_init: Prepared embeddings\n");
 
-        // RagFile creation
-        RagfileError error = ragfile_create(&self->rf, text, token_ids, num_tokens,
-                                            flattened_embeddings, total_floats, extended_metadata,
-                                            tokenizer_id, embedding_id, metadata_version, num_embeddings, embedding_dim);
-        free(token_ids);
-        free(flattened_embeddings);
+        // RagFile creation; the buffers stay held, so the MinHash can be computed without the GIL
+        RagfileError error;
+        Py_BEGIN_ALLOW_THREADS
+        error = ragfile_create_with_flags(&self->rf, text, (const uint32_t*)token_ids.data, num_tokens,
+                                          (const float*)flattened_embeddings.data, total_floats, extended_metadata,
+                                          tokenizer_id, embedding_id, metadata_version, num_embeddings, embedding_dim,
+                                          flags);
+        Py_END_ALLOW_THREADS
+        release_prepared(&token_ids);
+        release_prepared(&flattened_embeddings);
 
         if (error != RAGFILE_SUCCESS) {
             PyErr_SetString(PyExc_RuntimeError, "Failed to create RagFile");
@@ -162,39 +174,43 @@ static int PyRagFile_init(PyRagFile* self, PyObject* args, PyObject* kwds) {
     return PyRagFile_shared_init(self, self->rf, is_loaded, &PyRagFileHeaderType);
 }
 
+// Read sections of a lazy RagFile on first use (a no-op otherwise)
+int PyRagFile_load_sections(PyRagFile* self, unsigned sections) {
+    RagfileError error;
+    Py_BEGIN_ALLOW_THREADS
+    error = ragfile_load_section(self->rf, sections);
+    Py_END_ALLOW_THREADS
+    if (error != RAGFILE_SUCCESS) {
+        if (error == RAGFILE_ERROR_MEMORY) {
+            PyErr_NoMemory();
+        } else {
+            PyErr_SetString(PyExc_IOError, "Failed to read RagFile section");
+        }
+        return -1;
+    }
+    return 0;
+}
+
 // Getter methods for RagFile
 
 static PyObject* PyRagFile_get_text(PyRagFile* self, void* closure) {
-    return PyUnicode_FromString(self->rf->text);
+    if (PyRagFile_load_sections(self, RAGFILE_SECTION_TEXT) < 0) {
+        return NULL;
+    }
+    // Memory mapped views are not NUL terminated
+    if (self->rf->text == NULL) {
+        return PyUnicode_FromStringAndSize("", 0);
+    }
+    return PyUnicode_FromStringAndSize(self->rf->text, self->rf->file_metadata.text_size);
 }
 
+// A read-only (num_embeddings, embedding_dim) float32 memoryview that keeps the RagFile alive
 static PyObject* PyRagFile_get_embeddings(PyRagFile* self, void* closure) {
-    int num_embeddings = self->rf->file_metadata.num_embeddings;
-    int embedding_dim = self->rf->file_metadata.embedding_dim;
-
-    // Creating the outer list that will contain all embeddings
-    PyObject* embeddings_list = PyList_New(num_embeddings);
-    if (!embeddings_list) return PyErr_NoMemory();
-
-    // Calculate the base index for each embedding and create lists for them
-    for (int i = 0; i < num_embeddings; i++) {
-        PyObject* single_embedding = PyList_New(embedding_dim);
-        if (!single_embedding) {
-            Py_DECREF(embeddings_list);
-            return PyErr_NoMemory();
-        }
-        
-        // Accessing the correct elements in the flat array
-        for (int j = 0; j < embedding_dim; j++) {
-            int idx = i * embedding_dim + j;  // Correct index in the flat array
-            PyObject* float_obj = PyFloat_FromDouble(self->rf->embeddings[idx]);
-            PyList_SET_ITEM(single_embedding, j, float_obj); // Takes ownership of the float_obj reference
-        }
-
-        PyList_SET_ITEM(embeddings_list, i, single_embedding);  // Takes ownership of the single_embedding reference
+    if (PyRagFile_load_sections(self, RAGFILE_SECTION_EMBEDDINGS) < 0) {
+        return NULL;
     }
-
-    return embeddings_list;
+    Py_ssize_t shape[2] = {self->rf->file_metadata.num_embeddings, self->rf->file_metadata.embedding_dim};
+    return PyArrayView_New((PyObject*)self, self->rf->embeddings, "f", sizeof(float), 2, shape);
 }
 
 // Getter method for RagFile header
@@ -226,10 +242,274 @@ static PyObject* PyRagFile_get_header(PyRagFile* self, void* closure) {
 }
 
 static PyObject* PyRagFile_get_extended_metadata(PyRagFile* self, void* closure) {
+    if (PyRagFile_load_sections(self, RAGFILE_SECTION_METADATA) < 0) {
+        return NULL;
+    }
     if (self->rf->extended_metadata == NULL) {
         Py_RETURN_NONE;
     }
-    return PyUnicode_FromString(self->rf->extended_metadata);
+    return PyUnicode_FromStringAndSize(self->rf->extended_metadata, self->rf->file_metadata.metadata_size);
+}
+
+// Module level ragfile.open(path, mmap=False, lazy=False)
+PyObject* PyRagFile_open(PyObject* module, PyObject* args, PyObject* kwds) {
+    (void)module;
+    PyObject* path_bytes = NULL;
+    int use_mmap = 0;
+    int lazy = 0;
+
+    static char* kwlist[] = {"path", "mmap", "lazy", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O&|pp", kwlist, PyUnicode_FSConverter, &path_bytes, &use_mmap, &lazy)) {
+        return NULL;
+    }
+    if (use_mmap && lazy) {
+        PyErr_SetString(PyExc_ValueError, "mmap and lazy cannot be combined");
+        Py_DECREF(path_bytes);
+        return NULL;
+    }
+    const char* path = PyBytes_AS_STRING(path_bytes);
+
+    RagFile* rf = NULL;
+    RagfileError error;
+    Py_BEGIN_ALLOW_THREADS
+    if (use_mmap) {
+        error = ragfile_open_mmap(&rf, path);
+    } else if (lazy) {
+        error = ragfile_open_lazy(&rf, path);
+    } else {
+        FILE* file = fopen(path, "rb");
+        if (file == NULL) {
+            error = RAGFILE_ERROR_IO;
+        } else {
+            error = ragfile_load(&rf, file);
+            fclose(file);
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    if (error != RAGFILE_SUCCESS) {
+        if (error == RAGFILE_ERROR_MEMORY) {
+            PyErr_NoMemory();
+        } else if (error == RAGFILE_ERROR_FORMAT) {
+            PyErr_Format(PyExc_ValueError, "%s is not a valid RagFile", path);
+        } else {
+            PyErr_Format(PyExc_IOError, "Failed to load RagFile %s", path);
+        }
+        Py_DECREF(path_bytes);
+        return NULL;
+    }
+    Py_DECREF(path_bytes);
+
+    return PyRagFile_New(&PyRagFileType, rf, &PyRagFileHeaderType);
+}
+
+// Module level ragfile.create_many(texts, token_ids, embeddings, tokenizer_id, embedding_id,
+//                                   extended_metadata=None, metadata_version=0, threads=1)
+PyObject* PyRagFile_create_many(PyObject* module, PyObject* args, PyObject* kwds) {
+    (void)module;
+    PyObject* texts_obj;
+    PyObject* token_ids_obj;
+    PyObject* embeddings_obj;
+    PyObject* metadata_obj = Py_None;
+    const char* tokenizer_id;
+    const char* embedding_id;
+    uint16_t metadata_version = 0;
+    unsigned int threads = 1;
+    const char* minhash = NULL;
+    int normalize = 0;
+    uint16_t flags = 0;
+
+    static char* kwlist[] = {"texts", "token_ids", "embeddings", "tokenizer_id", "embedding_id",
+                             "extended_metadata", "metadata_version", "threads", "minhash", "normalize", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOss|OHIzp", kwlist, &texts_obj, &token_ids_obj, &embeddings_obj,
+                                     &tokenizer_id, &embedding_id, &metadata_obj, &metadata_version, &threads,
+                                     &minhash, &normalize)) {
+        return NULL;
+    }
+    if (!parse_minhash_scheme(minhash, &flags)) {
+        return NULL;
+    }
+    if (normalize) {
+        flags |= RAGFILE_FLAG_NORMALIZED_EMBEDDINGS;
+    }
+
+    PyObject* texts = PySequence_Fast(texts_obj, "texts must be a sequence");
+    PyObject* token_ids = PySequence_Fast(token_ids_obj, "token_ids must be a sequence");
+    PyObject* embeddings = PySequence_Fast(embeddings_obj, "embeddings must be a sequence");
+    PyObject* metadata = metadata_obj == Py_None ? NULL : PySequence_Fast(metadata_obj, "extended_metadata must be a sequence");
+    PyObject* result = NULL;
+    RagFileSpec* specs = NULL;
+    PreparedArray* prepared = NULL;  // Token IDs then embeddings of each document
+    RagFile** rfs = NULL;
+    Py_ssize_t count = 0;
+
+    if (!texts || !token_ids || !embeddings || (metadata_obj != Py_None && !metadata)) {
+        goto cleanup;
+    }
+    count = PySequence_Fast_GET_SIZE(texts);
+    if (PySequence_Fast_GET_SIZE(token_ids) != count || PySequence_Fast_GET_SIZE(embeddings) != count ||
+        (metadata && PySequence_Fast_GET_SIZE(metadata) != count)) {
+        PyErr_SetString(PyExc_ValueError, "texts, token_ids, embeddings and extended_metadata must have the same length");
+        goto cleanup;
+    }
+
+    specs = (RagFileSpec*)calloc(count > 0 ? count : 1, sizeof(RagFileSpec));
+    prepared = (PreparedArray*)calloc(count > 0 ? 2 * count : 1, sizeof(PreparedArray));
+    rfs = (RagFile**)calloc(count > 0 ? count : 1, sizeof(RagFile*));
+    if (!specs || !prepared || !rfs) {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+
+    // Validate and convert everything with the GIL held; the strings and buffers stay alive in the sequences
+    for (Py_ssize_t i = 0; i < count; i++) {
+        RagFileSpec* spec = &specs[i];
+        PyObject* text = PySequence_Fast_GET_ITEM(texts, i);
+        if (!PyUnicode_Check(text) || !(spec->text = PyUnicode_AsUTF8(text))) {
+            if (!PyErr_Occurred()) {
+                PyErr_Format(PyExc_TypeError, "texts[%zd] must be a string", i);
+            }
+            goto cleanup;
+        }
+        if (metadata && PySequence_Fast_GET_ITEM(metadata, i) != Py_None) {
+            PyObject* item = PySequence_Fast_GET_ITEM(metadata, i);
+            if (!PyUnicode_Check(item) || !(spec->extended_metadata = PyUnicode_AsUTF8(item))) {
+                if (!PyErr_Occurred()) {
+                    PyErr_Format(PyExc_TypeError, "extended_metadata[%zd] must be a string or None", i);
+                }
+                goto cleanup;
+            }
+        }
+
+        uint32_t num_embeddings;
+        uint32_t embedding_dim;
+        size_t total_floats;
+        if (!prepare_token_ids(PySequence_Fast_GET_ITEM(token_ids, i), &prepared[2 * i], &spec->token_count) ||
+            !prepare_embeddings(PySequence_Fast_GET_ITEM(embeddings, i), &prepared[2 * i + 1], &total_floats,
+                                &num_embeddings, &embedding_dim)) {
+            goto cleanup;
+        }
+        if (num_embeddings > UINT16_MAX || embedding_dim > UINT16_MAX) {
+            PyErr_Format(PyExc_ValueError, "embeddings[%zd] has too many embeddings or dimensions", i);
+            goto cleanup;
+        }
+        spec->token_ids = (const uint32_t*)prepared[2 * i].data;
+        spec->embeddings = (const float*)prepared[2 * i + 1].data;
+        spec->embedding_size = (uint32_t)total_floats;
+        spec->num_embeddings = (uint16_t)num_embeddings;
+        spec->embedding_dim = (uint16_t)embedding_dim;
+    }
+
+    if (match_pool_reserve(threads) < 0) {
+        goto cleanup;
+    }
+
+    // MinHash, binary embeddings and copies for the whole batch, without the GIL
+    RagfileError error;
+    size_t failed_index = 0;
+    Py_BEGIN_ALLOW_THREADS
+    error = ragfile_create_many(match_pool_get(threads), match_pool_workers(threads), specs, (size_t)count,
+                                tokenizer_id, embedding_id, metadata_version, flags, rfs, &failed_index);
+    Py_END_ALLOW_THREADS
+
+    if (error == RAGFILE_ERROR_MEMORY) {
+        PyErr_NoMemory();
+        goto cleanup;
+    } else if (error != RAGFILE_SUCCESS) {
+        PyErr_Format(PyExc_RuntimeError, "Failed to create RagFile %zu, error code: %d", failed_index, error);
+        goto cleanup;
+    }
+
+    result = PyList_New(count);
+    if (!result) {
+        goto cleanup;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject* item = PyRagFile_New(&PyRagFileType, rfs[i], &PyRagFileHeaderType);
+        rfs[i] = NULL;  // Owned by the new object, even when it fails
+        if (!item) {
+            Py_CLEAR(result);
+            goto cleanup;
+        }
+        PyList_SET_ITEM(result, i, item);
+    }
+
+cleanup:
+    if (rfs) {
+        for (Py_ssize_t i = 0; i < count; i++) {
+            ragfile_free(rfs[i]);
+        }
+    }
+    if (prepared) {
+        for (Py_ssize_t i = 0; i < 2 * count; i++) {
+            release_prepared(&prepared[i]);
+        }
+    }
+    free(rfs);
+    free(prepared);
+    free(specs);
+    Py_XDECREF(texts);
+    Py_XDECREF(token_ids);
+    Py_XDECREF(embeddings);
+    Py_XDECREF(metadata);
+    return result;
+}
+
+// Module level ragfile.minhash_windows(token_ids, window_size, step)
+PyObject* PyRagFile_minhash_windows(PyObject* module, PyObject* args, PyObject* kwds) {
+    (void)module;
+    PyObject* token_ids_obj;
+    Py_ssize_t window_size;
+    Py_ssize_t step;
+
+    static char* kwlist[] = {"token_ids", "window_size", "step", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "Onn", kwlist, &token_ids_obj, &window_size, &step)) {
+        return NULL;
+    }
+    if (window_size < 3 || step < 1) {
+        PyErr_SetString(PyExc_ValueError, "window_size must be at least 3 and step at least 1");
+        return NULL;
+    }
+
+    PreparedArray token_ids;
+    size_t num_tokens = 0;
+    if (!prepare_token_ids(token_ids_obj, &token_ids, &num_tokens)) {
+        return NULL;
+    }
+
+    // The signatures are written straight into a bytes object that the returned view keeps alive
+    size_t count = minhash_window_count(num_tokens, (size_t)window_size, (size_t)step);
+    PyObject* owner = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)(count * MINHASH_SIZE * sizeof(uint32_t)));
+    if (!owner) {
+        release_prepared(&token_ids);
+        return NULL;
+    }
+    uint32_t* signatures = (uint32_t*)PyBytes_AS_STRING(owner);
+
+    RagfileError error = RAGFILE_SUCCESS;
+    if (count > 0) {
+        Py_BEGIN_ALLOW_THREADS
+        error = ragfile_compute_minhash_windows((const uint32_t*)token_ids.data, num_tokens, (size_t)window_size,
+                                                (size_t)step, signatures);
+        Py_END_ALLOW_THREADS
+    }
+    release_prepared(&token_ids);
+    if (error != RAGFILE_SUCCESS) {
+        Py_DECREF(owner);
+        if (error == RAGFILE_ERROR_MEMORY) {
+            return PyErr_NoMemory();
+        }
+        PyErr_Format(PyExc_RuntimeError, "Failed to compute window signatures, error code: %d", error);
+        return NULL;
+    }
+
+    Py_ssize_t shape[2] = {(Py_ssize_t)count, MINHASH_SIZE};
+    PyObject* view = PyArrayView_New(owner, signatures, "I", sizeof(uint32_t), 2, shape);
+    Py_DECREF(owner);
+    return view;
 }
 
 static PyObject* PyRagFile_get_file_metadata(PyRagFile* self, void* closure) {
@@ -242,7 +522,10 @@ static PyMethodDef PyRagFile_methods[] = {
     {"jaccard", (PyCFunction)PyRagFile_jaccard, METH_VARARGS, "Compute Jaccard similarity with another RagFile"},
     {"hamming", (PyCFunction)PyRagFile_hamming, METH_VARARGS, "Compute Hamming similarity from the binary embedding"},
     {"cosine", (PyCFunction)PyRagFile_cosine, METH_VARARGS | METH_KEYWORDS, "Compute Cosine similarity with another RagFile"},
+    {"cosine_many", (PyCFunction)PyRagFile_cosine_many, METH_VARARGS | METH_KEYWORDS, "Compute Cosine similarity with each of a sequence of RagFiles"},
     {"match", (PyCFunction)PyRagFile_match, METH_VARARGS | METH_KEYWORDS, "Find matches in a directory using Jaccard similarity"},
+    {"match_index", (PyCFunction)PyRagFile_match_index, METH_VARARGS | METH_KEYWORDS, "Find matches in a .ragidx sidecar using Jaccard similarity"},
+    {"match_cascade", (PyCFunction)PyRagFile_match_cascade, METH_VARARGS | METH_KEYWORDS, "Find matches with a Hamming, Jaccard and cosine cascade"},
     {NULL}  /* Sentinel */
 };
 
@@ -11,6 +11,7 @@ typedef struct {
     RagFile* rf;         // Replace with actual definition or include necessary header
     PyRagFileHeader* header;    // Python object for header
     PyObject* file_metadata; // Metadata as a Python dictionary
+    PyObject* base;          // Buffer a borrowing RagFile points into (see ragfile.loads), or NULL
 } PyRagFile;
 
 extern PyTypeObject PyRagFileType;
@@ -18,6 +19,10 @@ extern PyTypeObject PyRagFileType;
 // Function declarations
 PyObject* PyRagFile_New(PyTypeObject* type, RagFile* rf, PyTypeObject* header_type);
 int PyRagFile_shared_init(PyRagFile* self, RagFile* rf, int is_loaded, PyTypeObject* header_type);
+int PyRagFile_load_sections(PyRagFile* self, unsigned sections);
+PyObject* PyRagFile_open(PyObject* module, PyObject* args, PyObject* kwds);
+PyObject* PyRagFile_create_many(PyObject* module, PyObject* args, PyObject* kwds);
+PyObject* PyRagFile_minhash_windows(PyObject* module, PyObject* args, PyObject* kwds);
 
 #endif // PYRAGFILE_H
 
@@ -1,6 +1,7 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include "pyragfileheader.h"
+#include "pyarrayview.h"
 
 // Deallocate PyRagFileHeader
 void PyRagFileHeader_dealloc(PyRagFileHeader* self) {
@@ -33,30 +34,61 @@ static PyObject* PyRagFileHeader_get_version(PyRagFileHeader* self, void* closur
 }
 
 static PyObject* PyRagFileHeader_get_tokenizer_hash(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
+    }
     return PyLong_FromUnsignedLong((unsigned long)self->header->tokenizer_id_hash);
 }
 
 static PyObject* PyRagFileHeader_get_embedding_hash(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
+    }
     return PyLong_FromUnsignedLong((unsigned long)self->header->embedding_id_hash);
 }
 
-static PyObject* PyRagFileHeader_get_minhash_signature(PyRagFileHeader* self, void* closure) {
-    PyObject* signature = PyList_New(MINHASH_SIZE);
-    if (signature == NULL) {
-        return PyErr_NoMemory();
+static PyObject* PyRagFileHeader_get_flags(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
     }
-    for (int i = 0; i < MINHASH_SIZE; i++) {
-        PyObject* item = PyLong_FromUnsignedLong(self->header->minhash_signature[i]);
-        if (!item) {  // Always check for failure!
-            Py_DECREF(signature);
-            return PyErr_NoMemory();
-        }
-        PyList_SET_ITEM(signature, i, item);  // Transfers ownership to list
+    return PyLong_FromUnsignedLong((unsigned long)self->header->flags);
+}
+
+static PyObject* PyRagFileHeader_get_minhash_scheme(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
+    }
+    return PyUnicode_FromString((self->header->flags & RAGFILE_FLAG_MINHASH_OPH) ? "oph" : "classic");
+}
+
+static PyObject* PyRagFileHeader_get_normalized_embeddings(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
     }
-    return signature;
+    return PyBool_FromLong(self->header->flags & RAGFILE_FLAG_NORMALIZED_EMBEDDINGS);
+}
+
+// A read-only uint32 memoryview of the signature that keeps the RagFile alive
+static PyObject* PyRagFileHeader_get_minhash_signature(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL || self->owner == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
+    }
+    _Static_assert(sizeof(unsigned int) == sizeof(uint32_t), "format I must match uint32_t");
+    Py_ssize_t shape[1] = {MINHASH_SIZE};
+    return PyArrayView_New(self->owner, self->header->minhash_signature, "I", sizeof(uint32_t), 1, shape);
 }
 
 static PyObject* PyRagFileHeader_get_binary_embedding(PyRagFileHeader* self, void* closure) {
+    if (self->header == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Header is NULL");
+        return NULL;
+    }
     PyObject* binary_embedding = PyList_New(BINARY_EMBEDDING_BYTE_DIM);
     if (binary_embedding == NULL) {
         return PyErr_NoMemory();
@@ -75,6 +107,9 @@ static PyObject* PyRagFileHeader_get_binary_embedding(PyRagFileHeader* self, voi
 // Getters for RagFileHeader
 static PyGetSetDef PyRagFileHeader_getsetters[] = {
     {"version", (getter)PyRagFileHeader_get_version, NULL, "Get the version", NULL},
+    {"flags", (getter)PyRagFileHeader_get_flags, NULL, "Get the header flags", NULL},
+    {"minhash_scheme", (getter)PyRagFileHeader_get_minhash_scheme, NULL, "Get the MinHash scheme of the signature, 'classic' or 'oph'", NULL},
+    {"normalized_embeddings", (getter)PyRagFileHeader_get_normalized_embeddings, NULL, "Whether the embeddings are stored with unit L2 norm", NULL},
     {"tokenizer_id_hash", (getter)PyRagFileHeader_get_tokenizer_hash, NULL, "Get the CRC 16 hash of the tokenzier id", NULL},
     {"embedding_id_hash", (getter)PyRagFileHeader_get_embedding_hash, NULL, "Get the CRC 16 hash of the embedding id", NULL},
     {"binary_embedding", (getter)PyRagFileHeader_get_binary_embedding, NULL, "Get the Binary Embedding", NULL},
@@ -8,6 +8,7 @@
 typedef struct {
     PyObject_HEAD
     RagfileHeader* header;
+    PyObject* owner;  // Borrowed: the RagFile holding the header, NULL once it is deallocated
 } PyRagFileHeader;
 
 extern PyTypeObject PyRagFileHeaderType;
@@ -1,6 +1,21 @@
 #include <Python.h>
 #include "pyragfile.h"
 #include "pyragfileheader.h"
+#include "pyarrayview.h"
+#include "pylshindex.h"
+#include "similarity.h"
+
+static PyMethodDef ragfile_methods[] = {
+    {"match_many", (PyCFunction)ragfile_match_many, METH_VARARGS | METH_KEYWORDS,
+     "Match several query RagFiles against the same files, reading each header once"},
+    {"create_many", (PyCFunction)PyRagFile_create_many, METH_VARARGS | METH_KEYWORDS,
+     "Create a batch of RagFiles on a thread pool, with the GIL released"},
+    {"minhash_windows", (PyCFunction)PyRagFile_minhash_windows, METH_VARARGS | METH_KEYWORDS,
+     "Compute the MinHash signature of every sliding window of token ids in one pass"},
+    {"open", (PyCFunction)PyRagFile_open, METH_VARARGS | METH_KEYWORDS,
+     "Open a RagFile from a path, optionally as a read-only memory mapped view"},
+    {NULL, NULL, 0, NULL}  // Sentinel
+};
 
 // Module definition
 static PyModuleDef ragfilemodule = {
@@ -8,7 +23,7 @@ static PyModuleDef ragfilemodule = {
     .m_name = "ragfile",
     .m_doc = "Python bindings for RagFile library",
     .m_size = -1,
-    //.m_methods = ragfile_methods,
+    .m_methods = ragfile_methods,
 };
 
 // Module initialization
@@ -21,6 +36,12 @@ PyMODINIT_FUNC PyInit_ragfile(void) {
     if (PyType_Ready(&PyRagFileHeaderType) < 0)
         return NULL;
 
+    if (PyType_Ready(&PyLshIndexType) < 0)
+        return NULL;
+
+    if (PyType_Ready(&PyArrayViewType) < 0)
+        return NULL;
+
     m = PyModule_Create(&ragfilemodule);
     if (m == NULL)
         return NULL;
@@ -40,6 +61,15 @@ PyMODINIT_FUNC PyInit_ragfile(void) {
         return NULL;
     }
 
+    Py_INCREF(&PyLshIndexType);
+    if (PyModule_AddObject(m, "LshIndex", (PyObject*)&PyLshIndexType) < 0) {
+        Py_DECREF(&PyLshIndexType);
+        Py_DECREF(&PyRagFileHeaderType);
+        Py_DECREF(&PyRagFileType);
+        Py_DECREF(m);
+        return NULL;
+    }
+
     // Create capsules containing the addresses of PyRagFileType and PyRagFileHeaderType
     PyObject* type_capsule = PyCapsule_New((void *)&PyRagFileType, "ragfile.PyRagFileType", NULL);
     if (!type_capsule) {
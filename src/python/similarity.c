@@ -1,10 +1,15 @@
 #include "similarity.h"
+#include "utility.h"
 #include "../core/minhash.h"
 #include "../algorithms/jaccard.h"
 #include "../algorithms/hamming.h"
 #include "../algorithms/cosine.h"
 #include "../search/heap.h"
 #include "../search/scan.h"
+#include "../search/uring_scan.h"
+#include "../search/cascade.h"
+#include "../utils/thread_pool.h"
+#include "../index/ragidx.h"
 
 // Methods for similarity calculations
 PyObject* PyRagFile_jaccard(PyRagFile* self, PyObject* args) {
@@ -13,6 +18,11 @@ PyObject* PyRagFile_jaccard(PyRagFile* self, PyObject* args) {
         return NULL;
     }
 
+    if (!ragfile_minhash_compatible(self->rf->header.flags, other->rf->header.flags)) {
+        PyErr_SetString(PyExc_ValueError, "RagFiles use different MinHash schemes");
+        return NULL;
+    }
+
     float similarity = jaccard_similarity(self->rf->header.minhash_signature, 
                                           other->rf->header.minhash_signature);
     return PyFloat_FromDouble(similarity);
@@ -26,120 +36,854 @@ PyObject* PyRagFile_hamming(PyRagFile* self, PyObject* args) {
 
     float similarity = hamming_similarity(self->rf->header.binary_embedding, 
                                           other->rf->header.binary_embedding,
-                                          self->rf->file_metadata.embedding_dim);
+                                          BINARY_EMBEDDING_BYTE_DIM);
     return PyFloat_FromDouble(similarity);
 }
 
-// Compute Cosine Similarity with options for max or avg
+// Compute the norms of a RagFile's embeddings, with an exception set on failure
+static int embedding_norms(const RagFile* rf, float** norms) {
+    RagfileError error = ragfile_embedding_norms(rf, norms);
+    if (error == RAGFILE_ERROR_MEMORY) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (error != RAGFILE_SUCCESS) {
+        PyErr_SetString(PyExc_ValueError, "RagFile has no embeddings");
+        return -1;
+    }
+    return 0;
+}
+
+// Compute Cosine Similarity with options for max, avg or maxsim
 PyObject* PyRagFile_cosine(PyRagFile* self, PyObject* args) {
     PyRagFile* other;
     const char* mode = "max";
+    CosineReduction reduction;
+
+    if (!PyArg_ParseTuple(args, "O!|s", &PyRagFileType, &other, &mode) || !parse_cosine_mode(mode, &reduction)) {
+        return NULL;
+    }
+
+    if (PyRagFile_load_sections(self, RAGFILE_SECTION_EMBEDDINGS) < 0 ||
+        PyRagFile_load_sections(other, RAGFILE_SECTION_EMBEDDINGS) < 0) {
+        return NULL;
+    }
+
+    if (self->rf->file_metadata.embedding_dim != other->rf->file_metadata.embedding_dim) {
+        PyErr_SetString(PyExc_ValueError, "RagFiles have different embedding dimensions");
+        return NULL;
+    }
+
+    // Each embedding's norm is computed once rather than for every pair, and not at all when stored normalized
+    float* norms_self;
+    float* norms_other = NULL;
+    if (embedding_norms(self->rf, &norms_self) < 0) {
+        return NULL;
+    }
+    if (embedding_norms(other->rf, &norms_other) < 0) {
+        free(norms_self);
+        return NULL;
+    }
+
+    double similarity = cosine_similarity_reduce(self->rf->embeddings, norms_self, self->rf->file_metadata.num_embeddings,
+                                                 other->rf->embeddings, norms_other, other->rf->file_metadata.num_embeddings,
+                                                 self->rf->file_metadata.embedding_dim, reduction);
+    free(norms_self);
+    free(norms_other);
+
+    return PyFloat_FromDouble(similarity);
+}
+
+// Free the norms gathered by PyRagFile_cosine_many
+static void cosine_batch_free(float** norms, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(norms[i]);
+    }
+    free(norms);
+}
+
+// Compute Cosine Similarity with each of a sequence of RagFiles in one batch
+PyObject* PyRagFile_cosine_many(PyRagFile* self, PyObject* args, PyObject* kwds) {
+    PyObject* candidates_obj;
+    const char* mode = "max";
+    CosineReduction reduction;
+
+    static char *kwlist[] = {"candidates", "mode", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|s", kwlist, &candidates_obj, &mode) ||
+        !parse_cosine_mode(mode, &reduction)) {
+        return NULL;
+    }
 
-    if (!PyArg_ParseTuple(args, "O!|s", &PyRagFileType, &other, &mode)) {
+    // A tuple holds its own references, so the candidates outlive the batch even if a list is changed meanwhile
+    PyObject* candidates = PySequence_Tuple(candidates_obj);
+    if (!candidates) {
         return NULL;
     }
+    if (PyRagFile_load_sections(self, RAGFILE_SECTION_EMBEDDINGS) < 0) {
+        Py_DECREF(candidates);
+        return NULL;
+    }
+
+    size_t count = (size_t)PyTuple_GET_SIZE(candidates);
+    size_t slots = count ? count : 1;
+    const float** embeddings = (const float**)malloc(slots * sizeof(float*));
+    float** norms = (float**)calloc(slots + 1, sizeof(float*));  // The last slot holds the query norms
+    size_t* counts = (size_t*)malloc(slots * sizeof(size_t));
+    double* scores = (double*)malloc(slots * sizeof(double));
+    if (!embeddings || !norms || !counts || !scores) {
+        free(embeddings);
+        free(norms);
+        free(counts);
+        free(scores);
+        Py_DECREF(candidates);
+        return PyErr_NoMemory();
+    }
 
-    // Assume embedding dimension and number of embeddings are part of file_metadata or a similar accessible structure
-    int embedding_dim = self->rf->file_metadata.embedding_dim;
-    int num_embeddings_self = self->rf->file_metadata.num_embeddings;
-    int num_embeddings_other = other->rf->file_metadata.num_embeddings;
+    // Every candidate is loaded and checked with the GIL held; the batch then runs without it
+    int ok = 1;
+    if (embedding_norms(self->rf, &norms[slots]) < 0) {
+        ok = 0;
+    }
+    for (size_t i = 0; ok && i < count; i++) {
+        PyObject* item = PyTuple_GET_ITEM(candidates, i);
+        if (!PyObject_TypeCheck(item, &PyRagFileType)) {
+            PyErr_SetString(PyExc_TypeError, "candidates must be a sequence of RagFiles");
+            ok = 0;
+            break;
+        }
+        PyRagFile* candidate = (PyRagFile*)item;
+        if (PyRagFile_load_sections(candidate, RAGFILE_SECTION_EMBEDDINGS) < 0) {
+            ok = 0;
+            break;
+        }
+        if (candidate->rf->file_metadata.embedding_dim != self->rf->file_metadata.embedding_dim) {
+            PyErr_SetString(PyExc_ValueError, "RagFiles have different embedding dimensions");
+            ok = 0;
+            break;
+        }
+        if (embedding_norms(candidate->rf, &norms[i]) < 0) {
+            ok = 0;
+            break;
+        }
+        embeddings[i] = candidate->rf->embeddings;
+        counts[i] = candidate->rf->file_metadata.num_embeddings;
+    }
 
-    float max_similarity = -1.0f;
-    float total_similarity = 0.0f;
-    int count = 0;
+    if (ok) {
+        Py_BEGIN_ALLOW_THREADS
+        cosine_similarity_batch(self->rf->embeddings, norms[slots], self->rf->file_metadata.num_embeddings,
+                                embeddings, (const float* const*)norms, counts, count,
+                                self->rf->file_metadata.embedding_dim, reduction, scores);
+        Py_END_ALLOW_THREADS
+    }
 
-    for (int i = 0; i < num_embeddings_self; i++) {
-        for (int j = 0; j < num_embeddings_other; j++) {
-            float* emb1 = self->rf->embeddings + (i * embedding_dim);
-            float* emb2 = other->rf->embeddings + (j * embedding_dim);
-            float similarity = cosine_similarity(emb1, emb2, embedding_dim);
-            max_similarity = fmax(max_similarity, similarity);
-            total_similarity += similarity;
-            count++;
+    PyObject* result = ok ? PyList_New((Py_ssize_t)count) : NULL;
+    for (size_t i = 0; result && i < count; i++) {
+        PyObject* score = PyFloat_FromDouble(scores[i]);
+        if (!score) {
+            Py_CLEAR(result);
+            break;
         }
+        PyList_SET_ITEM(result, (Py_ssize_t)i, score);
     }
 
-    float result = strcmp(mode, "avg") == 0 ? total_similarity / count : max_similarity;
-    return PyFloat_FromDouble(result);
+    cosine_batch_free(norms, slots + 1);
+    free(embeddings);
+    free(counts);
+    free(scores);
+    Py_DECREF(candidates);
+    return result;
 }
 
 // Scanning
+
+#define MATCH_BATCH_SIZE 8192  // Paths pulled from the iterator per GIL release
+
+// Worker pool shared by every match call; grown on demand and never freed
+static ThreadPool* match_pool = NULL;
+
+// Paths pulled from the iterator, kept alive while the batch is scanned without the GIL
+typedef struct {
+    PyObject** items;
+    const char** paths;
+    size_t count;
+} MatchBatch;
+
+static void match_batch_release(MatchBatch* batch) {
+    for (size_t i = 0; i < batch->count; i++) {
+        Py_DECREF(batch->items[i]);
+    }
+    batch->count = 0;
+}
+
+static void match_batch_free(MatchBatch* batch) {
+    if (batch->items) {
+        match_batch_release(batch);
+    }
+    free(batch->items);
+    free(batch->paths);
+}
+
+static int match_batch_init(MatchBatch* batch) {
+    memset(batch, 0, sizeof(MatchBatch));
+    batch->items = (PyObject**)malloc(MATCH_BATCH_SIZE * sizeof(PyObject*));
+    batch->paths = (const char**)malloc(MATCH_BATCH_SIZE * sizeof(const char*));
+    if (!batch->items || !batch->paths) {
+        match_batch_free(batch);
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+// Pull the next batch of paths from the iterator. Returns -1 on error.
+static int match_batch_collect(MatchBatch* batch, PyObject* file_iter) {
+    PyObject* file_path;
+    while (batch->count < MATCH_BATCH_SIZE && (file_path = PyIter_Next(file_iter)) != NULL) {
+        const char* path = PyUnicode_AsUTF8(file_path);
+        if (path == NULL) {
+            Py_DECREF(file_path);
+            PyErr_Format(PyExc_ValueError, "Invalid file path encountered");
+            return -1;
+        }
+        batch->items[batch->count] = file_path;
+        batch->paths[batch->count] = path;
+        batch->count++;
+    }
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+// Per-call scan state: one heap (and optionally one io_uring) per worker
+typedef struct {
+    unsigned int threads;
+    MinHeap** heaps;
+    ScanRing** rings;
+} MatchScan;
+
+static void match_scan_free(MatchScan* scan) {
+    for (unsigned int i = 0; i < scan->threads; i++) {
+        if (scan->heaps && scan->heaps[i]) {
+            free_min_heap(scan->heaps[i]);
+        }
+        if (scan->rings) {
+            scan_ring_free(scan->rings[i]);
+        }
+    }
+    free(scan->heaps);
+    free(scan->rings);
+}
+
+static int match_scan_init(MatchScan* scan, unsigned int threads, unsigned int top_k, int use_io_uring) {
+    memset(scan, 0, sizeof(MatchScan));
+    scan->threads = threads;
+    scan->heaps = (MinHeap**)calloc(threads, sizeof(MinHeap*));
+    if (!scan->heaps) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
+        return -1;
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        scan->heaps[i] = create_min_heap(top_k);
+        if (scan->heaps[i] == NULL) {
+            match_scan_free(scan);
+            PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
+            return -1;
+        }
+    }
+
+    // Workers without a ring (io_uring unavailable) use synchronous reads
+    if (use_io_uring) {
+        scan->rings = (ScanRing**)calloc(threads, sizeof(ScanRing*));
+        if (!scan->rings) {
+            match_scan_free(scan);
+            PyErr_NoMemory();
+            return -1;
+        }
+        for (unsigned int i = 0; i < threads; i++) {
+            scan->rings[i] = scan_ring_create(SCAN_RING_DEPTH);
+        }
+    }
+
+    return 0;
+}
+
+// Grow the shared worker pool to at least threads workers. Returns -1 on error.
+int match_pool_reserve(unsigned int threads) {
+    if (threads > 1 && match_pool == NULL) {
+        match_pool = thread_pool_create(threads);
+        if (match_pool == NULL) {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to create the worker pool");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Number of pool workers to run with; called without the GIL. The pool may be
+// larger than this call needs, but there is only one heap per thread.
+size_t match_pool_workers(unsigned int threads) {
+    if (threads <= 1) {
+        return 1;
+    }
+    size_t available = thread_pool_reserve(match_pool, threads);
+    return available < threads ? available : threads;
+}
+
+ThreadPool* match_pool_get(unsigned int threads) {
+    return threads > 1 ? match_pool : NULL;
+}
+
+PyObject* match_heap_to_list(MinHeap* heap) {
+    PyObject* result_list = PyList_New(0);
+    if (result_list == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to create list");
+        return NULL;
+    }
+
+    // Sorted ascending, so walk the entries from the best down
+    for (size_t i = heap_sort(heap); i-- > 0;) {
+        PyObject* dict = Py_BuildValue("{s:s, s:f}", "file", heap->heap[i].path, "jaccard", heap->heap[i].score);
+        if (dict == NULL || PyList_Append(result_list, dict) == -1) {
+            Py_XDECREF(dict);
+            Py_DECREF(result_list);
+            heap_clear(heap);
+            return NULL;
+        }
+        Py_DECREF(dict);
+    }
+    heap_clear(heap);
+
+    return result_list;
+}
+
 PyObject* PyRagFile_match(PyRagFile* self, PyObject* args, PyObject* kwds) {
     PyObject* file_iter;
     unsigned int top_k;
+    unsigned int threads = 1;
+    int use_io_uring = 0;
+    const char* pattern = NULL;
 
-    static char *kwlist[] = {"file_iter", "top_k", NULL};
+    static char *kwlist[] = {"file_iter", "top_k", "threads", "io_uring", "pattern", NULL};
 
     // Parse Python keyword arguments
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OI", kwlist, &file_iter, &top_k)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OI|Ipz", kwlist, &file_iter, &top_k, &threads, &use_io_uring, &pattern)) {
         return NULL;
     }
 
-    if (!PyIter_Check(file_iter)) {
-        PyErr_SetString(PyExc_TypeError, "file_iter must be an iterator");
+    // A str, bytes or os.PathLike names a directory that is walked natively
+    PyObject* root = NULL;
+    if (PyUnicode_Check(file_iter) || PyBytes_Check(file_iter) || PyObject_HasAttrString(file_iter, "__fspath__")) {
+        if (!PyUnicode_FSConverter(file_iter, &root)) {
+            return NULL;
+        }
+    } else if (!PyIter_Check(file_iter)) {
+        PyErr_SetString(PyExc_TypeError, "file_iter must be an iterator or a directory path");
+        return NULL;
+    }
+
+    if (root == NULL && pattern != NULL) {
+        PyErr_SetString(PyExc_TypeError, "pattern is only supported with a directory path");
         return NULL;
     }
 
     if (top_k == 0) {
         PyErr_SetString(PyExc_ValueError, "top_k must be greater than 0");
+        Py_XDECREF(root);
+        return NULL;
+    }
+
+    if (threads == 0) {
+        PyErr_SetString(PyExc_ValueError, "threads must be greater than 0");
+        Py_XDECREF(root);
         return NULL;
     }
 
+    if (match_pool_reserve(threads) < 0) {
+        Py_XDECREF(root);
+        return NULL;
+    }
+
+    MatchScan scan;
+    if (match_scan_init(&scan, threads, top_k, use_io_uring) < 0) {
+        Py_XDECREF(root);
+        return NULL;
+    }
+
+    int process_status = 0;
+    if (root != NULL) {
+        // Walk and score the whole tree without the GIL
+        const char* root_path = PyBytes_AS_STRING(root);
+        Py_BEGIN_ALLOW_THREADS
+        process_status = process_directory(match_pool, match_pool_workers(threads), root_path, pattern,
+                                           self->rf, scan.heaps, scan.rings);
+        Py_END_ALLOW_THREADS
+        if (process_status == -4) {
+            PyErr_Format(PyExc_IOError, "Failed to open directory %s", root_path);
+            Py_DECREF(root);
+            match_scan_free(&scan);
+            return NULL;
+        }
+        Py_DECREF(root);
+    } else {
+        MatchBatch batch;
+        if (match_batch_init(&batch) < 0) {
+            match_scan_free(&scan);
+            return NULL;
+        }
+
+        int exhausted = 0;
+        while (!exhausted && process_status == 0) {
+            // Collect a batch of paths while holding the GIL
+            if (match_batch_collect(&batch, file_iter) < 0) {
+                match_batch_free(&batch);
+                match_scan_free(&scan);
+                return NULL;
+            }
+            exhausted = batch.count < MATCH_BATCH_SIZE;
+
+            // Score the batch without the GIL
+            Py_BEGIN_ALLOW_THREADS
+            process_status = process_files(match_pool, match_pool_workers(threads), batch.paths, batch.count,
+                                           self->rf, scan.heaps, scan.rings);
+            Py_END_ALLOW_THREADS
+
+            match_batch_release(&batch);
+        }
+        match_batch_free(&batch);
+    }
+
     MinHeap* heap = create_min_heap(top_k);
     if (heap == NULL) {
+        match_scan_free(&scan);
         PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
         return NULL;
     }
+    int merge_status = 0;
+    for (unsigned int i = 0; i < threads && merge_status == 0; i++) {
+        merge_status = merge_heaps(heap, scan.heaps[i]);
+    }
+    match_scan_free(&scan);
 
-    PyObject* file_path;
-    while ((file_path = PyIter_Next(file_iter)) != NULL) {
-        const char* path = PyUnicode_AsUTF8(file_path);
-        if (path == NULL) {
-            PyErr_Format(PyExc_ValueError, "Invalid file path encountered");
-            Py_DECREF(file_path);
-            continue;
+    if (process_status != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "File processing failed");
+        free_min_heap(heap);
+        return NULL;
+    }
+    if (merge_status != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to merge the results");
+        free_min_heap(heap);
+        return NULL;
+    }
+
+    PyObject* result_list = match_heap_to_list(heap);
+    free_min_heap(heap);
+    return result_list;
+}
+
+PyObject* ragfile_match_many(PyObject* self, PyObject* args, PyObject* kwds) {
+    (void)self;
+    PyObject* queries;
+    PyObject* paths;
+    unsigned int top_k;
+    unsigned int threads = 1;
+    const char* pattern = NULL;
+
+    static char *kwlist[] = {"queries", "paths", "top_k", "threads", "pattern", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOI|Iz", kwlist, &queries, &paths, &top_k, &threads, &pattern)) {
+        return NULL;
+    }
+
+    if (top_k == 0) {
+        PyErr_SetString(PyExc_ValueError, "top_k must be greater than 0");
+        return NULL;
+    }
+
+    if (threads == 0) {
+        PyErr_SetString(PyExc_ValueError, "threads must be greater than 0");
+        return NULL;
+    }
+
+    PyObject* query_seq = PySequence_Fast(queries, "queries must be a sequence of RagFile objects");
+    if (query_seq == NULL) {
+        return NULL;
+    }
+    Py_ssize_t num_queries = PySequence_Fast_GET_SIZE(query_seq);
+    if (num_queries == 0) {
+        Py_DECREF(query_seq);
+        return PyList_New(0);
+    }
+
+    // Pack the query signatures back to back for the one-vs-many kernel
+    RagfileHeader query_header;
+    uint32_t* signatures = (uint32_t*)malloc((size_t)num_queries * MINHASH_SIZE * sizeof(uint32_t));
+    if (signatures == NULL) {
+        Py_DECREF(query_seq);
+        return PyErr_NoMemory();
+    }
+    for (Py_ssize_t q = 0; q < num_queries; q++) {
+        PyObject* query = PySequence_Fast_GET_ITEM(query_seq, q);
+        if (!PyObject_TypeCheck(query, &PyRagFileType)) {
+            PyErr_SetString(PyExc_TypeError, "queries must be a sequence of RagFile objects");
+            free(signatures);
+            Py_DECREF(query_seq);
+            return NULL;
+        }
+        const RagfileHeader* header = &((PyRagFile*)query)->rf->header;
+        if (q == 0) {
+            query_header = *header;
+        } else if (!ragfile_minhash_compatible(header->flags, query_header.flags)) {
+            PyErr_SetString(PyExc_ValueError, "queries must all use the same MinHash scheme");
+            free(signatures);
+            Py_DECREF(query_seq);
+            return NULL;
+        } else if (header->tokenizer_id_hash != query_header.tokenizer_id_hash ||
+                   header->embedding_id_hash != query_header.embedding_id_hash) {
+            PyErr_SetString(PyExc_ValueError, "queries must all use the same tokenizer and embedding model");
+            free(signatures);
+            Py_DECREF(query_seq);
+            return NULL;
         }
+        memcpy(signatures + q * MINHASH_SIZE, header->minhash_signature, MINHASH_SIZE * sizeof(uint32_t));
+    }
+    Py_DECREF(query_seq);
 
-        int process_status = process_file(path, self->rf, heap);
-        Py_DECREF(file_path);
-        if (process_status != 0) {
-            PyErr_SetString(PyExc_RuntimeError, "File processing failed");
-            free_min_heap(heap);
+    // A str, bytes or os.PathLike names a directory that is walked natively
+    PyObject* root = NULL;
+    PyObject* path_iter = NULL;
+    if (PyUnicode_Check(paths) || PyBytes_Check(paths) || PyObject_HasAttrString(paths, "__fspath__")) {
+        if (!PyUnicode_FSConverter(paths, &root)) {
+            free(signatures);
             return NULL;
         }
+    } else if (pattern != NULL) {
+        PyErr_SetString(PyExc_TypeError, "pattern is only supported with a directory path");
+        free(signatures);
+        return NULL;
+    } else if ((path_iter = PyObject_GetIter(paths)) == NULL) {
+        free(signatures);
+        return NULL;
     }
 
-    PyObject* result_list = PyList_New(0);
-    if (result_list == NULL) {
-        free_min_heap(heap);
-        PyErr_SetString(PyExc_MemoryError, "Failed to create list");
+    if (match_pool_reserve(threads) < 0) {
+        Py_XDECREF(root);
+        Py_XDECREF(path_iter);
+        free(signatures);
         return NULL;
     }
 
-    // Extract elements from the heap and append them to the Python list
-    while (heap->size > 0) {
-        FileScore min_score = heap->heap[0];  // Get the root, which has the minimum score
-        PyObject* dict = Py_BuildValue("{s:s, s:f}", "file", min_score.path, "jaccard", min_score.score);
-        if (PyList_Append(result_list, dict) == -1) {
-            Py_XDECREF(dict);
-            Py_DECREF(result_list);
-            free_min_heap(heap);
-            PyErr_SetString(PyExc_MemoryError, "Failed to append to list");
-            return NULL;
+    // heaps[worker * num_queries + query]
+    size_t num_heaps = (size_t)threads * (size_t)num_queries;
+    MinHeap** heaps = (MinHeap**)calloc(num_heaps, sizeof(MinHeap*));
+    MinHeap** merged = (MinHeap**)calloc((size_t)num_queries, sizeof(MinHeap*));
+    PyObject* result_list = NULL;
+    int process_status = 0;
+    if (heaps == NULL || merged == NULL) {
+        PyErr_NoMemory();
+        goto cleanup;
+    }
+    for (size_t i = 0; i < num_heaps; i++) {
+        if ((heaps[i] = create_min_heap(top_k)) == NULL) {
+            PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
+            goto cleanup;
         }
-        Py_DECREF(dict);
-        remove_root(heap);  // Remove the root to get the next item
     }
 
-    // Now reverse the list to get it in descending order of score
-    if (PyList_Reverse(result_list) == -1) {
-        Py_DECREF(result_list);
+    if (root != NULL) {
+        const char* root_path = PyBytes_AS_STRING(root);
+        Py_BEGIN_ALLOW_THREADS
+        process_status = process_directory_many(match_pool, match_pool_workers(threads), root_path, pattern,
+                                                signatures, (size_t)num_queries, &query_header, heaps);
+        Py_END_ALLOW_THREADS
+        if (process_status == -4) {
+            PyErr_Format(PyExc_IOError, "Failed to open directory %s", root_path);
+            goto cleanup;
+        }
+    } else {
+        MatchBatch batch;
+        if (match_batch_init(&batch) < 0) {
+            goto cleanup;
+        }
+        int exhausted = 0;
+        while (!exhausted && process_status == 0) {
+            if (match_batch_collect(&batch, path_iter) < 0) {
+                match_batch_free(&batch);
+                goto cleanup;
+            }
+            exhausted = batch.count < MATCH_BATCH_SIZE;
+
+            Py_BEGIN_ALLOW_THREADS
+            process_status = process_files_many(match_pool, match_pool_workers(threads), batch.paths, batch.count,
+                                                signatures, (size_t)num_queries, &query_header, heaps);
+            Py_END_ALLOW_THREADS
+
+            match_batch_release(&batch);
+        }
+        match_batch_free(&batch);
+    }
+
+    if (process_status != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "File processing failed");
+        goto cleanup;
+    }
+
+    result_list = PyList_New(num_queries);
+    if (result_list == NULL) {
+        goto cleanup;
+    }
+    for (Py_ssize_t q = 0; q < num_queries; q++) {
+        merged[q] = create_min_heap(top_k);
+        if (merged[q] == NULL) {
+            PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
+            Py_CLEAR(result_list);
+            goto cleanup;
+        }
+        for (unsigned int w = 0; w < threads; w++) {
+            if (merge_heaps(merged[q], heaps[w * (size_t)num_queries + q]) != 0) {
+                PyErr_SetString(PyExc_MemoryError, "Failed to merge the results");
+                Py_CLEAR(result_list);
+                goto cleanup;
+            }
+        }
+        PyObject* matches = match_heap_to_list(merged[q]);
+        if (matches == NULL) {
+            Py_CLEAR(result_list);
+            goto cleanup;
+        }
+        PyList_SET_ITEM(result_list, q, matches);
+    }
+
+cleanup:
+    if (heaps != NULL) {
+        for (size_t i = 0; i < num_heaps; i++) {
+            if (heaps[i] != NULL) {
+                free_min_heap(heaps[i]);
+            }
+        }
+    }
+    if (merged != NULL) {
+        for (Py_ssize_t q = 0; q < num_queries; q++) {
+            if (merged[q] != NULL) {
+                free_min_heap(merged[q]);
+            }
+        }
+    }
+    free(heaps);
+    free(merged);
+    free(signatures);
+    Py_XDECREF(root);
+    Py_XDECREF(path_iter);
+    return result_list;
+}
+
+PyObject* PyRagFile_match_index(PyRagFile* self, PyObject* args, PyObject* kwds) {
+    const char* index_path;
+    unsigned int top_k;
+    unsigned int threads = 1;
+
+    static char *kwlist[] = {"index_path", "top_k", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sI|I", kwlist, &index_path, &top_k, &threads)) {
+        return NULL;
+    }
+
+    if (top_k == 0) {
+        PyErr_SetString(PyExc_ValueError, "top_k must be greater than 0");
+        return NULL;
+    }
+
+    if (threads == 0) {
+        PyErr_SetString(PyExc_ValueError, "threads must be greater than 0");
+        return NULL;
+    }
+
+    if (match_pool_reserve(threads) < 0) {
+        return NULL;
+    }
+
+    RagIndex* index;
+    RagIndexError error;
+    Py_BEGIN_ALLOW_THREADS
+    error = ragidx_open(&index, index_path);
+    Py_END_ALLOW_THREADS
+    if (error != RAGIDX_SUCCESS) {
+        PyErr_Format(PyExc_IOError, "Failed to open index '%s', error code: %d", index_path, error);
+        return NULL;
+    }
+
+    MatchScan scan;
+    if (match_scan_init(&scan, threads, top_k, 0) < 0) {
+        ragidx_close(index);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    error = ragidx_match(match_pool, match_pool_workers(threads), index, self->rf, scan.heaps);
+    ragidx_close(index);
+    Py_END_ALLOW_THREADS
+
+    MinHeap* heap = create_min_heap(top_k);
+    if (heap == NULL) {
+        match_scan_free(&scan);
+        PyErr_SetString(PyExc_MemoryError, "Failed to create a heap");
+        return NULL;
+    }
+    int merge_status = 0;
+    for (unsigned int i = 0; i < threads && merge_status == 0; i++) {
+        merge_status = merge_heaps(heap, scan.heaps[i]);
+    }
+    match_scan_free(&scan);
+
+    if (error != RAGIDX_SUCCESS) {
+        PyErr_SetString(PyExc_RuntimeError, "Index scan failed");
+        free_min_heap(heap);
+        return NULL;
+    }
+    if (merge_status != 0) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to merge the results");
         free_min_heap(heap);
-        PyErr_SetString(PyExc_RuntimeError, "Failed to reverse the list");
         return NULL;
     }
 
+    PyObject* result_list = match_heap_to_list(heap);
     free_min_heap(heap);
     return result_list;
 }
 
+PyObject* PyRagFile_match_cascade(PyRagFile* self, PyObject* args, PyObject* kwds) {
+    PyObject* file_iter;
+    unsigned int top_k;
+    unsigned int hamming_keep = 1000;
+    unsigned int jaccard_keep = 100;
+    double hamming_weight = 0.0;
+    double jaccard_weight = 0.0;
+    double cosine_weight = 1.0;
+    const char* mode = "max";
+    unsigned int threads = 1;
+
+    static char *kwlist[] = {"file_iter", "top_k", "hamming_keep", "jaccard_keep", "weights", "mode", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OI|II(ddd)sI", kwlist, &file_iter, &top_k, &hamming_keep,
+                                     &jaccard_keep, &hamming_weight, &jaccard_weight, &cosine_weight,
+                                     &mode, &threads)) {
+        return NULL;
+    }
+
+    if (!PyIter_Check(file_iter)) {
+        PyErr_SetString(PyExc_TypeError, "file_iter must be an iterator");
+        return NULL;
+    }
+
+    if (top_k == 0 || top_k > jaccard_keep || jaccard_keep > hamming_keep) {
+        PyErr_SetString(PyExc_ValueError, "Stage sizes must satisfy 0 < top_k <= jaccard_keep <= hamming_keep");
+        return NULL;
+    }
+
+    CosineReduction reduction;
+    if (!parse_cosine_mode(mode, &reduction)) {
+        return NULL;
+    }
+
+    if (threads == 0) {
+        PyErr_SetString(PyExc_ValueError, "threads must be greater than 0");
+        return NULL;
+    }
+
+    if (match_pool_reserve(threads) < 0) {
+        return NULL;
+    }
+
+    CascadeParams params = {
+        .hamming_keep = hamming_keep,
+        .jaccard_keep = jaccard_keep,
+        .top_k = top_k,
+        .hamming_weight = hamming_weight,
+        .jaccard_weight = jaccard_weight,
+        .cosine_weight = cosine_weight,
+        .cosine_mode = reduction == COSINE_REDUCE_MEAN ? CASCADE_COSINE_AVG
+                     : reduction == COSINE_REDUCE_MAXSIM ? CASCADE_COSINE_MAXSIM
+                     : CASCADE_COSINE_MAX,
+    };
+    // Grow the shared pool to the requested size; a worker heap is allocated for each pool thread used
+    size_t num_workers;
+    Py_BEGIN_ALLOW_THREADS
+    num_workers = match_pool_workers(threads);
+    Py_END_ALLOW_THREADS
+    CascadeScan* scan = cascade_scan_create(self->rf, &params, num_workers);
+    if (scan == NULL) {
+        return PyErr_NoMemory();
+    }
+    MatchBatch batch;
+    if (match_batch_init(&batch) < 0) {
+        cascade_scan_free(scan);
+        return NULL;
+    }
+
+    // Hamming prefilter over the headers, batch by batch
+    int process_status = 0;
+    int exhausted = 0;
+    while (!exhausted && process_status == 0) {
+        if (match_batch_collect(&batch, file_iter) < 0) {
+            match_batch_free(&batch);
+            cascade_scan_free(scan);
+            return NULL;
+        }
+        exhausted = batch.count < MATCH_BATCH_SIZE;
+
+        Py_BEGIN_ALLOW_THREADS
+        process_status = cascade_scan_files(scan, match_pool_get(threads), batch.paths, batch.count);
+        Py_END_ALLOW_THREADS
+
+        match_batch_release(&batch);
+    }
+    match_batch_free(&batch);
+
+    // The cosine rerank needs the query's own embeddings, which a lazily opened file has not read yet
+    if (process_status == 0 && PyRagFile_load_sections(self, RAGFILE_SECTION_EMBEDDINGS) < 0) {
+        cascade_scan_free(scan);
+        return NULL;
+    }
+
+    // Jaccard and cosine stages over the survivors
+    CascadeResult* results = NULL;
+    size_t num_results = 0;
+    if (process_status == 0) {
+        Py_BEGIN_ALLOW_THREADS
+        process_status = cascade_scan_finish(scan, match_pool_get(threads), &results, &num_results);
+        Py_END_ALLOW_THREADS
+    }
+    cascade_scan_free(scan);
+
+    if (process_status == -3) {
+        return PyErr_NoMemory();
+    }
+    if (process_status == -4) {
+        PyErr_SetString(PyExc_ValueError, "The query RagFile has no embeddings loaded");
+        return NULL;
+    }
+    if (process_status != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "File processing failed");
+        return NULL;
+    }
+
+    PyObject* result_list = PyList_New(num_results);
+    if (result_list == NULL) {
+        cascade_results_free(results, num_results);
+        return NULL;
+    }
+    for (size_t i = 0; i < num_results; i++) {
+        PyObject* dict = Py_BuildValue("{s:s, s:d, s:d, s:d, s:d}", "file", results[i].path,
+                                       "hamming", results[i].hamming, "jaccard", results[i].jaccard,
+                                       "cosine", results[i].cosine, "score", results[i].score);
+        if (dict == NULL) {
+            Py_DECREF(result_list);
+            cascade_results_free(results, num_results);
+            return NULL;
+        }
+        PyList_SET_ITEM(result_list, i, dict);
+    }
+
+    cascade_results_free(results, num_results);
+    return result_list;
+}
@@ -3,11 +3,28 @@
 
 #include <Python.h>
 #include "pyragfile.h"
+#include "../search/heap.h"
+#include "../utils/thread_pool.h"
 
 PyObject* PyRagFile_jaccard(PyRagFile* self, PyObject* args);
 PyObject* PyRagFile_hamming(PyRagFile* self, PyObject* args);
 PyObject* PyRagFile_cosine(PyRagFile* self, PyObject* args);
+PyObject* PyRagFile_cosine_many(PyRagFile* self, PyObject* args, PyObject* kwds);
 PyObject* PyRagFile_match(PyRagFile* self, PyObject* args, PyObject* kwds);
+PyObject* PyRagFile_match_index(PyRagFile* self, PyObject* args, PyObject* kwds);
+PyObject* PyRagFile_match_cascade(PyRagFile* self, PyObject* args, PyObject* kwds);
+
+// Module level ragfile.match_many(queries, paths, top_k, threads=1, pattern=None)
+PyObject* ragfile_match_many(PyObject* self, PyObject* args, PyObject* kwds);
+
+// Worker pool shared by the functions that take threads=; reserve it with the GIL held,
+// then size the run with match_pool_workers without it. match_pool_get is NULL for one thread.
+int match_pool_reserve(unsigned int threads);
+size_t match_pool_workers(unsigned int threads);
+ThreadPool* match_pool_get(unsigned int threads);
+
+// Drain a heap into a list of {"file", "jaccard"} dicts in descending order of score
+PyObject* match_heap_to_list(MinHeap* heap);
 
 #endif // SIMILARITY_H
 
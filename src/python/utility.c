@@ -1,9 +1,218 @@
 #include "utility.h"
+#include "../include/config.h"
+
+typedef enum {
+    ITEM_UNSUPPORTED = 0,
+    ITEM_SIGNED,
+    ITEM_UNSIGNED,
+    ITEM_FLOAT
+} ItemKind;
+
+// Classify the items of a buffer from its struct module format, accepting native byte order only
+static ItemKind buffer_item_kind(const Py_buffer* view) {
+    const char* format = view->format ? view->format : "B";
+    const uint16_t probe = 1;
+    char native_order = *(const uint8_t*)&probe == 1 ? '<' : '>';
+    if (format[0] == '@' || format[0] == '=' || format[0] == native_order) {
+        format++;
+    }
+    if (format[0] == '\0' || format[1] != '\0') {
+        return ITEM_UNSUPPORTED;
+    }
+    switch (format[0]) {
+        case 'b': case 'h': case 'i': case 'l': case 'q': case 'n':
+            return ITEM_SIGNED;
+        case 'B': case 'H': case 'I': case 'L': case 'Q': case 'N':
+            return ITEM_UNSIGNED;
+        case 'f': case 'd':
+            return ITEM_FLOAT;
+        default:
+            return ITEM_UNSUPPORTED;
+    }
+}
+
+// Read an integer item of any size, reporting whether it is negative
+static uint64_t read_integer(const char* item, Py_ssize_t itemsize, int is_signed, int* negative) {
+    int64_t value = 0;
+    if (itemsize == 1) {
+        value = is_signed ? (int64_t)*(const int8_t*)item : (int64_t)*(const uint8_t*)item;
+    } else if (itemsize == 2) {
+        int16_t v;
+        uint16_t u;
+        memcpy(&v, item, 2);
+        memcpy(&u, item, 2);
+        value = is_signed ? (int64_t)v : (int64_t)u;
+    } else if (itemsize == 4) {
+        int32_t v;
+        uint32_t u;
+        memcpy(&v, item, 4);
+        memcpy(&u, item, 4);
+        value = is_signed ? (int64_t)v : (int64_t)u;
+    } else {
+        uint64_t u;
+        memcpy(&u, item, 8);
+        *negative = is_signed && (int64_t)u < 0;
+        return u;
+    }
+    *negative = value < 0;
+    return (uint64_t)value;
+}
+
+static int get_contiguous_buffer(PyObject* obj, PreparedArray* array, const char* name) {
+    if (PyObject_GetBuffer(obj, &array->view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        if (PyErr_ExceptionMatches(PyExc_BufferError)) {
+            PyErr_Format(PyExc_TypeError, "%s must be a C-contiguous buffer", name);
+        }
+        return 0;
+    }
+    array->has_view = 1;
+    return 1;
+}
+
+void release_prepared(PreparedArray* array) {
+    if (array->has_view) {
+        PyBuffer_Release(&array->view);
+        array->has_view = 0;
+    }
+    free(array->owned);
+    array->owned = NULL;
+    array->data = NULL;
+}
+
+static int prepare_token_ids_from_buffer(PyObject* token_ids_obj, PreparedArray* token_ids, size_t* num_tokens) {
+    if (!get_contiguous_buffer(token_ids_obj, token_ids, "token_ids")) {
+        return 0;
+    }
+    const Py_buffer* view = &token_ids->view;
+    ItemKind kind = buffer_item_kind(view);
+    if (view->ndim != 1 || (kind != ITEM_SIGNED && kind != ITEM_UNSIGNED) ||
+        (view->itemsize != 1 && view->itemsize != 2 && view->itemsize != 4 && view->itemsize != 8)) {
+        release_prepared(token_ids);
+        PyErr_SetString(PyExc_TypeError, "token_ids must be a 1-D buffer of integers");
+        return 0;
+    }
+    *num_tokens = (size_t)view->shape[0];
+
+    // Aligned uint32 token IDs are passed through untouched
+    if (kind == ITEM_UNSIGNED && view->itemsize == 4 && (uintptr_t)view->buf % _Alignof(uint32_t) == 0) {
+        token_ids->data = view->buf;
+        return 1;
+    }
+
+    uint32_t* converted = (uint32_t*)malloc((*num_tokens ? *num_tokens : 1) * sizeof(uint32_t));
+    if (!converted) {
+        release_prepared(token_ids);
+        PyErr_NoMemory();
+        return 0;
+    }
+    const char* item = (const char*)view->buf;
+    for (size_t i = 0; i < *num_tokens; i++, item += view->itemsize) {
+        int negative;
+        uint64_t value = read_integer(item, view->itemsize, kind == ITEM_SIGNED, &negative);
+        if (negative || value > UINT32_MAX) {
+            free(converted);
+            release_prepared(token_ids);
+            PyErr_SetString(PyExc_ValueError, "Token IDs must fit in an unsigned 32-bit integer");
+            return 0;
+        }
+        converted[i] = (uint32_t)value;
+    }
+    token_ids->owned = converted;
+    token_ids->data = converted;
+    return 1;
+}
+
+int prepare_token_ids(PyObject* token_ids_obj, PreparedArray* token_ids, size_t* num_tokens) {
+    memset(token_ids, 0, sizeof(PreparedArray));
+    if (!PyList_Check(token_ids_obj)) {
+        if (PyObject_CheckBuffer(token_ids_obj)) {
+            return prepare_token_ids_from_buffer(token_ids_obj, token_ids, num_tokens);
+        }
+        PyErr_SetString(PyExc_TypeError, "token_ids must be a list of integers or an integer buffer");
+        return 0;
+    }
+
+    *num_tokens = PyList_Size(token_ids_obj);
+    uint32_t* converted = (uint32_t*)malloc((*num_tokens ? *num_tokens : 1) * sizeof(uint32_t));
+    if (!converted) {
+        PyErr_NoMemory();
+        return 0;
+    }
+    for (size_t i = 0; i < *num_tokens; i++) {
+        PyObject* item = PyList_GetItem(token_ids_obj, i);
+        if (!PyLong_Check(item)) {
+            free(converted);
+            PyErr_SetString(PyExc_TypeError, "Token IDs must be integers");
+            return 0;
+        }
+        converted[i] = (uint32_t)PyLong_AsUnsignedLong(item);
+    }
+    token_ids->owned = converted;
+    token_ids->data = converted;
+    return 1;
+}
+
+static int prepare_embeddings_from_buffer(PyObject* embeddings_obj, PreparedArray* flattened, size_t* total_floats, uint32_t* num_embeddings, uint32_t* embedding_dim) {
+    if (!get_contiguous_buffer(embeddings_obj, flattened, "embeddings")) {
+        return 0;
+    }
+    const Py_buffer* view = &flattened->view;
+    if ((view->ndim != 1 && view->ndim != 2) || buffer_item_kind(view) != ITEM_FLOAT) {
+        release_prepared(flattened);
+        PyErr_SetString(PyExc_TypeError, "embeddings must be a 1-D or 2-D buffer of floats");
+        return 0;
+    }
+
+    // A 1-D buffer is a single embedding
+    *num_embeddings = view->ndim == 2 ? (uint32_t)view->shape[0] : 1;
+    *embedding_dim = (uint32_t)view->shape[view->ndim - 1];
+    if (*num_embeddings == 0 || *embedding_dim == 0) {
+        release_prepared(flattened);
+        PyErr_SetString(PyExc_ValueError, "embeddings list cannot be empty");
+        return 0;
+    }
+    if (view->shape[0] > UINT16_MAX || view->shape[view->ndim - 1] > UINT16_MAX) {
+        release_prepared(flattened);
+        PyErr_SetString(PyExc_ValueError, "Too many embeddings or embedding dimensions");
+        return 0;
+    }
+    *total_floats = (size_t)*num_embeddings * *embedding_dim;
+
+    // Aligned float32 embeddings are passed through untouched
+    if (view->itemsize == sizeof(float) && (uintptr_t)view->buf % _Alignof(float) == 0) {
+        flattened->data = view->buf;
+        return 1;
+    }
+
+    float* converted = (float*)malloc(*total_floats * sizeof(float));
+    if (!converted) {
+        release_prepared(flattened);
+        PyErr_NoMemory();
+        return 0;
+    }
+    const char* item = (const char*)view->buf;
+    for (size_t i = 0; i < *total_floats; i++, item += view->itemsize) {
+        if (view->itemsize == sizeof(double)) {
+            double value;
+            memcpy(&value, item, sizeof(double));
+            converted[i] = (float)value;
+        } else {
+            memcpy(&converted[i], item, sizeof(float));
+        }
+    }
+    flattened->owned = converted;
+    flattened->data = converted;
+    return 1;
+}
 
 // Validate embeddings and tokens, and prepare the embeddings array
-int prepare_embeddings(PyObject* embeddings_obj, float** flattened, size_t* total_floats, uint32_t* num_embeddings, uint32_t* embedding_dim) {
+int prepare_embeddings(PyObject* embeddings_obj, PreparedArray* flattened, size_t* total_floats, uint32_t* num_embeddings, uint32_t* embedding_dim) {
+    memset(flattened, 0, sizeof(PreparedArray));
     if (!PyList_Check(embeddings_obj)) {
-        PyErr_SetString(PyExc_TypeError, "embeddings must be a list of lists of floats");
+        if (PyObject_CheckBuffer(embeddings_obj)) {
+            return prepare_embeddings_from_buffer(embeddings_obj, flattened, total_floats, num_embeddings, embedding_dim);
+        }
+        PyErr_SetString(PyExc_TypeError, "embeddings must be a list of lists of floats or a float buffer");
         return 0;
     }
 
@@ -22,30 +231,61 @@ int prepare_embeddings(PyObject* embeddings_obj, float** flattened, size_t* tota
 
     *embedding_dim = PyList_Size(first_emb);
     *total_floats = *num_embeddings * *embedding_dim;
-    *flattened = (float*)malloc(*total_floats * sizeof(float));
-    if (*flattened == NULL) {
+    float* converted = (float*)malloc(*total_floats * sizeof(float));
+    if (converted == NULL) {
         PyErr_NoMemory();
         return 0;
     }
 
-    float* ptr = *flattened;
+    float* ptr = converted;
     for (Py_ssize_t i = 0; i < *num_embeddings; i++) {
         PyObject* emb_list = PyList_GetItem(embeddings_obj, i);
         if (!PyList_Check(emb_list) || PyList_Size(emb_list) != *embedding_dim) {
             PyErr_SetString(PyExc_TypeError, "All embeddings must be lists of floats of the same length");
-            free(*flattened);
+            free(converted);
             return 0;
         }
         for (Py_ssize_t j = 0; j < *embedding_dim; j++) {
             PyObject* float_obj = PyList_GetItem(emb_list, j);
             if (!PyFloat_Check(float_obj)) {
                 PyErr_SetString(PyExc_TypeError, "Embedding values must be floats");
-                free(*flattened);
+                free(converted);
                 return 0;
             }
             *ptr++ = (float)PyFloat_AsDouble(float_obj);
         }
     }
+    flattened->owned = converted;
+    flattened->data = converted;
     return 1;
 }
 
+int parse_minhash_scheme(const char* name, uint16_t* flags) {
+    if (name == NULL || strcmp(name, "classic") == 0) {
+        *flags = 0;
+        return 1;
+    }
+    if (strcmp(name, "oph") == 0) {
+        *flags = RAGFILE_FLAG_MINHASH_OPH;
+        return 1;
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown MinHash scheme '%s', expected 'classic' or 'oph'", name);
+    return 0;
+}
+
+int parse_cosine_mode(const char* name, CosineReduction* reduction) {
+    if (strcmp(name, "max") == 0) {
+        *reduction = COSINE_REDUCE_MAX;
+        return 1;
+    }
+    if (strcmp(name, "avg") == 0) {
+        *reduction = COSINE_REDUCE_MEAN;
+        return 1;
+    }
+    if (strcmp(name, "maxsim") == 0) {
+        *reduction = COSINE_REDUCE_MAXSIM;
+        return 1;
+    }
+    PyErr_Format(PyExc_ValueError, "Unknown cosine mode '%s', expected 'max', 'avg' or 'maxsim'", name);
+    return 0;
+}
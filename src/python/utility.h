@@ -2,8 +2,53 @@
 #define UTILITY_H
 
 #include <Python.h>
+#include <stdint.h>
+#include "../algorithms/cosine.h"
 
-int prepare_embeddings(PyObject* embeddings_obj, float** flattened, size_t* total_floats, uint32_t* num_embeddings, uint32_t* embedding_dim);
+// An array handed to the C library, borrowed from a Python buffer when its layout already matches
+typedef struct {
+    const void* data;
+    void* owned;        // Converted copy, or NULL when data points into view
+    Py_buffer view;
+    int has_view;
+} PreparedArray;
 
-#endif // UTILITY_H
+/**
+ * Convert token IDs to uint32. A list of ints is converted item by item; a
+ * C-contiguous 1-D integer buffer (e.g. a uint32 or int64 array) is borrowed
+ * when it is already aligned uint32, and converted in C otherwise.
+ *
+ * @return 1 on success, 0 with an exception set on failure.
+ */
+int prepare_token_ids(PyObject* token_ids_obj, PreparedArray* token_ids, size_t* num_tokens);
+
+/**
+ * Flatten embeddings to float32. Accepts a list of lists of floats, or a
+ * C-contiguous float buffer of shape (num_embeddings, embedding_dim) or
+ * (embedding_dim,) that is borrowed when it is aligned float32 and converted
+ * from float64 otherwise.
+ *
+ * @return 1 on success, 0 with an exception set on failure.
+ */
+int prepare_embeddings(PyObject* embeddings_obj, PreparedArray* flattened, size_t* total_floats, uint32_t* num_embeddings, uint32_t* embedding_dim);
+
+/**
+ * Map a MinHash scheme name ("classic" or "oph", NULL meaning "classic") to
+ * RagfileHeader flags.
+ *
+ * @return 1 on success, 0 with a ValueError set for an unknown name.
+ */
+int parse_minhash_scheme(const char* name, uint16_t* flags);
 
+/**
+ * Map a cosine mode name ("max", "avg" or "maxsim") to the reduction of the
+ * similarities of every pair of embeddings.
+ *
+ * @return 1 on success, 0 with a ValueError set for an unknown name.
+ */
+int parse_cosine_mode(const char* name, CosineReduction* reduction);
+
+// Release the buffer or free the copy behind a PreparedArray
+void release_prepared(PreparedArray* array);
+
+#endif // UTILITY_H
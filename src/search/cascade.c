@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "cascade.h"
+#include "scan.h"
+#include "../utils/file_io.h"
+#include "../utils/strdup.h"
+#include "../algorithms/hamming.h"
+#include "../algorithms/jaccard.h"
+#include "../algorithms/cosine.h"
+
+typedef struct {
+    char* path;
+    double hamming;
+    double jaccard;
+    uint32_t signature[MINHASH_SIZE];
+} CascadeCandidate;
+
+#define CASCADE_INITIAL_CANDIDATES 64  // Candidates allocated per worker before the first file is read
+
+// Hamming survivors of one worker: a min-heap of indices into a candidate array that grows up to hamming_keep
+typedef struct {
+    CascadeCandidate* candidates;
+    size_t* heap;
+    size_t size;
+    size_t capacity;     // Allocated candidates
+} CascadeWorker;
+
+struct CascadeScan {
+    const RagFile* referenceRagFile;
+    CascadeParams params;
+    size_t num_workers;
+    CascadeWorker* workers;
+};
+
+typedef struct {
+    CascadeScan* scan;
+    const char* const* file_paths;
+    size_t count;
+    atomic_size_t next;  // Index of the next unclaimed path
+    atomic_int status;   // First non-zero status reported by a worker
+} CascadeJob;
+
+typedef struct {
+    const RagFile* referenceRagFile;
+    const float* reference_norms;  // NULL when the reference embeddings are normalized
+    CascadeCosineMode cosine_mode;
+    CascadeResult* results;
+    bool* valid;         // False for candidates whose embeddings cannot be compared
+    size_t count;
+    atomic_size_t next;
+    atomic_int status;
+} CascadeRerankJob;
+
+static void cascade_record_status(atomic_int* status, int value) {
+    int expected = 0;
+    atomic_compare_exchange_strong(status, &expected, value);
+}
+
+// Hamming ties at the hamming_keep cut are common, so candidates are ordered on (hamming, path) as in
+// cascade_compare_hamming; the files kept at the cut then do not depend on how the paths were split between workers
+static bool cascade_ranks_below(double hamming, const char* path, double other_hamming, const char* other_path) {
+    return hamming < other_hamming || (hamming == other_hamming && strcmp(path, other_path) > 0);
+}
+
+static bool cascade_worker_less(const CascadeWorker* worker, size_t a, size_t b) {
+    const CascadeCandidate* x = &worker->candidates[worker->heap[a]];
+    const CascadeCandidate* y = &worker->candidates[worker->heap[b]];
+    return cascade_ranks_below(x->hamming, x->path, y->hamming, y->path);
+}
+
+static void cascade_worker_swap(CascadeWorker* worker, size_t a, size_t b) {
+    size_t temp = worker->heap[a];
+    worker->heap[a] = worker->heap[b];
+    worker->heap[b] = temp;
+}
+
+static void cascade_worker_sift_down(CascadeWorker* worker, size_t i) {
+    for (;;) {
+        size_t smallest = i;
+        size_t left = 2 * i + 1;
+        size_t right = 2 * i + 2;
+        if (left < worker->size && cascade_worker_less(worker, left, smallest)) {
+            smallest = left;
+        }
+        if (right < worker->size && cascade_worker_less(worker, right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        cascade_worker_swap(worker, i, smallest);
+        i = smallest;
+    }
+}
+
+// Double the candidate array, without exceeding limit candidates
+static int cascade_worker_grow(CascadeWorker* worker, size_t limit) {
+    size_t capacity = worker->capacity * 2 < limit ? worker->capacity * 2 : limit;
+    CascadeCandidate* candidates = (CascadeCandidate*)realloc(worker->candidates, capacity * sizeof(CascadeCandidate));
+    if (!candidates) {
+        return -1;
+    }
+    worker->candidates = candidates;
+    size_t* heap = (size_t*)realloc(worker->heap, capacity * sizeof(size_t));
+    if (!heap) {
+        return -1;
+    }
+    worker->heap = heap;
+    worker->capacity = capacity;
+    return 0;
+}
+
+// Keep the header if it is among the hamming_keep best seen by this worker
+static int cascade_worker_offer(CascadeWorker* worker, size_t limit, const char* path,
+                                double hamming, const RagfileHeader* header) {
+    CascadeCandidate* candidate;
+    if (worker->size < limit) {
+        if (worker->size == worker->capacity && cascade_worker_grow(worker, limit) != 0) {
+            return -1;
+        }
+        char* copy = strdup(path);
+        if (!copy) {
+            return -1;
+        }
+        size_t i = worker->size++;
+        worker->heap[i] = i;
+        candidate = &worker->candidates[i];
+        candidate->path = copy;
+        candidate->hamming = hamming;
+        memcpy(candidate->signature, header->minhash_signature, sizeof(candidate->signature));
+        while (i > 0 && cascade_worker_less(worker, i, (i - 1) / 2)) {
+            cascade_worker_swap(worker, i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+        return 0;
+    }
+
+    candidate = &worker->candidates[worker->heap[0]];
+    if (!cascade_ranks_below(candidate->hamming, candidate->path, hamming, path)) {
+        return 0;
+    }
+    char* copy = strdup(path);
+    if (!copy) {
+        return -1;
+    }
+    free(candidate->path);
+    candidate->path = copy;
+    candidate->hamming = hamming;
+    memcpy(candidate->signature, header->minhash_signature, sizeof(candidate->signature));
+    cascade_worker_sift_down(worker, 0);
+    return 0;
+}
+
+CascadeScan* cascade_scan_create(const RagFile* referenceRagFile, const CascadeParams* params, size_t num_workers) {
+    if (!referenceRagFile || !params || num_workers == 0 || params->top_k == 0 ||
+        params->top_k > params->jaccard_keep || params->jaccard_keep > params->hamming_keep) {
+        return NULL;
+    }
+
+    CascadeScan* scan = (CascadeScan*)calloc(1, sizeof(CascadeScan));
+    if (!scan) {
+        return NULL;
+    }
+    scan->referenceRagFile = referenceRagFile;
+    scan->params = *params;
+    scan->num_workers = num_workers;
+    scan->workers = (CascadeWorker*)calloc(num_workers, sizeof(CascadeWorker));
+    if (!scan->workers) {
+        free(scan);
+        return NULL;
+    }
+
+    // Each candidate carries a copy of its signature, so the arrays grow with the survivors rather than
+    // reserving hamming_keep of them per worker up front
+    size_t initial = params->hamming_keep < CASCADE_INITIAL_CANDIDATES ? params->hamming_keep : CASCADE_INITIAL_CANDIDATES;
+    for (size_t i = 0; i < num_workers; i++) {
+        scan->workers[i].candidates = (CascadeCandidate*)malloc(initial * sizeof(CascadeCandidate));
+        scan->workers[i].heap = (size_t*)malloc(initial * sizeof(size_t));
+        scan->workers[i].capacity = initial;
+        if (!scan->workers[i].candidates || !scan->workers[i].heap) {
+            cascade_scan_free(scan);
+            return NULL;
+        }
+    }
+
+    return scan;
+}
+
+void cascade_scan_free(CascadeScan* scan) {
+    if (!scan) {
+        return;
+    }
+    for (size_t i = 0; i < scan->num_workers; i++) {
+        CascadeWorker* worker = &scan->workers[i];
+        for (size_t j = 0; j < worker->size; j++) {
+            free(worker->candidates[j].path);
+        }
+        free(worker->candidates);
+        free(worker->heap);
+    }
+    free(scan->workers);
+    free(scan);
+}
+
+void cascade_results_free(CascadeResult* results, size_t count) {
+    if (!results) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        free(results[i].path);
+    }
+    free(results);
+}
+
+static void cascade_scan_worker(void* ctx, size_t worker_index) {
+    CascadeJob* job = (CascadeJob*)ctx;
+    CascadeScan* scan = job->scan;
+    CascadeWorker* worker = &scan->workers[worker_index];
+    const RagfileHeader* reference = &scan->referenceRagFile->header;
+
+    while (atomic_load_explicit(&job->status, memory_order_relaxed) == 0) {
+        size_t start = atomic_fetch_add_explicit(&job->next, SCAN_CHUNK_SIZE, memory_order_relaxed);
+        if (start >= job->count) {
+            break;
+        }
+        size_t end = start + SCAN_CHUNK_SIZE < job->count ? start + SCAN_CHUNK_SIZE : job->count;
+
+        for (size_t i = start; i < end; i++) {
+            RagfileHeader header;
+            FileIOError error = read_ragfile_header_at(job->file_paths[i], &header, SCAN_ADVISE_RANDOM);
+            if (error != FILE_IO_SUCCESS) {
+                cascade_record_status(&job->status, error == FILE_IO_ERROR_OPEN ? -1 : -2);
+                return;
+            }
+
+            // Scores are meaningless across tokenizers, embedding models and MinHash schemes
+            if (header.tokenizer_id_hash != reference->tokenizer_id_hash ||
+                header.embedding_id_hash != reference->embedding_id_hash ||
+                !ragfile_minhash_compatible(header.flags, reference->flags)) {
+                continue;
+            }
+
+            double hamming = hamming_similarity(reference->binary_embedding, header.binary_embedding,
+                                                BINARY_EMBEDDING_BYTE_DIM);
+            if (cascade_worker_offer(worker, scan->params.hamming_keep, job->file_paths[i], hamming, &header) != 0) {
+                cascade_record_status(&job->status, -3);
+                return;
+            }
+        }
+    }
+}
+
+int cascade_scan_files(CascadeScan* scan, ThreadPool* pool, const char* const* file_paths, size_t count) {
+    if (!scan || !file_paths) {
+        return -3;  // Invalid arguments
+    }
+
+    CascadeJob job = {
+        .scan = scan,
+        .file_paths = file_paths,
+        .count = count,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.status, 0);
+
+    size_t num_workers = scan->num_workers;
+    if (pool && num_workers > thread_pool_size(pool)) {
+        num_workers = thread_pool_size(pool);
+    }
+    if (pool == NULL || num_workers <= 1) {
+        cascade_scan_worker(&job, 0);
+    } else {
+        thread_pool_run(pool, cascade_scan_worker, &job, num_workers);
+    }
+
+    return atomic_load(&job.status);
+}
+
+// Descending order; ties are broken on the path so results do not depend on the number of workers
+static int cascade_compare_hamming(const void* a, const void* b) {
+    const CascadeCandidate* x = *(const CascadeCandidate* const*)a;
+    const CascadeCandidate* y = *(const CascadeCandidate* const*)b;
+    if (x->hamming != y->hamming) {
+        return x->hamming < y->hamming ? 1 : -1;
+    }
+    return strcmp(x->path, y->path);
+}
+
+static int cascade_compare_jaccard(const void* a, const void* b) {
+    const CascadeCandidate* x = *(const CascadeCandidate* const*)a;
+    const CascadeCandidate* y = *(const CascadeCandidate* const*)b;
+    if (x->jaccard != y->jaccard) {
+        return x->jaccard < y->jaccard ? 1 : -1;
+    }
+    if (x->hamming != y->hamming) {
+        return x->hamming < y->hamming ? 1 : -1;
+    }
+    return strcmp(x->path, y->path);
+}
+
+static int cascade_compare_score(const void* a, const void* b) {
+    const CascadeResult* x = (const CascadeResult*)a;
+    const CascadeResult* y = (const CascadeResult*)b;
+    if (x->score != y->score) {
+        return x->score < y->score ? 1 : -1;
+    }
+    return strcmp(x->path, y->path);
+}
+
+// Cosine similarity between the embeddings of two RagFiles, reduced over all pairs as the mode asks
+static int cascade_cosine(const RagFile* a, const float* norms_a, const RagFile* b, CascadeCosineMode mode,
+                          double* similarity) {
+    float* norms_b;
+    if (ragfile_embedding_norms(b, &norms_b) != RAGFILE_SUCCESS) {
+        return -1;
+    }
+
+    CosineReduction reduction = mode == CASCADE_COSINE_AVG ? COSINE_REDUCE_MEAN
+                              : mode == CASCADE_COSINE_MAXSIM ? COSINE_REDUCE_MAXSIM
+                              : COSINE_REDUCE_MAX;
+    *similarity = cosine_similarity_reduce(a->embeddings, norms_a, a->file_metadata.num_embeddings,
+                                           b->embeddings, norms_b, b->file_metadata.num_embeddings,
+                                           a->file_metadata.embedding_dim, reduction);
+    free(norms_b);
+    return 0;
+}
+
+static void cascade_rerank_worker(void* ctx, size_t worker) {
+    (void)worker;
+    CascadeRerankJob* job = (CascadeRerankJob*)ctx;
+
+    while (atomic_load_explicit(&job->status, memory_order_relaxed) == 0) {
+        size_t i = atomic_fetch_add_explicit(&job->next, 1, memory_order_relaxed);
+        if (i >= job->count) {
+            break;
+        }
+
+        // Only the embeddings are read; the text and extended metadata never leave the disk
+        RagFile* rf;
+        if (ragfile_open_lazy(&rf, job->results[i].path) != RAGFILE_SUCCESS) {
+            cascade_record_status(&job->status, -1);
+            return;
+        }
+
+        job->valid[i] = rf->file_metadata.embedding_dim == job->referenceRagFile->file_metadata.embedding_dim;
+        if (job->valid[i]) {
+            if (ragfile_load_section(rf, RAGFILE_SECTION_EMBEDDINGS) != RAGFILE_SUCCESS) {
+                ragfile_free(rf);
+                cascade_record_status(&job->status, -1);
+                return;
+            }
+            if (cascade_cosine(job->referenceRagFile, job->reference_norms, rf, job->cosine_mode,
+                               &job->results[i].cosine) != 0) {
+                ragfile_free(rf);
+                cascade_record_status(&job->status, -3);
+                return;
+            }
+        }
+        ragfile_free(rf);
+    }
+}
+
+int cascade_scan_finish(CascadeScan* scan, ThreadPool* pool, CascadeResult** results, size_t* num_results) {
+    if (!scan || !results || !num_results) {
+        return -3;
+    }
+    *results = NULL;
+    *num_results = 0;
+
+    // Hamming stage: keep the best hamming_keep over all workers
+    size_t total = 0;
+    for (size_t i = 0; i < scan->num_workers; i++) {
+        total += scan->workers[i].size;
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    CascadeCandidate** candidates = (CascadeCandidate**)malloc(total * sizeof(CascadeCandidate*));
+    if (!candidates) {
+        return -3;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < scan->num_workers; i++) {
+        for (size_t j = 0; j < scan->workers[i].size; j++) {
+            candidates[count++] = &scan->workers[i].candidates[j];
+        }
+    }
+    qsort(candidates, count, sizeof(CascadeCandidate*), cascade_compare_hamming);
+    if (count > scan->params.hamming_keep) {
+        count = scan->params.hamming_keep;
+    }
+
+    // Jaccard stage: rank the survivors on their signatures, keep jaccard_keep
+    const uint32_t* reference = scan->referenceRagFile->header.minhash_signature;
+    for (size_t i = 0; i < count; i++) {
+        candidates[i]->jaccard = jaccard_similarity(reference, candidates[i]->signature);
+    }
+    qsort(candidates, count, sizeof(CascadeCandidate*), cascade_compare_jaccard);
+    if (count > scan->params.jaccard_keep) {
+        count = scan->params.jaccard_keep;
+    }
+
+    CascadeResult* reranked = (CascadeResult*)calloc(count, sizeof(CascadeResult));
+    bool* valid = (bool*)calloc(count, sizeof(bool));
+    if (!reranked || !valid) {
+        free(reranked);
+        free(valid);
+        free(candidates);
+        return -3;
+    }
+    for (size_t i = 0; i < count; i++) {
+        reranked[i].path = candidates[i]->path;
+        reranked[i].hamming = candidates[i]->hamming;
+        reranked[i].jaccard = candidates[i]->jaccard;
+        candidates[i]->path = NULL;  // Owned by the results from here on
+    }
+    free(candidates);
+
+    // Cosine stage: only the Jaccard survivors are loaded from disk, and the reference norms are computed once
+    if (count > 0 && scan->referenceRagFile->embeddings == NULL) {
+        free(valid);
+        cascade_results_free(reranked, count);
+        return -4;
+    }
+    float* reference_norms = NULL;
+    if (count > 0 && ragfile_embedding_norms(scan->referenceRagFile, &reference_norms) != RAGFILE_SUCCESS) {
+        free(valid);
+        cascade_results_free(reranked, count);
+        return -3;
+    }
+    CascadeRerankJob job = {
+        .referenceRagFile = scan->referenceRagFile,
+        .reference_norms = reference_norms,
+        .cosine_mode = scan->params.cosine_mode,
+        .results = reranked,
+        .valid = valid,
+        .count = count,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.status, 0);
+
+    size_t num_workers = scan->num_workers < count ? scan->num_workers : count;
+    if (pool && num_workers > thread_pool_size(pool)) {
+        num_workers = thread_pool_size(pool);
+    }
+    if (pool == NULL || num_workers <= 1) {
+        cascade_rerank_worker(&job, 0);
+    } else {
+        thread_pool_run(pool, cascade_rerank_worker, &job, num_workers);
+    }
+    free(reference_norms);
+
+    int status = atomic_load(&job.status);
+    if (status != 0) {
+        free(valid);
+        cascade_results_free(reranked, count);
+        return status;
+    }
+
+    // Fuse the stage scores, dropping candidates with incompatible embeddings. A MaxSim sum grows with the
+    // number of reference embeddings, so it is averaged to keep the weights on the same scale for every query
+    uint16_t num_embeddings = scan->referenceRagFile->file_metadata.num_embeddings;
+    double cosine_scale = scan->params.cosine_mode == CASCADE_COSINE_MAXSIM && num_embeddings > 0
+                              ? 1.0 / num_embeddings : 1.0;
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!valid[i]) {
+            free(reranked[i].path);
+            continue;
+        }
+        reranked[i].score = scan->params.hamming_weight * reranked[i].hamming +
+                            scan->params.jaccard_weight * reranked[i].jaccard +
+                            scan->params.cosine_weight * cosine_scale * reranked[i].cosine;
+        reranked[kept++] = reranked[i];
+    }
+    free(valid);
+
+    qsort(reranked, kept, sizeof(CascadeResult), cascade_compare_score);
+    for (size_t i = scan->params.top_k; i < kept; i++) {
+        free(reranked[i].path);
+    }
+    if (kept > scan->params.top_k) {
+        kept = scan->params.top_k;
+    }
+
+    *results = reranked;
+    *num_results = kept;
+    return 0;
+}
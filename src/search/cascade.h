@@ -0,0 +1,97 @@
+#ifndef CASCADE_H
+#define CASCADE_H
+
+#include "../core/ragfile.h"
+#include "../utils/thread_pool.h"
+#include <stddef.h>
+
+typedef enum {
+    CASCADE_COSINE_MAX = 0,  // Best pair of embeddings
+    CASCADE_COSINE_AVG,      // Mean over all pairs of embeddings
+    CASCADE_COSINE_MAXSIM    // Sum over the reference embeddings of their best match (late interaction)
+} CascadeCosineMode;
+
+/**
+ * Stage sizes and score fusion weights of a cascaded query. Every file is
+ * first ranked on the Hamming similarity of its header bits, the best
+ * hamming_keep are re-ranked on MinHash Jaccard, and only the best
+ * jaccard_keep are loaded for a float cosine rerank. The final score is
+ * hamming_weight * hamming + jaccard_weight * jaccard + cosine_weight * cosine,
+ * where a CASCADE_COSINE_MAXSIM cosine is first divided by the number of
+ * reference embeddings.
+ */
+typedef struct {
+    size_t hamming_keep;    // N1: survivors of the Hamming prefilter
+    size_t jaccard_keep;    // N2: survivors of the Jaccard stage (files loaded for cosine)
+    size_t top_k;           // Results returned
+    double hamming_weight;
+    double jaccard_weight;
+    double cosine_weight;
+    CascadeCosineMode cosine_mode;
+} CascadeParams;
+
+typedef struct {
+    char* path;
+    double hamming;
+    double jaccard;
+    double cosine;          // Unscaled, so a MaxSim sum can exceed 1
+    double score;           // Fused score the results are ordered by
+} CascadeResult;
+
+/**
+ * State of a cascaded query. Files can be fed in several batches before the
+ * final stages are run.
+ */
+typedef struct CascadeScan CascadeScan;
+
+/**
+ * Create a cascaded query. Files whose tokenizer or embedding id hash differs
+ * from the reference are skipped.
+ *
+ * @param referenceRagFile RagFile to compare against (must outlive the scan).
+ * @param params Stage sizes and weights (top_k <= jaccard_keep <= hamming_keep).
+ * @param num_workers Maximum number of workers used by the scan.
+ * @return Pointer to the scan, or NULL on invalid parameters or allocation failure.
+ */
+CascadeScan* cascade_scan_create(const RagFile* referenceRagFile, const CascadeParams* params, size_t num_workers);
+
+/**
+ * Run the Hamming prefilter over a batch of files, reading only their headers.
+ *
+ * @param scan Pointer to the scan.
+ * @param pool Thread pool to run on, or NULL to scan on the calling thread.
+ * @param file_paths Array of paths to .rag files.
+ * @param count Number of paths in the array.
+ * @return int Status code of the first failing file (0 for success, -3 on allocation failure).
+ */
+int cascade_scan_files(CascadeScan* scan, ThreadPool* pool, const char* const* file_paths, size_t count);
+
+/**
+ * Run the Jaccard and cosine stages over the Hamming survivors. Call once,
+ * after the last batch of files.
+ *
+ * @param scan Pointer to the scan.
+ * @param pool Thread pool used to load the cosine candidates, or NULL.
+ * @param results Set to an array of at most top_k results, best first (free with cascade_results_free).
+ * @param num_results Set to the number of results.
+ * @return int Status code (0 for success, -1 if a candidate could not be loaded, -3 on allocation failure,
+ *             -4 if the embeddings of the reference RagFile are not loaded).
+ */
+int cascade_scan_finish(CascadeScan* scan, ThreadPool* pool, CascadeResult** results, size_t* num_results);
+
+/**
+ * Free a cascaded query.
+ *
+ * @param scan Pointer to the scan (can be NULL).
+ */
+void cascade_scan_free(CascadeScan* scan);
+
+/**
+ * Free the results of cascade_scan_finish.
+ *
+ * @param results Array of results (can be NULL).
+ * @param count Number of results.
+ */
+void cascade_results_free(CascadeResult* results, size_t count);
+
+#endif // CASCADE_H
@@ -1,8 +1,11 @@
 #include "heap.h"
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
 
-int parent(int i) { return (i - 1) / 2; }
-int left(int i) { return (2 * i + 1); }
-int right(int i) { return (2 * i + 2); }
+size_t parent(size_t i) { return (i - 1) / 2; }
+size_t left(size_t i) { return (2 * i + 1); }
+size_t right(size_t i) { return (2 * i + 2); }
 
 void swap(FileScore *x, FileScore *y) {
     FileScore temp = *x;
@@ -10,68 +13,315 @@ void swap(FileScore *x, FileScore *y) {
     *y = temp;
 }
 
-void heapify_down(MinHeap* minHeap, int i) {
-    int leftChild = 2 * i + 1;
-    int rightChild = 2 * i + 2;
-    int smallest = i;
+void heapify_down(MinHeap* minHeap, size_t i) {
+    // Move the entry down a hole instead of swapping at every level
+    FileScore entry = minHeap->heap[i];
+    size_t size = minHeap->size;
+    for (;;) {
+        size_t smallest = 2 * i + 1;
+        if (smallest >= size) {
+            break;
+        }
+        if (smallest + 1 < size && minHeap->heap[smallest + 1].score < minHeap->heap[smallest].score) {
+            smallest++;
+        }
+        if (minHeap->heap[smallest].score >= entry.score) {
+            break;
+        }
+        minHeap->heap[i] = minHeap->heap[smallest];
+        i = smallest;
+    }
+    minHeap->heap[i] = entry;
+}
 
-    if (leftChild < minHeap->size && minHeap->heap[leftChild].score < minHeap->heap[smallest].score) {
-        smallest = leftChild;
+void heapify_up(MinHeap* minHeap, size_t i) {
+    while (i != 0 && minHeap->heap[parent(i)].score > minHeap->heap[i].score) {
+        swap(&minHeap->heap[i], &minHeap->heap[parent(i)]);
+        i = parent(i);
     }
-    if (rightChild < minHeap->size && minHeap->heap[rightChild].score < minHeap->heap[smallest].score) {
-        smallest = rightChild;
+}
+
+// Start the arena over, keeping the most recent block for reuse
+static void arena_reset(MinHeap* minHeap) {
+    HeapArenaBlock* block = minHeap->blocks;
+    if (block) {
+        HeapArenaBlock* next = block->next;
+        while (next) {
+            HeapArenaBlock* after = next->next;
+            free(next);
+            next = after;
+        }
+        block->next = NULL;
+        block->used = 0;
     }
-    if (smallest != i) {
-        FileScore temp = minHeap->heap[i];
-        minHeap->heap[i] = minHeap->heap[smallest];
-        minHeap->heap[smallest] = temp;
-        heapify_down(minHeap, smallest);
+    minHeap->arena_used = 0;
+    minHeap->arena_live = 0;
+}
+
+static HeapArenaBlock* arena_block_create(size_t capacity) {
+    HeapArenaBlock* block = (HeapArenaBlock*)malloc(sizeof(HeapArenaBlock) + capacity);
+    if (block) {
+        block->next = NULL;
+        block->used = 0;
+        block->capacity = capacity;
     }
+    return block;
 }
 
-void remove_root(MinHeap* minHeap) {
-    if (minHeap->size == 0)
-        return;
+// Copy the live paths into a single new block with room for extra more bytes
+static int arena_compact(MinHeap* minHeap, size_t extra) {
+    size_t capacity = 2 * (minHeap->arena_live + extra);
+    HeapArenaBlock* block = arena_block_create(capacity > HEAP_ARENA_BLOCK_SIZE ? capacity : HEAP_ARENA_BLOCK_SIZE);
+    if (!block) {
+        return -1;
+    }
+    for (size_t i = 0; i < minHeap->size; i++) {
+        size_t length = strlen(minHeap->heap[i].path) + 1;
+        memcpy(block->data + block->used, minHeap->heap[i].path, length);
+        minHeap->heap[i].path = block->data + block->used;
+        block->used += length;
+    }
 
-    free(minHeap->heap[0].path);  // Free the memory allocated for the path
+    HeapArenaBlock* old = minHeap->blocks;
+    while (old) {
+        HeapArenaBlock* next = old->next;
+        free(old);
+        old = next;
+    }
+    minHeap->blocks = block;
+    minHeap->arena_used = block->used;
+    return 0;
+}
 
-    // Move the last element to root and reduce the size
-    minHeap->heap[0] = minHeap->heap[minHeap->size - 1];
-    minHeap->size--;
-    heapify_down(minHeap, 0);
+static char* arena_alloc(MinHeap* minHeap, size_t length) {
+    HeapArenaBlock* block = minHeap->blocks;
+    if (!block || block->capacity - block->used < length) {
+        // Replaced entries leave dead paths behind; reclaim them once they outweigh the live ones
+        if (minHeap->arena_used - minHeap->arena_live > minHeap->arena_live &&
+            minHeap->arena_used >= HEAP_ARENA_BLOCK_SIZE) {
+            if (arena_compact(minHeap, length) != 0) {
+                return NULL;
+            }
+        } else {
+            size_t capacity = minHeap->arena_live > length ? minHeap->arena_live : length;
+            HeapArenaBlock* next = arena_block_create(capacity > HEAP_ARENA_BLOCK_SIZE ? capacity : HEAP_ARENA_BLOCK_SIZE);
+            if (!next) {
+                return NULL;
+            }
+            next->next = minHeap->blocks;
+            minHeap->blocks = next;
+        }
+        block = minHeap->blocks;
+    }
+
+    char* data = block->data + block->used;
+    block->used += length;
+    minHeap->arena_used += length;
+    return data;
 }
 
-void heapify_up(MinHeap* minHeap, int i) {
-    while (i != 0 && minHeap->heap[parent(i)].score > minHeap->heap[i].score) {
-        swap(&minHeap->heap[i], &minHeap->heap[parent(i)]);
-        i = parent(i);
+// Release the interned path of an entry that leaves the heap
+static void release_path(MinHeap* minHeap, const FileScore* entry) {
+    minHeap->arena_live -= strlen(entry->path) + 1;
+}
+
+// Partially order items so that the k best scores come first, with the kth best at items[k - 1]
+static void select_best(FileScore* items, size_t count, size_t k) {
+    size_t lo = 0;
+    size_t hi = count - 1;
+    size_t target = k - 1;
+    while (lo < hi) {
+        // Median of three pivot, ordered descending
+        size_t mid = lo + (hi - lo) / 2;
+        if (items[mid].score > items[lo].score) swap(&items[mid], &items[lo]);
+        if (items[hi].score > items[lo].score) swap(&items[hi], &items[lo]);
+        if (items[hi].score > items[mid].score) swap(&items[hi], &items[mid]);
+        double pivot = items[mid].score;
+
+        size_t i = lo;
+        size_t j = hi;
+        while (i <= j) {
+            while (items[i].score > pivot) i++;
+            while (items[j].score < pivot) j--;
+            if (i <= j) {
+                swap(&items[i], &items[j]);
+                i++;
+                if (j == 0) break;
+                j--;
+            }
+        }
+        // [lo, j] scores >= pivot, [i, hi] scores <= pivot
+        if (target <= j) {
+            hi = j;
+        } else if (target >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+}
+
+// Cut a selection buffer back to its best capacity entries and raise the threshold
+static void select_trim(MinHeap* minHeap) {
+    size_t k = minHeap->capacity;
+    if (minHeap->size <= k) {
+        return;
+    }
+    select_best(minHeap->heap, minHeap->size, k);
+    for (size_t i = k; i < minHeap->size; i++) {
+        release_path(minHeap, &minHeap->heap[i]);
+    }
+    minHeap->size = k;
+    minHeap->threshold = minHeap->heap[k - 1].score;
+}
+
+// Turn a selection buffer back into a min-heap
+static void heap_order(MinHeap* minHeap) {
+    if (minHeap->ordered) {
+        return;
     }
+    select_trim(minHeap);
+    for (size_t i = minHeap->size / 2; i-- > 0;) {
+        heapify_down(minHeap, i);
+    }
+    minHeap->ordered = 1;
 }
 
-MinHeap* create_min_heap(int capacity) {
+MinHeap* create_top_k(size_t capacity, HeapStrategy strategy) {
+    // A selection buffer holds up to twice the capacity between trims
+    if (capacity > SIZE_MAX / 2 / sizeof(FileScore)) {
+        return NULL;
+    }
     MinHeap* minHeap = (MinHeap*)malloc(sizeof(MinHeap));
-    minHeap->heap = (FileScore*)malloc(sizeof(FileScore) * capacity);
+    if (!minHeap) {
+        return NULL;
+    }
+    if (strategy == HEAP_STRATEGY_AUTO) {
+        strategy = capacity >= HEAP_SELECT_MIN_CAPACITY ? HEAP_STRATEGY_SELECT : HEAP_STRATEGY_HEAP;
+    }
+    minHeap->select = strategy == HEAP_STRATEGY_SELECT && capacity > 0;
+
+    size_t slots = minHeap->select ? 2 * capacity : capacity;
+    minHeap->heap = (FileScore*)malloc(sizeof(FileScore) * (slots > 0 ? slots : 1));
+    if (!minHeap->heap) {
+        free(minHeap);
+        return NULL;
+    }
     minHeap->size = 0;
     minHeap->capacity = capacity;
+    minHeap->ordered = 1;
+    minHeap->threshold = -HUGE_VAL;
+    minHeap->blocks = NULL;
+    minHeap->arena_used = 0;
+    minHeap->arena_live = 0;
     return minHeap;
 }
 
-void add_to_heap(MinHeap* minHeap, FileScore fileScore) {
-    if (minHeap->size < minHeap->capacity) {
-        minHeap->heap[minHeap->size] = fileScore;
+MinHeap* create_min_heap(size_t capacity) {
+    return create_top_k(capacity, HEAP_STRATEGY_AUTO);
+}
+
+int heap_offer(MinHeap* minHeap, const char* path, double score) {
+    // Rejection is a single comparison against the root or threshold, with no allocation
+    if (minHeap->select) {
+        if (score <= minHeap->threshold) {
+            return 0;
+        }
+    } else if (minHeap->size == minHeap->capacity && (minHeap->capacity == 0 || score <= minHeap->heap[0].score)) {
+        return 0;
+    }
+
+    size_t length = strlen(path) + 1;
+    char* copy = arena_alloc(minHeap, length);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, path, length);
+    minHeap->arena_live += length;
+
+    if (minHeap->select) {
+        minHeap->heap[minHeap->size++] = (FileScore){copy, score};
+        minHeap->ordered = minHeap->ordered && minHeap->size == 1;
+        if (minHeap->size == 2 * minHeap->capacity) {
+            select_trim(minHeap);
+        }
+    } else if (minHeap->size < minHeap->capacity) {
+        minHeap->heap[minHeap->size] = (FileScore){copy, score};
         heapify_up(minHeap, minHeap->size);
         minHeap->size++;
-    } else if (fileScore.score > minHeap->heap[0].score) {
-        minHeap->heap[0] = fileScore;
+    } else {
+        release_path(minHeap, &minHeap->heap[0]);
+        minHeap->heap[0] = (FileScore){copy, score};
         heapify_down(minHeap, 0);
     }
+    return 1;
+}
+
+void add_to_heap(MinHeap* minHeap, FileScore fileScore) {
+    heap_offer(minHeap, fileScore.path, fileScore.score);
+    free(fileScore.path);
+}
+
+void remove_root(MinHeap* minHeap) {
+    if (minHeap->size == 0)
+        return;
+
+    heap_order(minHeap);
+    release_path(minHeap, &minHeap->heap[0]);
+    minHeap->threshold = -HUGE_VAL;  // There is room again below the old cut
+
+    // Move the last element to root and reduce the size
+    minHeap->heap[0] = minHeap->heap[minHeap->size - 1];
+    minHeap->size--;
+    heapify_down(minHeap, 0);
+
+    if (minHeap->size == 0) {
+        arena_reset(minHeap);
+    }
+}
+
+static int compare_ascending(const void* a, const void* b) {
+    double x = ((const FileScore*)a)->score;
+    double y = ((const FileScore*)b)->score;
+    return (x > y) - (x < y);
+}
+
+size_t heap_sort(MinHeap* minHeap) {
+    if (minHeap->select) {
+        select_trim(minHeap);
+    }
+    qsort(minHeap->heap, minHeap->size, sizeof(FileScore), compare_ascending);
+    minHeap->ordered = 1;  // An ascending array is a valid min-heap
+    return minHeap->size;
+}
+
+int merge_heaps(MinHeap* dest, MinHeap* src) {
+    for (size_t i = 0; i < src->size; i++) {
+        if (heap_offer(dest, src->heap[i].path, src->heap[i].score) < 0) {
+            return -1;  // src keeps its entries
+        }
+    }
+    heap_clear(src);
+    return 0;
+}
+
+void heap_clear(MinHeap* minHeap) {
+    minHeap->size = 0;
+    minHeap->ordered = 1;
+    minHeap->threshold = -HUGE_VAL;
+    arena_reset(minHeap);
 }
 
 void free_min_heap(MinHeap* minHeap) {
-    for (int i = 0; i < minHeap->size; i++) {
-        free(minHeap->heap[i].path);
+    if (!minHeap) {
+        return;
+    }
+    HeapArenaBlock* block = minHeap->blocks;
+    while (block) {
+        HeapArenaBlock* next = block->next;
+        free(block);
+        block = next;
     }
     free(minHeap->heap);
     free(minHeap);
 }
-
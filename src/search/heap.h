@@ -5,22 +5,52 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#define HEAP_ARENA_BLOCK_SIZE 4096  // Minimum size of a block of interned paths
+
+#ifndef HEAP_SELECT_MIN_CAPACITY
+#define HEAP_SELECT_MIN_CAPACITY 1024  // Capacities from which HEAP_STRATEGY_AUTO buffers and quickselects
+#endif
+
+typedef enum {
+    HEAP_STRATEGY_AUTO = 0,  // Heap below HEAP_SELECT_MIN_CAPACITY, selection from there on
+    HEAP_STRATEGY_HEAP,      // Binary min-heap: O(log k) per admitted entry
+    HEAP_STRATEGY_SELECT     // Buffer of 2k entries behind a score threshold, cut back to k by quickselect when full
+} HeapStrategy;
+
 typedef struct {
-    char* path;       // File path
+    char* path;       // File path, interned in the heap's arena
     double score;     // Jaccard similarity score
 } FileScore;
 
+// Block of a bump arena; blocks never move, so interned paths stay valid until compaction
+typedef struct HeapArenaBlock {
+    struct HeapArenaBlock* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} HeapArenaBlock;
+
 typedef struct {
-    FileScore* heap;  // Array of FileScore
-    int size;         // Current number of elements in the heap
-    int capacity;     // Maximum capacity of the heap
+    FileScore* heap;  // Array of FileScore; heap[0] is the minimum only while ordered
+    size_t size;      // Current number of elements in the heap (up to 2 * capacity while selecting)
+    size_t capacity;  // Maximum capacity of the heap
+    int select;       // Non-zero for HEAP_STRATEGY_SELECT
+    int ordered;      // Non-zero while heap[] is a valid min-heap of at most capacity entries
+    double threshold; // Selection only: entries scoring at most this can no longer be admitted
+    HeapArenaBlock* blocks;  // Path arena, most recent block first
+    size_t arena_used;       // Bytes handed out by the arena
+    size_t arena_live;       // Bytes still referenced by an entry
 } MinHeap;
 
 // Function declarations
-MinHeap* create_min_heap(int capacity);
-void add_to_heap(MinHeap* minHeap, FileScore fileScore);
+MinHeap* create_min_heap(size_t capacity);  // create_top_k with HEAP_STRATEGY_AUTO
+MinHeap* create_top_k(size_t capacity, HeapStrategy strategy);  // NULL if capacity is too large to allocate
+int heap_offer(MinHeap* minHeap, const char* path, double score);  // Copies path only if admitted; 1 admitted, 0 rejected, -1 on allocation failure
+void add_to_heap(MinHeap* minHeap, FileScore fileScore);  // Takes ownership of a malloc'd fileScore.path
 void remove_root(MinHeap* minHeap);
+size_t heap_sort(MinHeap* minHeap);  // Keeps the best capacity entries sorted by ascending score (also a valid min-heap); returns the count
+int merge_heaps(MinHeap* dest, MinHeap* src);  // Moves all entries of src into dest, leaving src empty; -1 on allocation failure
+void heap_clear(MinHeap* minHeap);  // Drops every entry and its path
 void free_min_heap(MinHeap* minHeap);
 
 #endif // HEAP_H
-
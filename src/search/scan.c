@@ -1,28 +1,232 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "scan.h"
 #include "heap.h"
+#include "../utils/dir_walk.h"
 #include "../utils/file_io.h"
-#include "../utils/strdup.h"
 #include "../algorithms/jaccard.h"
 
+typedef struct {
+    const char* const* file_paths;
+    size_t count;
+    const RagFile* referenceRagFile;
+    MinHeap** heaps;
+    ScanRing** rings;
+    atomic_size_t next;  // Index of the next unclaimed path
+    atomic_int status;   // First non-zero status reported by a worker
+} ScanJob;
+
+typedef struct {
+    const char* const* file_paths;
+    size_t count;
+    const uint32_t* query_signatures;
+    size_t num_queries;
+    const RagfileHeader* query_header;
+    MinHeap** heaps;
+    atomic_size_t next;
+    atomic_int status;
+} MultiScanJob;
+
+typedef struct {
+    ThreadPool* pool;
+    size_t num_workers;
+    const RagFile* referenceRagFile;
+    const uint32_t* query_signatures;
+    size_t num_queries;
+    const RagfileHeader* query_header;
+    MinHeap** heaps;
+    ScanRing** rings;
+} DirectoryScan;
+
 int process_file(const char* file_path, const RagFile* referenceRagFile, MinHeap* heap) {
-    FILE* file = fopen(file_path, "rb");
-    if (!file) {
+    RagfileHeader header;
+    FileIOError error = read_ragfile_header_at(file_path, &header, SCAN_ADVISE_RANDOM);
+    if (error == FILE_IO_ERROR_OPEN) {
         perror("Failed to open file");
         return -1;  // File opening failed
     }
-
-    RagfileHeader header;
-    if (read_ragfile_header(file, &header) != FILE_IO_SUCCESS) {
-        fclose(file);
+    if (error != FILE_IO_SUCCESS) {
         return -2;  // Header reading failed
     }
 
+    // Scores are meaningless across tokenizers, embedding models and MinHash schemes, so the file is skipped
+    if (header.tokenizer_id_hash != referenceRagFile->header.tokenizer_id_hash ||
+        header.embedding_id_hash != referenceRagFile->header.embedding_id_hash ||
+        !ragfile_minhash_compatible(header.flags, referenceRagFile->header.flags)) {
+        return 0;
+    }
+
     double score = jaccard_similarity(referenceRagFile->header.minhash_signature, header.minhash_signature);
-    add_to_heap(heap, (FileScore){strdup(file_path), score});
+    if (heap_offer(heap, file_path, score) < 0) {
+        return -3;  // Out of memory
+    }
 
-    fclose(file);
     return 0;  // Success
 }
 
+static void scan_worker(void* ctx, size_t worker) {
+    ScanJob* job = (ScanJob*)ctx;
+    MinHeap* heap = job->heaps[worker];
+    ScanRing* ring = job->rings ? job->rings[worker] : NULL;
+    size_t chunk_size = ring ? SCAN_RING_CHUNK_SIZE : SCAN_CHUNK_SIZE;
+
+    while (atomic_load_explicit(&job->status, memory_order_relaxed) == 0) {
+        size_t start = atomic_fetch_add_explicit(&job->next, chunk_size, memory_order_relaxed);
+        if (start >= job->count) {
+            break;
+        }
+        size_t end = start + chunk_size < job->count ? start + chunk_size : job->count;
+
+        if (ring) {
+            int status = process_files_uring(ring, job->file_paths + start, end - start, job->referenceRagFile, heap);
+            if (status != 0) {
+                int expected = 0;
+                atomic_compare_exchange_strong(&job->status, &expected, status);
+                return;
+            }
+            continue;
+        }
+
+        for (size_t i = start; i < end; i++) {
+            int status = process_file(job->file_paths[i], job->referenceRagFile, heap);
+            if (status != 0) {
+                int expected = 0;
+                atomic_compare_exchange_strong(&job->status, &expected, status);
+                return;
+            }
+        }
+    }
+}
+
+int process_files(ThreadPool* pool, size_t num_workers, const char* const* file_paths, size_t count,
+                  const RagFile* referenceRagFile, MinHeap** heaps, ScanRing** rings) {
+    if (!file_paths || !referenceRagFile || !heaps || num_workers == 0) {
+        return -3;  // Invalid arguments
+    }
+
+    ScanJob job = {
+        .file_paths = file_paths,
+        .count = count,
+        .referenceRagFile = referenceRagFile,
+        .heaps = heaps,
+        .rings = rings,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.status, 0);
+
+    if (pool == NULL || num_workers == 1) {
+        scan_worker(&job, 0);
+    } else {
+        thread_pool_run(pool, scan_worker, &job, num_workers);
+    }
+
+    return atomic_load(&job.status);
+}
+
+static int process_directory_batch(void* ctx, const char* const* paths, size_t count) {
+    DirectoryScan* scan = (DirectoryScan*)ctx;
+    return process_files(scan->pool, scan->num_workers, paths, count, scan->referenceRagFile, scan->heaps, scan->rings);
+}
+
+int process_directory(ThreadPool* pool, size_t num_workers, const char* root, const char* pattern,
+                      const RagFile* referenceRagFile, MinHeap** heaps, ScanRing** rings) {
+    if (!root || !referenceRagFile || !heaps || num_workers == 0) {
+        return -3;  // Invalid arguments
+    }
+
+    DirectoryScan scan = {.pool = pool, .num_workers = num_workers, .referenceRagFile = referenceRagFile,
+                          .heaps = heaps, .rings = rings};
+    return dir_walk(root, pattern, 0, process_directory_batch, &scan);
+}
+
+static void multi_scan_worker(void* ctx, size_t worker) {
+    MultiScanJob* job = (MultiScanJob*)ctx;
+    MinHeap** heaps = job->heaps + worker * job->num_queries;
+
+    float* scores = (float*)malloc(job->num_queries * sizeof(float));
+    if (!scores) {
+        int expected = 0;
+        atomic_compare_exchange_strong(&job->status, &expected, -3);
+        return;
+    }
+
+    while (atomic_load_explicit(&job->status, memory_order_relaxed) == 0) {
+        size_t start = atomic_fetch_add_explicit(&job->next, SCAN_CHUNK_SIZE, memory_order_relaxed);
+        if (start >= job->count) {
+            break;
+        }
+        size_t end = start + SCAN_CHUNK_SIZE < job->count ? start + SCAN_CHUNK_SIZE : job->count;
+
+        for (size_t i = start; i < end; i++) {
+            RagfileHeader header;
+            FileIOError error = read_ragfile_header_at(job->file_paths[i], &header, SCAN_ADVISE_RANDOM);
+            if (error != FILE_IO_SUCCESS) {
+                int expected = 0;
+                atomic_compare_exchange_strong(&job->status, &expected, error == FILE_IO_ERROR_OPEN ? -1 : -2);
+                free(scores);
+                return;
+            }
+
+            if (header.tokenizer_id_hash != job->query_header->tokenizer_id_hash ||
+                header.embedding_id_hash != job->query_header->embedding_id_hash ||
+                !ragfile_minhash_compatible(header.flags, job->query_header->flags)) {
+                continue;
+            }
+
+            jaccard_similarity_many(header.minhash_signature, job->query_signatures, job->num_queries, scores);
+            for (size_t q = 0; q < job->num_queries; q++) {
+                if (heap_offer(heaps[q], job->file_paths[i], scores[q]) < 0) {
+                    int expected = 0;
+                    atomic_compare_exchange_strong(&job->status, &expected, -3);
+                    free(scores);
+                    return;
+                }
+            }
+        }
+    }
+    free(scores);
+}
+
+int process_files_many(ThreadPool* pool, size_t num_workers, const char* const* file_paths, size_t count,
+                       const uint32_t* query_signatures, size_t num_queries, const RagfileHeader* query_header, MinHeap** heaps) {
+    if (!file_paths || !query_signatures || !query_header || !heaps || num_workers == 0 || num_queries == 0) {
+        return -3;  // Invalid arguments
+    }
+
+    MultiScanJob job = {
+        .file_paths = file_paths,
+        .count = count,
+        .query_signatures = query_signatures,
+        .num_queries = num_queries,
+        .query_header = query_header,
+        .heaps = heaps,
+    };
+    atomic_init(&job.next, 0);
+    atomic_init(&job.status, 0);
+
+    if (pool == NULL || num_workers == 1) {
+        multi_scan_worker(&job, 0);
+    } else {
+        thread_pool_run(pool, multi_scan_worker, &job, num_workers);
+    }
+
+    return atomic_load(&job.status);
+}
+
+static int process_directory_many_batch(void* ctx, const char* const* paths, size_t count) {
+    DirectoryScan* scan = (DirectoryScan*)ctx;
+    return process_files_many(scan->pool, scan->num_workers, paths, count, scan->query_signatures,
+                              scan->num_queries, scan->query_header, scan->heaps);
+}
+
+int process_directory_many(ThreadPool* pool, size_t num_workers, const char* root, const char* pattern,
+                           const uint32_t* query_signatures, size_t num_queries, const RagfileHeader* query_header, MinHeap** heaps) {
+    if (!root || !query_signatures || !query_header || !heaps || num_workers == 0 || num_queries == 0) {
+        return -3;  // Invalid arguments
+    }
+
+    DirectoryScan scan = {.pool = pool, .num_workers = num_workers, .query_signatures = query_signatures,
+                          .num_queries = num_queries, .query_header = query_header, .heaps = heaps};
+    return dir_walk(root, pattern, 0, process_directory_many_batch, &scan);
+}
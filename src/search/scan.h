@@ -4,10 +4,21 @@
 
 #include "../core/ragfile.h"
 #include "../search/heap.h"
+#include "../search/uring_scan.h"
+#include "../utils/thread_pool.h"
 #include <stdbool.h>
 
+#define SCAN_CHUNK_SIZE 64  // Number of paths a worker claims at a time
+#define SCAN_RING_CHUNK_SIZE (4 * SCAN_RING_DEPTH)  // Paths claimed at a time by a worker with a ScanRing
+
+#ifndef SCAN_ADVISE_RANDOM
+#define SCAN_ADVISE_RANDOM 1  // Disable kernel readahead for header reads
+#endif
+
 /**
- * Processes a single file and potentially adds it to the min heap.
+ * Processes a single file and potentially adds it to the min heap. Files whose
+ * tokenizer or embedding id hash differs from the reference, or whose signature
+ * uses another MinHash scheme, are skipped.
  *
  * @param file_path Path to the .rag file to process.
  * @param referenceRagFile Pointer to a RagFile containing the reference minhash signature.
@@ -16,5 +27,68 @@
  */
 int process_file(const char* file_path, const RagFile* referenceRagFile, MinHeap* heap);
 
-#endif // SCAN_H
+/**
+ * Processes a batch of files on a thread pool. Every worker keeps its own heap
+ * (heaps[worker]), so no locking is needed while scoring; merge them with
+ * merge_heaps once the scan is complete.
+ *
+ * @param pool Thread pool to run on, or NULL to scan on the calling thread using heaps[0].
+ * @param num_workers Number of workers to use (must not exceed the number of heaps).
+ * @param file_paths Array of paths to .rag files.
+ * @param count Number of paths in the array.
+ * @param referenceRagFile Pointer to a RagFile containing the reference minhash signature.
+ * @param heaps Array of num_workers MinHeaps.
+ * @param rings Optional array of num_workers ScanRings (NULL, or NULL entries, for synchronous reads).
+ * @return int Status code of the first failing file (0 for success).
+ */
+int process_files(ThreadPool* pool, size_t num_workers, const char* const* file_paths, size_t count,
+                  const RagFile* referenceRagFile, MinHeap** heaps, ScanRing** rings);
 
+/**
+ * Processes every matching file under a directory. The tree is walked natively
+ * (see dir_walk) and the paths are scanned with process_files in batches as
+ * they are found, so no caller supplied path list is needed.
+ *
+ * @param pool Thread pool to run on, or NULL to scan on the calling thread using heaps[0].
+ * @param num_workers Number of workers to use (must not exceed the number of heaps).
+ * @param root Directory to walk.
+ * @param pattern Glob or suffix the file names must match (NULL for "*.rag").
+ * @param referenceRagFile Pointer to a RagFile containing the reference minhash signature.
+ * @param heaps Array of num_workers MinHeaps.
+ * @param rings Optional array of num_workers ScanRings (NULL, or NULL entries, for synchronous reads).
+ * @return int Status code of the first failing file (0 for success, -4 if the root cannot be opened).
+ */
+int process_directory(ThreadPool* pool, size_t num_workers, const char* root, const char* pattern,
+                      const RagFile* referenceRagFile, MinHeap** heaps, ScanRing** rings);
+
+/**
+ * Processes a batch of files against several queries at once. Each header is
+ * read once and scored against every query signature, so the I/O of the scan
+ * is shared by the whole batch of queries.
+ *
+ * @param pool Thread pool to run on, or NULL to scan on the calling thread.
+ * @param num_workers Number of workers to use.
+ * @param file_paths Array of paths to .rag files.
+ * @param count Number of paths in the array.
+ * @param query_signatures num_queries MinHash signatures stored back to back.
+ * @param num_queries Number of queries.
+ * @param query_header Header shared by the queries; files whose tokenizer or embedding id hash
+ *                     differs from it, or whose signatures use another MinHash scheme (see
+ *                     ragfile_minhash_compatible), are skipped.
+ * @param heaps Array of num_workers * num_queries MinHeaps; worker w keeps the results of
+ *              query q in heaps[w * num_queries + q].
+ * @return int Status code of the first failing file (0 for success).
+ */
+int process_files_many(ThreadPool* pool, size_t num_workers, const char* const* file_paths, size_t count,
+                       const uint32_t* query_signatures, size_t num_queries, const RagfileHeader* query_header, MinHeap** heaps);
+
+/**
+ * Processes every matching file under a directory against several queries
+ * (see process_directory and process_files_many).
+ *
+ * @return int Status code of the first failing file (0 for success, -4 if the root cannot be opened).
+ */
+int process_directory_many(ThreadPool* pool, size_t num_workers, const char* root, const char* pattern,
+                           const uint32_t* query_signatures, size_t num_queries, const RagfileHeader* query_header, MinHeap** heaps);
+
+#endif // SCAN_H
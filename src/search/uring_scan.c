@@ -0,0 +1,408 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // syscall
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "uring_scan.h"
+#include "scan.h"
+#include "../algorithms/jaccard.h"
+
+// Each file is read by an open, read and close chain on a direct descriptor, which needs
+// linked requests to see a file opened earlier in their chain (Linux 5.18 headers and kernel)
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_FEAT_LINKED_FILE
+#define RAGFILE_HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef RAGFILE_HAVE_IO_URING
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// Request kinds, stored in the upper bits of user_data
+#define URING_OP_OPEN  1ULL
+#define URING_OP_READ  2ULL
+#define URING_OP_CLOSE 3ULL
+#define URING_USER_DATA(op, slot) (((op) << 32) | (uint64_t)(slot))
+#define URING_CHAIN_LENGTH 3  // Entries and completions per file: open, read, close
+
+// A file in flight; its direct descriptor is the registered file at the slot's index
+typedef struct {
+    size_t path_index;
+    unsigned int pending;     // Completions of the chain not yet reaped
+    RagfileHeader header;
+} ScanSlot;
+
+struct ScanRing {
+    int fd;
+    unsigned int depth;       // Number of slots
+    unsigned int entries;     // Number of submission queue entries
+
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;
+    size_t cq_map_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    unsigned int* sq_head;
+    unsigned int* sq_tail;
+    unsigned int* sq_mask;
+    unsigned int* sq_array;
+    unsigned int* cq_head;
+    unsigned int* cq_tail;
+    unsigned int* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    unsigned int to_submit;   // Queued but not yet submitted entries
+    ScanSlot* slots;
+    unsigned int* free_slots; // Stack of free slot indices
+    unsigned int num_free;
+};
+
+static int uring_setup(unsigned int entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned int opcode, void* arg, unsigned int nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Check that the kernel implements every opcode used by the scan
+static bool uring_probe_ops(int fd) {
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, size);
+    if (probe == NULL) {
+        return false;
+    }
+
+    bool supported = false;
+    if (uring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+        supported = true;
+        for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = false;
+            }
+        }
+    }
+
+    free(probe);
+    return supported;
+}
+
+ScanRing* scan_ring_create(unsigned int depth) {
+    if (depth == 0) {
+        depth = SCAN_RING_DEPTH;
+    }
+
+    ScanRing* ring = (ScanRing*)calloc(1, sizeof(ScanRing));
+    if (ring == NULL) {
+        return NULL;
+    }
+    ring->fd = -1;
+    ring->depth = depth;
+
+    // Every slot queues one chain at a time
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = uring_setup(depth * URING_CHAIN_LENGTH, &params);
+    if (ring->fd < 0 || !(params.features & IORING_FEAT_LINKED_FILE) || !uring_probe_ops(ring->fd)) {
+        scan_ring_free(ring);
+        return NULL;
+    }
+    ring->entries = params.sq_entries;
+
+    // One empty direct descriptor per slot, so no file is ever installed in the process fd table
+    int* files = (int*)malloc(depth * sizeof(int));
+    if (files == NULL) {
+        scan_ring_free(ring);
+        return NULL;
+    }
+    for (unsigned int i = 0; i < depth; i++) {
+        files[i] = -1;
+    }
+    int registered = uring_register(ring->fd, IORING_REGISTER_FILES, files, depth);
+    free(files);
+    if (registered != 0) {
+        scan_ring_free(ring);
+        return NULL;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = 0;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        scan_ring_free(ring);
+        return NULL;
+    }
+
+    if (ring->cq_map_size == 0) {
+        ring->cq_map = ring->sq_map;
+    } else {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+            scan_ring_free(ring);
+            return NULL;
+        }
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                            ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        scan_ring_free(ring);
+        return NULL;
+    }
+
+    char* sq = (char*)ring->sq_map;
+    char* cq = (char*)ring->cq_map;
+    ring->sq_head = (unsigned int*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned int*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned int*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned int*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned int*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned int*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    ring->slots = (ScanSlot*)malloc(depth * sizeof(ScanSlot));
+    ring->free_slots = (unsigned int*)malloc(depth * sizeof(unsigned int));
+    if (ring->slots == NULL || ring->free_slots == NULL) {
+        scan_ring_free(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void scan_ring_free(ScanRing* ring) {
+    if (!ring) {
+        return;
+    }
+
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    free(ring->slots);
+    free(ring->free_slots);
+    free(ring);
+}
+
+bool scan_ring_supported(void) {
+    ScanRing* ring = scan_ring_create(1);
+    if (ring == NULL) {
+        return false;
+    }
+    scan_ring_free(ring);
+    return true;
+}
+
+// Number of submission queue entries that can still be queued
+static unsigned int scan_ring_sq_space(const ScanRing* ring) {
+    unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned int tail = *ring->sq_tail + ring->to_submit;
+    return ring->entries - (tail - head);
+}
+
+// Take the next entry; call only after scan_ring_sq_space has shown there is room
+static struct io_uring_sqe* scan_ring_get_sqe(ScanRing* ring) {
+    unsigned int tail = *ring->sq_tail + ring->to_submit;
+    unsigned int index = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    ring->to_submit++;
+    return sqe;
+}
+
+// Publish queued entries and wait for at least min_complete completions
+static int scan_ring_submit(ScanRing* ring, unsigned int min_complete) {
+    unsigned int submitted = ring->to_submit;
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + submitted, __ATOMIC_RELEASE);
+    ring->to_submit = 0;
+
+    int ret;
+    do {
+        ret = uring_enter(ring->fd, submitted, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? -1 : 0;
+}
+
+// Queue the open, read and close of a file as one chain on the slot's direct descriptor. The
+// entries are reserved together, so a chain is never left without its close.
+static void scan_ring_queue_chain(ScanRing* ring, unsigned int slot, const char* path) {
+    struct io_uring_sqe* open_sqe = scan_ring_get_sqe(ring);
+    open_sqe->opcode = IORING_OP_OPENAT;
+    open_sqe->fd = AT_FDCWD;
+    open_sqe->addr = (uint64_t)(uintptr_t)path;
+    open_sqe->open_flags = O_RDONLY;  // O_CLOEXEC is rejected for (and meaningless on) direct descriptors
+    open_sqe->file_index = slot + 1;  // Install as direct descriptor slot (1-based)
+    open_sqe->flags = IOSQE_IO_LINK;  // A failed open cancels the read and close
+    open_sqe->user_data = URING_USER_DATA(URING_OP_OPEN, slot);
+
+    struct io_uring_sqe* read_sqe = scan_ring_get_sqe(ring);
+    read_sqe->opcode = IORING_OP_READ;
+    read_sqe->fd = (int)slot;
+    read_sqe->addr = (uint64_t)(uintptr_t)&ring->slots[slot].header;
+    read_sqe->len = sizeof(RagfileHeader);
+    read_sqe->off = 0;
+    read_sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;  // Close even if the read fails
+    read_sqe->user_data = URING_USER_DATA(URING_OP_READ, slot);
+
+    struct io_uring_sqe* close_sqe = scan_ring_get_sqe(ring);
+    close_sqe->opcode = IORING_OP_CLOSE;
+    close_sqe->file_index = slot + 1;
+    close_sqe->user_data = URING_USER_DATA(URING_OP_CLOSE, slot);
+
+    ring->slots[slot].pending = URING_CHAIN_LENGTH;
+}
+
+int process_files_uring(ScanRing* ring, const char* const* file_paths, size_t count,
+                        const RagFile* referenceRagFile, MinHeap* heap) {
+    if (!file_paths || !referenceRagFile || !heap) {
+        return -3;  // Invalid arguments
+    }
+
+    if (ring == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            int status = process_file(file_paths[i], referenceRagFile, heap);
+            if (status != 0) {
+                return status;
+            }
+        }
+        return 0;
+    }
+
+    ring->num_free = ring->depth;
+    for (unsigned int i = 0; i < ring->depth; i++) {
+        ring->free_slots[i] = ring->depth - 1 - i;
+    }
+
+    size_t next = 0;
+    unsigned int inflight = 0;  // Requests submitted and not yet completed
+    int status = 0;
+
+    while ((status == 0 && next < count) || inflight > 0) {
+        // Start a chain for every free slot; a slot is reused only once its close has completed
+        while (status == 0 && next < count && ring->num_free > 0 &&
+               scan_ring_sq_space(ring) >= URING_CHAIN_LENGTH) {
+            unsigned int slot = ring->free_slots[--ring->num_free];
+            ring->slots[slot].path_index = next;
+            scan_ring_queue_chain(ring, slot, file_paths[next]);
+            next++;
+            inflight += URING_CHAIN_LENGTH;
+        }
+
+        if (scan_ring_submit(ring, inflight > 0 ? 1 : 0) != 0) {
+            // The ring is unusable; requests already in flight are abandoned
+            return -2;
+        }
+
+        unsigned int head = *ring->cq_head;
+        unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            uint64_t op = cqe->user_data >> 32;
+            unsigned int slot = (unsigned int)(cqe->user_data & 0xFFFFFFFFu);
+            int res = cqe->res;
+            inflight--;
+
+            if (op == URING_OP_OPEN) {
+                if (res < 0 && status == 0) {
+                    errno = -res;
+                    perror("Failed to open file");
+                    status = -1;  // File opening failed
+                }
+            } else if (op == URING_OP_READ) {
+                if (res == (int)sizeof(RagfileHeader)) {
+                    const RagfileHeader* header = &ring->slots[slot].header;
+                    if (status == 0 && header->tokenizer_id_hash == referenceRagFile->header.tokenizer_id_hash &&
+                        header->embedding_id_hash == referenceRagFile->header.embedding_id_hash &&
+                        ragfile_minhash_compatible(header->flags, referenceRagFile->header.flags)) {
+                        double score = jaccard_similarity(referenceRagFile->header.minhash_signature,
+                                                          header->minhash_signature);
+                        if (heap_offer(heap, file_paths[ring->slots[slot].path_index], score) < 0) {
+                            status = -3;  // Out of memory
+                        }
+                    }
+                } else if (res != -ECANCELED && status == 0) {
+                    status = -2;  // Header reading failed (a cancelled read follows a failed open)
+                }
+            }
+
+            if (--ring->slots[slot].pending == 0) {
+                ring->free_slots[ring->num_free++] = slot;
+            }
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return status;
+}
+
+#else  // !RAGFILE_HAVE_IO_URING
+
+bool scan_ring_supported(void) {
+    return false;
+}
+
+ScanRing* scan_ring_create(unsigned int depth) {
+    (void)depth;
+    return NULL;
+}
+
+void scan_ring_free(ScanRing* ring) {
+    (void)ring;
+}
+
+int process_files_uring(ScanRing* ring, const char* const* file_paths, size_t count,
+                        const RagFile* referenceRagFile, MinHeap* heap) {
+    (void)ring;
+    if (!file_paths || !referenceRagFile || !heap) {
+        return -3;  // Invalid arguments
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int status = process_file(file_paths[i], referenceRagFile, heap);
+        if (status != 0) {
+            return status;
+        }
+    }
+    return 0;
+}
+
+#endif  // RAGFILE_HAVE_IO_URING
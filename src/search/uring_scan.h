@@ -0,0 +1,58 @@
+// uring_scan.h
+#ifndef URING_SCAN_H
+#define URING_SCAN_H
+
+#include "../core/ragfile.h"
+#include "../search/heap.h"
+#include <stdbool.h>
+
+#define SCAN_RING_DEPTH 256  // Header reads kept in flight per ring
+
+/**
+ * io_uring instance used to batch header reads. Every ring is owned by a
+ * single thread; create one per scan worker.
+ */
+typedef struct ScanRing ScanRing;
+
+/**
+ * Check whether io_uring with openat/read/close on direct descriptors in
+ * linked chains (Linux 5.18) is usable in this process.
+ *
+ * @return true if scan_ring_create can succeed.
+ */
+bool scan_ring_supported(void);
+
+/**
+ * Create a new ScanRing.
+ *
+ * @param depth Maximum number of files in flight (0 selects SCAN_RING_DEPTH).
+ * @return Pointer to the ring, or NULL if io_uring is not available at runtime.
+ */
+ScanRing* scan_ring_create(unsigned int depth);
+
+/**
+ * Free a ScanRing and its kernel resources.
+ *
+ * @param ring Pointer to the ring (can be NULL).
+ */
+void scan_ring_free(ScanRing* ring);
+
+/**
+ * Processes a batch of files with io_uring and adds them to the min heap.
+ * Each file is read by a single linked chain of openat, read and close
+ * requests on a registered (direct) descriptor, so a file costs one
+ * submission and never enters the process fd table. Up to depth files are
+ * kept in flight. Falls back to process_file for every path when ring is NULL.
+ *
+ * @param ring Ring created by scan_ring_create, or NULL for the synchronous path.
+ * @param file_paths Array of paths to .rag files.
+ * @param count Number of paths in the array.
+ * @param referenceRagFile Pointer to a RagFile containing the reference minhash signature.
+ * @param heap MinHeap structure to store top k results.
+ * @return int Status code (0 for success, -1 if a file could not be opened, -2 if a header could not be read,
+ *         -3 on allocation failure).
+ */
+int process_files_uring(ScanRing* ring, const char* const* file_paths, size_t count,
+                        const RagFile* referenceRagFile, MinHeap* heap);
+
+#endif // URING_SCAN_H
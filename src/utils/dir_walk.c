@@ -0,0 +1,311 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "dir_walk.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define DIR_WALK_DENTS_SIZE (64 * 1024)  // Bytes of directory records read per getdents64 call
+
+#ifdef __linux__
+// Record layout returned by getdents64 (not exported by every libc)
+struct dir_walk_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+// A directory being walked, kept open so its subdirectories can be opened relative to it
+typedef struct {
+    int fd;
+    size_t path_length;     // Length of the directory path in the walk's path buffer, including the trailing '/'
+    char* subdirs;          // NUL separated names of the subdirectories still to visit
+    size_t subdirs_size;
+    size_t subdirs_capacity;
+    size_t cursor;          // Offset of the next subdirectory name
+} DirWalkFrame;
+
+typedef struct {
+    const char* pattern;
+    size_t pattern_length;
+    bool is_glob;
+
+    char* path;             // Path of the current directory, with room for an entry name
+    size_t path_capacity;
+
+    char* arena;            // Matching paths of the current batch, NUL separated
+    size_t arena_size;
+    size_t arena_capacity;
+    size_t* offsets;        // Offset of each batched path in the arena
+    const char** batch;
+    size_t batch_count;
+    size_t batch_size;
+
+    DirWalkCallback callback;
+    void* ctx;
+} DirWalk;
+
+static bool reserve(char** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t new_capacity = *capacity ? *capacity : 256;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    char* new_buffer = realloc(*buffer, new_capacity);
+    if (!new_buffer) {
+        return false;
+    }
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+    return true;
+}
+
+static bool name_matches(const DirWalk* walk, const char* name) {
+    if (walk->is_glob) {
+        return fnmatch(walk->pattern, name, 0) == 0;
+    }
+    size_t length = strlen(name);
+    return length >= walk->pattern_length &&
+           memcmp(name + length - walk->pattern_length, walk->pattern, walk->pattern_length) == 0;
+}
+
+static int flush_batch(DirWalk* walk) {
+    if (walk->batch_count == 0) {
+        return 0;
+    }
+    // The arena may have moved while the batch was filled, so pointers are only taken here
+    for (size_t i = 0; i < walk->batch_count; i++) {
+        walk->batch[i] = walk->arena + walk->offsets[i];
+    }
+    int status = walk->callback(walk->ctx, walk->batch, walk->batch_count);
+    walk->batch_count = 0;
+    walk->arena_size = 0;
+    return status;
+}
+
+static int emit_file(DirWalk* walk, size_t dir_length, const char* name) {
+    size_t name_length = strlen(name);
+    if (!reserve(&walk->arena, &walk->arena_capacity, walk->arena_size + dir_length + name_length + 1)) {
+        return DIR_WALK_ERROR_MEMORY;
+    }
+    char* dest = walk->arena + walk->arena_size;
+    memcpy(dest, walk->path, dir_length);
+    memcpy(dest + dir_length, name, name_length + 1);
+    walk->offsets[walk->batch_count++] = walk->arena_size;
+    walk->arena_size += dir_length + name_length + 1;
+
+    if (walk->batch_count == walk->batch_size) {
+        return flush_batch(walk);
+    }
+    return 0;
+}
+
+static int add_subdir(DirWalkFrame* frame, const char* name) {
+    size_t length = strlen(name) + 1;
+    if (!reserve(&frame->subdirs, &frame->subdirs_capacity, frame->subdirs_size + length)) {
+        return DIR_WALK_ERROR_MEMORY;
+    }
+    memcpy(frame->subdirs + frame->subdirs_size, name, length);
+    frame->subdirs_size += length;
+    return 0;
+}
+
+// Batch a matching file, or queue a subdirectory, for one directory entry
+static int visit_entry(DirWalk* walk, DirWalkFrame* frame, const char* name, unsigned char type) {
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        return 0;
+    }
+
+    if (type == DT_DIR) {
+        return add_subdir(frame, name);
+    }
+    if (type == DT_REG) {
+        return name_matches(walk, name) ? emit_file(walk, frame->path_length, name) : 0;
+    }
+    if (type == DT_LNK || type == DT_UNKNOWN) {
+        // A symlink only matters if it leads to a matching file, so skip the stat otherwise
+        if (type == DT_LNK && !name_matches(walk, name)) {
+            return 0;
+        }
+        struct stat st;
+        if (fstatat(frame->fd, name, &st, type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+            return 0;
+        }
+        if (type == DT_UNKNOWN && S_ISDIR(st.st_mode)) {
+            return add_subdir(frame, name);
+        }
+        if (type == DT_UNKNOWN && S_ISLNK(st.st_mode)) {
+            return visit_entry(walk, frame, name, DT_LNK);
+        }
+        if (S_ISREG(st.st_mode) && name_matches(walk, name)) {
+            return emit_file(walk, frame->path_length, name);
+        }
+    }
+    return 0;
+}
+
+// Read every entry of a directory, batching matching files and queueing subdirectories
+static int list_directory(DirWalk* walk, DirWalkFrame* frame, char* dents) {
+#ifdef __linux__
+    for (;;) {
+        long nread = syscall(SYS_getdents64, frame->fd, dents, DIR_WALK_DENTS_SIZE);
+        if (nread <= 0) {
+            return 0;  // End of the directory, or a read error which ends it early
+        }
+        for (long offset = 0; offset < nread;) {
+            struct dir_walk_dirent64* entry = (struct dir_walk_dirent64*)(dents + offset);
+            int status = visit_entry(walk, frame, entry->d_name, entry->d_type);
+            if (status != 0) {
+                return status;
+            }
+            offset += entry->d_reclen;
+        }
+    }
+#else
+    (void)dents;
+    int fd = dup(frame->fd);
+    DIR* dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+    int status = 0;
+    struct dirent* entry;
+    while (status == 0 && (entry = readdir(dir)) != NULL) {
+        status = visit_entry(walk, frame, entry->d_name, entry->d_type);
+    }
+    closedir(dir);
+    return status;
+#endif
+}
+
+static bool push_frame(DirWalkFrame** frames, size_t* depth, size_t* capacity, int fd, size_t path_length) {
+    if (*depth == *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 16;
+        DirWalkFrame* new_frames = realloc(*frames, new_capacity * sizeof(DirWalkFrame));
+        if (!new_frames) {
+            return false;
+        }
+        *frames = new_frames;
+        *capacity = new_capacity;
+    }
+    (*frames)[(*depth)++] = (DirWalkFrame){.fd = fd, .path_length = path_length};
+    return true;
+}
+
+int dir_walk(const char* root, const char* pattern, size_t batch_size, DirWalkCallback callback, void* ctx) {
+    if (!root || !callback) {
+        return DIR_WALK_ERROR_MEMORY;
+    }
+    if (!pattern) {
+        pattern = DIR_WALK_DEFAULT_PATTERN;
+    }
+
+    int root_fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        return DIR_WALK_ERROR_ROOT;
+    }
+
+    DirWalk walk = {
+        .pattern = pattern,
+        .pattern_length = strlen(pattern),
+        .is_glob = strpbrk(pattern, "*?[") != NULL,
+        .batch_size = batch_size ? batch_size : DIR_WALK_BATCH_SIZE,
+        .callback = callback,
+        .ctx = ctx,
+    };
+    walk.offsets = malloc(walk.batch_size * sizeof(size_t));
+    walk.batch = malloc(walk.batch_size * sizeof(const char*));
+    char* dents = malloc(DIR_WALK_DENTS_SIZE);
+
+    DirWalkFrame* frames = NULL;
+    size_t depth = 0;
+    size_t frames_capacity = 0;
+    int status = 0;
+
+    size_t root_length = strlen(root);
+    bool needs_slash = root_length > 0 && root[root_length - 1] != '/';
+    if (!walk.offsets || !walk.batch || !dents ||
+        !reserve(&walk.path, &walk.path_capacity, root_length + 2) ||
+        !push_frame(&frames, &depth, &frames_capacity, root_fd, root_length + needs_slash)) {
+        close(root_fd);
+        status = DIR_WALK_ERROR_MEMORY;
+        goto cleanup;
+    }
+    memcpy(walk.path, root, root_length);
+    if (needs_slash) {
+        walk.path[root_length] = '/';
+    }
+    status = list_directory(&walk, &frames[0], dents);
+
+    while (status == 0 && depth > 0) {
+        DirWalkFrame* frame = &frames[depth - 1];
+        if (frame->cursor == frame->subdirs_size) {
+            close(frame->fd);
+            free(frame->subdirs);
+            depth--;
+            continue;
+        }
+
+        const char* name = frame->subdirs + frame->cursor;
+        size_t name_length = strlen(name);
+        frame->cursor += name_length + 1;
+
+        // Symlinked directories are not followed, which also rules out cycles
+        int fd = openat(frame->fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+        if (fd < 0) {
+            continue;
+        }
+        size_t path_length = frame->path_length + name_length + 1;
+        if (!reserve(&walk.path, &walk.path_capacity, path_length)) {
+            close(fd);
+            status = DIR_WALK_ERROR_MEMORY;
+            break;
+        }
+        memcpy(walk.path + frame->path_length, name, name_length);
+        walk.path[path_length - 1] = '/';
+
+        if (!push_frame(&frames, &depth, &frames_capacity, fd, path_length)) {
+            close(fd);
+            status = DIR_WALK_ERROR_MEMORY;
+            break;
+        }
+        status = list_directory(&walk, &frames[depth - 1], dents);
+    }
+
+    if (status == 0) {
+        status = flush_batch(&walk);
+    }
+
+cleanup:
+    for (size_t i = 0; i < depth; i++) {
+        close(frames[i].fd);
+        free(frames[i].subdirs);
+    }
+    free(frames);
+    free(dents);
+    free(walk.path);
+    free(walk.arena);
+    free(walk.offsets);
+    free(walk.batch);
+    return status;
+}
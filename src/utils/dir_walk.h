@@ -0,0 +1,40 @@
+#ifndef DIR_WALK_H
+#define DIR_WALK_H
+
+#include <stddef.h>
+
+#define DIR_WALK_BATCH_SIZE 8192     // Default number of paths handed to the callback at a time
+#define DIR_WALK_DEFAULT_PATTERN "*.rag"
+
+#define DIR_WALK_ERROR_MEMORY -3     // Invalid arguments or allocation failure
+#define DIR_WALK_ERROR_ROOT -4       // The root directory could not be opened
+
+/**
+ * Called with each batch of matching paths. The paths are only valid for the
+ * duration of the call.
+ *
+ * @param ctx Caller supplied context.
+ * @param paths Array of paths, each starting with the root directory.
+ * @param count Number of paths in the array.
+ * @return 0 to continue the walk, or a non-zero status to stop it.
+ */
+typedef int (*DirWalkCallback)(void* ctx, const char* const* paths, size_t count);
+
+/**
+ * Recursively list the regular files under a directory whose name matches a
+ * pattern. Directories are opened relative to their parent's descriptor with
+ * openat and read with getdents64, so each entry costs no more than one
+ * directory record; symlinks to files are followed, symlinks to directories
+ * are not. Subdirectories that cannot be opened are skipped.
+ *
+ * @param root Directory to walk.
+ * @param pattern Glob matched against the file name (e.g. "*.rag"), or a plain
+ *                suffix if it contains no wildcard. NULL means DIR_WALK_DEFAULT_PATTERN.
+ * @param batch_size Maximum number of paths per callback (0 for DIR_WALK_BATCH_SIZE).
+ * @param callback Function receiving the batches of matching paths.
+ * @param ctx Context passed to the callback.
+ * @return 0 on success, the first non-zero callback status, or a DIR_WALK_ERROR code.
+ */
+int dir_walk(const char* root, const char* pattern, size_t batch_size, DirWalkCallback callback, void* ctx);
+
+#endif // DIR_WALK_H
@@ -1,6 +1,12 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // O_NOATIME
+#endif
 #include "file_io.h"
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 FileIOError file_open(FILE** file, const char* filename, bool write_mode) {
     *file = fopen(filename, write_mode ? "wb" : "rb");
@@ -29,6 +35,74 @@ FileIOError read_ragfile_header(FILE* file, RagfileHeader* header) {
     return file_read(file, header, sizeof(RagfileHeader), 1);
 }
 
+// pread until size bytes are read, failing on an error or an early end of file
+static FileIOError pread_full(int fd, void* buffer, size_t size, off_t offset) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = pread(fd, (char*)buffer + total, size - total, offset + (off_t)total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return FILE_IO_ERROR_READ;
+        }
+        total += (size_t)n;
+    }
+    return FILE_IO_SUCCESS;
+}
+
+FileIOError read_ragfile_header_at(const char* path, RagfileHeader* header, bool advise_random) {
+    if (!path || !header) {
+        return FILE_IO_ERROR_INVALID_ARGUMENT;
+    }
+
+    int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_NOATIME
+    int fd = open(path, flags | O_NOATIME);
+    if (fd < 0 && errno == EPERM) {
+        fd = open(path, flags);  // O_NOATIME is only allowed for the file owner
+    }
+#else
+    int fd = open(path, flags);
+#endif
+    if (fd < 0) {
+        return FILE_IO_ERROR_OPEN;
+    }
+
+#ifdef POSIX_FADV_RANDOM
+    if (advise_random) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+    }
+#else
+    (void)advise_random;
+#endif
+
+    // Read into a stack buffer so that a short read never leaves a half written header
+    unsigned char buffer[sizeof(RagfileHeader)];
+    FileIOError error = pread_full(fd, buffer, sizeof(buffer), 0);
+    close(fd);
+    if (error != FILE_IO_SUCCESS) {
+        return error;
+    }
+
+    memcpy(header, buffer, sizeof(RagfileHeader));
+    return FILE_IO_SUCCESS;
+}
+
+FileIOError read_at(const char* path, uint64_t offset, void* buffer, size_t size) {
+    if (!path || (!buffer && size > 0)) {
+        return FILE_IO_ERROR_INVALID_ARGUMENT;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return FILE_IO_ERROR_OPEN;
+    }
+    FileIOError error = pread_full(fd, buffer, size, (off_t)offset);
+    close(fd);
+    return error;
+}
+
 FileIOError write_ragfile_header(FILE* file, const RagfileHeader* header) {
     return file_write(file, header, sizeof(RagfileHeader), 1);
 }
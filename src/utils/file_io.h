@@ -23,6 +23,28 @@ FileIOError file_write(FILE* file, const void* buffer, size_t size, size_t count
 FileIOError file_seek(FILE* file, long offset, int origin);
 
 FileIOError read_ragfile_header(FILE* file, RagfileHeader* header);
+
+/**
+ * Read only the RagfileHeader of the file at path, bypassing stdio.
+ * Uses open(O_RDONLY | O_NOATIME | O_CLOEXEC) and a single pread, so no stdio
+ * buffer is allocated and nothing past the header is requested.
+ *
+ * @param path Path to the .rag file.
+ * @param header Pointer to the header to fill.
+ * @param advise_random If true, posix_fadvise(POSIX_FADV_RANDOM) disables readahead for the file.
+ * @return FILE_IO_SUCCESS on success, or an error code on failure.
+ */
+FileIOError read_ragfile_header_at(const char* path, RagfileHeader* header, bool advise_random);
+/**
+ * Read size bytes at an offset of the file at path with pread, without stdio.
+ *
+ * @param path Path to the file.
+ * @param offset Byte offset to read from.
+ * @param buffer Buffer of at least size bytes.
+ * @param size Number of bytes to read; reaching the end of the file first is an error.
+ * @return FILE_IO_SUCCESS on success, or an error code on failure.
+ */
+FileIOError read_at(const char* path, uint64_t offset, void* buffer, size_t size);
 FileIOError write_ragfile_header(FILE* file, const RagfileHeader* header);
 
 FileIOError read_file_metadata(FILE* file, FileMetadata* metadata);
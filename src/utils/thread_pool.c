@@ -0,0 +1,188 @@
+#include "thread_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct {
+    ThreadPool* pool;
+    size_t index;
+    unsigned long seen_generation;  // Last run this worker has woken up for
+    pthread_t thread;
+} ThreadPoolWorker;
+
+struct ThreadPool {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    pthread_mutex_t run_lock;   // Serializes runs and resizing
+
+    ThreadPoolWorker** workers;
+    size_t num_threads;
+
+    ThreadPoolTask task;
+    void* ctx;
+    size_t active_workers;      // Workers taking part in the current run
+    size_t pending;             // Workers that have not finished the current run
+    unsigned long generation;   // Incremented for every run
+    bool shutdown;
+};
+
+static void* thread_pool_worker_main(void* arg) {
+    ThreadPoolWorker* worker = (ThreadPoolWorker*)arg;
+    ThreadPool* pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->shutdown && pool->generation == worker->seen_generation) {
+            pthread_cond_wait(&pool->work_ready, &pool->mutex);
+        }
+        if (pool->shutdown) {
+            break;
+        }
+        worker->seen_generation = pool->generation;
+        if (worker->index >= pool->active_workers) {
+            continue;  // Not part of this run
+        }
+
+        ThreadPoolTask task = pool->task;
+        void* ctx = pool->ctx;
+        pthread_mutex_unlock(&pool->mutex);
+
+        task(ctx, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->pending == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+static size_t thread_pool_spawn(ThreadPool* pool, size_t num_threads) {
+    if (num_threads <= pool->num_threads) {
+        return pool->num_threads;
+    }
+
+    ThreadPoolWorker** workers = (ThreadPoolWorker**)realloc(pool->workers, num_threads * sizeof(ThreadPoolWorker*));
+    if (workers == NULL) {
+        return pool->num_threads;
+    }
+    pool->workers = workers;
+
+    while (pool->num_threads < num_threads) {
+        ThreadPoolWorker* worker = (ThreadPoolWorker*)malloc(sizeof(ThreadPoolWorker));
+        if (worker == NULL) {
+            break;
+        }
+        worker->pool = pool;
+        worker->index = pool->num_threads;
+
+        // Only runs started after this point are picked up by the new worker
+        pthread_mutex_lock(&pool->mutex);
+        worker->seen_generation = pool->generation;
+        if (pthread_create(&worker->thread, NULL, thread_pool_worker_main, worker) != 0) {
+            pthread_mutex_unlock(&pool->mutex);
+            free(worker);
+            break;
+        }
+        pool->workers[pool->num_threads++] = worker;
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return pool->num_threads;
+}
+
+ThreadPool* thread_pool_create(size_t num_threads) {
+    if (num_threads == 0) {
+        return NULL;
+    }
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_mutex_init(&pool->run_lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    if (thread_pool_spawn(pool, num_threads) == 0) {
+        thread_pool_free(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+size_t thread_pool_reserve(ThreadPool* pool, size_t num_threads) {
+    if (!pool) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+    size_t size = thread_pool_spawn(pool, num_threads);
+    pthread_mutex_unlock(&pool->run_lock);
+    return size;
+}
+
+size_t thread_pool_size(const ThreadPool* pool) {
+    return pool ? pool->num_threads : 0;
+}
+
+void thread_pool_run(ThreadPool* pool, ThreadPoolTask task, void* ctx, size_t num_workers) {
+    if (!pool || !task || num_workers == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+
+    if (num_workers > pool->num_threads) {
+        num_workers = pool->num_threads;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->active_workers = num_workers;
+    pool->pending = num_workers;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->mutex);
+    }
+    pool->task = NULL;
+    pool->ctx = NULL;
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_unlock(&pool->run_lock);
+}
+
+void thread_pool_free(ThreadPool* pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->run_lock);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->workers[i]->thread, NULL);
+        free(pool->workers[i]);
+    }
+    free(pool->workers);
+
+    pthread_mutex_unlock(&pool->run_lock);
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->run_lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool);
+}
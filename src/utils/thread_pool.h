@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+/**
+ * Task executed by every participating worker of a ThreadPool run.
+ *
+ * @param ctx Caller supplied context shared by all workers.
+ * @param worker Index of the worker executing the task (0 .. num_workers - 1).
+ */
+typedef void (*ThreadPoolTask)(void* ctx, size_t worker);
+
+/**
+ * Persistent pool of worker threads. Workers sleep between runs, so a pool
+ * can be kept alive for the lifetime of a process and reused by every scan.
+ */
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Create a new ThreadPool.
+ *
+ * @param num_threads Number of worker threads to start (must be > 0).
+ * @return Pointer to the pool, or NULL on failure.
+ */
+ThreadPool* thread_pool_create(size_t num_threads);
+
+/**
+ * Grow the pool so that it has at least num_threads workers.
+ * Blocks until any run in progress has finished.
+ *
+ * @param pool Pointer to the pool.
+ * @param num_threads Minimum number of workers required.
+ * @return Number of workers in the pool after growing.
+ */
+size_t thread_pool_reserve(ThreadPool* pool, size_t num_threads);
+
+/**
+ * Number of workers currently in the pool.
+ *
+ * @param pool Pointer to the pool.
+ * @return Number of workers.
+ */
+size_t thread_pool_size(const ThreadPool* pool);
+
+/**
+ * Run a task on the first num_workers workers and wait for all of them to return.
+ * Concurrent callers are serialized.
+ *
+ * @param pool Pointer to the pool.
+ * @param task Task to execute.
+ * @param ctx Context passed to every invocation of the task.
+ * @param num_workers Number of workers to use (clamped to the pool size).
+ */
+void thread_pool_run(ThreadPool* pool, ThreadPoolTask task, void* ctx, size_t num_workers);
+
+/**
+ * Stop all workers and free the pool.
+ *
+ * @param pool Pointer to the pool.
+ */
+void thread_pool_free(ThreadPool* pool);
+
+#endif // THREAD_POOL_H
@@ -1,9 +1,9 @@
 #!/bin/bash
 
 # Define common flags
-INCLUDES="-I../src/core -I../src/algorithms -I../src/utils -I../src/search"
+INCLUDES="-I../src/core -I../src/algorithms -I../src/utils -I../src/search -I../src/index"
 CFLAGS="-Wall -Wextra -std=c11 -D_POSIX_C_SOURCE=200809L $INCLUDES"
-LFLAGS="-lm"
+LFLAGS="-lm -pthread"
 
 # Function for compiling and running tests
 compile_and_run() {
@@ -25,14 +25,20 @@ compile_and_run() {
 
 # List of tests and their dependencies
 compile_and_run test_minhash "../src/core/minhash.c" "../src/algorithms/jaccard.c" "test_minhash.c"
-compile_and_run test_ragfile "../src/core/ragfile.c" "../src/core/minhash.c" "../src/algorithms/jaccard.c" "../src/algorithms/quantize.c" "../src/utils/file_io.c" "test_ragfile.c" "-DBINARY_EMBEDDING_DIM=8" 
+compile_and_run test_ragfile "../src/core/ragfile.c" "../src/core/minhash.c" "../src/algorithms/jaccard.c" "../src/algorithms/quantize.c" "../src/algorithms/cosine.c" "../src/utils/file_io.c" "test_ragfile.c" "-DBINARY_EMBEDDING_DIM=8" 
+compile_and_run test_ragfile_batch "../src/core/ragfile_batch.c" "../src/core/ragfile.c" "../src/core/minhash.c" "../src/algorithms/jaccard.c" "../src/algorithms/quantize.c" "../src/algorithms/cosine.c" "../src/utils/file_io.c" "../src/utils/thread_pool.c" "test_ragfile_batch.c"
 compile_and_run test_jaccard "../src/core/minhash.c" "../src/algorithms/jaccard.c" "test_jaccard.c"
 compile_and_run test_minhash_jaccard "../src/core/minhash.c" "../src/algorithms/jaccard.c" "test_minhash_jaccard.c"
 compile_and_run test_cosine "../src/algorithms/cosine.c" "test_cosine.c"
 compile_and_run test_hamming "../src/algorithms/hamming.c" "test_hamming.c" "-DBINARY_EMBEDDING_DIM=16"
 compile_and_run test_quantize "../src/algorithms/quantize.c" "test_quantize.c" "-DBINARY_EMBEDDING_DIM=16"
 compile_and_run test_heap "../src/search/heap.c" "../src/utils/strdup.h" "test_heap.c"
-compile_and_run test_scan "../src/search/scan.c" "../src/search/heap.c" "../src/core/ragfile.c" "../src/core/minhash.c" "../src/utils/file_io.c" "../src/algorithms/jaccard.c" "../src/algorithms/quantize.c" "test_scan.c"
+compile_and_run test_scan "../src/search/scan.c" "../src/utils/dir_walk.c" "../src/search/uring_scan.c" "../src/search/heap.c" "../src/core/ragfile.c" "../src/core/minhash.c" "../src/utils/file_io.c" "../src/utils/thread_pool.c" "../src/algorithms/jaccard.c" "../src/algorithms/quantize.c" "../src/algorithms/cosine.c" "test_scan.c"
+compile_and_run test_cascade "../src/search/cascade.c" "../src/core/ragfile.c" "../src/core/minhash.c" "../src/utils/file_io.c" "../src/utils/thread_pool.c" "../src/algorithms/jaccard.c" "../src/algorithms/hamming.c" "../src/algorithms/cosine.c" "../src/algorithms/quantize.c" "test_cascade.c"
+compile_and_run test_ragidx "../src/index/ragidx.c" "../src/search/scan.c" "../src/utils/dir_walk.c" "../src/search/uring_scan.c" "../src/search/heap.c" "../src/core/ragfile.c" "../src/core/minhash.c" "../src/utils/file_io.c" "../src/utils/thread_pool.c" "../src/algorithms/jaccard.c" "../src/algorithms/quantize.c" "../src/algorithms/cosine.c" "test_ragidx.c"
+compile_and_run test_lsh "../src/index/lsh.c" "../src/search/heap.c" "../src/algorithms/jaccard.c" "test_lsh.c"
+compile_and_run test_dir_walk "../src/utils/dir_walk.c" "test_dir_walk.c"
+compile_and_run test_thread_pool "../src/utils/thread_pool.c" "test_thread_pool.c"
 
 echo "All tests completed."
 
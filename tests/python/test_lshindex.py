@@ -0,0 +1,61 @@
+import unittest
+import ragfile
+from ragfile import LshIndex
+
+
+class TestLshIndex(unittest.TestCase):
+
+    def setUp(self):
+        self.embeddings = [[0.1] * 16]
+        self.ragfile = ragfile.RagFile(
+            text="Sample text",
+            token_ids=list(range(20)),
+            embeddings=self.embeddings,
+            tokenizer_id="tokenizer",
+            embedding_id="embedding",
+        )
+
+    def test_insert_and_query(self):
+        index = LshIndex(bands=20, rows=6)
+        index.insert("sample.rag", rf=self.ragfile)
+        self.assertEqual(len(index), 1)
+        self.assertEqual((index.bands, index.rows), (20, 6))
+        self.assertEqual(
+            index.query(self.ragfile, threshold=0.5),
+            [{"file": "sample.rag", "jaccard": 1.0}],
+        )
+        index.delete("sample.rag")
+        self.assertEqual(len(index), 0)
+
+    def test_other_model(self):
+        other = ragfile.RagFile(
+            text="Sample text",
+            token_ids=list(range(20)),
+            embeddings=self.embeddings,
+            tokenizer_id="other_tokenizer",
+            embedding_id="embedding",
+        )
+        index = LshIndex()
+        index.insert("sample.rag", rf=self.ragfile)
+        with self.assertRaises(ValueError):
+            index.insert("other.rag", rf=other)
+        self.assertEqual(len(index), 1)
+        self.assertEqual(index.query(other, threshold=0.0), [])
+
+    def test_uninitialized(self):
+        index = LshIndex.__new__(LshIndex)
+        for access in (
+            lambda: index.bands,
+            lambda: index.rows,
+            lambda: len(index),
+            lambda: index.insert("sample.rag", rf=self.ragfile),
+            lambda: index.delete("sample.rag"),
+            lambda: index.query(self.ragfile),
+            lambda: index.save("sample.rlsh"),
+        ):
+            with self.assertRaisesRegex(ValueError, "LshIndex is not initialized"):
+                access()
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,233 @@
+#include "../src/search/cascade.h"
+#include "../src/core/ragfile.h"
+#include "../src/utils/thread_pool.h"
+#include "test_util.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_NUM_FILES 150
+
+// Tokens and embedding both drift away from file 0 as i grows
+static void write_cascade_file(const char* path, uint32_t i, const char* embedding_id) {
+    float embedding[TEST_EMBEDDING_DIM];
+    for (uint32_t j = 0; j < TEST_EMBEDDING_DIM; j++) {
+        embedding[j] = (j < 2 * i ? -1.0f : 1.0f) * (1.0f + (float)((j * 7 + i) % 5));
+    }
+    write_test_file(path, "cascade test", i / 3, embedding, embedding_id);
+}
+
+static RagFile* create_reference() {
+    uint32_t tokens[16];
+    for (uint32_t t = 0; t < 16; t++) {
+        tokens[t] = t;
+    }
+    float embedding[TEST_EMBEDDING_DIM];
+    for (uint32_t j = 0; j < TEST_EMBEDDING_DIM; j++) {
+        embedding[j] = 1.0f + (float)((j * 7) % 5);
+    }
+    RagFile* reference;
+    assert(ragfile_create(&reference, "reference", tokens, 16, embedding, TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+    return reference;
+}
+
+static CascadeResult* run_cascade(ThreadPool* pool, size_t num_workers, const char* const* paths, size_t count,
+                                  const RagFile* reference, const CascadeParams* params, size_t* num_results) {
+    CascadeScan* scan = cascade_scan_create(reference, params, num_workers);
+    assert(scan != NULL);
+
+    // Feed the files in two batches
+    assert(cascade_scan_files(scan, pool, paths, count / 2) == 0);
+    assert(cascade_scan_files(scan, pool, paths + count / 2, count - count / 2) == 0);
+
+    CascadeResult* results;
+    assert(cascade_scan_finish(scan, pool, &results, num_results) == 0);
+    cascade_scan_free(scan);
+    return results;
+}
+
+void test_cascade_stages() {
+    char paths[TEST_NUM_FILES][32];
+    const char* path_ptrs[TEST_NUM_FILES];
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_cascade_%d.rag", i);
+        write_cascade_file(paths[i], (uint32_t)i, i == 0 ? "other_embedding" : "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+    RagFile* reference = create_reference();
+
+    // Invalid stage sizes are rejected
+    CascadeParams params = {20, 10, 5, 0.0, 0.0, 1.0, CASCADE_COSINE_MAX};
+    CascadeParams invalid = params;
+    invalid.jaccard_keep = 30;
+    assert(cascade_scan_create(reference, &invalid, 1) == NULL);
+
+    size_t num_results;
+    CascadeResult* results = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &params, &num_results);
+    assert(num_results == 5);
+    for (size_t i = 0; i < num_results; i++) {
+        // File 0 has a different embedding model and is never returned
+        assert(strcmp(results[i].path, paths[0]) != 0);
+        assert(results[i].score == results[i].cosine && "Only the cosine weight is set");
+        assert(i == 0 || results[i - 1].score >= results[i].score);
+        assert(results[i].hamming >= 0.0 && results[i].hamming <= 1.0);
+        assert(results[i].jaccard >= 0.0 && results[i].jaccard <= 1.0);
+    }
+
+    // Every result survived the Jaccard stage: at most jaccard_keep - 1 Hamming survivors beat it
+    CascadeParams jaccard_only = {20, 20, 20, 0.0, 1.0, 0.0, CASCADE_COSINE_MAX};
+    size_t num_ranked;
+    CascadeResult* ranked = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &jaccard_only, &num_ranked);
+    assert(num_ranked == 20);
+    for (size_t i = 0; i < num_results; i++) {
+        assert(results[i].jaccard >= ranked[params.jaccard_keep - 1].jaccard);
+    }
+
+    // The fused score mixes the stages
+    CascadeParams fused = {20, 10, 5, 0.25, 0.25, 0.5, CASCADE_COSINE_AVG};
+    size_t num_fused;
+    CascadeResult* fused_results = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &fused, &num_fused);
+    for (size_t i = 0; i < num_fused; i++) {
+        double expected = 0.25 * fused_results[i].hamming + 0.25 * fused_results[i].jaccard + 0.5 * fused_results[i].cosine;
+        assert(fabs(fused_results[i].score - expected) < 1e-9);
+    }
+
+    // A parallel scan returns the same results
+    ThreadPool* pool = thread_pool_create(3);
+    size_t num_parallel;
+    CascadeResult* parallel = run_cascade(pool, 3, path_ptrs, TEST_NUM_FILES, reference, &params, &num_parallel);
+    assert(num_parallel == num_results);
+    for (size_t i = 0; i < num_results; i++) {
+        assert(strcmp(parallel[i].path, results[i].path) == 0);
+        assert(parallel[i].score == results[i].score);
+    }
+
+    // Keeping every file grows the candidate arrays past their initial size
+    CascadeParams keep_all = {TEST_NUM_FILES, TEST_NUM_FILES, TEST_NUM_FILES, 1.0, 0.0, 0.0, CASCADE_COSINE_MAX};
+    size_t num_all;
+    CascadeResult* all = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &keep_all, &num_all);
+    assert(num_all == TEST_NUM_FILES - 1);
+    for (size_t i = 0; i < num_all; i++) {
+        assert(all[i].path != NULL && strcmp(all[i].path, paths[0]) != 0);
+        assert(i == 0 || all[i - 1].hamming >= all[i].hamming);
+    }
+    cascade_results_free(all, num_all);
+
+    // With a single reference embedding, late interaction reduces to the best pair
+    CascadeParams maxsim = params;
+    maxsim.cosine_mode = CASCADE_COSINE_MAXSIM;
+    size_t num_maxsim;
+    CascadeResult* maxsim_results = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &maxsim, &num_maxsim);
+    assert(num_maxsim == num_results);
+    for (size_t i = 0; i < num_results; i++) {
+        assert(strcmp(maxsim_results[i].path, results[i].path) == 0);
+        assert(fabs(maxsim_results[i].cosine - results[i].cosine) < 1e-9);
+    }
+
+    // A MaxSim sum over several reference embeddings is averaged in the fused score
+    uint32_t tokens[16];
+    for (uint32_t t = 0; t < 16; t++) {
+        tokens[t] = t;
+    }
+    float embeddings[3 * TEST_EMBEDDING_DIM];
+    for (uint32_t j = 0; j < 3 * TEST_EMBEDDING_DIM; j++) {
+        embeddings[j] = 1.0f + (float)(((j % TEST_EMBEDDING_DIM) * 7) % 5);
+    }
+    RagFile* chunked;
+    assert(ragfile_create(&chunked, "chunked reference", tokens, 16, embeddings, 3 * TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 3, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+    size_t num_chunked;
+    CascadeResult* chunked_results = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, chunked, &maxsim, &num_chunked);
+    assert(num_chunked == num_results);
+    for (size_t i = 0; i < num_results; i++) {
+        assert(strcmp(chunked_results[i].path, results[i].path) == 0);
+        assert(fabs(chunked_results[i].cosine - 3.0 * results[i].cosine) < 1e-6);
+        assert(fabs(chunked_results[i].score - results[i].score) < 1e-6);
+    }
+    cascade_results_free(chunked_results, num_chunked);
+    ragfile_free(chunked);
+
+    // A lazily opened reference has no embeddings until they are loaded
+    FILE* reference_file = fopen("test_cascade_reference.rag", "wb");
+    assert(reference_file != NULL && ragfile_save(reference, reference_file) == RAGFILE_SUCCESS);
+    fclose(reference_file);
+    RagFile* lazy;
+    assert(ragfile_open_lazy(&lazy, "test_cascade_reference.rag") == RAGFILE_SUCCESS && lazy->embeddings == NULL);
+    CascadeScan* lazy_scan = cascade_scan_create(lazy, &params, 1);
+    assert(cascade_scan_files(lazy_scan, NULL, path_ptrs, TEST_NUM_FILES) == 0);
+    CascadeResult* lazy_results;
+    size_t num_lazy;
+    assert(cascade_scan_finish(lazy_scan, NULL, &lazy_results, &num_lazy) == -4 && num_lazy == 0);
+    cascade_scan_free(lazy_scan);
+    assert(ragfile_load_section(lazy, RAGFILE_SECTION_EMBEDDINGS) == RAGFILE_SUCCESS);
+    lazy_results = run_cascade(NULL, 1, path_ptrs, TEST_NUM_FILES, lazy, &params, &num_lazy);
+    assert(num_lazy == num_results);
+    for (size_t i = 0; i < num_results; i++) {
+        assert(strcmp(lazy_results[i].path, results[i].path) == 0 && lazy_results[i].score == results[i].score);
+    }
+    cascade_results_free(lazy_results, num_lazy);
+    ragfile_free(lazy);
+    remove("test_cascade_reference.rag");
+
+    // A missing file is reported
+    const char* missing[] = {paths[1], "does_not_exist.rag"};
+    CascadeScan* scan = cascade_scan_create(reference, &params, 1);
+    assert(cascade_scan_files(scan, NULL, missing, 2) == -1);
+    cascade_scan_free(scan);
+
+    cascade_results_free(results, num_results);
+    cascade_results_free(ranked, num_ranked);
+    cascade_results_free(fused_results, num_fused);
+    cascade_results_free(parallel, num_parallel);
+    cascade_results_free(maxsim_results, num_maxsim);
+    thread_pool_free(pool);
+    ragfile_free(reference);
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        remove(paths[i]);
+    }
+    printf("Test cascade stages passed.\n");
+}
+
+void test_cascade_hamming_ties() {
+    // Identical files tie on every stage, so the cut keeps the smallest paths
+    const int num_files = 40;
+    char paths[40][32];
+    const char* path_ptrs[40];
+    const char* reversed[40];
+    for (int i = 0; i < num_files; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_cascade_tie_%02d.rag", i);
+        write_cascade_file(paths[i], 5, "test_embedding");
+        path_ptrs[i] = paths[i];
+        reversed[num_files - 1 - i] = paths[i];
+    }
+    RagFile* reference = create_reference();
+    CascadeParams params = {10, 10, 10, 1.0, 0.0, 0.0, CASCADE_COSINE_MAX};
+
+    ThreadPool* pool = thread_pool_create(3);
+    const char* const* orders[] = {path_ptrs, reversed, path_ptrs, reversed};
+    for (size_t run = 0; run < 4; run++) {
+        size_t num_results;
+        CascadeResult* results = run_cascade(run < 2 ? NULL : pool, run < 2 ? 1 : 3, orders[run], (size_t)num_files,
+                                             reference, &params, &num_results);
+        assert(num_results == 10);
+        for (size_t i = 0; i < num_results; i++) {
+            assert(strcmp(results[i].path, paths[i]) == 0 && "Ties should not depend on the scan order or workers");
+        }
+        cascade_results_free(results, num_results);
+    }
+
+    thread_pool_free(pool);
+    ragfile_free(reference);
+    for (int i = 0; i < num_files; i++) {
+        remove(paths[i]);
+    }
+    printf("Test cascade Hamming ties passed.\n");
+}
+
+int main() {
+    test_cascade_stages();
+    test_cascade_hamming_ties();
+    return 0;
+}
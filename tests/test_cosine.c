@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <assert.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "../src/algorithms/cosine.h"
 
 #define EPSILON 1e-6
@@ -27,8 +29,195 @@ void test_cosine_similarity() {
     assert(fabsf(similarity4 - 1.0f) < EPSILON);
 }
 
+void test_dot_product_kernels() {
+    enum { MAX_SIZE = 203 };
+    float vec1[MAX_SIZE];
+    float vec2[MAX_SIZE];
+    for (size_t i = 0; i < MAX_SIZE; i++) {
+        vec1[i] = sinf((float)i * 0.37f);
+        vec2[i] = cosf((float)i * 0.11f) - 0.25f;
+    }
+
+    // Sizes below one vector, between the unrolled and single-vector loops, and with odd tails
+    static const size_t sizes[] = {0, 1, 7, 8, 15, 16, 31, 33, 64, 65, 128, 200, MAX_SIZE};
+    static const CosineKernel kernels[] = {COSINE_KERNEL_SCALAR, COSINE_KERNEL_AVX2, COSINE_KERNEL_AVX512};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        double expected = 0.0;
+        for (size_t i = 0; i < sizes[s]; i++) {
+            expected += (double)vec1[i] * vec2[i];
+        }
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            if (!cosine_kernel_supported(kernels[k])) {
+                continue;
+            }
+            float result = dot_product_with_kernel(vec1, vec2, sizes[s], kernels[k]);
+            assert(fabs(result - expected) < 1e-4);
+        }
+        assert(fabs(dot_product(vec1, vec2, sizes[s]) - expected) < 1e-4);
+    }
+    printf("Test dot product kernels passed.\n");
+}
+
+void test_cosine_similarity_pairs() {
+    enum { DIM = 40, COUNT1 = 3, COUNT2 = 5 };
+    float set1[COUNT1 * DIM];
+    float set2[COUNT2 * DIM];
+    for (size_t i = 0; i < COUNT1 * DIM; i++) {
+        set1[i] = sinf((float)i * 0.7f) * 3.0f;
+    }
+    for (size_t i = 0; i < COUNT2 * DIM; i++) {
+        set2[i] = cosf((float)i * 0.3f) + 0.1f;
+    }
+    memset(set2 + 4 * DIM, 0, DIM * sizeof(float));  // A zero vector scores 0 against everything
+
+    double expected_max = -1.0;
+    double expected_total = 0.0;
+    for (size_t i = 0; i < COUNT1; i++) {
+        for (size_t j = 0; j < COUNT2; j++) {
+            double similarity = cosine_similarity(set1 + i * DIM, set2 + j * DIM, DIM);
+            expected_max = similarity > expected_max ? similarity : expected_max;
+            expected_total += similarity;
+        }
+    }
+
+    float norms1[COUNT1];
+    float norms2[COUNT2];
+    l2_norms(set1, COUNT1, DIM, norms1);
+    l2_norms(set2, COUNT2, DIM, norms2);
+    assert(norms2[4] == 0.0f);
+    double max_similarity;
+    double mean_similarity;
+    cosine_similarity_pairs(set1, norms1, COUNT1, set2, norms2, COUNT2, DIM, &max_similarity, &mean_similarity);
+    assert(fabs(max_similarity - expected_max) < EPSILON);
+    assert(fabs(mean_similarity - expected_total / (COUNT1 * COUNT2)) < EPSILON);
+
+    // Once normalized, the sets need no norms and score the same
+    l2_normalize(set1, COUNT1, DIM);
+    l2_normalize(set2, COUNT2, DIM);
+    l2_norms(set1, COUNT1, DIM, norms1);
+    assert(fabsf(norms1[0] - 1.0f) < EPSILON && fabsf(norms1[2] - 1.0f) < EPSILON);
+    cosine_similarity_pairs(set1, NULL, COUNT1, set2, NULL, COUNT2, DIM, &max_similarity, &mean_similarity);
+    assert(fabs(max_similarity - expected_max) < EPSILON);
+    assert(fabs(mean_similarity - expected_total / (COUNT1 * COUNT2)) < EPSILON);
+
+    cosine_similarity_pairs(set1, NULL, 0, set2, NULL, COUNT2, DIM, &max_similarity, &mean_similarity);
+    assert(max_similarity == -1.0 && mean_similarity == 0.0);
+    printf("Test cosine similarity pairs passed.\n");
+}
+
+// Cosine similarity of one pair in double precision, 0 for zero vectors
+static double reference_cosine(const float* vec1, const float* vec2, size_t size) {
+    double dot = 0.0, norm1 = 0.0, norm2 = 0.0;
+    for (size_t i = 0; i < size; i++) {
+        dot += (double)vec1[i] * vec2[i];
+        norm1 += (double)vec1[i] * vec1[i];
+        norm2 += (double)vec2[i] * vec2[i];
+    }
+    return norm1 == 0.0 || norm2 == 0.0 ? 0.0 : dot / sqrt(norm1 * norm2);
+}
+
+static void fill_vectors(float* vectors, size_t count, size_t size, float seed) {
+    for (size_t i = 0; i < count * size; i++) {
+        vectors[i] = sinf((float)i * seed) + 0.1f * cosf((float)i * 0.013f);
+    }
+}
+
+void test_cosine_similarity_matrix() {
+    // Ragged tiles, several cache blocks of vectors, and vectors longer than one block depth
+    static const size_t shapes[][3] = {{1, 1, 5}, {4, 4, 16}, {7, 9, 33}, {70, 5, 17}, {5, 131, 40}, {6, 6, 1500}};
+    static const CosineKernel kernels[] = {COSINE_KERNEL_SCALAR, COSINE_KERNEL_AVX2, COSINE_KERNEL_AVX512};
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t count1 = shapes[s][0], count2 = shapes[s][1], size = shapes[s][2];
+        float* set1 = (float*)malloc(count1 * size * sizeof(float));
+        float* set2 = (float*)malloc(count2 * size * sizeof(float));
+        float* norms1 = (float*)malloc(count1 * sizeof(float));
+        float* norms2 = (float*)malloc(count2 * sizeof(float));
+        float* scores = (float*)malloc(count1 * count2 * sizeof(float));
+        assert(set1 && set2 && norms1 && norms2 && scores);
+        fill_vectors(set1, count1, size, 0.61f);
+        fill_vectors(set2, count2, size, 0.23f);
+        memset(set2, 0, size * sizeof(float));  // A zero vector scores 0 against everything
+        l2_norms(set1, count1, size, norms1);
+        l2_norms(set2, count2, size, norms2);
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            if (!cosine_kernel_supported(kernels[k])) {
+                assert(!cosine_similarity_matrix_with_kernel(set1, norms1, count1, set2, norms2, count2, size,
+                                                             scores, kernels[k]));
+                continue;
+            }
+            assert(cosine_similarity_matrix_with_kernel(set1, norms1, count1, set2, norms2, count2, size,
+                                                        scores, kernels[k]));
+            for (size_t i = 0; i < count1; i++) {
+                for (size_t j = 0; j < count2; j++) {
+                    double expected = reference_cosine(set1 + i * size, set2 + j * size, size);
+                    assert(fabs(scores[i * count2 + j] - expected) < 1e-4);
+                }
+            }
+        }
+        free(set1);
+        free(set2);
+        free(norms1);
+        free(norms2);
+        free(scores);
+    }
+    printf("Test cosine similarity matrix passed.\n");
+}
+
+void test_cosine_similarity_reduce() {
+    enum { DIM = 48, QUERY = 9, NUM_CANDIDATES = 3 };
+    static const size_t candidate_counts[NUM_CANDIDATES] = {5, 1, 70};
+    float query[QUERY * DIM];
+    float candidate_data[76 * DIM];
+    fill_vectors(query, QUERY, DIM, 0.41f);
+    fill_vectors(candidate_data, 76, DIM, 0.17f);
+    const float* candidates[NUM_CANDIDATES] = {candidate_data, candidate_data + 5 * DIM, candidate_data + 6 * DIM};
+
+    float query_norms[QUERY];
+    float candidate_norms[76];
+    l2_norms(query, QUERY, DIM, query_norms);
+    l2_norms(candidate_data, 76, DIM, candidate_norms);
+    const float* norms[NUM_CANDIDATES] = {candidate_norms, candidate_norms + 5, candidate_norms + 6};
+
+    static const CosineReduction reductions[] = {COSINE_REDUCE_MAX, COSINE_REDUCE_MEAN, COSINE_REDUCE_MAXSIM};
+    for (size_t r = 0; r < sizeof(reductions) / sizeof(reductions[0]); r++) {
+        double scores[NUM_CANDIDATES];
+        assert(cosine_similarity_batch(query, query_norms, QUERY, candidates, norms, candidate_counts,
+                                       NUM_CANDIDATES, DIM, reductions[r], scores));
+        for (size_t c = 0; c < NUM_CANDIDATES; c++) {
+            double best = -1.0, total = 0.0, maxsim = 0.0;
+            for (size_t i = 0; i < QUERY; i++) {
+                double row_best = -1.0;
+                for (size_t j = 0; j < candidate_counts[c]; j++) {
+                    double similarity = reference_cosine(query + i * DIM, candidates[c] + j * DIM, DIM);
+                    row_best = similarity > row_best ? similarity : row_best;
+                    total += similarity;
+                }
+                best = row_best > best ? row_best : best;
+                maxsim += row_best;
+            }
+            double expected = reductions[r] == COSINE_REDUCE_MAX ? best
+                            : reductions[r] == COSINE_REDUCE_MEAN ? total / (QUERY * candidate_counts[c])
+                            : maxsim;
+            assert(fabs(scores[c] - expected) < 1e-4);
+            assert(scores[c] == cosine_similarity_reduce(query, query_norms, QUERY, candidates[c], norms[c],
+                                                         candidate_counts[c], DIM, reductions[r]));
+        }
+    }
+
+    // Empty sets
+    assert(cosine_similarity_reduce(query, NULL, QUERY, candidate_data, NULL, 0, DIM, COSINE_REDUCE_MAX) == -1.0);
+    assert(cosine_similarity_reduce(query, NULL, 0, candidate_data, NULL, 5, DIM, COSINE_REDUCE_MAXSIM) == 0.0);
+    assert(cosine_similarity_reduce(query, NULL, QUERY, candidate_data, NULL, 0, DIM, COSINE_REDUCE_MEAN) == 0.0);
+    printf("Test cosine similarity reductions passed.\n");
+}
+
 int main() {
     test_cosine_similarity();
+    test_dot_product_kernels();
+    test_cosine_similarity_pairs();
+    test_cosine_similarity_matrix();
+    test_cosine_similarity_reduce();
     printf("All cosine similarity tests passed!\n");
     return 0;
 }
@@ -0,0 +1,151 @@
+#include "../src/utils/dir_walk.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_ROOT "test_walk_root"
+#define TEST_MAX_PATHS 64
+
+typedef struct {
+    char* paths[TEST_MAX_PATHS];
+    size_t count;
+    size_t batches;
+    int stop_status;  // Returned from the first callback when non-zero
+} Collected;
+
+static int collect(void* ctx, const char* const* paths, size_t count) {
+    Collected* collected = (Collected*)ctx;
+    collected->batches++;
+    for (size_t i = 0; i < count; i++) {
+        assert(collected->count < TEST_MAX_PATHS);
+        collected->paths[collected->count++] = strdup(paths[i]);
+    }
+    return collected->stop_status;
+}
+
+static int contains(const Collected* collected, const char* path) {
+    for (size_t i = 0; i < collected->count; i++) {
+        if (strcmp(collected->paths[i], path) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void collected_free(Collected* collected) {
+    for (size_t i = 0; i < collected->count; i++) {
+        free(collected->paths[i]);
+    }
+    memset(collected, 0, sizeof(*collected));
+}
+
+static void touch(const char* path) {
+    FILE* file = fopen(path, "wb");
+    assert(file != NULL && "Failed to create test file");
+    fclose(file);
+}
+
+static const char* test_files[] = {
+    TEST_ROOT "/a.rag",
+    TEST_ROOT "/notes.txt",
+    TEST_ROOT "/sub/doc_1.rag",
+    TEST_ROOT "/sub/doc_2.rag",
+    TEST_ROOT "/sub/deeper/doc_3.rag",
+    TEST_ROOT "/sub/deeper/other.rag",
+    TEST_ROOT "/sub/deeper/doc_4.ragx",
+};
+
+static void create_tree() {
+    assert(mkdir(TEST_ROOT, 0755) == 0);
+    assert(mkdir(TEST_ROOT "/sub", 0755) == 0);
+    assert(mkdir(TEST_ROOT "/sub/deeper", 0755) == 0);
+    assert(mkdir(TEST_ROOT "/empty", 0755) == 0);
+    for (size_t i = 0; i < sizeof(test_files) / sizeof(test_files[0]); i++) {
+        touch(test_files[i]);
+    }
+    // A symlinked file is followed, a symlinked directory (here a cycle) is not
+    assert(symlink("sub/doc_1.rag", TEST_ROOT "/link.rag") == 0);
+    assert(symlink("..", TEST_ROOT "/sub/loop") == 0);
+}
+
+static void remove_tree() {
+    for (size_t i = 0; i < sizeof(test_files) / sizeof(test_files[0]); i++) {
+        remove(test_files[i]);
+    }
+    remove(TEST_ROOT "/link.rag");
+    remove(TEST_ROOT "/sub/loop");
+    rmdir(TEST_ROOT "/sub/deeper");
+    rmdir(TEST_ROOT "/sub");
+    rmdir(TEST_ROOT "/empty");
+    rmdir(TEST_ROOT);
+}
+
+void test_dir_walk_patterns() {
+    create_tree();
+    Collected collected = {0};
+
+    // The default pattern finds every .rag file, including through the file symlink
+    assert(dir_walk(TEST_ROOT, NULL, 0, collect, &collected) == 0);
+    assert(collected.count == 6);
+    assert(collected.batches == 1);
+    assert(contains(&collected, TEST_ROOT "/a.rag"));
+    assert(contains(&collected, TEST_ROOT "/link.rag"));
+    assert(contains(&collected, TEST_ROOT "/sub/deeper/doc_3.rag"));
+    assert(!contains(&collected, TEST_ROOT "/notes.txt"));
+    assert(!contains(&collected, TEST_ROOT "/sub/deeper/doc_4.ragx"));
+    collected_free(&collected);
+
+    // A trailing slash on the root does not double up
+    assert(dir_walk(TEST_ROOT "/", "*.rag", 0, collect, &collected) == 0);
+    assert(collected.count == 6);
+    assert(contains(&collected, TEST_ROOT "/sub/doc_2.rag"));
+    collected_free(&collected);
+
+    // Globs match the file name only
+    assert(dir_walk(TEST_ROOT, "doc_?.rag", 0, collect, &collected) == 0);
+    assert(collected.count == 3);
+    assert(!contains(&collected, TEST_ROOT "/sub/deeper/other.rag"));
+    collected_free(&collected);
+
+    // A pattern without wildcards is a suffix
+    assert(dir_walk(TEST_ROOT, ".ragx", 0, collect, &collected) == 0);
+    assert(collected.count == 1);
+    assert(contains(&collected, TEST_ROOT "/sub/deeper/doc_4.ragx"));
+    collected_free(&collected);
+
+    remove_tree();
+    printf("Test dir_walk patterns passed.\n");
+}
+
+void test_dir_walk_batches() {
+    create_tree();
+    Collected collected = {0};
+
+    // Small batches are flushed as they fill, with the remainder at the end
+    assert(dir_walk(TEST_ROOT, NULL, 4, collect, &collected) == 0);
+    assert(collected.count == 6);
+    assert(collected.batches == 2);
+    collected_free(&collected);
+
+    // A non-zero callback status stops the walk and is returned
+    collected.stop_status = 7;
+    assert(dir_walk(TEST_ROOT, NULL, 1, collect, &collected) == 7);
+    assert(collected.count == 1);
+    collected_free(&collected);
+
+    // A missing root is reported
+    assert(dir_walk("does_not_exist_dir", NULL, 0, collect, &collected) == DIR_WALK_ERROR_ROOT);
+    assert(collected.count == 0);
+
+    remove_tree();
+    printf("Test dir_walk batches passed.\n");
+}
+
+int main() {
+    test_dir_walk_patterns();
+    test_dir_walk_batches();
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <math.h>
+#include <assert.h>
+#include <string.h>
 #include "../src/algorithms/hamming.h"
 
 void testHammingDistance() {
@@ -57,9 +59,99 @@ int testHammingSimilarityExt() {
     return !success; // Return 0 on success, 1 on failure
 }
 
+// Bit-by-bit reference distance
+static int reference_distance(const uint8_t* a, const uint8_t* b, size_t size) {
+    int distance = 0;
+    for (size_t i = 0; i < size * 8; i++) {
+        distance += ((a[i / 8] >> (i % 8)) & 1) != ((b[i / 8] >> (i % 8)) & 1);
+    }
+    return distance;
+}
+
+void testHammingKernels() {
+    enum { NUM_CODES = 37, MAX_SIZE = 72 };
+    static uint8_t codes[NUM_CODES * MAX_SIZE];
+    uint8_t query[MAX_SIZE];
+    uint32_t state = 12345;
+    for (size_t i = 0; i < sizeof(codes); i++) {
+        state = state * 1103515245u + 12345u;
+        codes[i] = (uint8_t)(state >> 16);
+    }
+    for (size_t i = 0; i < MAX_SIZE; i++) {
+        query[i] = (uint8_t)(i * 37 + 11);
+    }
+
+    // Sizes packed several to a vector, a full vector, and sizes left to the word loop
+    static const size_t sizes[] = {8, 16, 32, 64, 3, 24, 72};
+    static const HammingKernel kernels[] = {HAMMING_KERNEL_SCALAR, HAMMING_KERNEL_POPCNT, HAMMING_KERNEL_AVX2, HAMMING_KERNEL_AVX512};
+    uint16_t distances[NUM_CODES];
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t size = sizes[s];
+        for (size_t n = 0; n < NUM_CODES; n++) {
+            assert(hamming_distance(query, codes + n * size, size) == reference_distance(query, codes + n * size, size));
+        }
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+            if (!hamming_kernel_supported(kernels[k])) {
+                printf("Skipping Hamming kernel %d, not supported by this CPU\n", (int)kernels[k]);
+                continue;
+            }
+            memset(distances, 0xff, sizeof(distances));
+            assert(hamming_distance_many_with_kernel(query, codes, NUM_CODES, size, distances, kernels[k]) == 0);
+            for (size_t n = 0; n < NUM_CODES; n++) {
+                assert(distances[n] == reference_distance(query, codes + n * size, size));
+            }
+        }
+    }
+
+    assert(hamming_distance(NULL, query, 16) == -1);
+    assert(hamming_similarity(query, NULL, 16) == -1.0);
+    assert(hamming_distance_many(query, codes, NUM_CODES, HAMMING_MAX_CODE_BYTES + 1, distances) == -1);
+    printf("Test Hamming kernels passed.\n");
+}
+
+void testHammingTopK() {
+    enum { NUM_CODES = 3000, SIZE = 16, K = 10 };
+    static uint8_t codes[NUM_CODES * SIZE];
+    uint8_t query[SIZE] = {0};
+    // Code n differs from the query in (n * 7919) % 97 bits, so distances repeat and ties are broken by index
+    for (size_t n = 0; n < NUM_CODES; n++) {
+        size_t bits = (n * 7919) % 97 % (SIZE * 8 + 1);
+        for (size_t b = 0; b < bits; b++) {
+            codes[n * SIZE + b / 8] |= (uint8_t)(1u << (b % 8));
+        }
+    }
+
+    HammingMatch matches[K];
+    assert(hamming_top_k(query, codes, NUM_CODES, SIZE, K, matches) == K);
+
+    // Each match is the smallest (distance, index) after the previous one
+    uint16_t distances[NUM_CODES];
+    assert(hamming_distance_many(query, codes, NUM_CODES, SIZE, distances) == 0);
+    for (size_t r = 0; r < K; r++) {
+        size_t best = NUM_CODES;
+        for (size_t n = 0; n < NUM_CODES; n++) {
+            int after_previous = r == 0 || distances[n] > matches[r - 1].distance ||
+                                 (distances[n] == matches[r - 1].distance && n > matches[r - 1].index);
+            if (after_previous && (best == NUM_CODES || distances[n] < distances[best])) {
+                best = n;
+            }
+        }
+        assert(matches[r].index == best && matches[r].distance == distances[best]);
+    }
+    assert(matches[0].distance == 0 && matches[0].index == 0);
+
+    // k larger than the number of codes returns them all
+    HammingMatch all[4];
+    assert(hamming_top_k(query, codes, 3, SIZE, 4, all) == 3);
+    assert(hamming_top_k(query, codes, NUM_CODES, SIZE, 0, all) == 0);
+    printf("Test Hamming top-k passed.\n");
+}
+
 int main() {
     testHammingDistance(); // Existing function call
     testHammingSimilarity(); // New function call
     testHammingSimilarityExt();
+    testHammingKernels();
+    testHammingTopK();
     return 0;
 }
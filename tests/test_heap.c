@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 #include <time.h>
 #include "../src/search/heap.h"
@@ -97,11 +98,177 @@ void test_heap_remove_root() {
     printf("Test Heap Remove Root passed.\n");
 }
 
+void test_heap_offer() {
+    MinHeap* heap = create_min_heap(3);
+    char path[32];
+
+    // Paths are copied on admission, so the caller's buffer can be reused
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "file%d.txt", i);
+        assert(heap_offer(heap, path, 0.5 + i * 0.1) == 1);
+    }
+    assert(strcmp(heap->heap[0].path, "file0.txt") == 0);
+
+    // A rejected candidate is not copied
+    size_t arena_used = heap->arena_used;
+    assert(heap_offer(heap, "rejected.txt", 0.5) == 0);
+    assert(heap_offer(heap, "rejected.txt", 0.1) == 0);
+    assert(heap->arena_used == arena_used && "Rejection should not touch the arena");
+
+    assert(heap_offer(heap, "file3.txt", 0.95) == 1);
+    assert(heap->size == 3);
+    assert(strcmp(heap->heap[0].path, "file1.txt") == 0);
+
+    // Merging copies the paths into the destination and empties the source
+    MinHeap* dest = create_min_heap(2);
+    assert(merge_heaps(dest, heap) == 0);
+    assert(heap->size == 0 && heap->arena_used == 0);
+    assert(dest->size == 2);
+    assert(strcmp(dest->heap[0].path, "file2.txt") == 0 && dest->heap[0].score == 0.7);
+    remove_root(dest);
+    assert(strcmp(dest->heap[0].path, "file3.txt") == 0);
+
+    // A zero capacity heap admits nothing
+    MinHeap* empty = create_min_heap(0);
+    assert(heap_offer(empty, "file.txt", 1.0) == 0);
+
+    // Capacities beyond INT_MAX are representable; ones that cannot be allocated fail cleanly
+    assert(create_top_k(SIZE_MAX, HEAP_STRATEGY_SELECT) == NULL);
+    assert(create_top_k(SIZE_MAX / 2, HEAP_STRATEGY_HEAP) == NULL);
+
+    free_min_heap(empty);
+    free_min_heap(dest);
+    free_min_heap(heap);
+    printf("Test Heap Offer passed.\n");
+}
+
+void test_heap_arena_bounded() {
+    // Increasing scores replace the root on every offer, the worst case for the arena
+    MinHeap* heap = create_min_heap(10);
+    char path[64];
+    for (int i = 0; i < 200000; i++) {
+        snprintf(path, sizeof(path), "corpus/shard_%03d/document_%07d.rag", i % 100, i);
+        assert(heap_offer(heap, path, (double)i) == 1);
+        assert(heap->arena_used <= 4 * HEAP_ARENA_BLOCK_SIZE && "Dead paths should be reclaimed");
+    }
+
+    // Compaction keeps the surviving paths intact
+    for (int i = 200000 - 10; i < 200000; i++) {
+        snprintf(path, sizeof(path), "corpus/shard_%03d/document_%07d.rag", i % 100, i);
+        assert(heap->heap[0].score == (double)i);
+        assert(strcmp(heap->heap[0].path, path) == 0);
+        remove_root(heap);
+    }
+    assert(heap->arena_used == 0 && heap->arena_live == 0);
+
+    free_min_heap(heap);
+    printf("Test Heap Arena Bounded passed.\n");
+}
+
+// Deterministic score stream with plenty of ties
+static double stream_score(unsigned int* state) {
+    *state = *state * 1103515245u + 12345u;
+    return (double)((*state >> 8) % 5000) / 5000.0;
+}
+
+void test_heap_select() {
+    const size_t k = 300;
+    MinHeap* heap = create_top_k(k, HEAP_STRATEGY_HEAP);
+    MinHeap* select = create_top_k(k, HEAP_STRATEGY_SELECT);
+    MinHeap* large = create_min_heap(HEAP_SELECT_MIN_CAPACITY);
+    assert(large->select && !heap->select && "Large capacities should select");
+    free_min_heap(large);
+
+    unsigned int state = 1;
+    char path[32];
+    for (int i = 0; i < 20000; i++) {
+        double score = stream_score(&state);
+        snprintf(path, sizeof(path), "file%d.txt", i);
+        heap_offer(heap, path, score);
+        heap_offer(select, path, score);
+    }
+    assert(select->size <= 2 * k);
+
+    // Both strategies keep the same scores, sorted ascending
+    assert(heap_sort(heap) == k);
+    assert(heap_sort(select) == k);
+    for (size_t i = 0; i < k; i++) {
+        assert(heap->heap[i].score == select->heap[i].score);
+        assert(i == 0 || select->heap[i - 1].score <= select->heap[i].score);
+    }
+
+    // The sorted array is still a heap, and removal works on a selection buffer
+    heap_offer(select, "best.txt", 2.0);
+    double previous = -1.0;
+    for (size_t i = 0; i < k; i++) {
+        assert(select->heap[0].score >= previous);
+        previous = select->heap[0].score;
+        remove_root(select);
+    }
+    assert(select->size == 0);
+    assert(previous == 2.0);
+
+    // Merging a selection buffer into a heap keeps the best entries
+    for (int i = 0; i < 1000; i++) {
+        snprintf(path, sizeof(path), "file%d.txt", i);
+        heap_offer(select, path, (double)i);
+    }
+    MinHeap* small = create_min_heap(5);
+    assert(merge_heaps(small, select) == 0);
+    assert(heap_sort(small) == 5 && small->heap[0].score == 995.0 && small->heap[4].score == 999.0);
+    assert(strcmp(small->heap[4].path, "file999.txt") == 0);
+
+    free_min_heap(small);
+    free_min_heap(heap);
+    free_min_heap(select);
+    printf("Test Heap Select passed.\n");
+}
+
+static double bench_top_k(HeapStrategy strategy, int k, int count, int ascending, double* checksum) {
+    MinHeap* heap = create_top_k(k, strategy);
+    unsigned int state = 7;
+    char path[32];
+    clock_t start = clock();
+    for (int i = 0; i < count; i++) {
+        double score = ascending ? (double)i : stream_score(&state) + (double)(i % 97) * 1e-9;
+        snprintf(path, sizeof(path), "doc_%d.rag", i);
+        heap_offer(heap, path, score);
+    }
+    size_t size = heap_sort(heap);
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    *checksum = 0.0;
+    for (size_t i = 0; i < size; i++) {
+        *checksum += heap->heap[i].score * (i + 1);
+    }
+    free_min_heap(heap);
+    return elapsed;
+}
+
+void test_heap_large_k_benchmark() {
+    const int k = 20000;
+    const int count = 1000000;
+    const char* names[] = {"random", "ascending"};
+    for (int ascending = 0; ascending <= 1; ascending++) {
+        double heap_sum;
+        double select_sum;
+        double heap_time = bench_top_k(HEAP_STRATEGY_HEAP, k, count, ascending, &heap_sum);
+        double select_time = bench_top_k(HEAP_STRATEGY_SELECT, k, count, ascending, &select_sum);
+        assert(heap_sum == select_sum && "Both strategies should keep the same scores");
+        printf("Benchmark top-%d of %d %s scores: heap %f s, select %f s\n", k, count, names[ascending],
+               heap_time, select_time);
+    }
+}
+
 int main() {
     test_heap_basic_operations();
     test_heap_replacement();
     test_heap_performance();
     test_heap_remove_root();
+    test_heap_offer();
+    test_heap_arena_bounded();
+    test_heap_select();
+    test_heap_large_k_benchmark();
     return 0;
 }
 
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
+#include <string.h>
 #include "../src/include/config.h"
 #include "../src/core/minhash.h"
 #include "../src/algorithms/jaccard.h"
@@ -38,8 +40,138 @@ void test_jaccard_similarity() {
     minhash_free(mh3);
 }
 
+void test_jaccard_similarity_many() {
+    // Seven queries cover a full block of four and a remainder of three
+    enum { NUM_QUERIES = 7 };
+    static uint32_t queries[NUM_QUERIES * MINHASH_SIZE];
+    uint32_t signature[MINHASH_SIZE];
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        signature[i] = (uint32_t)(i * 2654435761u);
+        for (size_t q = 0; q < NUM_QUERIES; q++) {
+            // Query q agrees with the signature on every (q + 1)th value
+            queries[q * MINHASH_SIZE + i] = i % (q + 1) == 0 ? signature[i] : signature[i] + 1;
+        }
+    }
+
+    float scores[NUM_QUERIES];
+    jaccard_similarity_many(signature, queries, NUM_QUERIES, scores);
+    for (size_t q = 0; q < NUM_QUERIES; q++) {
+        assert(scores[q] == jaccard_similarity(signature, queries + q * MINHASH_SIZE));
+    }
+    assert(scores[0] == 1.0f);
+    assert(scores[6] < scores[1]);
+}
+
+void test_jaccard_kernels() {
+    // Signature n agrees with the base on the slots where (i * 7 + n) % (n + 2) == 0
+    enum { NUM_SIGNATURES = 11, NUM_QUERIES = 9 };
+    static uint32_t signatures[NUM_SIGNATURES * MINHASH_SIZE];
+    static uint32_t queries[NUM_QUERIES * MINHASH_SIZE];
+    for (size_t n = 0; n < NUM_SIGNATURES; n++) {
+        for (size_t i = 0; i < MINHASH_SIZE; i++) {
+            uint32_t base = (uint32_t)(i * 2654435761u);
+            signatures[n * MINHASH_SIZE + i] = (i * 7 + n) % (n + 2) == 0 ? base : base ^ (uint32_t)(n + 1);
+        }
+    }
+    for (size_t q = 0; q < NUM_QUERIES; q++) {
+        for (size_t i = 0; i < MINHASH_SIZE; i++) {
+            uint32_t base = (uint32_t)(i * 2654435761u);
+            queries[q * MINHASH_SIZE + i] = i % (q + 1) == 0 ? base : base + (uint32_t)(q + 100);
+        }
+    }
+
+    static const JaccardKernel kernels[] = {JACCARD_KERNEL_SCALAR, JACCARD_KERNEL_AVX2, JACCARD_KERNEL_AVX512};
+    static float expected[NUM_QUERIES * NUM_SIGNATURES];
+    static float scores[NUM_QUERIES * NUM_SIGNATURES];
+    for (size_t q = 0; q < NUM_QUERIES; q++) {
+        for (size_t n = 0; n < NUM_SIGNATURES; n++) {
+            uint32_t matches = 0;
+            for (size_t i = 0; i < MINHASH_SIZE; i++) {
+                matches += queries[q * MINHASH_SIZE + i] == signatures[n * MINHASH_SIZE + i];
+            }
+            expected[q * NUM_SIGNATURES + n] = (float)matches / MINHASH_SIZE;
+        }
+    }
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!jaccard_kernel_supported(kernels[k])) {
+            printf("Skipping Jaccard kernel %d, not supported by this CPU\n", (int)kernels[k]);
+            continue;
+        }
+        for (size_t q = 0; q < NUM_QUERIES; q++) {
+            for (size_t n = 0; n < NUM_SIGNATURES; n++) {
+                float score = jaccard_similarity_with_kernel(queries + q * MINHASH_SIZE,
+                                                             signatures + n * MINHASH_SIZE, kernels[k]);
+                assert(score == expected[q * NUM_SIGNATURES + n]);
+            }
+        }
+
+        // Query counts of 1 (one against many), a partial block, and full blocks plus a remainder
+        static const size_t query_counts[] = {1, 3, 4, NUM_QUERIES};
+        for (size_t c = 0; c < sizeof(query_counts) / sizeof(query_counts[0]); c++) {
+            size_t num_queries = query_counts[c];
+            memset(scores, 0, sizeof(scores));
+            assert(jaccard_similarity_matrix_with_kernel(queries, num_queries, signatures, NUM_SIGNATURES,
+                                                         scores, kernels[k]) == 1);
+            assert(memcmp(scores, expected, num_queries * NUM_SIGNATURES * sizeof(float)) == 0);
+        }
+    }
+
+    jaccard_similarity_matrix(queries, NUM_QUERIES, signatures, NUM_SIGNATURES, scores);
+    assert(memcmp(scores, expected, sizeof(expected)) == 0);
+    jaccard_similarity_many(queries, signatures, NUM_SIGNATURES, scores);
+    assert(memcmp(scores, expected, NUM_SIGNATURES * sizeof(float)) == 0);
+    assert(jaccard_similarity_matrix_with_kernel(NULL, 1, signatures, NUM_SIGNATURES, scores, JACCARD_KERNEL_AUTO) == 0);
+
+    printf("Test Jaccard kernels passed.\n");
+}
+
+void test_bbit_jaccard_similarity() {
+    uint32_t signature[MINHASH_SIZE];
+    uint32_t other[MINHASH_SIZE];
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        signature[i] = (uint32_t)(state >> 32);
+        // Half of the slots agree, the others are unrelated values
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        other[i] = i % 2 == 0 ? signature[i] : (uint32_t)(state >> 32);
+    }
+    assert(fabsf(jaccard_similarity(signature, other) - 0.5f) < 0.01f);
+
+    assert(bbit_bits_supported(1) && bbit_bits_supported(16));
+    assert(!bbit_bits_supported(0) && !bbit_bits_supported(3) && !bbit_bits_supported(32));
+
+    static const unsigned widths[] = {1, 2, 4, 8, 16};
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        unsigned bits = widths[w];
+        uint64_t packed[BBIT_SIGNATURE_WORDS(BBIT_MAX_BITS)];
+        uint64_t packed_other[BBIT_SIGNATURE_WORDS(BBIT_MAX_BITS)];
+        bbit_pack_signature(signature, bits, packed);
+        bbit_pack_signature(other, bits, packed_other);
+
+        // Slot i keeps its lowest bits at bit i * bits
+        for (size_t i = 0; i < MINHASH_SIZE; i++) {
+            uint64_t slot = (packed[i * bits / 64] >> (i * bits % 64)) & ((UINT64_C(1) << bits) - 1);
+            assert(slot == (signature[i] & ((UINT32_C(1) << bits) - 1)));
+        }
+
+        assert(bbit_jaccard_similarity(packed, packed, bits) == 1.0f);
+
+        // The corrected estimate stays near the full signature Jaccard, tighter with more bits
+        float estimate = bbit_jaccard_similarity(packed, packed_other, bits);
+        float tolerance = bits == 1 ? 0.2f : 0.1f;
+        assert(fabsf(estimate - 0.5f) < tolerance);
+    }
+
+    printf("Test b-bit Jaccard similarity passed.\n");
+}
+
 int main() {
     test_jaccard_similarity();
+    test_jaccard_similarity_many();
+    test_jaccard_kernels();
+    test_bbit_jaccard_similarity();
     printf("All Jaccard similarity tests passed!\n");
     return 0;
 }
@@ -0,0 +1,200 @@
+#include "../src/index/lsh.h"
+#include "../src/search/heap.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_NUM_ENTRIES 500
+
+// Entry i differs from entry 0 in (i + 1) / 2 slots spread over the whole signature
+static void make_signature(uint32_t* signature, uint32_t i) {
+    for (uint32_t slot = 0; slot < MINHASH_SIZE; slot++) {
+        signature[slot] = (slot * 167u) % MINHASH_SIZE < (i + 1) / 2 ? slot + 100000u * (i + 1) : slot;
+    }
+}
+
+static void make_path(char* path, size_t size, uint32_t i) {
+    snprintf(path, size, "doc_%u.rag", i);
+}
+
+void test_lsh_create() {
+    LshIndex* index;
+    assert(lsh_create(&index, 0, 6) == LSH_ERROR_INVALID_ARGUMENT);
+    assert(lsh_create(&index, 20, 7) == LSH_ERROR_INVALID_ARGUMENT);  // 140 > LSH_HALF_SIZE
+    assert(lsh_create(&index, LSH_DEFAULT_BANDS, LSH_DEFAULT_ROWS) == LSH_SUCCESS);
+    assert(lsh_size(index) == 0);
+    lsh_free(index);
+
+    uint16_t bands = 1, rows = 1;
+    lsh_config(NULL, &bands, &rows);
+    assert(bands == 0 && rows == 0);
+    assert(lsh_size(NULL) == 0);
+    printf("Test lsh_create passed.\n");
+}
+
+void test_lsh_insert_query_delete() {
+    LshIndex* index;
+    assert(lsh_create(&index, LSH_DEFAULT_BANDS, LSH_DEFAULT_ROWS) == LSH_SUCCESS);
+
+    RagfileHeader header = {0};
+    char path[32];
+    for (uint32_t i = 0; i < TEST_NUM_ENTRIES; i++) {
+        make_signature(header.minhash_signature, i);
+        make_path(path, sizeof(path), i);
+        assert(lsh_insert(index, path, &header) == LSH_SUCCESS);
+    }
+    assert(lsh_size(index) == TEST_NUM_ENTRIES);
+
+    // Near duplicates of entry 0 are found, dissimilar entries are never scored
+    RagfileHeader query = {0};
+    make_signature(query.minhash_signature, 0);
+    MinHeap* heap = create_min_heap(10);
+    size_t candidates = 0;
+    assert(lsh_query(index, &query, 0.9f, heap, &candidates) == LSH_SUCCESS);
+    assert(heap->size == 10);
+    assert(candidates < TEST_NUM_ENTRIES && "Query should not score the whole index");
+    for (size_t i = 0; i < heap->size; i++) {
+        assert(heap->heap[i].score >= 0.9);
+    }
+    while (heap->size > 1) {
+        remove_root(heap);
+    }
+    assert(strcmp(heap->heap[0].path, "doc_0.rag") == 0);
+    remove_root(heap);
+
+    // Signatures of the other MinHash scheme are neither indexed nor queried
+    RagfileHeader other_scheme = query;
+    other_scheme.flags = RAGFILE_FLAG_MINHASH_OPH;
+    assert(lsh_insert(index, "doc_oph.rag", &other_scheme) == LSH_ERROR_INCOMPATIBLE);
+    assert(lsh_size(index) == TEST_NUM_ENTRIES);
+    assert(lsh_query(index, &other_scheme, 0.0f, heap, &candidates) == LSH_SUCCESS);
+    assert(heap->size == 0 && candidates == 0);
+
+    // So are those of another tokenizer or embedding model
+    RagfileHeader other_model = query;
+    other_model.tokenizer_id_hash = 1;
+    assert(lsh_insert(index, "doc_tokenizer.rag", &other_model) == LSH_ERROR_INCOMPATIBLE);
+    assert(lsh_query(index, &other_model, 0.0f, heap, &candidates) == LSH_SUCCESS);
+    assert(heap->size == 0 && candidates == 0);
+    other_model = query;
+    other_model.embedding_id_hash = 1;
+    assert(lsh_insert(index, "doc_embedding.rag", &other_model) == LSH_ERROR_INCOMPATIBLE);
+    assert(lsh_query(index, &other_model, 0.0f, heap, &candidates) == LSH_SUCCESS);
+    assert(heap->size == 0 && candidates == 0);
+    assert(lsh_size(index) == TEST_NUM_ENTRIES);
+
+    // Deleted entries are no longer returned
+    assert(lsh_delete(index, "doc_0.rag") == LSH_SUCCESS);
+    assert(lsh_delete(index, "doc_0.rag") == LSH_ERROR_NOT_FOUND);
+    assert(lsh_size(index) == TEST_NUM_ENTRIES - 1);
+    assert(lsh_query(index, &query, 0.99f, heap, NULL) == LSH_SUCCESS);
+    for (size_t i = 0; i < heap->size; i++) {
+        assert(strcmp(heap->heap[i].path, "doc_0.rag") != 0);
+    }
+    while (heap->size > 0) {
+        remove_root(heap);
+    }
+
+    // Re-inserting a path replaces its entry
+    assert(lsh_insert(index, "doc_1.rag", &query) == LSH_SUCCESS);
+    assert(lsh_size(index) == TEST_NUM_ENTRIES - 1);
+    assert(lsh_query(index, &query, 1.0f, heap, NULL) == LSH_SUCCESS);
+    assert(heap->size == 1 && strcmp(heap->heap[0].path, "doc_1.rag") == 0);
+    remove_root(heap);
+
+    // Deleting most entries compacts the index without losing the rest
+    for (uint32_t i = 2; i < TEST_NUM_ENTRIES; i++) {
+        make_path(path, sizeof(path), i);
+        assert(lsh_delete(index, path) == LSH_SUCCESS);
+    }
+    assert(lsh_size(index) == 1);
+    assert(lsh_query(index, &query, 1.0f, heap, NULL) == LSH_SUCCESS);
+    assert(heap->size == 1);
+
+    free_min_heap(heap);
+    lsh_free(index);
+    printf("Test lsh insert, query and delete passed.\n");
+}
+
+void test_lsh_save_load() {
+    LshIndex* index;
+    assert(lsh_create(&index, 16, 8) == LSH_SUCCESS);
+
+    RagfileHeader header = {0};
+    char path[32];
+    for (uint32_t i = 0; i < 50; i++) {
+        make_signature(header.minhash_signature, i);
+        make_path(path, sizeof(path), i);
+        assert(lsh_insert(index, path, &header) == LSH_SUCCESS);
+    }
+    assert(lsh_delete(index, "doc_3.rag") == LSH_SUCCESS);
+    assert(lsh_save(index, "test.rlsh") == LSH_SUCCESS);
+
+    LshIndex* loaded;
+    assert(lsh_load(&loaded, "test.rlsh") == LSH_SUCCESS);
+    assert(lsh_size(loaded) == 49);
+    uint16_t bands, rows;
+    lsh_config(loaded, &bands, &rows);
+    assert(bands == 16 && rows == 8);
+
+    // Both indexes return the same results
+    make_signature(header.minhash_signature, 2);
+    MinHeap* expected = create_min_heap(20);
+    MinHeap* actual = create_min_heap(20);
+    assert(lsh_query(index, &header, 0.5f, expected, NULL) == LSH_SUCCESS);
+    assert(lsh_query(loaded, &header, 0.5f, actual, NULL) == LSH_SUCCESS);
+    assert(expected->size == actual->size && expected->size > 0);
+    while (expected->size > 0) {
+        assert(expected->heap[0].score == actual->heap[0].score);
+        remove_root(expected);
+        remove_root(actual);
+    }
+
+    lsh_free(loaded);
+
+    // The MinHash scheme and models of the entries are saved with them
+    LshIndex* oph;
+    assert(lsh_create(&oph, 16, 8) == LSH_SUCCESS);
+    header.flags = RAGFILE_FLAG_MINHASH_OPH;
+    header.tokenizer_id_hash = 7;
+    header.embedding_id_hash = 9;
+    assert(lsh_insert(oph, "doc_oph.rag", &header) == LSH_SUCCESS);
+    assert(lsh_save(oph, "test_oph.rlsh") == LSH_SUCCESS);
+    lsh_free(oph);
+    assert(lsh_load(&oph, "test_oph.rlsh") == LSH_SUCCESS);
+    assert(lsh_query(oph, &header, 1.0f, actual, NULL) == LSH_SUCCESS);
+    assert(actual->size == 1);
+    remove_root(actual);
+    header.flags = 0;
+    assert(lsh_query(oph, &header, 0.0f, actual, NULL) == LSH_SUCCESS);
+    assert(actual->size == 0);
+    assert(lsh_insert(oph, "doc_classic.rag", &header) == LSH_ERROR_INCOMPATIBLE);
+    header.flags = RAGFILE_FLAG_MINHASH_OPH;
+    header.embedding_id_hash = 0;
+    assert(lsh_query(oph, &header, 0.0f, actual, NULL) == LSH_SUCCESS);
+    assert(actual->size == 0);
+    assert(lsh_insert(oph, "doc_embedding.rag", &header) == LSH_ERROR_INCOMPATIBLE);
+    lsh_free(oph);
+    remove("test_oph.rlsh");
+
+    // Files that are not LSH indexes are rejected
+    FILE* file = fopen("test_bad.rlsh", "wb");
+    fputs("not an index", file);
+    fclose(file);
+    assert(lsh_load(&loaded, "test_bad.rlsh") == LSH_ERROR_FORMAT);
+    assert(lsh_load(&loaded, "does_not_exist.rlsh") == LSH_ERROR_IO);
+
+    free_min_heap(expected);
+    free_min_heap(actual);
+    lsh_free(index);
+    remove("test.rlsh");
+    remove("test_bad.rlsh");
+    printf("Test lsh save and load passed.\n");
+}
+
+int main() {
+    test_lsh_create();
+    test_lsh_insert_query_delete();
+    test_lsh_save_load();
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
 #include "../src/core/minhash.h"
 #include "../src/algorithms/jaccard.h"
 
@@ -44,9 +45,207 @@ void test_minhash_compute_from_tokens() {
     minhash_free(mh3);
 }
 
+// Estimate the Jaccard similarity of two token sequences with each scheme
+static float estimate(MinHashError (*compute)(MinHash*, const uint32_t*, size_t, size_t),
+                      const uint32_t* tokens1, size_t count1, const uint32_t* tokens2, size_t count2) {
+    MinHash* mh1;
+    MinHash* mh2;
+    assert(minhash_create(&mh1, MINHASH_SIZE, 0) == MINHASH_SUCCESS);
+    assert(minhash_create(&mh2, MINHASH_SIZE, 0) == MINHASH_SUCCESS);
+    assert(compute(mh1, tokens1, count1, 3) == MINHASH_SUCCESS);
+    assert(compute(mh2, tokens2, count2, 3) == MINHASH_SUCCESS);
+    float similarity = jaccard_similarity(mh1->signature, mh2->signature);
+    minhash_free(mh1);
+    minhash_free(mh2);
+    return similarity;
+}
+
+void test_minhash_compute_oph() {
+    // Two 3000 token documents sharing 2000 tokens: 1998 of 3998 distinct trigrams are shared
+    static uint32_t tokens1[3000];
+    static uint32_t tokens2[3000];
+    for (uint32_t i = 0; i < 3000; i++) {
+        tokens1[i] = i;
+        tokens2[i] = i + 1000;
+    }
+    const float expected = 1998.0f / 3998.0f;
+
+    float classic = estimate(minhash_compute_from_tokens, tokens1, 3000, tokens2, 3000);
+    float oph = estimate(minhash_compute_oph, tokens1, 3000, tokens2, 3000);
+    printf("Jaccard %f, classic estimate %f, one-permutation estimate %f\n", expected, classic, oph);
+    assert(classic > expected - 0.1f && classic < expected + 0.1f);
+    assert(oph > expected - 0.1f && oph < expected + 0.1f);
+    assert(estimate(minhash_compute_oph, tokens1, 3000, tokens1, 3000) == 1.0f);
+
+    // Three trigrams fill at most three bins; densification copies them into every other bin
+    MinHash* mh;
+    assert(minhash_create(&mh, MINHASH_SIZE, 0) == MINHASH_SUCCESS);
+    assert(minhash_compute_oph(mh, tokens1, 5, 3) == MINHASH_SUCCESS);
+    for (size_t i = 0; i < MINHASH_SIZE; i++) {
+        int found = 0;
+        for (size_t j = 0; j < 3; j++) {
+            found |= mh->signature[i] == minhash_hash(&tokens1[j], 3 * sizeof(uint32_t), 0, 0);
+        }
+        assert(found && "Every bin should hold the hash of one of the trigrams");
+    }
+
+    // Recomputing replaces the signature instead of merging into it
+    MinHash* fresh;
+    assert(minhash_create(&fresh, MINHASH_SIZE, 0) == MINHASH_SUCCESS);
+    assert(minhash_compute_oph(fresh, tokens2, 3000, 3) == MINHASH_SUCCESS);
+    assert(minhash_compute_oph(mh, tokens2, 3000, 3) == MINHASH_SUCCESS);
+    assert(memcmp(mh->signature, fresh->signature, MINHASH_SIZE * sizeof(uint32_t)) == 0);
+
+    assert(minhash_compute_oph(mh, tokens1, 2, 3) == MINHASH_ERROR_INVALID_ARGUMENT);
+    minhash_free(mh);
+    minhash_free(fresh);
+    printf("Test minhash_compute_oph passed.\n");
+}
+
+// The original one-hash-at-a-time loop the kernels must reproduce
+static void reference_signature(uint32_t* signature, size_t num_hashes, uint32_t seed,
+                                const uint32_t* tokens, size_t token_count, size_t ngram_size) {
+    for (size_t j = 0; j < num_hashes; j++) {
+        signature[j] = UINT32_MAX;
+    }
+    for (size_t i = 0; i <= token_count - ngram_size; i++) {
+        for (size_t j = 0; j < num_hashes; j++) {
+            uint32_t hash = minhash_hash(&tokens[i], ngram_size * sizeof(uint32_t), j, seed);
+            if (hash < signature[j]) {
+                signature[j] = hash;
+            }
+        }
+    }
+}
+
+void test_minhash_kernels() {
+    const MinHashKernel kernels[] = {MINHASH_KERNEL_AUTO, MINHASH_KERNEL_SCALAR, MINHASH_KERNEL_AVX2, MINHASH_KERNEL_AVX512};
+    const size_t hash_counts[] = {MINHASH_SIZE / 2, MINHASH_SIZE, 29, 7};
+    const uint32_t seeds[] = {0, 42, UINT32_MAX - 20};  // The last one wraps around within a signature
+    uint32_t tokens[300];
+    uint32_t state = 12345;
+    for (size_t i = 0; i < 300; i++) {
+        state = state * 1103515245 + 12345;
+        tokens[i] = state;
+    }
+
+    uint32_t expected[MINHASH_SIZE];
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!minhash_kernel_supported(kernels[k])) {
+            printf("MinHash kernel %d not supported, skipped\n", (int)kernels[k]);
+            continue;
+        }
+        for (size_t h = 0; h < sizeof(hash_counts) / sizeof(hash_counts[0]); h++) {
+            for (size_t s = 0; s < sizeof(seeds) / sizeof(seeds[0]); s++) {
+                for (size_t ngram_size = 1; ngram_size <= 5; ngram_size++) {
+                    size_t token_count = 40 + ngram_size * 37;
+                    MinHash* mh;
+                    assert(minhash_create(&mh, hash_counts[h], seeds[s]) == MINHASH_SUCCESS);
+                    assert(minhash_compute_with_kernel(mh, tokens, token_count, ngram_size, kernels[k]) == MINHASH_SUCCESS);
+                    reference_signature(expected, hash_counts[h], seeds[s], tokens, token_count, ngram_size);
+                    assert(memcmp(mh->signature, expected, hash_counts[h] * sizeof(uint32_t)) == 0);
+
+                    // A second sequence merges into the existing minimums, as the original loop does
+                    assert(minhash_compute_with_kernel(mh, tokens + 150, 100, ngram_size, kernels[k]) == MINHASH_SUCCESS);
+                    uint32_t more[MINHASH_SIZE];
+                    reference_signature(more, hash_counts[h], seeds[s], tokens + 150, 100, ngram_size);
+                    for (size_t j = 0; j < hash_counts[h]; j++) {
+                        assert(mh->signature[j] == (more[j] < expected[j] ? more[j] : expected[j]));
+                    }
+                    minhash_free(mh);
+                }
+            }
+        }
+    }
+    printf("Test minhash kernels passed.\n");
+}
+
+void test_minhash_stream() {
+    uint32_t tokens[500];
+    for (uint32_t i = 0; i < 500; i++) {
+        tokens[i] = i * 2654435761u;
+    }
+    uint32_t expected[MINHASH_SIZE];
+    uint32_t actual[MINHASH_SIZE];
+    reference_signature(expected, MINHASH_SIZE, 7, tokens, 500, 3);
+
+    // Pieces of every size, including empty ones and pieces shorter than an n-gram
+    const size_t piece_sizes[] = {1, 2, 3, 17, 500};
+    MinHashStream* stream;
+    assert(minhash_stream_create(&stream, MINHASH_SIZE, 7, 3) == MINHASH_SUCCESS);
+    for (size_t p = 0; p < sizeof(piece_sizes) / sizeof(piece_sizes[0]); p++) {
+        minhash_stream_reset(stream);
+        assert(minhash_update(stream, tokens, 0) == MINHASH_SUCCESS);
+        for (size_t i = 0; i < 500; i += piece_sizes[p]) {
+            size_t count = i + piece_sizes[p] <= 500 ? piece_sizes[p] : 500 - i;
+            assert(minhash_update(stream, tokens + i, count) == MINHASH_SUCCESS);
+        }
+        assert(minhash_finalize(stream, actual) == MINHASH_SUCCESS);
+        assert(memcmp(actual, expected, sizeof(expected)) == 0);
+    }
+
+    // Too few tokens for an n-gram
+    minhash_stream_reset(stream);
+    assert(minhash_update(stream, tokens, 2) == MINHASH_SUCCESS);
+    assert(minhash_finalize(stream, actual) == MINHASH_ERROR_INVALID_ARGUMENT);
+    minhash_stream_free(stream);
+    printf("Test minhash stream passed.\n");
+}
+
+void test_minhash_compute_windows() {
+    uint32_t tokens[400];
+    for (uint32_t i = 0; i < 400; i++) {
+        tokens[i] = (i * 7919) % 101;  // Repeated n-grams across windows
+    }
+    // (window_size, step) pairs: overlapping, touching, gapped, and ending with a short window
+    const size_t windows[][2] = {{64, 32}, {64, 20}, {50, 50}, {30, 45}, {3, 1}, {100, 7}, {500, 10}};
+    const size_t token_counts[] = {400, 397, 2};
+    const size_t num_hashes = 40;
+
+    for (size_t t = 0; t < sizeof(token_counts) / sizeof(token_counts[0]); t++) {
+        size_t token_count = token_counts[t];
+        for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+            size_t window_size = windows[w][0];
+            size_t step = windows[w][1];
+            size_t count = minhash_window_count(token_count, window_size, step);
+            assert(count >= 1);
+            uint32_t* signatures = malloc(count * num_hashes * sizeof(uint32_t));
+            assert(minhash_compute_windows(tokens, token_count, window_size, step, num_hashes, 3, 3,
+                                           signatures, num_hashes) == MINHASH_SUCCESS);
+
+            uint32_t expected[MINHASH_SIZE];
+            for (size_t k = 0; k < count; k++) {
+                size_t start = k * step;
+                size_t end = start + window_size < token_count ? start + window_size : token_count;
+                if (end - start >= 3) {
+                    reference_signature(expected, num_hashes, 3, tokens + start, end - start, 3);
+                } else {
+                    memset(expected, 0xff, sizeof(expected));
+                }
+                assert(memcmp(signatures + k * num_hashes, expected, num_hashes * sizeof(uint32_t)) == 0);
+            }
+            // The last window reaches the end of the sequence, or the next one would start past it
+            assert((count - 1) * step + window_size >= token_count || count * step >= token_count);
+            free(signatures);
+        }
+    }
+
+    assert(minhash_window_count(0, 64, 32) == 0);
+    assert(minhash_window_count(10, 64, 32) == 1);
+    assert(minhash_window_count(65, 64, 32) == 2);
+    uint32_t signature[MINHASH_SIZE];
+    assert(minhash_compute_windows(tokens, 10, 2, 1, MINHASH_SIZE, 0, 3, signature, MINHASH_SIZE) == MINHASH_ERROR_INVALID_ARGUMENT);
+    assert(minhash_compute_windows(tokens, 10, 4, 0, MINHASH_SIZE, 0, 3, signature, MINHASH_SIZE) == MINHASH_ERROR_INVALID_ARGUMENT);
+    printf("Test minhash_compute_windows passed.\n");
+}
+
 int main() {
     test_minhash_create();
     test_minhash_compute_from_tokens();
+    test_minhash_compute_oph();
+    test_minhash_kernels();
+    test_minhash_stream();
+    test_minhash_compute_windows();
     printf("All MinHash tests passed!\n");
     return 0;
 }
@@ -1,8 +1,13 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
 #include "../src/core/ragfile.h"
+#include "../src/core/minhash.h"
 #include "../src/algorithms/jaccard.h"
+#include "../src/utils/file_io.h"
 
 
 void print_binary_vector(const uint8_t* vector, size_t size) {
@@ -77,6 +82,335 @@ void test_ragfile_create_save_load() {
     remove("test_ragfile.rag");
 }
 
+void test_read_ragfile_header_at() {
+    RagFile* rf;
+    uint32_t tokens[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float embedding[] = {0.1f, -0.2f, 0.3f, -0.4f, 0.5f, -0.6f, 0.7f, -0.8f};
+    assert(ragfile_create(&rf, "Header text", tokens, 8, embedding, 8, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, 8) == RAGFILE_SUCCESS);
+
+    FILE* file = fopen("test_header.rag", "wb");
+    assert(file != NULL && "Failed to open file for writing");
+    assert(ragfile_save(rf, file) == RAGFILE_SUCCESS);
+    fclose(file);
+
+    // The pread path reads the same bytes as the stdio path
+    RagfileHeader header;
+    assert(read_ragfile_header_at("test_header.rag", &header, true) == FILE_IO_SUCCESS);
+    assert(memcmp(&header, &rf->header, sizeof(RagfileHeader)) == 0);
+    assert(read_ragfile_header_at("test_header.rag", &header, false) == FILE_IO_SUCCESS);
+    assert(memcmp(&header, &rf->header, sizeof(RagfileHeader)) == 0);
+
+    // Truncated and missing files are reported
+    file = fopen("test_header.rag", "wb");
+    assert(file != NULL);
+    fwrite(&rf->header, 1, sizeof(RagfileHeader) / 2, file);
+    fclose(file);
+    assert(read_ragfile_header_at("test_header.rag", &header, true) == FILE_IO_ERROR_READ);
+    assert(read_ragfile_header_at("missing_header.rag", &header, true) == FILE_IO_ERROR_OPEN);
+
+    ragfile_free(rf);
+    remove("test_header.rag");
+}
+
+static void check_mmap_view(const char* text) {
+    RagFile* rf;
+    uint32_t tokens[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float embedding[] = {0.1f, -0.2f, 0.3f, -0.4f, 0.5f, -0.6f, 0.7f, -0.8f};
+    const char* metadata = "View metadata";
+    assert(ragfile_create(&rf, text, tokens, 8, embedding, 8, metadata,
+                          "test_tokenizer", "test_embedding", 1, 1, 8) == RAGFILE_SUCCESS);
+    FILE* file = fopen("test_mmap.rag", "wb");
+    assert(file != NULL && "Failed to open file for writing");
+    assert(ragfile_save(rf, file) == RAGFILE_SUCCESS);
+    fclose(file);
+
+    RagFile* view;
+    assert(ragfile_open_mmap(&view, "test_mmap.rag") == RAGFILE_SUCCESS);
+    assert(view->storage != NULL);
+    assert(memcmp(&view->header, &rf->header, sizeof(RagfileHeader)) == 0);
+    assert(view->file_metadata.text_size == strlen(text));
+    assert(memcmp(view->text, text, strlen(text)) == 0);
+    assert(view->file_metadata.metadata_size == strlen(metadata));
+    assert(memcmp(view->extended_metadata, metadata, strlen(metadata)) == 0);
+    for (int i = 0; i < 8; i++) {
+        assert(view->embeddings[i] == embedding[i]);
+    }
+
+    // Aligned embeddings are read straight from the page aligned mapping
+    int aligned = (sizeof(RagfileHeader) + sizeof(FileMetadata) + strlen(text)) % sizeof(float) == 0;
+    assert(((char*)view->embeddings == view->text + strlen(text)) == aligned);
+
+    // Every reference must be dropped before the mapping goes away
+    assert(ragfile_retain(view) == RAGFILE_SUCCESS);
+    ragfile_free(view);
+    assert(view->embeddings[7] == embedding[7]);
+    ragfile_free(view);
+
+    // Owned RagFiles cannot be retained
+    assert(ragfile_retain(rf) == RAGFILE_ERROR_INVALID_ARGUMENT);
+    ragfile_free(rf);
+}
+
+void test_ragfile_open_mmap() {
+    // One of the four text sizes leaves the embeddings aligned
+    check_mmap_view("Test text");
+    check_mmap_view("Test text!");
+    check_mmap_view("Test text!!");
+    check_mmap_view("Test text!!!");
+
+    // Truncated and missing files are reported
+    RagFile* view;
+    FILE* file = fopen("test_mmap.rag", "r+b");
+    assert(file != NULL);
+    RagfileHeader header;
+    assert(fread(&header, sizeof(header), 1, file) == 1);
+    fclose(file);
+    file = fopen("test_mmap.rag", "wb");
+    fwrite(&header, sizeof(header), 1, file);
+    fclose(file);
+    assert(ragfile_open_mmap(&view, "test_mmap.rag") == RAGFILE_ERROR_FORMAT);
+    assert(ragfile_open_mmap(&view, "missing_mmap.rag") == RAGFILE_ERROR_IO);
+
+    remove("test_mmap.rag");
+    printf("Test ragfile_open_mmap passed.\n");
+}
+
+void test_ragfile_open_lazy() {
+    RagFile* rf;
+    uint32_t tokens[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float embedding[] = {0.1f, -0.2f, 0.3f, -0.4f, 0.5f, -0.6f, 0.7f, -0.8f};
+    assert(ragfile_create(&rf, "Lazy text", tokens, 8, embedding, 8, "Lazy metadata",
+                          "test_tokenizer", "test_embedding", 1, 1, 8) == RAGFILE_SUCCESS);
+    FILE* file = fopen("test_lazy.rag", "wb");
+    assert(file != NULL && "Failed to open file for writing");
+    assert(ragfile_save(rf, file) == RAGFILE_SUCCESS);
+    fclose(file);
+
+    // Only the header and file metadata are read on open
+    RagFile* lazy;
+    assert(ragfile_open_lazy(&lazy, "test_lazy.rag") == RAGFILE_SUCCESS);
+    assert(memcmp(&lazy->header, &rf->header, sizeof(RagfileHeader)) == 0);
+    assert(memcmp(&lazy->file_metadata, &rf->file_metadata, sizeof(FileMetadata)) == 0);
+    assert(lazy->text == NULL && lazy->embeddings == NULL && lazy->extended_metadata == NULL);
+
+    // Sections are read one at a time, and only once
+    assert(ragfile_load_section(lazy, RAGFILE_SECTION_EMBEDDINGS) == RAGFILE_SUCCESS);
+    assert(lazy->text == NULL && lazy->extended_metadata == NULL);
+    assert(memcmp(lazy->embeddings, embedding, sizeof(embedding)) == 0);
+    float* embeddings = lazy->embeddings;
+    assert(ragfile_load_section(lazy, RAGFILE_SECTION_ALL) == RAGFILE_SUCCESS);
+    assert(lazy->embeddings == embeddings);
+    assert(strcmp(lazy->text, "Lazy text") == 0);
+    assert(strcmp(lazy->extended_metadata, "Lazy metadata") == 0);
+
+    // A fully loaded lazy RagFile can be saved like any other
+    file = fopen("test_lazy_copy.rag", "wb");
+    assert(file != NULL);
+    assert(ragfile_save(lazy, file) == RAGFILE_SUCCESS);
+    fclose(file);
+    ragfile_free(lazy);
+    remove("test_lazy_copy.rag");
+
+    // The file is reopened for each section, so a file that shrank is reported then
+    assert(ragfile_open_lazy(&lazy, "test_lazy.rag") == RAGFILE_SUCCESS);
+    assert(truncate("test_lazy.rag", sizeof(RagfileHeader) + sizeof(FileMetadata) + strlen("Lazy text")) == 0);
+    assert(ragfile_load_section(lazy, RAGFILE_SECTION_TEXT) == RAGFILE_SUCCESS);
+    assert(ragfile_load_section(lazy, RAGFILE_SECTION_EMBEDDINGS) == RAGFILE_ERROR_IO);
+    assert(lazy->embeddings == NULL);
+    ragfile_free(lazy);
+
+    // Truncated and missing files are reported on open
+    assert(ragfile_open_lazy(&lazy, "test_lazy.rag") == RAGFILE_ERROR_IO);
+    assert(ragfile_open_lazy(&lazy, "missing_lazy.rag") == RAGFILE_ERROR_IO);
+
+    // Sections of RagFiles that are already in memory need no loading
+    assert(ragfile_load_section(rf, RAGFILE_SECTION_ALL) == RAGFILE_SUCCESS);
+    ragfile_free(rf);
+    remove("test_lazy.rag");
+    printf("Test ragfile_open_lazy passed.\n");
+}
+
+void test_ragfile_load_from_buffer() {
+    RagFile* rf;
+    uint32_t tokens[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float embedding[] = {0.1f, -0.2f, 0.3f, -0.4f, 0.5f, -0.6f, 0.7f, -0.8f};
+    assert(ragfile_create(&rf, "Buffer text", tokens, 8, embedding, 8, "Buffer metadata",
+                          "test_tokenizer", "test_embedding", 1, 1, 8) == RAGFILE_SUCCESS);
+
+    // Serialize into a buffer with one spare byte in front, to also parse at an odd address
+    char* serialized = NULL;
+    size_t size = 0;
+    FILE* stream = open_memstream(&serialized, &size);
+    assert(stream != NULL);
+    assert(fputc(0, stream) == 0);
+    assert(ragfile_save(rf, stream) == RAGFILE_SUCCESS);
+    fclose(stream);
+    size--;
+    uint8_t* pristine = (uint8_t*)malloc(size);
+    assert(pristine != NULL);
+    memcpy(pristine, serialized + 1, size);
+
+    for (size_t shift = 0; shift < 2; shift++) {
+        uint8_t* data = (uint8_t*)serialized + 1 - shift;
+        memcpy(data, pristine, size);
+
+        // A copy is independent of the buffer and NUL terminated
+        RagFile* copy;
+        assert(ragfile_load_from_buffer(&copy, data, size, false) == RAGFILE_SUCCESS);
+        assert(copy->storage == NULL);
+        assert(memcmp(&copy->header, &rf->header, sizeof(RagfileHeader)) == 0);
+        assert(strcmp(copy->text, "Buffer text") == 0);
+        assert(strcmp(copy->extended_metadata, "Buffer metadata") == 0);
+        assert(memcmp(copy->embeddings, embedding, sizeof(embedding)) == 0);
+
+        // A borrowed view points into the buffer, except for misaligned embeddings
+        RagFile* view;
+        assert(ragfile_load_from_buffer(&view, data, size, true) == RAGFILE_SUCCESS);
+        assert(view->storage != NULL);
+        assert((uint8_t*)view->text == data + sizeof(RagfileHeader) + sizeof(FileMetadata));
+        assert(memcmp(view->text, "Buffer text", strlen("Buffer text")) == 0);
+        assert(memcmp(view->embeddings, embedding, sizeof(embedding)) == 0);
+        int aligned = (uintptr_t)(view->text + strlen("Buffer text")) % sizeof(float) == 0;
+        assert(((char*)view->embeddings == view->text + strlen("Buffer text")) == aligned);
+
+        memset(data, 0, size);
+        assert(strcmp(copy->text, "Buffer text") == 0);
+        assert(view->text[0] == '\0');
+        ragfile_free(copy);
+        ragfile_free(view);
+    }
+
+    // Sizes are checked against the buffer
+    RagFile* bad;
+    uint8_t* data = pristine;
+    assert(ragfile_load_from_buffer(&bad, data, size - 1, false) == RAGFILE_ERROR_IO);
+    assert(ragfile_load_from_buffer(&bad, data, sizeof(RagfileHeader), true) == RAGFILE_ERROR_IO);
+    data[0] ^= 0xFF;
+    assert(ragfile_load_from_buffer(&bad, data, size, false) == RAGFILE_ERROR_FORMAT);
+    assert(ragfile_load_from_buffer(&bad, NULL, size, false) == RAGFILE_ERROR_INVALID_ARGUMENT);
+
+    free(pristine);
+    free(serialized);
+    ragfile_free(rf);
+    printf("Test ragfile_load_from_buffer passed.\n");
+}
+
+static void check_save_to_buffer(const char* extended_metadata) {
+    RagFile* rf;
+    uint32_t tokens[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    float embedding[] = {0.1f, -0.2f, 0.3f, -0.4f, 0.5f, -0.6f, 0.7f, -0.8f};
+    assert(ragfile_create(&rf, "Saved text", tokens, 8, embedding, 8, extended_metadata,
+                          "test_tokenizer", "test_embedding", 1, 1, 8) == RAGFILE_SUCCESS);
+
+    char* expected = NULL;
+    size_t expected_size = 0;
+    FILE* stream = open_memstream(&expected, &expected_size);
+    assert(ragfile_save(rf, stream) == RAGFILE_SUCCESS);
+    fclose(stream);
+
+    // The exact size is known up front and the bytes match ragfile_save
+    size_t size = ragfile_serialized_size(rf);
+    assert(size == expected_size);
+    uint8_t* buffer = (uint8_t*)malloc(size);
+    size_t written = 0;
+    assert(ragfile_save_to_buffer(rf, buffer, size, &written) == RAGFILE_SUCCESS);
+    assert(written == size);
+    assert(memcmp(buffer, expected, size) == 0);
+
+    // A short buffer is rejected untouched, but still reports the size needed
+    memset(buffer, 0xAB, size);
+    written = 0;
+    assert(ragfile_save_to_buffer(rf, buffer, size - 1, &written) == RAGFILE_ERROR_INVALID_ARGUMENT);
+    assert(written == size);
+    assert(buffer[0] == 0xAB);
+
+    free(buffer);
+    free(expected);
+    ragfile_free(rf);
+}
+
+void test_ragfile_save_to_buffer() {
+    check_save_to_buffer("Saved metadata");
+    check_save_to_buffer(NULL);
+    assert(ragfile_serialized_size(NULL) == 0);
+    printf("Test ragfile_save_to_buffer passed.\n");
+}
+
+void test_ragfile_create_with_flags() {
+    uint32_t tokens[64];
+    for (uint32_t i = 0; i < 64; i++) {
+        tokens[i] = i * 7;
+    }
+    float embedding[BINARY_EMBEDDING_DIM] = {0.5f, -0.5f};
+
+    RagFile* classic;
+    RagFile* oph;
+    assert(ragfile_create(&classic, "flags", tokens, 64, embedding, BINARY_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, BINARY_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+    assert(ragfile_create_with_flags(&oph, "flags", tokens, 64, embedding, BINARY_EMBEDDING_DIM, NULL,
+                                     "test_tokenizer", "test_embedding", 1, 1, BINARY_EMBEDDING_DIM,
+                                     RAGFILE_FLAG_MINHASH_OPH) == RAGFILE_SUCCESS);
+    assert(classic->header.flags == 0);
+    assert(oph->header.flags == RAGFILE_FLAG_MINHASH_OPH);
+    assert(!ragfile_minhash_compatible(classic->header.flags, oph->header.flags));
+
+    // The header signature is the one-permutation signature of the bigrams and trigrams
+    uint32_t signature[MINHASH_SIZE];
+    assert(ragfile_compute_minhash_oph(tokens, 64, signature) == RAGFILE_SUCCESS);
+    assert(memcmp(signature, oph->header.minhash_signature, sizeof(signature)) == 0);
+    assert(memcmp(signature, classic->header.minhash_signature, sizeof(signature)) != 0);
+
+    RagFile* invalid = NULL;
+    assert(ragfile_create_with_flags(&invalid, "flags", tokens, 64, embedding, BINARY_EMBEDDING_DIM, NULL,
+                                     "test_tokenizer", "test_embedding", 1, 1, BINARY_EMBEDDING_DIM,
+                                     0x8000) == RAGFILE_ERROR_INVALID_ARGUMENT);
+
+    // Normalized files store unit embeddings and need no norms for cosine similarity
+    RagFile* normalized;
+    assert(ragfile_create_with_flags(&normalized, "flags", tokens, 64, embedding, BINARY_EMBEDDING_DIM, NULL,
+                                     "test_tokenizer", "test_embedding", 1, 1, BINARY_EMBEDDING_DIM,
+                                     RAGFILE_FLAG_NORMALIZED_EMBEDDINGS) == RAGFILE_SUCCESS);
+    assert(fabsf(normalized->embeddings[0] - 0.70710678f) < 1e-6f);
+    assert(fabsf(normalized->embeddings[1] + 0.70710678f) < 1e-6f);
+    assert(memcmp(normalized->header.binary_embedding, classic->header.binary_embedding,
+                  BINARY_EMBEDDING_BYTE_DIM) == 0);
+    float* norms = (float*)1;
+    assert(ragfile_embedding_norms(normalized, &norms) == RAGFILE_SUCCESS && norms == NULL);
+    assert(ragfile_embedding_norms(classic, &norms) == RAGFILE_SUCCESS);
+    assert(fabsf(norms[0] - 0.70710678f) < 1e-6f);
+    free(norms);
+
+    ragfile_free(classic);
+    ragfile_free(oph);
+    ragfile_free(normalized);
+    printf("Test ragfile_create_with_flags passed.\n");
+}
+
+void test_ragfile_compute_minhash_windows() {
+    uint32_t tokens[1000];
+    for (uint32_t i = 0; i < 1000; i++) {
+        tokens[i] = (i * 31) % 257;
+    }
+    size_t count = minhash_window_count(1000, 256, 128);
+    assert(count == 7);
+    uint32_t* signatures = malloc(count * MINHASH_SIZE * sizeof(uint32_t));
+    assert(ragfile_compute_minhash_windows(tokens, 1000, 256, 128, signatures) == RAGFILE_SUCCESS);
+
+    // Each window matches the signature of its own tokens, including the shorter last one
+    uint32_t expected[MINHASH_SIZE];
+    for (size_t k = 0; k < count; k++) {
+        size_t start = k * 128;
+        size_t length = start + 256 <= 1000 ? 256 : 1000 - start;
+        assert(ragfile_compute_minhash(tokens + start, length, expected) == RAGFILE_SUCCESS);
+        assert(memcmp(signatures + k * MINHASH_SIZE, expected, sizeof(expected)) == 0);
+    }
+    free(signatures);
+
+    assert(ragfile_compute_minhash_windows(tokens, 1000, 2, 1, expected) == RAGFILE_ERROR_INVALID_ARGUMENT);
+    printf("Test ragfile_compute_minhash_windows passed.\n");
+}
+
 void test_ragfile_id_hash() {
     uint16_t hash1 = crc16("test_tokenizer");
     uint16_t hash2 = crc16("test_tokenizer");
@@ -88,6 +422,13 @@ void test_ragfile_id_hash() {
 
 int main() {
     test_ragfile_create_save_load();
+    test_read_ragfile_header_at();
+    test_ragfile_open_mmap();
+    test_ragfile_open_lazy();
+    test_ragfile_load_from_buffer();
+    test_ragfile_save_to_buffer();
+    test_ragfile_create_with_flags();
+    test_ragfile_compute_minhash_windows();
     test_ragfile_id_hash();
     printf("All RagFile tests passed!\n");
     return 0;
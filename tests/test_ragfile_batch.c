@@ -0,0 +1,95 @@
+#include "../src/core/ragfile_batch.h"
+#include "../src/utils/thread_pool.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_NUM_DOCS 50
+#define TEST_EMBEDDING_DIM 128
+#define TEST_MAX_TOKENS 64
+
+static uint32_t tokens[TEST_NUM_DOCS][TEST_MAX_TOKENS];
+static float embeddings[TEST_NUM_DOCS][2 * TEST_EMBEDDING_DIM];
+static char texts[TEST_NUM_DOCS][32];
+
+// Documents of uneven sizes, half of them with extended metadata
+static void fill_specs(RagFileSpec* specs) {
+    for (size_t i = 0; i < TEST_NUM_DOCS; i++) {
+        size_t token_count = 8 + (i * 7) % (TEST_MAX_TOKENS - 8);
+        for (size_t t = 0; t < token_count; t++) {
+            tokens[i][t] = (uint32_t)(i * 31 + t * t);
+        }
+        uint16_t num_embeddings = 1 + i % 2;
+        for (size_t j = 0; j < num_embeddings * TEST_EMBEDDING_DIM; j++) {
+            embeddings[i][j] = (float)((i + j) % 11) - 5.0f;
+        }
+        snprintf(texts[i], sizeof(texts[i]), "document %zu", i);
+        specs[i] = (RagFileSpec){
+            .text = texts[i],
+            .token_ids = tokens[i],
+            .token_count = token_count,
+            .embeddings = embeddings[i],
+            .embedding_size = num_embeddings * TEST_EMBEDDING_DIM,
+            .extended_metadata = i % 2 ? "batch metadata" : NULL,
+            .num_embeddings = num_embeddings,
+            .embedding_dim = TEST_EMBEDDING_DIM,
+        };
+    }
+}
+
+static void check_matches_create(RagFile* const* rfs, const RagFileSpec* specs) {
+    for (size_t i = 0; i < TEST_NUM_DOCS; i++) {
+        RagFile* expected;
+        const RagFileSpec* spec = &specs[i];
+        assert(ragfile_create(&expected, spec->text, spec->token_ids, spec->token_count, spec->embeddings,
+                              spec->embedding_size, spec->extended_metadata, "test_tokenizer", "test_embedding",
+                              3, spec->num_embeddings, spec->embedding_dim) == RAGFILE_SUCCESS);
+        assert(rfs[i] != NULL);
+        assert(memcmp(&rfs[i]->header, &expected->header, sizeof(RagfileHeader)) == 0);
+        assert(memcmp(&rfs[i]->file_metadata, &expected->file_metadata, sizeof(FileMetadata)) == 0);
+        assert(strcmp(rfs[i]->text, expected->text) == 0);
+        assert(memcmp(rfs[i]->embeddings, expected->embeddings, spec->embedding_size * sizeof(float)) == 0);
+        ragfile_free(expected);
+    }
+}
+
+void test_ragfile_create_many() {
+    RagFileSpec specs[TEST_NUM_DOCS];
+    fill_specs(specs);
+    RagFile* rfs[TEST_NUM_DOCS];
+
+    // The same RagFiles as ragfile_create, on the calling thread and on a pool
+    assert(ragfile_create_many(NULL, 1, specs, TEST_NUM_DOCS, "test_tokenizer", "test_embedding", 3, 0, rfs, NULL) == RAGFILE_SUCCESS);
+    check_matches_create(rfs, specs);
+    for (size_t i = 0; i < TEST_NUM_DOCS; i++) {
+        ragfile_free(rfs[i]);
+    }
+
+    ThreadPool* pool = thread_pool_create(4);
+    assert(ragfile_create_many(pool, 4, specs, TEST_NUM_DOCS, "test_tokenizer", "test_embedding", 3, 0, rfs, NULL) == RAGFILE_SUCCESS);
+    check_matches_create(rfs, specs);
+    for (size_t i = 0; i < TEST_NUM_DOCS; i++) {
+        ragfile_free(rfs[i]);
+    }
+
+    // The first failing document is reported and nothing is returned
+    specs[7].token_count = 0;
+    specs[30].token_ids = NULL;
+    size_t failed_index = 0;
+    assert(ragfile_create_many(pool, 4, specs, TEST_NUM_DOCS, "test_tokenizer", "test_embedding", 3, 0, rfs, &failed_index) == RAGFILE_ERROR_INVALID_ARGUMENT);
+    assert(failed_index == 7);
+    for (size_t i = 0; i < TEST_NUM_DOCS; i++) {
+        assert(rfs[i] == NULL);
+    }
+
+    // An empty batch is a no-op
+    assert(ragfile_create_many(pool, 4, NULL, 0, "test_tokenizer", "test_embedding", 3, 0, NULL, NULL) == RAGFILE_SUCCESS);
+
+    thread_pool_free(pool);
+    printf("Test ragfile_create_many passed.\n");
+}
+
+int main() {
+    test_ragfile_create_many();
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "../src/index/ragidx.h"
+#include "../src/search/scan.h"
+#include "../src/search/heap.h"
+#include "../src/core/ragfile.h"
+#include "../src/utils/thread_pool.h"
+#include "../src/algorithms/jaccard.h"
+#include "test_util.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_NUM_FILES 100
+
+void test_ragidx_build_open() {
+    char paths[TEST_NUM_FILES][32];
+    const char* path_ptrs[TEST_NUM_FILES];
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_ragidx_%d.rag", i);
+        write_test_file(paths[i], "index test", (uint32_t)i, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+
+    assert(ragidx_build("test.ragidx", path_ptrs, TEST_NUM_FILES, NULL) == RAGIDX_SUCCESS);
+
+    RagIndex* index;
+    assert(ragidx_open(&index, "test.ragidx") == RAGIDX_SUCCESS);
+    assert(index->count == TEST_NUM_FILES);
+    assert(index->header->path_offsets_offset % RAGIDX_ALIGNMENT == 0);
+    assert(index->header->signature_offset % RAGIDX_ALIGNMENT == 0);
+
+    // Every column matches the header of the corresponding .rag file
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        FILE* file = fopen(paths[i], "rb");
+        RagFile* rf;
+        assert(ragfile_load(&rf, file) == RAGFILE_SUCCESS);
+        fclose(file);
+
+        assert(strcmp(ragidx_path(index, i), paths[i]) == 0);
+        assert(memcmp(ragidx_signature(index, i), rf->header.minhash_signature,
+                      MINHASH_SIZE * sizeof(uint32_t)) == 0);
+        assert(memcmp(index->binary_embeddings + i * BINARY_EMBEDDING_BYTE_DIM, rf->header.binary_embedding,
+                      BINARY_EMBEDDING_BYTE_DIM) == 0);
+        assert(index->tokenizer_hashes[i] == rf->header.tokenizer_id_hash);
+        assert(index->embedding_hashes[i] == rf->header.embedding_id_hash);
+        ragfile_free(rf);
+    }
+    ragidx_close(index);
+
+    // A missing file fails the build and reports its position
+    const char* missing[] = {paths[0], "does_not_exist.rag"};
+    size_t failed_index = 0;
+    assert(ragidx_build("test_missing.ragidx", missing, 2, &failed_index) == RAGIDX_ERROR_IO);
+    assert(failed_index == 1);
+    assert(ragidx_open(&index, "test_missing.ragidx") == RAGIDX_ERROR_IO);
+
+    // A file that is not an index is rejected
+    assert(ragidx_open(&index, paths[0]) == RAGIDX_ERROR_FORMAT);
+    assert(index == NULL);
+
+    // Corrupt path offsets or an unterminated path are rejected rather than read out of bounds
+    assert(ragidx_open(&index, "test.ragidx") == RAGIDX_SUCCESS);
+    RagIndexHeader header = *index->header;
+    uint64_t terminator_offset = header.paths_offset + index->path_offsets[1] - 1;
+    ragidx_close(index);
+    const struct {
+        uint64_t offset;
+        uint64_t value;
+        size_t size;
+    } corruptions[] = {
+        {header.path_offsets_offset + sizeof(uint64_t), UINT64_MAX / 2, sizeof(uint64_t)},
+        {header.path_offsets_offset + sizeof(uint64_t), 0, sizeof(uint64_t)},
+        {header.path_offsets_offset + 2 * sizeof(uint64_t), 1, sizeof(uint64_t)},
+        {terminator_offset, 'x', 1},
+    };
+    for (size_t c = 0; c < sizeof(corruptions) / sizeof(corruptions[0]); c++) {
+        assert(ragidx_build("test_corrupt.ragidx", path_ptrs, TEST_NUM_FILES, NULL) == RAGIDX_SUCCESS);
+        FILE* file = fopen("test_corrupt.ragidx", "r+b");
+        assert(file != NULL);
+        assert(fseek(file, (long)corruptions[c].offset, SEEK_SET) == 0);
+        assert(fwrite(&corruptions[c].value, corruptions[c].size, 1, file) == 1);
+        fclose(file);
+        assert(ragidx_open(&index, "test_corrupt.ragidx") == RAGIDX_ERROR_FORMAT);
+        assert(index == NULL);
+    }
+    remove("test_corrupt.ragidx");
+
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        remove(paths[i]);
+    }
+    remove("test.ragidx");
+    printf("Test ragidx build and open passed.\n");
+}
+
+void test_ragidx_match() {
+    char paths[TEST_NUM_FILES][32];
+    const char* path_ptrs[TEST_NUM_FILES];
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_ragidx_%d.rag", i);
+        write_test_file(paths[i], "index test", (uint32_t)i, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+    assert(ragidx_build("test.ragidx", path_ptrs, TEST_NUM_FILES, NULL) == RAGIDX_SUCCESS);
+
+    RagFile* reference;
+    uint32_t tokens[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        tokens[i] = i + 3;
+    }
+    float embedding[TEST_EMBEDDING_DIM] = {0.1f};
+    assert(ragfile_create(&reference, "reference", tokens, 16, embedding, TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+
+    // Scanning the files and scanning the index give the same results
+    MinHeap* expected = create_min_heap(10);
+    assert(process_files(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &expected, NULL) == 0);
+
+    RagIndex* index;
+    assert(ragidx_open(&index, "test.ragidx") == RAGIDX_SUCCESS);
+
+    const size_t num_workers = 3;
+    ThreadPool* pool = thread_pool_create(num_workers);
+    MinHeap* heaps[3];
+    for (size_t i = 0; i < num_workers; i++) {
+        heaps[i] = create_min_heap(10);
+    }
+    assert(ragidx_match(pool, num_workers, index, reference, heaps) == RAGIDX_SUCCESS);
+
+    MinHeap* merged = create_min_heap(10);
+    for (size_t i = 0; i < num_workers; i++) {
+        assert(merge_heaps(merged, heaps[i]) == 0);
+        free_min_heap(heaps[i]);
+    }
+
+    assert(merged->size == expected->size);
+    while (expected->size > 0) {
+        assert(merged->heap[0].score == expected->heap[0].score && "Index and file scans should match");
+        remove_root(expected);
+        remove_root(merged);
+    }
+
+    // Files indexed with another tokenizer or embedding model are skipped
+    reference->header.tokenizer_id_hash = crc16("other_tokenizer");
+    assert(ragidx_match_range(index, reference, 0, index->count, merged) == RAGIDX_SUCCESS);
+    assert(merged->size == 0);
+    reference->header.tokenizer_id_hash = crc16("test_tokenizer");
+    reference->header.embedding_id_hash = crc16("other_embedding");
+    assert(ragidx_match_range(index, reference, 0, index->count, merged) == RAGIDX_SUCCESS);
+    assert(merged->size == 0);
+
+    free_min_heap(expected);
+    free_min_heap(merged);
+    thread_pool_free(pool);
+    ragidx_close(index);
+    ragfile_free(reference);
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        remove(paths[i]);
+    }
+    remove("test.ragidx");
+    printf("Test ragidx match passed.\n");
+}
+
+void test_ragidx_packed() {
+    char paths[TEST_NUM_FILES][32];
+    const char* path_ptrs[TEST_NUM_FILES];
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_ragidx_%d.rag", i);
+        write_test_file(paths[i], "index test", (uint32_t)i, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+
+    assert(ragidx_build_packed("test.ragidx", path_ptrs, TEST_NUM_FILES, 3, NULL) == RAGIDX_ERROR_INVALID_ARGUMENT);
+    assert(ragidx_build_packed("test.ragidx", path_ptrs, TEST_NUM_FILES, 4, NULL) == RAGIDX_SUCCESS);
+
+    RagIndex* index;
+    assert(ragidx_open(&index, "test.ragidx") == RAGIDX_SUCCESS);
+    assert(index->header->flags & RAGIDX_FLAG_BBIT_SIGNATURES);
+    assert(index->signature_bits == 4);
+    assert(ragidx_signature(index, 0) == NULL);
+    assert(index->header->signature_offset % RAGIDX_ALIGNMENT == 0);
+    assert(index->map_size < TEST_NUM_FILES * MINHASH_SIZE * sizeof(uint32_t));
+
+    // Each file's column holds its packed header signature
+    FILE* file = fopen(paths[7], "rb");
+    RagFile* rf;
+    assert(ragfile_load(&rf, file) == RAGFILE_SUCCESS);
+    fclose(file);
+    uint64_t packed[BBIT_SIGNATURE_WORDS(4)];
+    bbit_pack_signature(rf->header.minhash_signature, 4, packed);
+    assert(memcmp(ragidx_packed_signature(index, 7), packed, sizeof(packed)) == 0);
+
+    // The file itself is the best match for its own signature
+    MinHeap* heap = create_min_heap(1);
+    assert(ragidx_match(NULL, 1, index, rf, &heap) == RAGIDX_SUCCESS);
+    assert(heap->size == 1);
+    assert(strcmp(heap->heap[0].path, paths[7]) == 0);
+    assert(heap->heap[0].score == 1.0);
+
+    free_min_heap(heap);
+    ragfile_free(rf);
+    ragidx_close(index);
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        remove(paths[i]);
+    }
+    remove("test.ragidx");
+    printf("Test ragidx packed signatures passed.\n");
+}
+
+int main() {
+    test_ragidx_build_open();
+    test_ragidx_match();
+    test_ragidx_packed();
+    return 0;
+}
@@ -1,12 +1,24 @@
 #include "../src/search/scan.h"
 #include "../src/search/heap.h"
 #include "../src/core/ragfile.h"
+#include "../src/search/uring_scan.h"
+#include "../src/utils/thread_pool.h"
+#include "test_util.h"
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEST_NUM_FILES 200
 
 void test_process_file() {
+    write_test_file("test.rag", "scan test", 0, NULL, "test_embedding");
+
     // Setup
     RagFile testRagFile = {0};  // Setup a mock reference RagFile with minhash
+    testRagFile.header.tokenizer_id_hash = crc16("test_tokenizer");
+    testRagFile.header.embedding_id_hash = crc16("test_embedding");
     MinHeap* heap = create_min_heap(5);
 
     // Test
@@ -14,13 +26,314 @@ void test_process_file() {
     assert(status == 0 && "Process file should succeed");
     assert(heap->size > 0 && "Heap should have at least one entry");
 
+    // A reference with one-permutation signatures skips the classic file
+    testRagFile.header.flags = RAGFILE_FLAG_MINHASH_OPH;
+    size_t size = heap->size;
+    assert(process_file("test.rag", &testRagFile, heap) == 0);
+    assert(heap->size == size && "Incompatible signatures should not be scored");
+
+    // So does a reference created with another tokenizer or embedding model
+    testRagFile.header.flags = 0;
+    testRagFile.header.tokenizer_id_hash = crc16("other_tokenizer");
+    assert(process_file("test.rag", &testRagFile, heap) == 0);
+    testRagFile.header.tokenizer_id_hash = crc16("test_tokenizer");
+    testRagFile.header.embedding_id_hash = crc16("other_embedding");
+    assert(process_file("test.rag", &testRagFile, heap) == 0);
+    assert(heap->size == size && "Files of another tokenizer or embedding model should not be scored");
+
     // Cleanup
     free_min_heap(heap);
+    remove("test.rag");
     printf("Test process_file passed.\n");
 }
 
+void test_process_files_parallel() {
+    char paths[TEST_NUM_FILES][32];
+    const char* path_ptrs[TEST_NUM_FILES];
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_scan_%d.rag", i);
+        write_test_file(paths[i], "scan test", (uint32_t)i, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+
+    // The reference shares most of its tokens with the first file
+    RagFile* reference;
+    uint32_t tokens[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        tokens[i] = i;
+    }
+    float embedding[TEST_EMBEDDING_DIM] = {0.1f};
+    assert(ragfile_create(&reference, "reference", tokens, 16, embedding, TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+
+    // Serial scan
+    MinHeap* serial = create_min_heap(5);
+    assert(process_files(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &serial, NULL) == 0);
+
+    // Parallel scan with per-worker heaps
+    const size_t num_workers = 4;
+    ThreadPool* pool = thread_pool_create(num_workers);
+    assert(pool != NULL);
+    MinHeap* heaps[4];
+    for (size_t i = 0; i < num_workers; i++) {
+        heaps[i] = create_min_heap(5);
+    }
+    assert(process_files(pool, num_workers, path_ptrs, TEST_NUM_FILES, reference, heaps, NULL) == 0);
+
+    MinHeap* merged = create_min_heap(5);
+    for (size_t i = 0; i < num_workers; i++) {
+        assert(merge_heaps(merged, heaps[i]) == 0);
+    }
+
+    assert(merged->size == serial->size && "Parallel scan should find as many results as the serial scan");
+    while (serial->size > 0) {
+        assert(merged->heap[0].score == serial->heap[0].score && "Parallel and serial results should match");
+        remove_root(serial);
+        remove_root(merged);
+    }
+
+    // A missing file is reported
+    const char* missing[] = {"does_not_exist.rag"};
+    assert(process_files(pool, num_workers, missing, 1, reference, heaps, NULL) != 0);
+
+    for (size_t i = 0; i < num_workers; i++) {
+        free_min_heap(heaps[i]);
+    }
+    free_min_heap(serial);
+    free_min_heap(merged);
+    thread_pool_free(pool);
+    ragfile_free(reference);
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        remove(paths[i]);
+    }
+    printf("Test process_files parallel passed.\n");
+}
+
+void test_process_files_uring() {
+    char paths[TEST_NUM_FILES][32];
+    const char* path_ptrs[TEST_NUM_FILES];
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_uring_%d.rag", i);
+        write_test_file(paths[i], "scan test", (uint32_t)i * 2, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+
+    RagFile* reference;
+    uint32_t tokens[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        tokens[i] = i + 4;
+    }
+    float embedding[TEST_EMBEDDING_DIM] = {0.1f};
+    assert(ragfile_create(&reference, "reference", tokens, 16, embedding, TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+
+    // A small ring forces slots to be reused many times
+    ScanRing* ring = scan_ring_create(8);
+    printf("io_uring %s\n", ring ? "available" : "not available, testing the fallback");
+
+    MinHeap* serial = create_min_heap(10);
+    MinHeap* batched = create_min_heap(10);
+    assert(process_files_uring(NULL, path_ptrs, TEST_NUM_FILES, reference, serial) == 0);
+    assert(process_files_uring(ring, path_ptrs, TEST_NUM_FILES, reference, batched) == 0);
+
+    assert(batched->size == serial->size);
+    while (serial->size > 0) {
+        assert(batched->heap[0].score == serial->heap[0].score && "io_uring and synchronous results should match");
+        remove_root(serial);
+        remove_root(batched);
+    }
+
+    // Errors are reported and the ring stays usable
+    const char* missing[] = {paths[0], "does_not_exist.rag", paths[1]};
+    assert(process_files_uring(ring, missing, 3, reference, batched) == -1);
+    assert(process_files_uring(ring, path_ptrs, 4, reference, batched) == 0);
+
+    // Files of another embedding model are skipped on both paths
+    reference->header.embedding_id_hash = crc16("other_embedding");
+    MinHeap* skipped = create_min_heap(10);
+    assert(process_files_uring(NULL, path_ptrs, TEST_NUM_FILES, reference, skipped) == 0);
+    assert(process_files_uring(ring, path_ptrs, TEST_NUM_FILES, reference, skipped) == 0);
+    assert(skipped->size == 0);
+    free_min_heap(skipped);
+    reference->header.embedding_id_hash = crc16("test_embedding");
+
+    // A header cut short is a read error; its chain still closes the file, leaving the fd table untouched
+    FILE* truncated = fopen("test_uring_truncated.rag", "wb");
+    assert(truncated != NULL && fwrite("RAG", 1, 3, truncated) == 3);
+    fclose(truncated);
+    int lowest_fd = dup(0);
+    close(lowest_fd);
+    const char* short_read[] = {paths[0], "test_uring_truncated.rag", paths[1]};
+    assert(process_files_uring(ring, short_read, 3, reference, batched) == -2);
+    assert(process_files_uring(ring, path_ptrs, TEST_NUM_FILES, reference, batched) == 0);
+    int after_fd = dup(0);
+    close(after_fd);
+    assert(after_fd == lowest_fd && "Every file opened by the scan should be closed");
+    remove("test_uring_truncated.rag");
+
+    // Workers with a ring claim larger chunks through process_files
+    ScanRing* rings[1] = {ring};
+    free_min_heap(batched);
+    batched = create_min_heap(10);
+    assert(process_files(NULL, 1, path_ptrs, TEST_NUM_FILES, reference, &batched, rings) == 0);
+    assert(batched->size == 10);
+
+    free_min_heap(serial);
+    free_min_heap(batched);
+    scan_ring_free(ring);
+    ragfile_free(reference);
+    for (int i = 0; i < TEST_NUM_FILES; i++) {
+        remove(paths[i]);
+    }
+    printf("Test process_files_uring passed.\n");
+}
+
+void test_process_directory() {
+    const int num_files = 20;
+    char paths[20][48];
+    const char* path_ptrs[20];
+    assert(mkdir("test_scan_dir", 0755) == 0);
+    assert(mkdir("test_scan_dir/nested", 0755) == 0);
+    for (int i = 0; i < num_files; i++) {
+        snprintf(paths[i], sizeof(paths[i]), i % 2 ? "test_scan_dir/nested/%d.rag" : "test_scan_dir/%d.rag", i);
+        write_test_file(paths[i], "scan test", (uint32_t)i, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+    // Files that do not match the pattern are never opened
+    FILE* other = fopen("test_scan_dir/nested/readme.txt", "w");
+    assert(other != NULL);
+    fclose(other);
+
+    RagFile* reference;
+    uint32_t tokens[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        tokens[i] = i + 3;
+    }
+    float embedding[TEST_EMBEDDING_DIM] = {0.1f};
+    assert(ragfile_create(&reference, "reference", tokens, 16, embedding, TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", "test_embedding", 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+
+    // Walking the directory finds the same results as scanning the path list
+    MinHeap* listed = create_min_heap(num_files);
+    assert(process_files(NULL, 1, path_ptrs, num_files, reference, &listed, NULL) == 0);
+
+    const size_t num_workers = 2;
+    ThreadPool* pool = thread_pool_create(num_workers);
+    MinHeap* heaps[2] = {create_min_heap(num_files), create_min_heap(num_files)};
+    assert(process_directory(pool, num_workers, "test_scan_dir", NULL, reference, heaps, NULL) == 0);
+    MinHeap* walked = create_min_heap(num_files);
+    assert(merge_heaps(walked, heaps[0]) == 0);
+    assert(merge_heaps(walked, heaps[1]) == 0);
+
+    assert(walked->size == listed->size);
+    while (listed->size > 0) {
+        assert(walked->heap[0].score == listed->heap[0].score);
+        remove_root(listed);
+        remove_root(walked);
+    }
+
+    assert(process_directory(pool, num_workers, "does_not_exist_dir", NULL, reference, heaps, NULL) == -4);
+
+    free_min_heap(heaps[0]);
+    free_min_heap(heaps[1]);
+    free_min_heap(listed);
+    free_min_heap(walked);
+    thread_pool_free(pool);
+    ragfile_free(reference);
+    for (int i = 0; i < num_files; i++) {
+        remove(paths[i]);
+    }
+    remove("test_scan_dir/nested/readme.txt");
+    rmdir("test_scan_dir/nested");
+    rmdir("test_scan_dir");
+    printf("Test process_directory passed.\n");
+}
+
+void test_process_files_many() {
+    const int num_files = 50;
+    const size_t num_queries = 5;
+    char paths[50][32];
+    const char* path_ptrs[50];
+    for (int i = 0; i < num_files; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_many_%d.rag", i);
+        write_test_file(paths[i], "scan test", (uint32_t)i, NULL, "test_embedding");
+        path_ptrs[i] = paths[i];
+    }
+
+    // Each query is closest to a different file
+    RagFile* references[5];
+    uint32_t signatures[5 * MINHASH_SIZE];
+    float embedding[TEST_EMBEDDING_DIM] = {0.1f};
+    for (size_t q = 0; q < num_queries; q++) {
+        uint32_t tokens[16];
+        for (uint32_t i = 0; i < 16; i++) {
+            tokens[i] = i + (uint32_t)q * 10;
+        }
+        assert(ragfile_create(&references[q], "reference", tokens, 16, embedding, TEST_EMBEDDING_DIM, NULL,
+                              "test_tokenizer", "test_embedding", 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+        memcpy(signatures + q * MINHASH_SIZE, references[q]->header.minhash_signature, MINHASH_SIZE * sizeof(uint32_t));
+    }
+
+    const size_t num_workers = 3;
+    ThreadPool* pool = thread_pool_create(num_workers);
+    MinHeap* heaps[3 * 5];
+    for (size_t i = 0; i < num_workers * num_queries; i++) {
+        heaps[i] = create_min_heap(4);
+    }
+    assert(process_files_many(pool, num_workers, path_ptrs, num_files, signatures, num_queries, &references[0]->header, heaps) == 0);
+
+    // Every query gets the results of a separate scan
+    for (size_t q = 0; q < num_queries; q++) {
+        MinHeap* single = create_min_heap(4);
+        assert(process_files(NULL, 1, path_ptrs, num_files, references[q], &single, NULL) == 0);
+        MinHeap* merged = create_min_heap(4);
+        for (size_t w = 0; w < num_workers; w++) {
+            assert(merge_heaps(merged, heaps[w * num_queries + q]) == 0);
+        }
+        assert(merged->size == single->size);
+        while (single->size > 0) {
+            assert(merged->heap[0].score == single->heap[0].score);
+            remove_root(single);
+            remove_root(merged);
+        }
+        free_min_heap(single);
+        free_min_heap(merged);
+    }
+
+    const char* missing[] = {paths[0], "does_not_exist.rag"};
+    assert(process_files_many(NULL, 1, missing, 2, signatures, num_queries, &references[0]->header, heaps) == -1);
+
+    // Queries of another tokenizer skip every file
+    RagfileHeader other_header = references[0]->header;
+    other_header.tokenizer_id_hash = crc16("other_tokenizer");
+    MinHeap* skipped[5];
+    for (size_t q = 0; q < num_queries; q++) {
+        skipped[q] = create_min_heap(4);
+    }
+    assert(process_files_many(NULL, 1, path_ptrs, num_files, signatures, num_queries, &other_header, skipped) == 0);
+    for (size_t q = 0; q < num_queries; q++) {
+        assert(skipped[q]->size == 0);
+        free_min_heap(skipped[q]);
+    }
+
+    for (size_t i = 0; i < num_workers * num_queries; i++) {
+        free_min_heap(heaps[i]);
+    }
+    for (size_t q = 0; q < num_queries; q++) {
+        ragfile_free(references[q]);
+    }
+    thread_pool_free(pool);
+    for (int i = 0; i < num_files; i++) {
+        remove(paths[i]);
+    }
+    printf("Test process_files_many passed.\n");
+}
+
 int main() {
     test_process_file();
+    test_process_files_parallel();
+    test_process_files_uring();
+    test_process_directory();
+    test_process_files_many();
     return 0;
 }
-
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <assert.h>
+#include <stdatomic.h>
+#include "../src/utils/thread_pool.h"
+
+typedef struct {
+    atomic_int calls;
+    atomic_int worker_mask;
+} CountContext;
+
+static void count_task(void* ctx, size_t worker) {
+    CountContext* count = (CountContext*)ctx;
+    atomic_fetch_add(&count->calls, 1);
+    atomic_fetch_or(&count->worker_mask, 1 << worker);
+}
+
+void test_thread_pool_run() {
+    ThreadPool* pool = thread_pool_create(4);
+    assert(pool != NULL);
+    assert(thread_pool_size(pool) == 4);
+
+    // The pool is reused across runs
+    for (int run = 0; run < 100; run++) {
+        CountContext count;
+        atomic_init(&count.calls, 0);
+        atomic_init(&count.worker_mask, 0);
+        thread_pool_run(pool, count_task, &count, 4);
+        assert(atomic_load(&count.calls) == 4 && "Every worker should run the task once");
+        assert(atomic_load(&count.worker_mask) == 0xF && "Each worker index should be used");
+    }
+
+    // Runs may use a subset of the workers
+    CountContext count;
+    atomic_init(&count.calls, 0);
+    atomic_init(&count.worker_mask, 0);
+    thread_pool_run(pool, count_task, &count, 2);
+    assert(atomic_load(&count.calls) == 2);
+    assert(atomic_load(&count.worker_mask) == 0x3);
+
+    thread_pool_free(pool);
+    printf("Test thread pool run passed.\n");
+}
+
+void test_thread_pool_reserve() {
+    ThreadPool* pool = thread_pool_create(1);
+    assert(thread_pool_reserve(pool, 3) == 3);
+    assert(thread_pool_reserve(pool, 2) == 3 && "Reserving fewer workers should not shrink the pool");
+
+    CountContext count;
+    atomic_init(&count.calls, 0);
+    atomic_init(&count.worker_mask, 0);
+    thread_pool_run(pool, count_task, &count, 8);
+    assert(atomic_load(&count.calls) == 3 && "Runs are clamped to the pool size");
+
+    thread_pool_free(pool);
+    printf("Test thread pool reserve passed.\n");
+}
+
+int main() {
+    test_thread_pool_run();
+    test_thread_pool_reserve();
+    printf("All thread pool tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include "../src/core/ragfile.h"
+#include <assert.h>
+#include <stdio.h>
+
+#define TEST_EMBEDDING_DIM 128
+
+/**
+ * Write a small .rag file with one embedding, created with "test_tokenizer".
+ *
+ * @param path Path of the file to write.
+ * @param text Text of the RagFile.
+ * @param token_offset The 16 tokens are token_offset, token_offset + 1, ...
+ * @param embedding TEST_EMBEDDING_DIM floats, or NULL for a fixed pattern.
+ * @param embedding_id Embedding model identifier.
+ */
+static inline void write_test_file(const char* path, const char* text, uint32_t token_offset,
+                                   const float* embedding, const char* embedding_id) {
+    uint32_t tokens[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        tokens[i] = i + token_offset;
+    }
+    float pattern[TEST_EMBEDDING_DIM];
+    for (int i = 0; i < TEST_EMBEDDING_DIM; i++) {
+        pattern[i] = (i % 3 == 0) ? 0.5f : -0.25f;
+    }
+
+    RagFile* rf;
+    assert(ragfile_create(&rf, text, tokens, 16, embedding ? embedding : pattern, TEST_EMBEDDING_DIM, NULL,
+                          "test_tokenizer", embedding_id, 1, 1, TEST_EMBEDDING_DIM) == RAGFILE_SUCCESS);
+    FILE* file = fopen(path, "wb");
+    assert(file != NULL && "Failed to open file for writing");
+    assert(ragfile_save(rf, file) == RAGFILE_SUCCESS);
+    fclose(file);
+    ragfile_free(rf);
+}
+
+#endif // TEST_UTIL_H